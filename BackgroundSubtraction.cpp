@@ -49,6 +49,14 @@ void BackgroundSubtraction::StartTraining(TrainingSet *sampleSet) {
     assert(FALSE);
 }
 
+Classifier* BackgroundSubtraction::CreateStreamInstance() {
+	// there is no trained model to share, just a background to learn for each stream
+	BackgroundSubtraction *instance = new BackgroundSubtraction();
+	instance->InitStreamInstance(this);
+	instance->isTrained = false;
+	return instance;
+}
+
 ClassifierOutputData BackgroundSubtraction::ClassifyFrame(IplImage *frame) {
 	cvZero(guessMask);
     if(!frame) return outputData;
@@ -80,11 +88,10 @@ ClassifierOutputData BackgroundSubtraction::ClassifyFrame(IplImage *frame) {
         // update background model
         cvUpdateBGStatModel(smallFrameCopy, bgmodel);
 
-        // close the foreground mask
-		cvCopy(bgmodel->foreground, fgMaskSmall);
-		IplConvKernel *circElem = cvCreateStructuringElementEx(3,3,1,1,CV_SHAPE_ELLIPSE);        
-		cvMorphologyEx(fgMaskSmall, fgMaskSmall, 0, circElem, CV_MOP_CLOSE, 3);
-		cvReleaseStructuringElement(&circElem);
+        // close the foreground mask (packed, one bit per pixel)
+		closeMask.FromImage(bgmodel->foreground);
+		closeMask.Close(3);
+		closeMask.ToImage(fgMaskSmall);
 
 		// copy the final output mask
 		cvResize(fgMaskSmall, guessMask);
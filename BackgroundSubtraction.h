@@ -1,5 +1,6 @@
 #pragma once
 #include "Classifier.h"
+#include "BitMask.h"
 
 class BackgroundSubtraction : public Classifier {
 public:
@@ -12,9 +13,11 @@ public:
 	ClassifierOutputData ClassifyFrame(IplImage*);
     void Save();
 	void ResetRunningState();
+	Classifier* CreateStreamInstance();
 
 private:
     long frameNum;
     CvBGStatModel* bgmodel;
 	IplImage *smallFrameCopy, *fgMaskSmall;
+	BitMask closeMask;
 };
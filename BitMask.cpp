@@ -0,0 +1,332 @@
+#include "precomp.h"
+#include "BitMask.h"
+
+#if defined(_M_IX86) || defined(_M_X64) || defined(__SSE2__)
+#define BITMASK_SSE2
+#include <emmintrin.h>
+#endif
+
+BitMask::BitMask() {
+	width = height = 0;
+	wordsPerRow = 0;
+	buffer = bits = scratch = NULL;
+}
+
+BitMask::~BitMask() {
+	Release();
+}
+
+void BitMask::Release() {
+	delete[] buffer;
+	buffer = bits = scratch = NULL;
+	width = height = wordsPerRow = 0;
+}
+
+void BitMask::Create(int newWidth, int newHeight) {
+	if ((newWidth == width) && (newHeight == height) && (buffer != NULL)) {
+		Clear();
+		return;
+	}
+	Release();
+	width = newWidth;
+	height = newHeight;
+	wordsPerRow = ((width+127)/128)*4;
+
+	// 3 extra words are enough to line the rows up on 16 bytes
+	int nWords = wordsPerRow*(height+3);
+	buffer = new unsigned int[nWords+3];
+	bits = (unsigned int*)(((size_t)buffer + 15) & ~(size_t)15);
+	scratch = bits + wordsPerRow*height;
+	memset(bits, 0, nWords*sizeof(unsigned int));
+}
+
+void BitMask::Clear() {
+	memset(bits, 0, wordsPerRow*height*sizeof(unsigned int));
+}
+
+void BitMask::Fill() {
+	memset(bits, 0xFF, wordsPerRow*height*sizeof(unsigned int));
+	ClearPadding();
+}
+
+void BitMask::CopyFrom(const BitMask &src) {
+	if ((src.width != width) || (src.height != height) || (buffer == NULL)) Create(src.width, src.height);
+	memcpy(bits, src.bits, wordsPerRow*height*sizeof(unsigned int));
+}
+
+void BitMask::ClearPadding() {
+	int lastWord = width/32;
+	unsigned int lastBits = (width%32) ? ((1u << (width%32)) - 1) : 0;
+	for (int y=0; y<height; y++) {
+		unsigned int *row = Row(y);
+		if (lastWord < wordsPerRow) {
+			row[lastWord] &= lastBits;
+			for (int i=lastWord+1; i<wordsPerRow; i++) row[i] = 0;
+		}
+	}
+}
+
+void BitMask::Invert() {
+	int n = wordsPerRow*height;
+#ifdef BITMASK_SSE2
+	__m128i ones = _mm_set1_epi32(-1);
+	for (int i=0; i<n; i+=4) {
+		__m128i *p = (__m128i*)(bits+i);
+		_mm_store_si128(p, _mm_xor_si128(_mm_load_si128(p), ones));
+	}
+#else
+	for (int i=0; i<n; i++) bits[i] = ~bits[i];
+#endif
+}
+
+void BitMask::FromImage(const CvArr *src, int thresh) {
+	CvMat stub;
+	CvMat *mat = cvGetMat(src, &stub);
+	if ((mat->cols != width) || (mat->rows != height) || (buffer == NULL)) Create(mat->cols, mat->rows);
+
+	// nothing is above 255, and everything is above a negative threshold
+	if (thresh >= 255) {
+		Clear();
+		return;
+	} else if (thresh < 0) {
+		Fill();
+		return;
+	}
+
+#ifdef BITMASK_SSE2
+	// SSE2 only compares signed bytes, so flip the top bit of both sides first
+	__m128i bias = _mm_set1_epi8((char)0x80);
+	__m128i limit = _mm_set1_epi8((char)(thresh ^ 0x80));
+#endif
+	for (int y=0; y<height; y++) {
+		const unsigned char *p = mat->data.ptr + y*mat->step;
+		unsigned int *row = Row(y);
+		int x = 0;
+#ifdef BITMASK_SSE2
+		for (; x+32<=width; x+=32) {
+			__m128i a = _mm_xor_si128(_mm_loadu_si128((const __m128i*)(p+x)), bias);
+			__m128i b = _mm_xor_si128(_mm_loadu_si128((const __m128i*)(p+x+16)), bias);
+			unsigned int lo = (unsigned int)_mm_movemask_epi8(_mm_cmpgt_epi8(a, limit));
+			unsigned int hi = (unsigned int)_mm_movemask_epi8(_mm_cmpgt_epi8(b, limit));
+			row[x/32] = lo | (hi << 16);
+		}
+#endif
+		for (int i=x/32; i<wordsPerRow; i++) row[i] = 0;
+		for (; x<width; x++) {
+			if (p[x] > thresh) row[x/32] |= 1u << (x%32);
+		}
+	}
+}
+
+void BitMask::ToImage(CvArr *dst) {
+	CvMat stub;
+	CvMat *mat = cvGetMat(dst, &stub);
+	assert((mat->cols == width) && (mat->rows == height));
+
+#ifdef BITMASK_SSE2
+	// spread 16 bits over 16 bytes, then pick out each byte's own bit
+	__m128i select = _mm_setr_epi8(1, 2, 4, 8, 16, 32, 64, (char)128, 1, 2, 4, 8, 16, 32, 64, (char)128);
+#endif
+	for (int y=0; y<height; y++) {
+		unsigned char *p = mat->data.ptr + y*mat->step;
+		const unsigned int *row = Row(y);
+		int x = 0;
+#ifdef BITMASK_SSE2
+		for (; x+16<=width; x+=16) {
+			__m128i v = _mm_cvtsi32_si128((row[x/32] >> (x%32)) & 0xFFFF);
+			v = _mm_unpacklo_epi8(v, v);
+			v = _mm_unpacklo_epi16(v, v);
+			v = _mm_unpacklo_epi32(v, v);
+			v = _mm_cmpeq_epi8(_mm_and_si128(v, select), select);
+			_mm_storeu_si128((__m128i*)(p+x), v);
+		}
+#endif
+		for (; x<width; x++) {
+			p[x] = ((row[x/32] >> (x%32)) & 1) ? 0xFF : 0;
+		}
+	}
+}
+
+void BitMask::And(const BitMask &other) {
+	assert((other.width == width) && (other.height == height));
+	int n = wordsPerRow*height;
+#ifdef BITMASK_SSE2
+	for (int i=0; i<n; i+=4) {
+		__m128i *p = (__m128i*)(bits+i);
+		_mm_store_si128(p, _mm_and_si128(_mm_load_si128(p), _mm_load_si128((const __m128i*)(other.bits+i))));
+	}
+#else
+	for (int i=0; i<n; i++) bits[i] &= other.bits[i];
+#endif
+}
+
+void BitMask::Or(const BitMask &other) {
+	assert((other.width == width) && (other.height == height));
+	int n = wordsPerRow*height;
+#ifdef BITMASK_SSE2
+	for (int i=0; i<n; i+=4) {
+		__m128i *p = (__m128i*)(bits+i);
+		_mm_store_si128(p, _mm_or_si128(_mm_load_si128(p), _mm_load_si128((const __m128i*)(other.bits+i))));
+	}
+#else
+	for (int i=0; i<n; i++) bits[i] |= other.bits[i];
+#endif
+}
+
+void BitMask::AndNot(const BitMask &other) {
+	assert((other.width == width) && (other.height == height));
+	int n = wordsPerRow*height;
+#ifdef BITMASK_SSE2
+	for (int i=0; i<n; i+=4) {
+		__m128i *p = (__m128i*)(bits+i);
+		_mm_store_si128(p, _mm_andnot_si128(_mm_load_si128((const __m128i*)(other.bits+i)), _mm_load_si128(p)));
+	}
+#else
+	for (int i=0; i<n; i++) bits[i] &= ~other.bits[i];
+#endif
+}
+
+// One step of dilation by the cross: each pixel is or'ed with its four neighbours.  Pixels
+// outside the mask count as clear, which is the same as OpenCV replicating the border, since
+// the cross always includes the pixel the border would be copied from.
+void BitMask::DilateOnce() {
+	unsigned int *above = scratch;
+	unsigned int *current = scratch + wordsPerRow;
+	unsigned int *zeros = scratch + 2*wordsPerRow;
+	memset(above, 0, wordsPerRow*sizeof(unsigned int));
+	memset(zeros, 0, wordsPerRow*sizeof(unsigned int));
+
+	for (int y=0; y<height; y++) {
+		unsigned int *row = Row(y);
+		const unsigned int *below = (y+1 < height) ? Row(y+1) : zeros;
+		memcpy(current, row, wordsPerRow*sizeof(unsigned int));
+#ifdef BITMASK_SSE2
+		__m128i zero = _mm_setzero_si128();
+		__m128i prev = zero;
+		__m128i v = _mm_load_si128((const __m128i*)current);
+		for (int i=0; i<wordsPerRow; i+=4) {
+			__m128i next = (i+4 < wordsPerRow) ? _mm_load_si128((const __m128i*)(current+i+4)) : zero;
+
+			// pixel x takes x-1: shift left one bit, carrying the top bit of the word before
+			__m128i carry = _mm_or_si128(_mm_slli_si128(v, 4), _mm_srli_si128(prev, 12));
+			__m128i left = _mm_or_si128(_mm_slli_epi32(v, 1), _mm_srli_epi32(carry, 31));
+
+			// pixel x takes x+1: shift right one bit, carrying the bottom bit of the word after
+			carry = _mm_or_si128(_mm_srli_si128(v, 4), _mm_slli_si128(next, 12));
+			__m128i right = _mm_or_si128(_mm_srli_epi32(v, 1), _mm_slli_epi32(carry, 31));
+
+			__m128i vertical = _mm_or_si128(_mm_load_si128((const __m128i*)(above+i)), _mm_load_si128((const __m128i*)(below+i)));
+			_mm_store_si128((__m128i*)(row+i), _mm_or_si128(_mm_or_si128(v, vertical), _mm_or_si128(left, right)));
+			prev = v;
+			v = next;
+		}
+#else
+		for (int i=0; i<wordsPerRow; i++) {
+			unsigned int w = current[i];
+			unsigned int left = (w << 1) | ((i > 0) ? (current[i-1] >> 31) : 0);
+			unsigned int right = (w >> 1) | ((i+1 < wordsPerRow) ? (current[i+1] << 31) : 0);
+			row[i] = w | left | right | above[i] | below[i];
+		}
+#endif
+		// the unchanged row is the one above the next
+		unsigned int *swap = above;
+		above = current;
+		current = swap;
+	}
+
+	// the last column may have spread into the padding
+	ClearPadding();
+}
+
+void BitMask::Dilate(int iterations) {
+	for (int i=0; i<iterations; i++) DilateOnce();
+}
+
+void BitMask::Erode(int iterations) {
+	// eroding the mask is dilating its background; the padding stays clear so that pixels outside
+	// the mask count as set, which again matches OpenCV's replicated border
+	Invert();
+	ClearPadding();
+	Dilate(iterations);
+	Invert();
+	ClearPadding();
+}
+
+void BitMask::Close(int iterations) {
+	Dilate(iterations);
+	Erode(iterations);
+}
+
+int BitMask::CountPixels() {
+	int n = wordsPerRow*height;
+#ifdef BITMASK_SSE2
+	// count the bits in each byte, then add the bytes up
+	__m128i m1 = _mm_set1_epi8(0x55), m2 = _mm_set1_epi8(0x33), m4 = _mm_set1_epi8(0x0F);
+	__m128i zero = _mm_setzero_si128();
+	__m128i total = zero;
+	for (int i=0; i<n; i+=4) {
+		__m128i x = _mm_load_si128((const __m128i*)(bits+i));
+		x = _mm_sub_epi8(x, _mm_and_si128(_mm_srli_epi64(x, 1), m1));
+		x = _mm_add_epi8(_mm_and_si128(x, m2), _mm_and_si128(_mm_srli_epi64(x, 2), m2));
+		x = _mm_and_si128(_mm_add_epi8(x, _mm_srli_epi64(x, 4)), m4);
+		total = _mm_add_epi64(total, _mm_sad_epu8(x, zero));
+	}
+	return _mm_cvtsi128_si32(total) + _mm_cvtsi128_si32(_mm_srli_si128(total, 8));
+#else
+	int count = 0;
+	for (int i=0; i<n; i++) {
+		unsigned int x = bits[i];
+		x = x - ((x >> 1) & 0x55555555);
+		x = (x & 0x33333333) + ((x >> 2) & 0x33333333);
+		x = (x + (x >> 4)) & 0x0F0F0F0F;
+		count += (x * 0x01010101) >> 24;
+	}
+	return count;
+#endif
+}
+
+bool BitMask::IsEmpty() {
+	int n = wordsPerRow*height;
+#ifdef BITMASK_SSE2
+	__m128i zero = _mm_setzero_si128();
+	for (int i=0; i<n; i+=4) {
+		__m128i x = _mm_load_si128((const __m128i*)(bits+i));
+		if (_mm_movemask_epi8(_mm_cmpeq_epi8(x, zero)) != 0xFFFF) return false;
+	}
+#else
+	for (int i=0; i<n; i++) {
+		if (bits[i] != 0) return false;
+	}
+#endif
+	return true;
+}
+
+void BitMask::ScaleTo(BitMask &dst) {
+	if ((dst.width == width) && (dst.height == height)) {
+		dst.CopyFrom(*this);
+		return;
+	}
+	columnMap.resize(dst.width);
+	for (int x=0; x<dst.width; x++) {
+		columnMap[x] = x*width/dst.width;
+	}
+
+	int lastSrcY = -1;
+	for (int y=0; y<dst.height; y++) {
+		int srcY = y*height/dst.height;
+		unsigned int *out = dst.Row(y);
+
+		// rows that come from the same source row are just copies of the one before
+		if (srcY == lastSrcY) {
+			memcpy(out, dst.Row(y-1), dst.wordsPerRow*sizeof(unsigned int));
+			continue;
+		}
+		const unsigned int *in = Row(srcY);
+		memset(out, 0, dst.wordsPerRow*sizeof(unsigned int));
+		for (int x=0; x<dst.width; x++) {
+			int sx = columnMap[x];
+			out[x/32] |= ((in[sx/32] >> (sx%32)) & 1) << (x%32);
+		}
+		lastSrcY = srcY;
+	}
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+// A binary mask packed one bit per pixel (pixel x of a row is bit x%32 of word x/32), for
+// combining, closing and counting masks without touching a byte per pixel.  Rows are padded
+// to whole 128 bit vectors, and the padding bits are always kept clear.  The kernels use SSE2
+// where it's available, with plain integer versions that give the same results elsewhere.
+//
+// Masks come from and go back to 8 bit IplImages (0 or 0xFF) at the edges, where OpenCV needs them.
+class BitMask
+{
+public:
+	BitMask();
+	~BitMask();
+
+	// (re)allocates the mask if the size changed, leaving it cleared
+	void Create(int width, int height);
+	int GetWidth() const { return width; }
+	int GetHeight() const { return height; }
+	const unsigned int* GetRow(int y) const { return Row(y); }
+	unsigned int* GetRow(int y) { return Row(y); }	// writers must leave the padding bits clear
+
+	void Clear();	// no pixels set
+	void Fill();	// every pixel set
+	void CopyFrom(const BitMask &src);	// (re)creates this mask at the size of src
+
+	// conversions from and to 8 bit single channel images or CvMat regions of the same size:
+	// a pixel is set where the image is above thresh, and set pixels are written as 0xFF
+	void FromImage(const CvArr *src, int thresh = 0);
+	void ToImage(CvArr *dst);
+
+	// combine with another mask of the same size
+	void And(const BitMask &other);
+	void Or(const BitMask &other);
+	void AndNot(const BitMask &other);	// clears the pixels that are set in other
+
+	// morphology with the 3x3 cross that cvCreateStructuringElementEx(3,3,1,1,CV_SHAPE_ELLIPSE)
+	// makes, with the same results as cvDilate, cvErode and cvMorphologyEx(CV_MOP_CLOSE) on the image
+	void Dilate(int iterations = 1);
+	void Erode(int iterations = 1);
+	void Close(int iterations = 1);
+
+	int CountPixels();
+	bool IsEmpty();
+
+	// nearest neighbour rescale into dst, which keeps its own size
+	void ScaleTo(BitMask &dst);
+
+private:
+	BitMask(const BitMask&);
+	void operator=(const BitMask&);
+
+	void Release();
+	void Invert();
+	void ClearPadding();
+	void DilateOnce();
+	unsigned int* Row(int y) const { return bits + y*wordsPerRow; }
+
+	int width, height;
+	int wordsPerRow;		// always a multiple of 4
+	unsigned int *buffer;	// the allocation, holding the rows and three rows of scratch space
+	unsigned int *bits;		// 16 byte aligned start of the rows
+	unsigned int *scratch;	// the rows above and at the one being dilated, and a row of zeros
+	vector<int> columnMap;	// source column of each destination column, for ScaleTo
+};
@@ -4,6 +4,7 @@
 #include "TrainingSet.h"
 #include "Classifier.h"
 #include "BrightnessClassifier.h"
+#include "FusedMaskEvaluator.h"
 
 BrightnessClassifier::BrightnessClassifier() :
 	Classifier() {
@@ -15,9 +16,15 @@ BrightnessClassifier::BrightnessClassifier() :
 	float* hranges = hranges_arr;
 	hist = cvCreateHist( 1, &hdims, CV_HIST_ARRAY, &hranges, 1 );
 
+	// working images are allocated on the first frame
+	image = backproject = newMask = NULL;
+	levels = levelBackproject = NULL;
+	storage = cvCreateMemStorage(0);
+
     // set the default "friendly name" and type
     wcscpy(friendlyName, L"Brightness Filter");
     classifierType = BRIGHTNESS_FILTER;
+    workingWidth = BRIGHTNESS_WORKING_WIDTH;
     
     // append identifier to directory name
     wcscat(directoryName, FILE_BRIGHTNESS_SUFFIX);
@@ -35,6 +42,11 @@ BrightnessClassifier::BrightnessClassifier(LPCWSTR pathname) :
 	float* hranges = hranges_arr;
 	hist = cvCreateHist( 1, &hdims, CV_HIST_ARRAY, &hranges, 1 );
 
+	// working images are allocated on the first frame
+	image = backproject = newMask = NULL;
+	levels = levelBackproject = NULL;
+	storage = cvCreateMemStorage(0);
+
     WCHAR filename[MAX_PATH];
     wcscpy(filename, pathname);
     wcscat(filename, FILE_DATA_NAME);
@@ -53,6 +65,7 @@ BrightnessClassifier::BrightnessClassifier(LPCWSTR pathname) :
 
 	// set the type
 	classifierType = BRIGHTNESS_FILTER;
+	workingWidth = BRIGHTNESS_WORKING_WIDTH;
 	
 	UpdateHistogramImage();
 }
@@ -60,6 +73,13 @@ BrightnessClassifier::BrightnessClassifier(LPCWSTR pathname) :
 BrightnessClassifier::~BrightnessClassifier() {
 	// free histogram
 	cvReleaseHist(&hist);
+
+	cvReleaseImage(&image);
+	cvReleaseImage(&backproject);
+	cvReleaseImage(&newMask);
+	cvReleaseImage(&levels);
+	cvReleaseImage(&levelBackproject);
+	cvReleaseMemStorage(&storage);
 }
 
 BOOL BrightnessClassifier::ContainsSufficientSamples(TrainingSet *sampleSet) {
@@ -103,54 +123,107 @@ void BrightnessClassifier::StartTraining(TrainingSet *sampleSet) {
 	isTrained = true;
 }
 
-ClassifierOutputData BrightnessClassifier::ClassifyFrame(IplImage *frame) {
-	cvZero(guessMask);
-	if (!isTrained) return outputData;
-    if(!frame) return outputData;
-
-    IplImage *image = cvCreateImage( cvGetSize(frame), IPL_DEPTH_8U, 3 );
-    IplImage *brightness = cvCreateImage( cvGetSize(frame), IPL_DEPTH_8U, 1 );
-	IplImage *backproject = cvCreateImage( cvGetSize(frame), IPL_DEPTH_8U, 1 );
-    IplImage *newMask = cvCreateImage( cvGetSize(frame), IPL_DEPTH_8U, 1 );
-    cvZero(newMask);
-
-    cvCopy(frame, image, 0);
-    cvCvtColor(image, brightness, CV_BGR2GRAY);
-
-	// create backprojection image
-    cvCalcBackProject(&brightness, backproject, hist);
-
-    // copy back projection into demo image
-    cvCvtColor(backproject, image, CV_GRAY2BGR);
+Classifier* BrightnessClassifier::CreateStreamInstance() {
+	BrightnessClassifier *instance = new BrightnessClassifier();
+	instance->InitStreamInstance(this);
+	return instance;
+}
 
-    // create contour storage
-    CvMemStorage* storage = cvCreateMemStorage(0);
-	CvSeq* contours = NULL;
+ClassifierOutputData BrightnessClassifier::ClassifyFrame(IplImage *frame) {
+	frameContext.SetFrame(frame);
+	return ClassifyFrame(&frameContext);
+}
 
-	// threhold the backprojection image
-	cvThreshold(backproject, backproject, threshold*255, 255, CV_THRESH_BINARY);
+ClassifierOutputData BrightnessClassifier::ClassifyFrame(FrameContext *context) {
+	return ClassifyPixelMasks(context, NULL);
+}
 
-    // close the backprojection image
-    IplConvKernel *circElem = cvCreateStructuringElementEx(3,3,1,1,CV_SHAPE_ELLIPSE);        
-    cvMorphologyEx(backproject, backproject, 0, circElem, CV_MOP_CLOSE, 2);
-	cvReleaseStructuringElement(&circElem);
+bool BrightnessClassifier::GetPixelTest(PixelTest &test) {
+	if (!isTrained || !FusedMaskEvaluator::GrayMatchesOpenCV()) return false;
 
-    // find contours in backprojection image
-    cvFindContours( backproject, storage, &contours, sizeof(CvContour),
-                    CV_RETR_LIST, CV_CHAIN_APPROX_SIMPLE, cvPoint(0,0) );
+	// backproject every gray level, so the table holds exactly what cvCalcBackProject would give
+	if (levels == NULL) {
+		levels = cvCreateImage(cvSize(256, 1), IPL_DEPTH_8U, 1);
+		levelBackproject = cvCreateImage(cvSize(256, 1), IPL_DEPTH_8U, 1);
+		for (int i=0; i<256; i++) ((unsigned char*)levels->imageData)[i] = (unsigned char)i;
+	}
+	cvCalcArrBackProject((CvArr**)&levels, levelBackproject, GetModel()->hist);
+	int thresh = cvFloor(threshold*255);
+	for (int i=0; i<256; i++) {
+		levelPass[i] = (((unsigned char*)levelBackproject->imageData)[i] > thresh) ? 1 : 0;
+	}
+	test.type = PIXELTEST_GRAY;
+	test.pass = levelPass;
+	return true;
+}
 
-	// Loop over the found contours
-	for (; contours != NULL; contours = contours->h_next)
-	{
-        double contourArea = fabs(cvContourArea(contours));
-		if ((contourArea > COLOR_MIN_AREA) && (contourArea < COLOR_MAX_AREA)) {
+ClassifierOutputData BrightnessClassifier::ClassifyPixelMasks(FrameContext *context, BitMask **masks) {
+	cvZero(guessMask);
+	if (!isTrained) return outputData;
+	IplImage *frame = context->GetFrame();
+    if(!frame) return outputData;
 
-            // draw contour in new mask image
-            cvDrawContours(newMask, contours, cvScalar(0xFF), cvScalar(0xFF), 0, CV_FILLED, 8);
+    EnsureImage(&image, cvGetSize(frame), IPL_DEPTH_8U, 3);
+    EnsureImage(&backproject, cvGetSize(frame), IPL_DEPTH_8U, 1);
+    EnsureImage(&newMask, cvGetSize(frame), IPL_DEPTH_8U, 1);
+    cvZero(newMask);
 
-            // draw contour in demo image
-            cvDrawContours(image, contours, CV_RGB(0,255,255), CV_RGB(0,255,255), 0, 2, 8);
-        }
+    // unless the masks were worked out along with other classifiers', we work from the grayscale
+    // conversion shared with the other classifiers on this frame
+    IplImage *brightness = (masks == NULL) ? context->GetGray() : NULL;
+	CvHistogram *modelHist = GetModel()->hist;
+
+    // the area limits are in full frame pixels, so shrink them to match a smaller pyramid level
+	double areaScale = context->GetScale()*context->GetScale();
+	double minArea = COLOR_MIN_AREA/areaScale, maxArea = COLOR_MAX_AREA/areaScale;
+
+    // reset contour storage
+    cvClearMemStorage(storage);
+
+	// only the regions of interest get filled in below
+	if (context->HasRegions()) cvZero(image);
+
+	for (int r=0; r<context->NumRegions(); r++) {
+		CvRect region = context->GetRegion(r);
+		CvMat backprojectRegion, imageRegion;
+		cvGetSubRect(backproject, &backprojectRegion, region);
+		cvGetSubRect(image, &imageRegion, region);
+
+		BitMask *regionMask = &closeMask;
+		if (masks != NULL) {
+			regionMask = masks[r];
+		} else {
+			// create backprojection image and threshold it as a packed mask
+			CvMat brightnessRegion;
+			CvArr *brightnessArr = cvGetSubRect(brightness, &brightnessRegion, region);
+		    cvCalcArrBackProject(&brightnessArr, &backprojectRegion, modelHist);
+			closeMask.FromImage(&backprojectRegion, cvFloor(threshold*255));
+		}
+
+		// close the mask, then unpack it for cvFindContours (and into the demo image, before
+		// cvFindContours changes it)
+		regionMask->Close(2);
+		regionMask->ToImage(&backprojectRegion);
+	    cvCvtColor(&backprojectRegion, &imageRegion, CV_GRAY2BGR);
+
+	    // find contours in backprojection image (offset back into frame coordinates)
+		CvSeq* contours = NULL;
+	    cvFindContours( &backprojectRegion, storage, &contours, sizeof(CvContour),
+	                    CV_RETR_LIST, CV_CHAIN_APPROX_SIMPLE, cvPoint(region.x,region.y) );
+
+		// Loop over the found contours
+		for (; contours != NULL; contours = contours->h_next)
+		{
+	        double contourArea = fabs(cvContourArea(contours));
+			if ((contourArea > minArea) && (contourArea < maxArea)) {
+
+	            // draw contour in new mask image
+	            cvDrawContours(newMask, contours, cvScalar(0xFF), cvScalar(0xFF), 0, CV_FILLED, 8);
+
+	            // draw contour in demo image
+	            cvDrawContours(image, contours, CV_RGB(0,255,255), CV_RGB(0,255,255), 0, 2, 8);
+	        }
+		}
 	}
 
 	// copy the final output mask
@@ -160,13 +233,6 @@ ClassifierOutputData BrightnessClassifier::ClassifyFrame(IplImage *frame) {
     cvResize(image, applyImage);
     IplToBitmap(applyImage, applyBitmap);
 
-	cvReleaseMemStorage(&storage);
-
-	cvReleaseImage(&image);
-	cvReleaseImage(&brightness);
-	cvReleaseImage(&backproject);
-	cvReleaseImage(&newMask);
-
 	UpdateStandardOutputData();
 	return outputData;
 }
@@ -1,5 +1,6 @@
 #pragma once
 #include "Classifier.h"
+#include "BitMask.h"
 
 class BrightnessClassifier : public Classifier {
 public:
@@ -10,13 +11,31 @@ public:
     BOOL ContainsSufficientSamples(TrainingSet*);
     void StartTraining(TrainingSet*);
 	ClassifierOutputData ClassifyFrame(IplImage*);
+	ClassifierOutputData ClassifyFrame(FrameContext*);
+	int GetFrameRequirements() { return FRAME_GRAY; }
+	bool GetPixelTest(PixelTest &test);
+	ClassifierOutputData ClassifyPixelMasks(FrameContext *context, BitMask **masks);	// masks NULL to work them out here
     void Save();
 	void ResetRunningState() {}		// This classifier doesn't have store any new state info while running live
+	Classifier* CreateStreamInstance();
 
 private:
     void UpdateHistogramImage();
 
+	// the classifier holding the trained histogram (this one, unless we are a stream instance)
+	BrightnessClassifier* GetModel() { return sharedModel ? (BrightnessClassifier*)sharedModel : this; }
+
 	CvHistogram *hist;
     int hdims;
 	float avg_level;  // the average brightness value (we threshold on this)
+
+	// 1 for the gray levels whose backprojection is above the threshold, worked out by
+	// backprojecting every level, for GetPixelTest
+	unsigned char levelPass[256];
+	IplImage *levels, *levelBackproject;
+
+	// working images, contour storage and the packed mask for closing, kept between frames
+	IplImage *image, *backproject, *newMask;
+	CvMemStorage *storage;
+	BitMask closeMask;
 };
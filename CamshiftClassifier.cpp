@@ -1,4 +1,5 @@
 #include "precomp.h"
+#include "constants.h"
 #include "TrainingSample.h"
 #include "TrainingSet.h"
 #include "Classifier.h"
@@ -6,28 +7,85 @@
 
 CamshiftClassifier::CamshiftClassifier() :
 	Classifier() {
-	image = NULL;
-	hsv = NULL;
-	hue = NULL;
-	mask = NULL;
-	backproject = NULL;
-	histimg = NULL;
-	hist = NULL;
 
-	hdims = 16;
-	hranges_arr[0] = 0;	hranges_arr[1] = 180;
-	hranges = hranges_arr;
+	Init();
+
+    // set the default "friendly name" and type
+    wcscpy(friendlyName, L"CamShift Tracker");
+    classifierType = CAMSHIFT_FILTER;
+    workingWidth = CAMSHIFT_WORKING_WIDTH;
+
+    // append identifier to directory name
+    wcscat(directoryName, FILE_CAMSHIFT_SUFFIX);
+}
+
+CamshiftClassifier::CamshiftClassifier(LPCWSTR pathname) :
+	Classifier(pathname) {
+
+    USES_CONVERSION;
+
+	Init();
+
+    WCHAR filename[MAX_PATH];
+    wcscpy(filename, pathname);
+    wcscat(filename, FILE_DATA_NAME);
+
+    // load the data from the histogram file
+    FILE *datafile = fopen(W2A(filename), "rb");
+    for(int i = 0; i < hdims; i++) {
+        float val;
+        fread(&val, sizeof(float), 1, datafile);
+		cvSetReal1D(hist->bins,i,val);
+    }
+    fclose(datafile);
+
+	// set the type
+	classifierType = CAMSHIFT_FILTER;
+	workingWidth = CAMSHIFT_WORKING_WIDTH;
 
+    UpdateHistogramImage();
+}
+
+void CamshiftClassifier::Init() {
 	// allocate histogram
+	hdims = 16;
+	float hranges_arr[2];
+	hranges_arr[0] = 0;	hranges_arr[1] = 180;
+	float* hranges = hranges_arr;
 	hist = cvCreateHist( 1, &hdims, CV_HIST_ARRAY, &hranges, 1 );
+
+	// working images are allocated on the first frame
+	hsv = hue = mask = backproject = NULL;
+	storage = cvCreateMemStorage(0);
+	boxStorage = cvCreateMemStorage(0);
+	orientedBoxes = cvCreateSeq(0, sizeof(CvSeq), sizeof(CvBox2D), boxStorage);
+
+	// the tracking outputs, besides the standard ones
+	outputData.AddVariable("OrientedBoxes", orientedBoxes, true);
+	outputData.AddVariable("Angle", 0.0f, true);
+	Point pt(0,0);
+	outputData.AddVariable("Size", pt, true);
 }
 
 CamshiftClassifier::~CamshiftClassifier() {
 	// free histogram
 	cvReleaseHist(&hist);
+
+	cvReleaseImage(&hsv);
+	cvReleaseImage(&hue);
+	cvReleaseImage(&mask);
+	cvReleaseImage(&backproject);
+	cvReleaseMemStorage(&storage);
+	cvReleaseMemStorage(&boxStorage);
+}
+
+BOOL CamshiftClassifier::ContainsSufficientSamples(TrainingSet *sampleSet) {
+    return (sampleSet->posSampleCount > 0);
 }
 
 void CamshiftClassifier::StartTraining(TrainingSet *sampleSet) {
+	// Make a copy of the set used for training (we'll want to save it later)
+	sampleSet->CopyTo(&trainSet);
 
 	// clear out the histogram
 	cvClearHist(hist);
@@ -35,35 +93,248 @@ void CamshiftClassifier::StartTraining(TrainingSet *sampleSet) {
 	// TODO: call into trainingset class to do this instead of accessing samplemap
     for (map<UINT, TrainingSample*>::iterator i = sampleSet->sampleMap.begin(); i != sampleSet->sampleMap.end(); i++) {
         TrainingSample *sample = (*i).second;
-        if (sample->iGroupId == 0) { // positive sample
+        if (sample->iGroupId == GROUPID_POSSAMPLES) { // positive sample
 
 			// allocate image buffers
-			hsv = cvCreateImage( cvGetSize(sample->fullImageCopy), 8, 3 );
-			hue = cvCreateImage( cvGetSize(sample->fullImageCopy), 8, 1 );
-			mask = cvCreateImage( cvGetSize(sample->fullImageCopy), 8, 1 );
+			IplImage *sampleHsv = cvCreateImage( cvGetSize(sample->fullImageCopy), 8, 3 );
+			IplImage *sampleHue = cvCreateImage( cvGetSize(sample->fullImageCopy), 8, 1 );
+			IplImage *sampleMask = cvCreateImage( cvGetSize(sample->fullImageCopy), 8, 1 );
 
 			// convert to hsv space
-			cvCvtColor(sample->fullImageCopy, hsv, CV_BGR2HSV);
+			cvCvtColor(sample->fullImageCopy, sampleHsv, CV_BGR2HSV);
 
 			// clip max and min range and split out hue channel
-			cvInRangeS(hsv, cvScalar(0,COLOR_SMIN,COLOR_VMIN,0),cvScalar(180,256,COLOR_VMAX,0), mask);
-			cvSplit(hsv, hue, 0, 0, 0);
+			cvInRangeS(sampleHsv, cvScalar(0,COLOR_SMIN,COLOR_VMIN,0),cvScalar(180,256,COLOR_VMAX,0), sampleMask);
+			cvSplit(sampleHsv, sampleHue, 0, 0, 0);
 
 			// accumulate into hue histogram
-			cvCalcHist(&hue, hist, 1, mask);
+			cvCalcHist(&sampleHue, hist, 1, sampleMask);
 
 			// free image buffers
-			cvReleaseImage(&hsv);
-			cvReleaseImage(&hue);
-			cvReleaseImage(&mask);
+			cvReleaseImage(&sampleHsv);
+			cvReleaseImage(&sampleHue);
+			cvReleaseImage(&sampleMask);
 
-		} else if (sample->iGroupId == 1) { // negative sample
+		} else if (sample->iGroupId == GROUPID_NEGSAMPLES) { // negative sample
 			// TODO: we could potentially subtract this from histogram
         }
     }
 
-	// create histogram image
-	histimg = cvCreateImage( cvSize(320,200), 8, 3 );
+    UpdateHistogramImage();
+
+    if (isOnDisk) { // this classifier has been saved so we'll update the files
+        Save();
+    }
+
+	// update member variables
+	isTrained = true;
+	tracks.clear();
+}
+
+Classifier* CamshiftClassifier::CreateStreamInstance() {
+	CamshiftClassifier *instance = new CamshiftClassifier();
+	instance->InitStreamInstance(this);
+	return instance;
+}
+
+void CamshiftClassifier::ResetRunningState() {
+	// start over without any tracks
+	tracks.clear();
+}
+
+ClassifierOutputData CamshiftClassifier::ClassifyFrame(IplImage *frame) {
+	frameContext.SetFrame(frame);
+	return ClassifyFrame(&frameContext);
+}
+
+ClassifierOutputData CamshiftClassifier::ClassifyFrame(FrameContext *context) {
+	cvZero(guessMask);
+	cvClearSeq(orientedBoxes);
+	if (!isTrained) return outputData;
+	IplImage *frame = context->GetFrame();
+    if(!frame) return outputData;
+
+	// the tracks are in the coordinates of the frame we work on, so start over if its size changes
+	if ((backproject == NULL) || (backproject->width != frame->width) || (backproject->height != frame->height)) {
+		tracks.clear();
+	}
+    EnsureImage(&hsv, cvGetSize(frame), 8, 3);
+    EnsureImage(&hue, cvGetSize(frame), 8, 1);
+    EnsureImage(&mask, cvGetSize(frame), 8, 1);
+    EnsureImage(&backproject, cvGetSize(frame), 8, 1);
+
+    // the area limits are in full frame pixels, so shrink them to match a smaller pyramid level
+	double areaScale = context->GetScale()*context->GetScale();
+	double minArea = COLOR_MIN_AREA/areaScale, maxArea = COLOR_MAX_AREA/areaScale;
+	int thresh = cvFloor(threshold*255);
+
+	// follow each object from where it was on the last frame, then look over the whole frame for
+	// new ones if we lost any (or have none)
+	bool lost = tracks.empty();
+	for (int i=0; i<(int)tracks.size(); ) {
+		if (FollowTrack(frame, tracks[i], minArea, thresh)) {
+			i++;
+		} else {
+			tracks.erase(tracks.begin()+i);
+			lost = true;
+		}
+	}
+
+	// two tracks whose windows have run into each other are following the same object, so the
+	// later one goes (and counts as lost, so anything it was hiding gets picked up again)
+	for (int i=1; i<(int)tracks.size(); ) {
+		bool duplicate = false;
+		for (int j=0; (j<i) && !duplicate; j++) {
+			duplicate = Overlaps(tracks[i].window, tracks[j].window);
+		}
+		if (duplicate) {
+			tracks.erase(tracks.begin()+i);
+			lost = true;
+		} else {
+			i++;
+		}
+	}
+	if (lost) Acquire(context, minArea, maxArea, thresh);
+
+	// draw the oriented boxes straight into the mask and the demo image (both smaller than the
+	// frame, so this doesn't grow with it); the demo image is the frame with the boxes over it
+    cvResize(frame, applyImage);
+	float maskScale = (float)guessMask->width/frame->width;
+	float demoScale = (float)applyImage->width/frame->width;
+	int largest = -1;
+	for (int i=0; i<(int)tracks.size(); i++) {
+		CvBox2D box = tracks[i].box;
+		box.center.x *= maskScale;
+		box.center.y *= maskScale;
+		box.size.width *= maskScale;
+		box.size.height *= maskScale;
+		cvSeqPush(orientedBoxes, &box);
+		if ((largest < 0) || (tracks[i].box.size.width*tracks[i].box.size.height > tracks[largest].box.size.width*tracks[largest].box.size.height)) {
+			largest = i;
+		}
+
+		CvPoint2D32f corners[4];
+		CvPoint maskCorners[4], demoCorners[4];
+		cvBoxPoints(tracks[i].box, corners);
+		for (int c=0; c<4; c++) {
+			maskCorners[c] = cvPoint(cvRound(corners[c].x*maskScale), cvRound(corners[c].y*maskScale));
+			demoCorners[c] = cvPoint(cvRound(corners[c].x*demoScale), cvRound(corners[c].y*demoScale));
+		}
+		cvFillConvexPoly(guessMask, maskCorners, 4, cvScalar(0xFF));
+		CvPoint *demoPolygon = demoCorners;
+		int nCorners = 4;
+		cvPolyLine(applyImage, &demoPolygon, &nCorners, 1, 1, CV_RGB(0,255,255), 2, 8);
+	}
+    IplToBitmap(applyImage, applyBitmap);
+
+	// the angle and size of the largest object (or nothing, once they are all lost)
+	float angle = 0;
+	Point size(0,0);
+	if (largest >= 0) {
+		CvBox2D box = tracks[largest].box;
+		angle = box.angle;
+		size = Point(cvRound(box.size.width*maskScale), cvRound(box.size.height*maskScale));
+	}
+	if (IsOutputNeeded(CVAR_ID_ANGLE)) outputData.SetVariable(CVAR_ID_ANGLE, angle);
+	if (IsOutputNeeded(CVAR_ID_SIZE)) outputData.SetVariable(CVAR_ID_SIZE, size);
+
+	UpdateStandardOutputData();
+	return outputData;
+}
+
+void CamshiftClassifier::Backproject(IplImage *frame, CvRect rect) {
+	CvMat frameRect, hsvRect, hueRect, maskRect, backprojectRect;
+	cvGetSubRect(frame, &frameRect, rect);
+	cvGetSubRect(hsv, &hsvRect, rect);
+	CvArr *hueArr = cvGetSubRect(hue, &hueRect, rect);
+	cvGetSubRect(mask, &maskRect, rect);
+	cvGetSubRect(backproject, &backprojectRect, rect);
+
+	// as in the color recognizer: clip out pixels outside of the saturation and value range,
+	// and backproject the hue of the rest
+	cvCvtColor(&frameRect, &hsvRect, CV_BGR2HSV);
+	cvInRangeS(&hsvRect, cvScalar(0,COLOR_SMIN,COLOR_VMIN,0), cvScalar(180,256,COLOR_VMAX,0), &maskRect);
+	cvSplit(&hsvRect, &hueRect, 0, 0, 0);
+    cvCalcArrBackProject(&hueArr, &backprojectRect, GetModel()->hist);
+    cvAnd(&backprojectRect, &maskRect, &backprojectRect, 0);
+}
+
+bool CamshiftClassifier::FollowTrack(IplImage *frame, CamshiftTrack &track, double minArea, int thresh) {
+	// search a little past where the object was last time
+	CvRect w = track.window;
+	int marginX = cvRound(w.width*CAMSHIFT_SEARCH_MARGIN), marginY = cvRound(w.height*CAMSHIFT_SEARCH_MARGIN);
+	int x1 = max(w.x-marginX, 0), y1 = max(w.y-marginY, 0);
+	int x2 = min(w.x+w.width+marginX, frame->width), y2 = min(w.y+w.height+marginY, frame->height);
+	if ((x2 <= x1) || (y2 <= y1)) return false;
+	CvRect search = cvRect(x1, y1, x2-x1, y2-y1);
+	Backproject(frame, search);
+
+	CvMat searchBackproject;
+	cvGetSubRect(backproject, &searchBackproject, search);
+	CvConnectedComp comp;
+	CvBox2D box;
+	cvCamShift(&searchBackproject, cvRect(w.x-search.x, w.y-search.y, w.width, w.height),
+		cvTermCriteria(CV_TERMCRIT_EPS | CV_TERMCRIT_ITER, CAMSHIFT_MAX_ITERATIONS, 1), &comp, &box);
+	if ((comp.rect.width <= 0) || (comp.rect.height <= 0)) return false;
+
+	// the object is lost once too little of the window looks like it
+	CvMat windowBackproject;
+	cvGetSubRect(&searchBackproject, &windowBackproject, comp.rect);
+	trackMask.FromImage(&windowBackproject, thresh);
+	int covered = trackMask.CountPixels();
+	if ((covered < minArea) || (covered < CAMSHIFT_MIN_COVERAGE*comp.rect.width*comp.rect.height)) return false;
+
+	track.window = cvRect(comp.rect.x+search.x, comp.rect.y+search.y, comp.rect.width, comp.rect.height);
+	box.center.x += search.x;
+	box.center.y += search.y;
+	track.box = box;
+	return true;
+}
+
+void CamshiftClassifier::Acquire(FrameContext *context, double minArea, double maxArea, int thresh) {
+	IplImage *frame = context->GetFrame();
+    cvClearMemStorage(storage);
+
+	for (int r=0; (r<context->NumRegions()) && ((int)tracks.size() < CAMSHIFT_MAX_TRACKS); r++) {
+		CvRect region = context->GetRegion(r);
+		Backproject(frame, region);
+
+		// threshold and close the backprojection as the color recognizer does (into the mask
+		// image, which Backproject is done with), then find the objects in it
+		CvMat backprojectRegion, maskRegion;
+		cvGetSubRect(backproject, &backprojectRegion, region);
+		cvGetSubRect(mask, &maskRegion, region);
+		scanMask.FromImage(&backprojectRegion, thresh);
+		scanMask.Close(1);
+		scanMask.ToImage(&maskRegion);
+		CvSeq* contours = NULL;
+	    cvFindContours( &maskRegion, storage, &contours, sizeof(CvContour),
+	                    CV_RETR_EXTERNAL, CV_CHAIN_APPROX_SIMPLE, cvPoint(region.x,region.y) );
+
+		for (; (contours != NULL) && ((int)tracks.size() < CAMSHIFT_MAX_TRACKS); contours = contours->h_next) {
+	        double contourArea = fabs(cvContourArea(contours));
+			if ((contourArea <= minArea) || (contourArea >= maxArea)) continue;
+
+			// skip the objects we are following already
+			CvRect bounds = cvBoundingRect(contours);
+			bool tracked = false;
+			for (int i=0; (i<(int)tracks.size()) && !tracked; i++) {
+				tracked = Overlaps(bounds, tracks[i].window);
+			}
+			if (tracked) continue;
+
+			CamshiftTrack track;
+			track.window = bounds;
+			track.box = cvMinAreaRect2(contours, storage);
+			tracks.push_back(track);
+		}
+	}
+}
+
+void CamshiftClassifier::UpdateHistogramImage() {
+
+    // create histogram image
+	IplImage *histimg = cvCreateImage( cvSize(320,200), 8, 3 );
 	float max_val = 0.f;
 	cvGetMinMaxHistValue( hist, 0, &max_val, 0, 0 );
 	cvConvertScale( hist->bins, hist->bins, max_val ? 255. / max_val : 0., 0 );
@@ -80,71 +351,23 @@ void CamshiftClassifier::StartTraining(TrainingSet *sampleSet) {
     cvResize(histimg, filterImage);
     IplToBitmap(filterImage, filterBitmap);
     cvReleaseImage(&histimg);
-
-	// update member variables
-	nPosSamples = sampleSet->posSampleCount;
-	nNegSamples = sampleSet->negSampleCount;
-	isTrained = true;
 }
 
-void CamshiftClassifier::ClassifyFrame(IplImage *frame, list<Rect>* objList) {
+void CamshiftClassifier::Save() {
     if (!isTrained) return;
-    if(!frame) return;
-
-    image = cvCreateImage( cvGetSize(frame), 8, 3 );
-    hsv = cvCreateImage( cvGetSize(frame), 8, 3 );
-    hue = cvCreateImage( cvGetSize(frame), 8, 1 );
-    mask = cvCreateImage( cvGetSize(frame), 8, 1 );
-	backproject = cvCreateImage( cvGetSize(frame), 8, 1 );
-
-    cvCopy( frame, image, 0 );
-    cvCvtColor( image, hsv, CV_BGR2HSV );
-
-	// create mask to clip out pixels outside of specified range
-	cvInRangeS(hsv, cvScalar(0,COLOR_SMIN,COLOR_VMIN,0), cvScalar(180,256,COLOR_VMAX,0), mask);
-    cvSplit(hsv, hue, 0, 0, 0 );
-
-	// create backprojection image and clip with mask
-    cvCalcBackProject(&hue, backproject, hist);
-    cvAnd(backproject, mask, backproject, 0);
 
-    // copy back projection into demo image
-    cvCvtColor(backproject, image, CV_GRAY2BGR);
+	Classifier::Save();
 
-	// find contours in backprojection image
-    CvMemStorage* storage = cvCreateMemStorage(0);
-	CvSeq* contours = NULL;
-    cvFindContours( backproject, storage, &contours, sizeof(CvContour),
-                    CV_RETR_LIST, CV_CHAIN_APPROX_SIMPLE, cvPoint(0,0) );
+    USES_CONVERSION;
+    WCHAR filename[MAX_PATH];
 
-	// Loop over the found contours
-	objList->clear();
-	for (; contours != NULL; contours = contours->h_next)
-	{
-        double contourArea = fabs(cvContourArea(contours));
-		if ((contourArea > COLOR_MIN_AREA) && (contourArea < COLOR_MAX_AREA)) {
-			Rect objRect;
-			CvRect rect = cvBoundingRect(contours);
-			objRect.X = rect.x;
-			objRect.Y = rect.y;
-			objRect.Width = rect.width;
-			objRect.Height = rect.height;
-			objList->push_back(objRect);
-
-            // draw contour in demo image
-            cvDrawContours(image, contours, CV_RGB(0,255,255), CV_RGB(0,255,255), 0, 2, 8);
-        }
+    // save the histogram data
+    wcscpy(filename,directoryName);
+    wcscat(filename, FILE_DATA_NAME);
+    FILE *datafile = fopen(W2A(filename), "wb");
+	for(int i = 0; i < hdims; i++) {
+		float val = cvGetReal1D(hist->bins,i);
+        fwrite(&val, sizeof(float), 1, datafile);
 	}
-
-    // update bitmap demo image
-    cvResize(image, applyImage);
-    IplToBitmap(applyImage, applyBitmap);
-
-	cvReleaseMemStorage(&storage);
-
-	cvReleaseImage(&image);
-	cvReleaseImage(&hsv);
-	cvReleaseImage(&hue);
-	cvReleaseImage(&mask);
-	cvReleaseImage(&backproject);
+    fclose(datafile);
 }
@@ -1,19 +1,64 @@
 #pragma once
 #include "Classifier.h"
+#include "BitMask.h"
 
+// one object followed by a CamshiftClassifier, in the coordinates of the frame it works on
+struct CamshiftTrack {
+	CvRect window;	// where CamShift found it last
+	CvBox2D box;	// and its oriented box
+};
+
+// Tracks colored objects with CamShift.  The hue histogram is trained as for the color
+// recognizer; objects are found by backprojecting it over the whole frame, as the color
+// recognizer does on every frame, but from then on each one is followed with cvCamShift in a
+// window a little larger than where it was last, and the backprojection is only worked out
+// there, so each frame costs in proportion to the size of the objects rather than the frame.
+// The whole frame is only scanned again once a track is lost (or while there are none).
+//
+// The mask holds the oriented box of each track, and besides the standard outputs there are the
+// oriented boxes themselves (a sequence of CvBox2D), and the angle and size of the largest.
 class CamshiftClassifier : public Classifier {
 public:
     CamshiftClassifier();
+    CamshiftClassifier(LPCWSTR pathname);
     ~CamshiftClassifier();
 
+    BOOL ContainsSufficientSamples(TrainingSet*);
 	void StartTraining(TrainingSet*);
-	void ClassifyFrame(IplImage*, list<Rect>*);
+	ClassifierOutputData ClassifyFrame(IplImage*);
+	ClassifierOutputData ClassifyFrame(FrameContext*);
+    void Save();
+	void ResetRunningState();
+	Classifier* CreateStreamInstance();
 
 private:
-	IplImage *image, *hsv, *hue, *mask, *backproject, *histimg;
-	CvHistogram *hist;
+	void Init();
+    void UpdateHistogramImage();
+
+	// the classifier holding the trained histogram (this one, unless we are a stream instance)
+	CamshiftClassifier* GetModel() { return sharedModel ? (CamshiftClassifier*)sharedModel : this; }
+
+	// backprojects the histogram over one rectangle of the frame, into the same rectangle of backproject
+	void Backproject(IplImage *frame, CvRect rect);
+
+	// moves a track to where the object is on this frame; false if it has been lost
+	bool FollowTrack(IplImage *frame, CamshiftTrack &track, double minArea, int thresh);
 
+	// starts tracks on the objects found over the whole frame (or its regions) that aren't tracked yet
+	void Acquire(FrameContext *context, double minArea, double maxArea, int thresh);
+
+	static bool Overlaps(CvRect a, CvRect b) {
+		return (a.x < b.x+b.width) && (b.x < a.x+a.width) && (a.y < b.y+b.height) && (b.y < a.y+a.height);
+	}
+
+    CvHistogram *hist;
 	int hdims;
-	float hranges_arr[2];
-	float* hranges;
+
+	vector<CamshiftTrack> tracks;
+	CvSeq *orientedBoxes;	// of the tracks, in mask coordinates
+
+	// working images (only the parts around the tracks are filled in), contour storage and packed masks
+	IplImage *hsv, *hue, *mask, *backproject;
+	CvMemStorage *storage, *boxStorage;
+	BitMask scanMask, trackMask;
 };
@@ -1,7 +1,9 @@
 #include "precomp.h"
 #include "Classifier.h"
 #include "constants.h"
+#include "ResultCache.h"
 
+#ifndef EYEPATCH_HEADLESS
 CClassifierDialog::CClassifierDialog(Classifier* c) { 
 	parent = c;
 }
@@ -66,15 +68,20 @@ LRESULT CClassifierDialog::OnClose(UINT uMsg, WPARAM wParam, LPARAM lParam, BOOL
 LRESULT CClassifierDialog::OnDestroy(UINT uMsg, WPARAM wParam, LPARAM lParam, BOOL& bHandled) {
 	return 0;
 }
+#endif
 
 
 
-Classifier::Classifier() :
-	m_ClassifierDialog(this) {
+Classifier::Classifier()
+#ifndef EYEPATCH_HEADLESS
+	: m_ClassifierDialog(this)
+#endif
+{
 
 	isTrained = false;
     isOnDisk = false;
     classifierType = 0;
+	workingWidth = 0;
 	threshold = 0.5;
     filterImage = cvCreateImage(cvSize(FILTERIMAGE_WIDTH, FILTERIMAGE_HEIGHT), IPL_DEPTH_8U, 3);
     applyImage = cvCreateImage(cvSize(FILTERIMAGE_WIDTH, FILTERIMAGE_HEIGHT), IPL_DEPTH_8U, 3);
@@ -87,12 +94,21 @@ Classifier::Classifier() :
 
     // create a directory to store this in
     WCHAR rootpath[MAX_PATH];
+#ifndef EYEPATCH_HEADLESS
     SHGetFolderPath(NULL, CSIDL_APPDATA, NULL, SHGFP_TYPE_CURRENT, rootpath);
+#else
+    GetAppDataPath(rootpath);
+#endif
     int classifiernum = (int)time(0);
-    wsprintf(directoryName, L"%s\\%s\\%s%d", rootpath, APP_CLASS, FILE_CLASSIFIER_PREFIX, classifiernum);
+    wsprintf(directoryName, L"%ls" FILE_PATH_SEPARATOR L"%ls" FILE_PATH_SEPARATOR L"%ls%d", rootpath, APP_CLASS, FILE_CLASSIFIER_PREFIX, classifiernum);
 
 	// Initialize contour storage
 	contourStorage = cvCreateMemStorage(0);
+	standardOutputMs = 0;
+	requiredOutputs = 0;
+	sendingOutputs = true;
+	sharedModel = NULL;
+	modelHash = 0;
 
 	// Create the default variables (all classifiers have these)
 	outputData.AddVariable("Mask", guessMask);
@@ -104,14 +120,18 @@ Classifier::Classifier() :
 	outputData.AddVariable("Contours", (CvSeq*)NULL, false);
 }
 
-Classifier::Classifier(LPCWSTR pathname) :
-	m_ClassifierDialog(this) {
+Classifier::Classifier(LPCWSTR pathname)
+#ifndef EYEPATCH_HEADLESS
+	: m_ClassifierDialog(this)
+#endif
+{
 
 	USES_CONVERSION;
 
 	isTrained = true;
     isOnDisk = true;
     classifierType = 0;
+	workingWidth = 0;
 	threshold = 0.5;
 
 	filterImage = cvCreateImage(cvSize(FILTERIMAGE_WIDTH, FILTERIMAGE_HEIGHT), IPL_DEPTH_8U, 3);
@@ -148,6 +168,11 @@ Classifier::Classifier(LPCWSTR pathname) :
 
 	// Initialize contour storage
 	contourStorage = cvCreateMemStorage(0);
+	standardOutputMs = 0;
+	requiredOutputs = 0;
+	sendingOutputs = true;
+	sharedModel = NULL;
+	modelHash = 0;
 
 	// Create the default variables (all classifiers have these)
 	outputData.AddVariable("Mask", guessMask);
@@ -174,7 +199,11 @@ void Classifier::Save() {
 	WCHAR filename[MAX_PATH];
 
 	// make sure the directory exists 
+#ifndef EYEPATCH_HEADLESS
     SHCreateDirectory(NULL, directoryName);
+#else
+    MakeDirectory(directoryName);
+#endif
 
 	// save the "friendly name"
 	wcscpy(filename,directoryName);
@@ -199,11 +228,34 @@ void Classifier::Save() {
 	cvSaveImage(W2A(filename), filterImage);
 
 	isOnDisk = true;
+	modelHash = 0;
 }
 
+// Called by the derived classes on a newly constructed (untrained) classifier to make it a stream
+// instance of model: it takes the model's name, settings and output variable selection, and its
+// ClassifyFrame reads the trained data from the model.
+void Classifier::InitStreamInstance(Classifier *model) {
+	sharedModel = model;
+	wcscpy(friendlyName, model->friendlyName);
+	isTrained = model->isTrained;
+	isOnDisk = false;
+	classifierType = model->classifierType;
+	workingWidth = model->workingWidth;
+	threshold = model->threshold;
+	cvCopy(model->filterImage, filterImage);
+	IplToBitmap(filterImage, filterBitmap);
+
+	for (int i=0; i<model->outputData.NumVariables(); i++) {
+		const ClassifierOutputVariable &var = model->outputData.GetVariableOfIndex(i);
+		outputData.SetVariableState(var.GetName(), var.GetState());
+	}
+}
+
+#ifndef EYEPATCH_HEADLESS
 void Classifier::Configure() {
 	m_ClassifierDialog.DoModal();
 }
+#endif
 
 void Classifier::DeleteFromDisk() {
     if (!isOnDisk) return;
@@ -211,6 +263,30 @@ void Classifier::DeleteFromDisk() {
     isOnDisk = false;
 }
 
+unsigned long long Classifier::GetModelHash() {
+	if (sharedModel != NULL) return sharedModel->GetModelHash();
+	if (!isTrained || !isOnDisk) return 0;
+	if (modelHash == 0) {
+		USES_CONVERSION;
+		static const LPCWSTR modelFiles[] = { FILE_DATA_NAME, FILE_CONTOUR_NAME, FILE_CASCADE_NAME, FILE_SIFTIMAGE_NAME };
+		unsigned long long hash = ResultCache::HashBytes(ResultCache::HASH_START, &classifierType, sizeof(classifierType));
+		for (int i=0; i<(int)(sizeof(modelFiles)/sizeof(modelFiles[0])); i++) {
+			WCHAR filename[MAX_PATH];
+			wcscpy(filename, directoryName);
+			wcscat(filename, modelFiles[i]);
+			hash = ResultCache::HashFile(hash, W2A(filename));
+		}
+		modelHash = (hash != 0) ? hash : 1;
+	}
+	return modelHash;
+}
+
+ClassifierOutputData Classifier::ReplayMask(BitMask &mask) {
+	mask.ToImage(guessMask);
+	UpdateStandardOutputData();
+	return outputData;
+}
+
 CvSeq* Classifier::GetMaskContours() {
     // reset the contour storage
     cvClearMemStorage(contourStorage);
@@ -243,32 +319,36 @@ void Classifier::ActivateVariable(LPCWSTR varName, bool state) {
 }
 
 void Classifier::UpdateStandardOutputData() {
-	outputData.SetVariable("Mask", guessMask);
-	CvSeq *contours = GetMaskContours();
-	outputData.SetVariable("Contours", contours);
-
-	// compute bounding boxes of mask contours, along with area and centroid, and count # of regions
-	boundingBoxes.clear();
-	Point centroid(0,0);
-	int nRegions = 0;
-	int totalArea = 0;
-    if (contours != NULL){
-        for (CvSeq *contour = contours; contour != NULL; contour = contour->h_next) {
-            CvRect cvr = cvBoundingRect(contour, 1);
-			totalArea += fabs(cvContourArea(contour));
+	double start = GetTimeMs();
+	outputData.SetVariable(CVAR_ID_MASK, guessMask);
+
+	// compute bounding boxes of mask regions, along with area and centroid, and count # of regions
+	if (IsOutputNeeded(CVAR_ID_BOUNDINGBOXES) || IsOutputNeeded(CVAR_ID_NUMREGIONS) ||
+		IsOutputNeeded(CVAR_ID_TOTALAREA) || IsOutputNeeded(CVAR_ID_CENTROID)) {
+		int nRegions = regionLabeller.Label(guessMask);
+		boundingBoxes.clear();
+		Point centroid(0,0);
+		for (int i=0; i<nRegions; i++) {
+			CvRect cvr = regionLabeller.GetRegion(i).bounds;
 			Rect r(cvr.x, cvr.y, cvr.width, cvr.height);
 			boundingBoxes.push_back(r);
 			centroid.X += (cvr.x+cvr.width/2);
 			centroid.Y += (cvr.y+cvr.height/2);
-			nRegions++;
-        }
+		}
 		if (nRegions > 0) {
 			centroid.X /= nRegions;
 			centroid.Y /= nRegions;
 		}
+		outputData.SetVariable(CVAR_ID_BOUNDINGBOXES, &boundingBoxes);
+		outputData.SetVariable(CVAR_ID_NUMREGIONS, nRegions);
+		outputData.SetVariable(CVAR_ID_TOTALAREA, regionLabeller.GetTotalArea());
+		outputData.SetVariable(CVAR_ID_CENTROID, centroid);
 	}
-	outputData.SetVariable("BoundingBoxes", &boundingBoxes);
-	outputData.SetVariable("NumRegions", nRegions);
-	outputData.SetVariable("TotalArea", totalArea);
-	outputData.SetVariable("Centroid", centroid);
+
+	// the contours are traced last, since cvFindContours changes the mask (and they live in storage
+	// that is reused, so they never keep their last value)
+	CvSeq *contours = NULL;
+	if (IsOutputNeeded(CVAR_ID_CONTOURS)) contours = GetMaskContours();
+	outputData.SetVariable(CVAR_ID_CONTOURS, contours);
+	standardOutputMs = GetTimeMs()-start;
 }
@@ -1,11 +1,15 @@
 #pragma once
 #include "ClassifierOutputData.h"
+#include "FrameContext.h"
+#include "RegionLabeller.h"
 #include "TrainingSample.h"
 #include "TrainingSet.h"
 #include "../resource.h"
 
 class Classifier;
+struct PixelTest;
 
+#ifndef EYEPATCH_HEADLESS
 class CClassifierDialog : public CDialogImpl<CClassifierDialog> {
 public:
 	CClassifierDialog(Classifier* c);
@@ -27,6 +31,7 @@ public:
 private:
 	Classifier *parent;
 };
+#endif
 
 
 
@@ -41,10 +46,49 @@ public:
 	virtual void StartTraining(TrainingSet*) = 0;
     virtual BOOL ContainsSufficientSamples(TrainingSet*) = 0;
 	virtual ClassifierOutputData ClassifyFrame(IplImage*) = 0;
+
+	// Classify using the derived images shared by all classifiers on this frame.  Classifiers that
+	// work from gray, HSV, hue or edge images override this and report them in GetFrameRequirements.
+	virtual ClassifierOutputData ClassifyFrame(FrameContext *context) { return ClassifyFrame(context->GetFrame()); }
+	virtual int GetFrameRequirements() { return 0; }
+
+	// Classifiers whose mask starts out as a test of each pixel on its own (color, color table and
+	// brightness) describe the test for this frame here, so the filter chain can work out the masks
+	// of several of them in one pass (see FusedMaskEvaluator); ClassifyPixelMasks then carries on
+	// from those masks, one for each region of the context, exactly as ClassifyFrame would have.
+	virtual bool GetPixelTest(PixelTest &) { return false; }
+	virtual ClassifierOutputData ClassifyPixelMasks(FrameContext *context, BitMask **) { return ClassifyFrame(context); }
+
+	// Classify only the given rectangles of the frame (in frame coordinates); the rest of the mask stays empty.
+	// Haar, SIFT, color, shape and brightness classifiers limit their work to these regions, others search the whole frame.
+	ClassifierOutputData ClassifyRegions(IplImage *frame, const vector<Rect> &rois) {
+		frameContext.SetFrame(frame);
+		frameContext.SetRegions(&rois);
+		return ClassifyFrame(&frameContext);
+	}
 	virtual void ResetRunningState() = 0;
 
+	// Creates a classifier for another video stream that shares this one's trained model but has
+	// its own masks, output data, working images and running state, so the two can classify
+	// frames on different threads at the same time.  The model is only read while classifying;
+	// it stays with this classifier, which must outlive its stream instances, and must not be
+	// retrained while they are running.  Stream instances can't be trained or saved themselves.
+	// Returns NULL for classifiers that can't run on more than one stream.
+	virtual Classifier* CreateStreamInstance() { return NULL; }
+	bool IsStreamInstance() { return (sharedModel != NULL); }
+
+	// Identifies the trained model by a hash of its type and saved model files (a stream instance
+	// gives its model's), for the result cache; 0 if it hasn't been saved.  Saved models don't change.
+	unsigned long long GetModelHash();
+
+	// Sets the mask to one found on an earlier run (see ResultCache) and works out the outputs
+	// from it, as ClassifyFrame would have; only for classifiers whose outputs all come from the mask
+	ClassifierOutputData ReplayMask(BitMask &mask);
+
 	virtual void Save();
+#ifndef EYEPATCH_HEADLESS
 	void Configure();
+#endif
     void DeleteFromDisk();
 	CvSeq* GetMaskContours();
     Bitmap* GetFilterImage();
@@ -55,20 +99,44 @@ public:
 	void UpdateStandardOutputData();
 
 	ClassifierOutputData outputData;
+	double standardOutputMs;	// time the last UpdateStandardOutputData call took
+
+	// The standard outputs (and any classifier specific ones that take work) are only computed
+	// when something needs them: the variables in requiredOutputs (CVAR_BIT flags, set by the
+	// filter chain for its combine logic and display), plus the active variables when
+	// sendingOutputs is set.  Variables that aren't needed keep their last values.
+	unsigned int requiredOutputs;
+	bool sendingOutputs;
+	bool IsOutputNeeded(int id) {
+		return ((requiredOutputs & CVAR_BIT(id)) != 0) || (sendingOutputs && outputData.GetVariable(id).GetState());
+	}
 	bool isTrained;
     bool isOnDisk;
     int classifierType;
 	float threshold;
 
+	// the narrowest frame this classifier still works well on (0 for always the full frame); on
+	// larger frames it classifies the smallest pyramid level at least this wide instead
+	int workingWidth;
+
 protected:
     Bitmap *filterBitmap, *applyBitmap;
     IplImage *filterImage, *applyImage, *guessMask;
 	CvMemStorage *contourStorage;
 	vector<Rect> boundingBoxes;
+	RegionLabeller regionLabeller;
 	TrainingSet trainSet;	// samples last used to train classifier
+	FrameContext frameContext;	// for classifying a bare frame with ClassifyFrame(IplImage*)
+
+	// the classifier whose trained model a stream instance uses (NULL if we have our own)
+	Classifier *sharedModel;
+	void InitStreamInstance(Classifier *model);
+	unsigned long long modelHash;	// worked out on first use
 
+#ifndef EYEPATCH_HEADLESS
 	friend class CClassifierDialog;
 	CClassifierDialog m_ClassifierDialog;
+#endif
 
     WCHAR friendlyName[MAX_PATH];
     WCHAR directoryName[MAX_PATH];
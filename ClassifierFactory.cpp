@@ -0,0 +1,42 @@
+#include "precomp.h"
+#include "constants.h"
+#include "TrainingSample.h"
+#include "TrainingSet.h"
+#include "Classifier.h"
+#include "BrightnessClassifier.h"
+#include "CamshiftClassifier.h"
+#include "ColorClassifier.h"
+#include "ColorLutClassifier.h"
+#include "ShapeClassifier.h"
+#include "SiftClassifier.h"
+#include "HaarClassifier.h"
+#include "MotionClassifier.h"
+#include "GestureClassifier.h"
+#include "ClassifierFactory.h"
+
+Classifier* LoadClassifierFromDirectory(LPCWSTR pathname) {
+
+    Classifier *newclassifier = NULL;
+
+    if (wcsstr(pathname, FILE_BRIGHTNESS_SUFFIX) != NULL) {
+        newclassifier = new BrightnessClassifier(pathname);
+    } else if (wcsstr(pathname, FILE_CAMSHIFT_SUFFIX) != NULL) { 
+        newclassifier = new CamshiftClassifier(pathname);
+    } else if (wcsstr(pathname, FILE_COLOR_SUFFIX) != NULL) { 
+        newclassifier = new ColorClassifier(pathname);
+    } else if (wcsstr(pathname, FILE_COLOR_LUT_SUFFIX) != NULL) { 
+        newclassifier = new ColorLutClassifier(pathname);
+    } else if (wcsstr(pathname, FILE_GESTURE_SUFFIX) != NULL) { 
+        newclassifier = new GestureClassifier(pathname);
+    } else if (wcsstr(pathname, FILE_HAAR_SUFFIX) != NULL) { 
+        newclassifier = new HaarClassifier(pathname);
+    } else if (wcsstr(pathname, FILE_MOTION_SUFFIX) != NULL) { 
+        newclassifier = new MotionClassifier(pathname);
+    } else if (wcsstr(pathname, FILE_SHAPE_SUFFIX) != NULL) { 
+        newclassifier = new ShapeClassifier(pathname);
+    } else if (wcsstr(pathname, FILE_SIFT_SUFFIX) != NULL) { 
+        newclassifier = new SiftClassifier(pathname);
+    }
+
+    return newclassifier;
+}
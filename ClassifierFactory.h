@@ -0,0 +1,6 @@
+#pragma once
+#include "Classifier.h"
+
+// Creates the appropriate recognizer for a saved classifier directory, based on its
+// folder suffix (_COL, _SHP, etc).  Returns NULL if the suffix isn't recognized.
+Classifier* LoadClassifierFromDirectory(LPCWSTR pathname);
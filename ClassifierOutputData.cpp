@@ -1,204 +1,153 @@
 #include "precomp.h"
 #include "ClassifierOutputData.h"
-
-
-ClassifierOutputData::ClassifierOutputData() {
-}
-
-ClassifierOutputData::~ClassifierOutputData() {
-}
-
-void ClassifierOutputData::AddVariable(ClassifierOutputVariable var) {
-	if (HasVariable(var.GetName())) {	// this variable already exists
-		SetVariable(var);
-	} else {
-		data.push_back(var);
+#ifdef EYEPATCH_HEADLESS
+#include <atomic>
+#endif
+
+// Registered variable names, indexed by id.  Names are only ever appended, and the count is
+// published after the name is in place, so lookups don't need a lock.
+static string variableNames[CVAR_MAX_VARIABLES] = {
+	"Mask", "BoundingBoxes", "NumRegions", "TotalArea", "Centroid", "Contours", "IsMatch", "Gesture", "Text",
+	"OrientedBoxes", "Angle", "Size"
+};
+#ifdef EYEPATCH_HEADLESS
+static std::atomic<int> nVariableNames(CVAR_NUM_STANDARD_IDS);
+#else
+static volatile LONG nVariableNames = CVAR_NUM_STANDARD_IDS;
+#endif
+
+// returned for variables we don't have
+static const ClassifierOutputVariable missingVariable;
+static const string missingName = "ERROR";
+
+int ClassifierOutputData::FindVariableId(const string &name) {
+	int nNames = nVariableNames;
+	for (int i=0; i<nNames; i++) {
+		if (name.compare(variableNames[i]) == 0) return i;
 	}
+	return -1;
 }
 
-void ClassifierOutputData::AddVariable(string name, int value, bool state) {
-	ClassifierOutputVariable var(name, value, state);
-	AddVariable(var);
-}
+int ClassifierOutputData::GetVariableId(const string &name) {
+	int id = FindVariableId(name);
+	if (id >= 0) return id;
 
-void ClassifierOutputData::AddVariable(string name, float value, bool state) {
-	ClassifierOutputVariable var(name, value, state);
-	AddVariable(var);
+	int nNames = nVariableNames;
+	assert(nNames < CVAR_MAX_VARIABLES);
+	if (nNames >= CVAR_MAX_VARIABLES) return -1;
+	variableNames[nNames] = name;
+	nVariableNames = nNames+1;
+	return nNames;
 }
 
-void ClassifierOutputData::AddVariable(string name, Point value, bool state) {
-	ClassifierOutputVariable var(name, value, state);
-	AddVariable(var);
+const string& ClassifierOutputData::GetVariableName(int id) {
+	if ((id < 0) || (id >= nVariableNames)) return missingName;
+	return variableNames[id];
 }
 
-void ClassifierOutputData::AddVariable(string name, string value, bool state) {
-	ClassifierOutputVariable var(name, value, state);
-	AddVariable(var);
+const string& ClassifierOutputVariable::GetName() const {
+	return ClassifierOutputData::GetVariableName(m_id);
 }
 
-void ClassifierOutputData::AddVariable(string name, IplImage* value, bool state) {
-	ClassifierOutputVariable var(name, value, state);
-	AddVariable(var);
+ClassifierOutputData::ClassifierOutputData() {
+	nVariables = 0;
 }
 
-void ClassifierOutputData::AddVariable(string name, CvSeq* value, bool state) {
-	ClassifierOutputVariable var(name, value, state);
-	AddVariable(var);
+ClassifierOutputData::ClassifierOutputData(const ClassifierOutputData &other) {
+	nVariables = 0;
+	*this = other;
 }
 
-void ClassifierOutputData::AddVariable(string name, vector<Rect>* value, bool state) {
-	ClassifierOutputVariable var(name, value, state);
-	AddVariable(var);
-}
+ClassifierOutputData& ClassifierOutputData::operator=(const ClassifierOutputData &other) {
+	if (this == &other) return *this;
 
-ClassifierOutputVariable ClassifierOutputData::GetVariable(string name) {
-	for (int i=0; i<data.size(); i++) {
-		ClassifierOutputVariable var = data[i];
-		if (name.compare(var.GetName()) == 0) {
-			return var;
-		}
-	}
-	ClassifierOutputVariable error;
-	return error;
-}
-
-void ClassifierOutputData::SetVariable(ClassifierOutputVariable newvar) {
-	string name = newvar.GetName();
-	for (int i=0; i<data.size(); i++) {
-		ClassifierOutputVariable var = data[i];
-		if (name.compare(var.GetName()) == 0) {
-			assert(newvar.GetType() == var.GetType());
-			// preserve the old state; this should only be changed with the SetVariableState function
-			newvar.SetState(var.GetState());
-			data[i] = newvar;
-		}
+	// empty the slots the other one doesn't use, then copy the ones it does
+	for (int i=0; i<nVariables; i++) {
+		if (!other.HasVariable(order[i])) slots[order[i]] = missingVariable;
 	}
-}
-
-bool ClassifierOutputData::GetVariableState(string name) {
-	for (int i=0; i<data.size(); i++) {
-		ClassifierOutputVariable var = data[i];
-		if (name.compare(var.GetName()) == 0) {
-			return var.GetState();
-		}
+	for (int i=0; i<other.nVariables; i++) {
+		slots[other.order[i]] = other.slots[other.order[i]];
+		order[i] = other.order[i];
 	}
-	return false;
+	nVariables = other.nVariables;
+	return *this;
 }
 
-void ClassifierOutputData::SetVariableState(string name, bool state) {
-	for (int i=0; i<data.size(); i++) {
-		ClassifierOutputVariable var = data[i];
-		if (name.compare(var.GetName()) == 0) {
-			var.SetState(state);
-			data[i] = var;
-		}
-	}
+ClassifierOutputData::~ClassifierOutputData() {
 }
 
-bool ClassifierOutputData::HasVariable(string name) {
-	for (int i=0; i<data.size(); i++) {
-		ClassifierOutputVariable var = data[i];
-		if (name.compare(var.GetName()) == 0) {
-			return true;
-		}
+void ClassifierOutputData::AddVariable(const ClassifierOutputVariable &var) {
+	int id = var.GetId();
+	if ((id < 0) || (id >= CVAR_MAX_VARIABLES)) return;
+	if (HasVariable(id)) {	// this variable already exists
+		SetVariable(var);
+	} else {
+		slots[id] = var;
+		order[nVariables++] = (unsigned char)id;
 	}
-	return false;
-}
-
-int ClassifierOutputData::GetIntData(string name) {
-	ClassifierOutputVariable var = GetVariable(name);
-	return var.GetIntData();
-}
-
-float ClassifierOutputData::GetFloatData(string name) {
-	ClassifierOutputVariable var = GetVariable(name);
-	return var.GetFloatData();
-}
-
-Point ClassifierOutputData::GetPointData(string name) {
-	ClassifierOutputVariable var = GetVariable(name);
-	return var.GetPointData();
-}
-
-string ClassifierOutputData::GetStringData(string name) {
-	ClassifierOutputVariable var = GetVariable(name);
-	return var.GetStringData();
-}
-
-IplImage* ClassifierOutputData::GetImageData(string name) {
-	ClassifierOutputVariable var = GetVariable(name);
-	return var.GetImageData();
 }
 
-CvSeq* ClassifierOutputData::GetSequenceData(string name) {
-	ClassifierOutputVariable var = GetVariable(name);
-	return var.GetSequenceData();
+void ClassifierOutputData::AddVariable(const string &name, int value, bool state) {
+	AddVariable(ClassifierOutputVariable(GetVariableId(name), value, state));
 }
 
-vector<Rect>* ClassifierOutputData::GetBoundingBoxData(string name) {
-	ClassifierOutputVariable var = GetVariable(name);
-	return var.GetBoundingBoxData();
+void ClassifierOutputData::AddVariable(const string &name, float value, bool state) {
+	AddVariable(ClassifierOutputVariable(GetVariableId(name), value, state));
 }
 
-
-void ClassifierOutputData::SetVariable(string name, int value) {
-	ClassifierOutputVariable var(name, value);
-	SetVariable(var);
+void ClassifierOutputData::AddVariable(const string &name, Point value, bool state) {
+	AddVariable(ClassifierOutputVariable(GetVariableId(name), value, state));
 }
 
-void ClassifierOutputData::SetVariable(string name, float value) {
-	ClassifierOutputVariable var(name, value);
-	SetVariable(var);
+void ClassifierOutputData::AddVariable(const string &name, const string &value, bool state) {
+	AddVariable(ClassifierOutputVariable(GetVariableId(name), value, state));
 }
 
-void ClassifierOutputData::SetVariable(string name, Point value) {
-	ClassifierOutputVariable var(name, value);
-	SetVariable(var);
+void ClassifierOutputData::AddVariable(const string &name, IplImage* value, bool state) {
+	AddVariable(ClassifierOutputVariable(GetVariableId(name), value, state));
 }
 
-void ClassifierOutputData::SetVariable(string name, string value) {
-	ClassifierOutputVariable var(name, value);
-	SetVariable(var);
+void ClassifierOutputData::AddVariable(const string &name, CvSeq* value, bool state) {
+	AddVariable(ClassifierOutputVariable(GetVariableId(name), value, state));
 }
 
-void ClassifierOutputData::SetVariable(string name, IplImage* value) {
-	ClassifierOutputVariable var(name, value);
-	SetVariable(var);
+void ClassifierOutputData::AddVariable(const string &name, vector<Rect>* value, bool state) {
+	AddVariable(ClassifierOutputVariable(GetVariableId(name), value, state));
 }
 
-void ClassifierOutputData::SetVariable(string name, CvSeq* value) {
-	ClassifierOutputVariable var(name, value);
-	SetVariable(var);
+const ClassifierOutputVariable& ClassifierOutputData::GetVariable(int id) const {
+	if (!HasVariable(id)) return missingVariable;
+	return slots[id];
 }
 
-void ClassifierOutputData::SetVariable(string name, vector<Rect>* value) {
-	ClassifierOutputVariable var(name, value);
-	SetVariable(var);
-}
+void ClassifierOutputData::SetVariable(const ClassifierOutputVariable &newvar) {
+	int id = newvar.GetId();
+	if (!HasVariable(id)) return;
+	ClassifierOutputVariable &var = slots[id];
+	assert(newvar.GetType() == var.GetType());
 
-int ClassifierOutputData::NumVariables() {
-	return data.size();
+	// preserve the old state; this should only be changed with the SetVariableState function
+	bool state = var.GetState();
+	var = newvar;
+	var.SetState(state);
 }
 
-bool ClassifierOutputData::GetStateOfIndex(int i) {
-	return data[i].GetState();
+bool ClassifierOutputData::GetVariableState(const string &name) const {
+	return GetVariable(name).GetState();
 }
 
-string ClassifierOutputData::GetNameOfIndex(int i) {
-	return data[i].GetName();
+void ClassifierOutputData::SetVariableState(const string &name, bool state) {
+	int id = FindVariableId(name);
+	if (HasVariable(id)) slots[id].SetState(state);
 }
 
-ClassifierVariableType ClassifierOutputData::GetTypeOfIndex(int i) {
-	return data[i].GetType();
-}
-
-void ClassifierOutputData::MergeWith(ClassifierOutputData mergeData) {
-	for (int i=0; i<mergeData.data.size(); i++) {
-		ClassifierOutputVariable var = mergeData.data[i];
-		if (this->HasVariable(var.GetName())) {	// this variable is already present, so we'll overwrite it
-			this->SetVariable(var);
+void ClassifierOutputData::MergeWith(const ClassifierOutputData &mergeData) {
+	for (int i=0; i<mergeData.nVariables; i++) {
+		int id = mergeData.order[i];
+		if (HasVariable(id)) {	// this variable is already present, so we'll overwrite it
+			SetVariable(mergeData.slots[id]);
 		} else {	// it's missing, so we'll add it
-			this->AddVariable(var);
+			AddVariable(mergeData.slots[id]);
 		}
 	}
-}
\ No newline at end of file
+}
@@ -11,127 +11,190 @@ typedef enum ClassifierVariableType {
 	CVAR_BBOXES
 } ClassifierVariableType;
 
+// Variable names are interned to small integer ids when they are first registered, so the
+// per-frame code can look variables up by id instead of comparing strings.  The names used
+// by the built-in classifiers are registered up front with these ids.
+typedef enum ClassifierVariableId {
+	CVAR_ID_MASK = 0,
+	CVAR_ID_BOUNDINGBOXES,
+	CVAR_ID_NUMREGIONS,
+	CVAR_ID_TOTALAREA,
+	CVAR_ID_CENTROID,
+	CVAR_ID_CONTOURS,
+	CVAR_ID_ISMATCH,
+	CVAR_ID_GESTURE,
+	CVAR_ID_TEXT,
+	CVAR_ID_ORIENTEDBOXES,
+	CVAR_ID_ANGLE,
+	CVAR_ID_SIZE,
+	CVAR_NUM_STANDARD_IDS
+} ClassifierVariableId;
+
+// most distinct variable names in the program (and so in any one ClassifierOutputData)
+#define CVAR_MAX_VARIABLES 32
+
+// a set of variables as a bit mask, e.g. CVAR_BIT(CVAR_ID_CONTOURS)|CVAR_BIT(CVAR_ID_CENTROID)
+#define CVAR_BIT(id) (1u << (id))
+
 class ClassifierOutputVariable {
 public:
 	ClassifierOutputVariable() {
-		m_name = "ERROR";
+		m_id = -1;
 		m_type = CVAR_VOID;
 		m_state = false;
+		m_ptrdata = NULL;
 	}
-	ClassifierOutputVariable(string name, int data, bool state=true) {
-		m_name = name;
-		m_type = CVAR_INT;
+	ClassifierOutputVariable(int id, int data, bool state=true) {
+		Init(id, CVAR_INT, state);
 		m_intdata = data;
-		m_state = state;
 	}
-	ClassifierOutputVariable(string name, float data, bool state=true) {
-		m_name = name;
-		m_type = CVAR_FLOAT;
+	ClassifierOutputVariable(int id, float data, bool state=true) {
+		Init(id, CVAR_FLOAT, state);
 		m_floatdata = data;
-		m_state = state;
 	}
-	ClassifierOutputVariable(string name, Point data, bool state=true) {
-		m_name = name;
-		m_type = CVAR_POINT;
+	ClassifierOutputVariable(int id, Point data, bool state=true) {
+		Init(id, CVAR_POINT, state);
 		m_pointdata = data;
-		m_state = state;
 	}
-	ClassifierOutputVariable(string name, string data, bool state=true) {
-		m_name = name;
-		m_type = CVAR_STRING;
+	ClassifierOutputVariable(int id, const string &data, bool state=true) {
+		Init(id, CVAR_STRING, state);
 		m_stringdata = data;
-		m_state = state;
 	}
-	ClassifierOutputVariable(string name, IplImage *data, bool state=true) {
-		m_name = name;
-		m_type = CVAR_IMAGE;
+	ClassifierOutputVariable(int id, IplImage *data, bool state=true) {
+		Init(id, CVAR_IMAGE, state);
 		m_imagedata = data;
-		m_state = state;
 	}
-	ClassifierOutputVariable(string name, CvSeq *data, bool state=true) {
-		m_name = name;
-		m_type = CVAR_SEQ;
+	ClassifierOutputVariable(int id, CvSeq *data, bool state=true) {
+		Init(id, CVAR_SEQ, state);
 		m_sequencedata = data;
-		m_state = state;
 	}
-	ClassifierOutputVariable(string name, vector<Rect> *data, bool state=true) {
-		m_name = name;
-		m_type = CVAR_BBOXES;
+	ClassifierOutputVariable(int id, vector<Rect> *data, bool state=true) {
+		Init(id, CVAR_BBOXES, state);
 		m_bboxdata = data;
-		m_state = state;
 	}
 
 	~ClassifierOutputVariable() { }
-	string GetName() { return m_name; }
-	ClassifierVariableType GetType() { return m_type; }
-	bool GetState() { return m_state; }
+	int GetId() const { return m_id; }
+	const string& GetName() const;
+	ClassifierVariableType GetType() const { return m_type; }
+	bool GetState() const { return m_state; }
 	void SetState(bool state) { m_state = state; }
 
-	int GetIntData() { assert(m_type==CVAR_INT);	return m_intdata; }
-	float GetFloatData() { assert(m_type==CVAR_FLOAT);	return m_floatdata; }
-	Point GetPointData() { assert(m_type==CVAR_POINT);	return m_pointdata; }
-	string GetStringData() { assert(m_type==CVAR_STRING);	return m_stringdata; }
-	IplImage* GetImageData() { assert(m_type==CVAR_IMAGE);	return m_imagedata; }
-	CvSeq* GetSequenceData() { assert(m_type==CVAR_SEQ);	return m_sequencedata; }
-	vector<Rect>* GetBoundingBoxData() { assert(m_type==CVAR_BBOXES);	return m_bboxdata; }
+	int GetIntData() const { assert(m_type==CVAR_INT);	return m_intdata; }
+	float GetFloatData() const { assert(m_type==CVAR_FLOAT);	return m_floatdata; }
+	Point GetPointData() const { assert(m_type==CVAR_POINT);	return m_pointdata; }
+	const string& GetStringData() const { assert(m_type==CVAR_STRING);	return m_stringdata; }
+	IplImage* GetImageData() const { assert(m_type==CVAR_IMAGE);	return m_imagedata; }
+	CvSeq* GetSequenceData() const { assert(m_type==CVAR_SEQ);	return m_sequencedata; }
+	vector<Rect>* GetBoundingBoxData() const { assert(m_type==CVAR_BBOXES);	return m_bboxdata; }
 
 private:
-	string m_name;
+	void Init(int id, ClassifierVariableType type, bool state) {
+		m_id = id;
+		m_type = type;
+		m_state = state;
+		m_ptrdata = NULL;
+	}
+
+	int m_id;
 	ClassifierVariableType m_type;
 	bool m_state;
-	int m_intdata;
-	float m_floatdata;
+	union {
+		int m_intdata;
+		float m_floatdata;
+		IplImage *m_imagedata;
+		CvSeq* m_sequencedata;
+		vector<Rect>* m_bboxdata;
+		void *m_ptrdata;
+	};
 	Point m_pointdata;
 	string m_stringdata;
-	IplImage *m_imagedata;
-	CvSeq* m_sequencedata;
-	vector<Rect>* m_bboxdata;
 };
 
+// The variables a classifier (or a combination of classifiers) reports for a frame.
+// Variables live in a fixed table indexed by id, so setting, reading, copying and merging
+// them never touches the heap (apart from growing the text of a string variable).  The
+// order in which variables were added is kept for listing them.
+//
+// The name-based methods look the name up and call the id-based ones.
 class ClassifierOutputData {
 public:
 	ClassifierOutputData();
+	ClassifierOutputData(const ClassifierOutputData &other);
+	ClassifierOutputData& operator=(const ClassifierOutputData &other);
 	~ClassifierOutputData();
 
-	void AddVariable(ClassifierOutputVariable var);
-	void AddVariable(string name, int value, bool state=true);
-	void AddVariable(string name, float value, bool state=true);
-	void AddVariable(string name, Point value, bool state=true);
-	void AddVariable(string name, string value, bool state=true);
-	void AddVariable(string name, IplImage* value, bool state=true);
-	void AddVariable(string name, CvSeq* value, bool state=true);
-	void AddVariable(string name, vector<Rect>* value, bool state=true);
-
-	void SetVariable(ClassifierOutputVariable var);
-	void SetVariable(string name, int value);
-	void SetVariable(string name, float value);
-	void SetVariable(string name, Point value);
-	void SetVariable(string name, string value);
-	void SetVariable(string name, IplImage* value);
-	void SetVariable(string name, CvSeq* value);
-	void SetVariable(string name, vector<Rect>* value);
-
-	void SetVariableState(string name, bool state);
-	bool GetVariableState(string name);
-
-	void MergeWith(ClassifierOutputData mergeData);
-
-	ClassifierOutputVariable GetVariable(string name);
-	int GetIntData(string name);
-	float GetFloatData(string name);
-	Point GetPointData(string name);
-	string GetStringData(string name);
-	IplImage* GetImageData(string name);
-	CvSeq* GetSequenceData(string name);
-	vector<Rect>* GetBoundingBoxData(string name);
-
-	bool HasVariable(string name);
-	int NumVariables();
-	bool GetStateOfIndex(int index);
-	string GetNameOfIndex(int index);
-	ClassifierVariableType GetTypeOfIndex(int index);
-
-	vector<ClassifierOutputVariable> data;
+	// id of a variable name, registering it if it is new (names are registered from one
+	// thread at a time, when classifiers are created); FindVariableId returns -1 for unknown names
+	static int GetVariableId(const string &name);
+	static int FindVariableId(const string &name);
+	static const string& GetVariableName(int id);
+
+	void AddVariable(const ClassifierOutputVariable &var);
+	void AddVariable(const string &name, int value, bool state=true);
+	void AddVariable(const string &name, float value, bool state=true);
+	void AddVariable(const string &name, Point value, bool state=true);
+	void AddVariable(const string &name, const string &value, bool state=true);
+	void AddVariable(const string &name, IplImage* value, bool state=true);
+	void AddVariable(const string &name, CvSeq* value, bool state=true);
+	void AddVariable(const string &name, vector<Rect>* value, bool state=true);
+
+	// replaces the value of a variable we already have, keeping its state
+	void SetVariable(const ClassifierOutputVariable &var);
+	void SetVariable(int id, int value) { SetVariable(ClassifierOutputVariable(id, value)); }
+	void SetVariable(int id, float value) { SetVariable(ClassifierOutputVariable(id, value)); }
+	void SetVariable(int id, Point value) { SetVariable(ClassifierOutputVariable(id, value)); }
+	void SetVariable(int id, const string &value) { SetVariable(ClassifierOutputVariable(id, value)); }
+	void SetVariable(int id, IplImage* value) { SetVariable(ClassifierOutputVariable(id, value)); }
+	void SetVariable(int id, CvSeq* value) { SetVariable(ClassifierOutputVariable(id, value)); }
+	void SetVariable(int id, vector<Rect>* value) { SetVariable(ClassifierOutputVariable(id, value)); }
+	void SetVariable(const string &name, int value) { SetVariable(FindVariableId(name), value); }
+	void SetVariable(const string &name, float value) { SetVariable(FindVariableId(name), value); }
+	void SetVariable(const string &name, Point value) { SetVariable(FindVariableId(name), value); }
+	void SetVariable(const string &name, const string &value) { SetVariable(FindVariableId(name), value); }
+	void SetVariable(const string &name, IplImage* value) { SetVariable(FindVariableId(name), value); }
+	void SetVariable(const string &name, CvSeq* value) { SetVariable(FindVariableId(name), value); }
+	void SetVariable(const string &name, vector<Rect>* value) { SetVariable(FindVariableId(name), value); }
+
+	void SetVariableState(const string &name, bool state);
+	bool GetVariableState(const string &name) const;
+
+	// overwrite our variables with the ones in mergeData, adding any we don't have
+	void MergeWith(const ClassifierOutputData &mergeData);
+
+	// a variable we don't have comes back with type CVAR_VOID
+	const ClassifierOutputVariable& GetVariable(int id) const;
+	const ClassifierOutputVariable& GetVariable(const string &name) const { return GetVariable(FindVariableId(name)); }
+
+	bool HasVariable(int id) const { return (id >= 0) && (id < CVAR_MAX_VARIABLES) && (slots[id].GetType() != CVAR_VOID); }
+	bool HasVariable(const string &name) const { return HasVariable(FindVariableId(name)); }
+
+	int GetIntData(int id) const { return GetVariable(id).GetIntData(); }
+	float GetFloatData(int id) const { return GetVariable(id).GetFloatData(); }
+	Point GetPointData(int id) const { return GetVariable(id).GetPointData(); }
+	const string& GetStringData(int id) const { return GetVariable(id).GetStringData(); }
+	IplImage* GetImageData(int id) const { return GetVariable(id).GetImageData(); }
+	CvSeq* GetSequenceData(int id) const { return GetVariable(id).GetSequenceData(); }
+	vector<Rect>* GetBoundingBoxData(int id) const { return GetVariable(id).GetBoundingBoxData(); }
+	int GetIntData(const string &name) const { return GetIntData(FindVariableId(name)); }
+	float GetFloatData(const string &name) const { return GetFloatData(FindVariableId(name)); }
+	Point GetPointData(const string &name) const { return GetPointData(FindVariableId(name)); }
+	const string& GetStringData(const string &name) const { return GetStringData(FindVariableId(name)); }
+	IplImage* GetImageData(const string &name) const { return GetImageData(FindVariableId(name)); }
+	CvSeq* GetSequenceData(const string &name) const { return GetSequenceData(FindVariableId(name)); }
+	vector<Rect>* GetBoundingBoxData(const string &name) const { return GetBoundingBoxData(FindVariableId(name)); }
+
+	// variables in the order they were added
+	int NumVariables() const { return nVariables; }
+	ClassifierOutputVariable& GetVariableOfIndex(int index) { return slots[order[index]]; }
+	const ClassifierOutputVariable& GetVariableOfIndex(int index) const { return slots[order[index]]; }
+	bool GetStateOfIndex(int index) const { return GetVariableOfIndex(index).GetState(); }
+	const string& GetNameOfIndex(int index) const { return GetVariableOfIndex(index).GetName(); }
+	ClassifierVariableType GetTypeOfIndex(int index) const { return GetVariableOfIndex(index).GetType(); }
 
 private:
+	// slots[id] holds the variable with that id (type CVAR_VOID if we don't have it)
+	ClassifierOutputVariable slots[CVAR_MAX_VARIABLES];
+	unsigned char order[CVAR_MAX_VARIABLES];
+	int nVariables;
 };
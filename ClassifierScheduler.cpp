@@ -0,0 +1,171 @@
+#include "precomp.h"
+#include "constants.h"
+#include "TrainingSample.h"
+#include "TrainingSet.h"
+#include "Classifier.h"
+#include "ClassifierScheduler.h"
+
+// weight of the newest sample in the running averages
+#define SCHEDULER_AVERAGE_WEIGHT 0.1
+// frames between adaptive adjustments, so each change has time to show in the average
+#define SCHEDULER_ADAPT_INTERVAL 15
+// longest cadence the adaptive mode will stretch a classifier to
+#define SCHEDULER_MAX_STRETCH 30
+
+ClassifierScheduler::ClassifierScheduler() {
+	targetFps = 0;
+	frameStart = 0;
+	avgFrameMs = 0;
+	framesSinceAdapt = 0;
+}
+
+double ClassifierScheduler::Now() {
+	return GetTimeMs()/1000.0;
+}
+
+ClassifierSchedule& ClassifierScheduler::Lookup(Classifier *c) {
+	map<Classifier*, ClassifierSchedule>::iterator i = schedules.find(c);
+	if (i != schedules.end()) return i->second;
+
+	ClassifierSchedule &s = schedules[c];
+	s.everyNFrames = 1;
+	s.maxHz = 0;
+	s.budgetMs = 0;
+	s.stretch = 1;
+	s.lastRunFrame = 0;
+	s.lastRunTime = 0;
+	s.avgCostMs = 0;
+	s.hasOutput = false;
+	s.runs = s.skips = 0;
+	return s;
+}
+
+void ClassifierScheduler::SetCadence(Classifier *c, int everyNFrames, double maxHz) {
+	ClassifierSchedule &s = Lookup(c);
+	s.everyNFrames = max(everyNFrames, 1);
+	s.maxHz = max(maxHz, 0.0);
+}
+
+void ClassifierScheduler::SetBudget(Classifier *c, double budgetMs) {
+	Lookup(c).budgetMs = max(budgetMs, 0.0);
+}
+
+void ClassifierScheduler::SetTargetFps(double fps) {
+	targetFps = max(fps, 0.0);
+	if (targetFps == 0) {
+		for (map<Classifier*, ClassifierSchedule>::iterator i=schedules.begin(); i!=schedules.end(); i++) {
+			i->second.stretch = 1;
+		}
+	}
+}
+
+double ClassifierScheduler::GetTargetFps() {
+	return targetFps;
+}
+
+void ClassifierScheduler::Remove(Classifier *c) {
+	schedules.erase(c);
+}
+
+void ClassifierScheduler::Clear() {
+	schedules.clear();
+}
+
+void ClassifierScheduler::Reset() {
+	for (map<Classifier*, ClassifierSchedule>::iterator i=schedules.begin(); i!=schedules.end(); i++) {
+		ClassifierSchedule &s = i->second;
+		s.stretch = 1;
+		s.lastRunFrame = 0;
+		s.lastRunTime = 0;
+		s.avgCostMs = 0;
+		s.hasOutput = false;
+		s.lastOutput = ClassifierOutputData();
+		s.runs = s.skips = 0;
+	}
+	avgFrameMs = 0;
+	framesSinceAdapt = 0;
+}
+
+void ClassifierScheduler::BeginFrame() {
+	frameStart = Now();
+}
+
+void ClassifierScheduler::EndFrame() {
+	double frameMs = (Now()-frameStart)*1000.0;
+	if (avgFrameMs == 0) avgFrameMs = frameMs;
+	else avgFrameMs += SCHEDULER_AVERAGE_WEIGHT*(frameMs-avgFrameMs);
+
+	if (targetFps <= 0) return;
+	if (++framesSinceAdapt < SCHEDULER_ADAPT_INTERVAL) return;
+	framesSinceAdapt = 0;
+	Adapt();
+}
+
+void ClassifierScheduler::Adapt() {
+	double targetMs = 1000.0/targetFps;
+	if (avgFrameMs > targetMs*1.05) {
+		// too slow: stretch the classifier that costs the most per frame
+		ClassifierSchedule *worst = NULL;
+		double worstCost = 0;
+		for (map<Classifier*, ClassifierSchedule>::iterator i=schedules.begin(); i!=schedules.end(); i++) {
+			ClassifierSchedule &s = i->second;
+			if (s.stretch >= SCHEDULER_MAX_STRETCH) continue;
+			double costPerFrame = s.avgCostMs/Cadence(s);
+			if (costPerFrame > worstCost) {
+				worst = &s;
+				worstCost = costPerFrame;
+			}
+		}
+		if (worst != NULL) worst->stretch++;
+	} else if (avgFrameMs < targetMs*0.8) {
+		// time to spare: relax the classifier we stretched the most
+		ClassifierSchedule *most = NULL;
+		for (map<Classifier*, ClassifierSchedule>::iterator i=schedules.begin(); i!=schedules.end(); i++) {
+			ClassifierSchedule &s = i->second;
+			if ((s.stretch > 1) && ((most == NULL) || (s.stretch > most->stretch))) most = &s;
+		}
+		if (most != NULL) most->stretch--;
+	}
+}
+
+int ClassifierScheduler::Cadence(ClassifierSchedule &s) {
+	int cadence = s.everyNFrames;
+	if ((s.budgetMs > 0) && (s.avgCostMs > s.budgetMs)) {
+		cadence = max(cadence, (int)ceil(s.avgCostMs/s.budgetMs));
+	}
+	return cadence*s.stretch;
+}
+
+int ClassifierScheduler::GetCadence(Classifier *c) {
+	return Cadence(Lookup(c));
+}
+
+ClassifierSchedule ClassifierScheduler::GetSchedule(Classifier *c) {
+	return Lookup(c);
+}
+
+bool ClassifierScheduler::ShouldRun(Classifier *c, long frameNum) {
+	ClassifierSchedule &s = Lookup(c);
+	bool run = true;
+	if (s.hasOutput && (frameNum >= s.lastRunFrame)) {	// a lower frame number means the video restarted
+		if (frameNum-s.lastRunFrame < Cadence(s)) run = false;
+		else if ((s.maxHz > 0) && (Now()-s.lastRunTime < 1.0/s.maxHz)) run = false;
+	}
+	if (!run) s.skips++;
+	return run;
+}
+
+void ClassifierScheduler::RecordRun(Classifier *c, long frameNum, const ClassifierOutputData &outdata, double costMs) {
+	ClassifierSchedule &s = Lookup(c);
+	s.lastRunFrame = frameNum;
+	s.lastRunTime = Now();
+	if (s.runs == 0) s.avgCostMs = costMs;
+	else s.avgCostMs += SCHEDULER_AVERAGE_WEIGHT*(costMs-s.avgCostMs);
+	s.hasOutput = true;
+	s.lastOutput = outdata;
+	s.runs++;
+}
+
+const ClassifierOutputData& ClassifierScheduler::GetLastOutput(Classifier *c) {
+	return Lookup(c).lastOutput;
+}
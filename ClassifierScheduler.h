@@ -0,0 +1,74 @@
+#pragma once
+
+// How often one classifier in a chain runs, and what it has cost so far
+struct ClassifierSchedule {
+	// settings
+	int everyNFrames;		// run on every Nth frame (1 runs every frame)
+	double maxHz;			// never run more often than this (0 for no limit)
+	double budgetMs;		// average time per frame this classifier may use (0 for no limit)
+
+	// running state
+	int stretch;			// extra cadence factor added by the adaptive mode (1 means none)
+	long lastRunFrame;
+	double lastRunTime;		// in seconds
+	double avgCostMs;		// running average of the time one call takes
+	bool hasOutput;
+	ClassifierOutputData lastOutput;
+	long runs, skips;
+};
+
+// Decides which classifiers of a chain run on each frame, so that cheap filters can run at
+// the full frame rate while expensive ones (OCR, SIFT) run less often.  A classifier that
+// sits out a frame reports the output of its last run again.
+//
+// A classifier's cadence is the largest of its every-Nth-frame setting, the cadence that
+// keeps its average cost within its time budget, and the stretch applied by the adaptive
+// mode.  With a target frame rate set, the adaptive mode stretches the cadence of whichever
+// classifier costs the most per frame while the chain runs too slowly, and relaxes it again
+// once there is time to spare.
+//
+// Classifiers without settings run on every frame, as before.  Motion and gesture classifiers
+// track state from frame to frame, so FilterChain always runs them.
+class ClassifierScheduler
+{
+public:
+	ClassifierScheduler();
+
+	void SetCadence(Classifier *c, int everyNFrames, double maxHz = 0);
+	void SetBudget(Classifier *c, double budgetMs);
+	void SetTargetFps(double fps);	// 0 turns the adaptive mode off
+	double GetTargetFps();
+
+	// forget the settings for one or all classifiers
+	void Remove(Classifier *c);
+	void Clear();
+
+	// forget the running state (last outputs, costs and stretches) but keep the settings
+	void Reset();
+
+	// called around each frame; the scheduler times the whole frame for the adaptive mode
+	void BeginFrame();
+	void EndFrame();
+
+	bool ShouldRun(Classifier *c, long frameNum);
+	void RecordRun(Classifier *c, long frameNum, const ClassifierOutputData &outdata, double costMs);
+	const ClassifierOutputData& GetLastOutput(Classifier *c);
+
+	// the cadence the classifier currently runs at, in frames
+	int GetCadence(Classifier *c);
+	ClassifierSchedule GetSchedule(Classifier *c);
+
+	static double Now();
+
+private:
+	ClassifierSchedule& Lookup(Classifier *c);
+	int Cadence(ClassifierSchedule &s);
+	void Adapt();
+
+	map<Classifier*, ClassifierSchedule> schedules;
+
+	double targetFps;
+	double frameStart;
+	double avgFrameMs;
+	int framesSinceAdapt;
+};
@@ -4,6 +4,7 @@
 #include "TrainingSet.h"
 #include "Classifier.h"
 #include "ColorClassifier.h"
+#include "FusedMaskEvaluator.h"
 
 ColorClassifier::ColorClassifier() :
 	Classifier() {
@@ -15,9 +16,14 @@ ColorClassifier::ColorClassifier() :
 	float* hranges = hranges_arr;
 	hist = cvCreateHist( 1, &hdims, CV_HIST_ARRAY, &hranges, 1 );
 
+	// working images are allocated on the first frame
+	image = mask = backproject = newMask = NULL;
+	storage = cvCreateMemStorage(0);
+
     // set the default "friendly name" and type
     wcscpy(friendlyName, L"Color Recognizer");
     classifierType = COLOR_FILTER;        
+    workingWidth = COLOR_WORKING_WIDTH;
     
     // append identifier to directory name
     wcscat(directoryName, FILE_COLOR_SUFFIX);   
@@ -35,6 +41,10 @@ ColorClassifier::ColorClassifier(LPCWSTR pathname) :
 	float* hranges = hranges_arr;
 	hist = cvCreateHist( 1, &hdims, CV_HIST_ARRAY, &hranges, 1 );
 
+	// working images are allocated on the first frame
+	image = mask = backproject = newMask = NULL;
+	storage = cvCreateMemStorage(0);
+
     WCHAR filename[MAX_PATH];
     wcscpy(filename, pathname);
     wcscat(filename, FILE_DATA_NAME);
@@ -50,6 +60,7 @@ ColorClassifier::ColorClassifier(LPCWSTR pathname) :
 
 	// set the type
 	classifierType = COLOR_FILTER;
+	workingWidth = COLOR_WORKING_WIDTH;
 
     UpdateHistogramImage();
 }
@@ -57,6 +68,12 @@ ColorClassifier::ColorClassifier(LPCWSTR pathname) :
 ColorClassifier::~ColorClassifier() {
 	// free histogram
 	cvReleaseHist(&hist);
+
+	cvReleaseImage(&image);
+	cvReleaseImage(&mask);
+	cvReleaseImage(&backproject);
+	cvReleaseImage(&newMask);
+	cvReleaseMemStorage(&storage);
 }
 
 BOOL ColorClassifier::ContainsSufficientSamples(TrainingSet *sampleSet) {
@@ -110,61 +127,117 @@ void ColorClassifier::StartTraining(TrainingSet *sampleSet) {
 	isTrained = true;
 }
 
+Classifier* ColorClassifier::CreateStreamInstance() {
+	ColorClassifier *instance = new ColorClassifier();
+	instance->InitStreamInstance(this);
+	return instance;
+}
+
 ClassifierOutputData ColorClassifier::ClassifyFrame(IplImage *frame) {
+	frameContext.SetFrame(frame);
+	return ClassifyFrame(&frameContext);
+}
+
+ClassifierOutputData ColorClassifier::ClassifyFrame(FrameContext *context) {
+	return ClassifyPixelMasks(context, NULL);
+}
+
+bool ColorClassifier::GetPixelTest(PixelTest &test) {
+	if (!isTrained || !ColorMaskKernel::MatchesOpenCV()) return false;
+	maskKernel.SetModel(GetModel()->hist, cvFloor(threshold*255), COLOR_SMIN, COLOR_VMIN, COLOR_VMAX);
+	test.type = PIXELTEST_HUE;
+	test.pass = maskKernel.GetHuePass();
+	test.minDiff = maskKernel.GetMinDiff();
+	return true;
+}
+
+ClassifierOutputData ColorClassifier::ClassifyPixelMasks(FrameContext *context, BitMask **masks) {
 	cvZero(guessMask);
 	if (!isTrained) return outputData;
+	IplImage *frame = context->GetFrame();
     if(!frame) return outputData;
 
-    IplImage *image = cvCreateImage( cvGetSize(frame), 8, 3 );
-    IplImage *hsv = cvCreateImage( cvGetSize(frame), 8, 3 );
-    IplImage *hue = cvCreateImage( cvGetSize(frame), 8, 1 );
-    IplImage *mask = cvCreateImage( cvGetSize(frame), 8, 1 );
-	IplImage *backproject = cvCreateImage( cvGetSize(frame), 8, 1 );
-    IplImage *newMask = cvCreateImage( cvGetSize(frame), 8, 1 );
+    EnsureImage(&image, cvGetSize(frame), 8, 3);
+    EnsureImage(&backproject, cvGetSize(frame), 8, 1);
+    EnsureImage(&newMask, cvGetSize(frame), 8, 1);
     cvZero(newMask);
 
-    cvCopy( frame, image, 0 );
-    cvCvtColor( image, hsv, CV_BGR2HSV );
-
-	// create mask to clip out pixels outside of specified range
-	cvInRangeS(hsv, cvScalar(0,COLOR_SMIN,COLOR_VMIN,0), cvScalar(180,256,COLOR_VMAX,0), mask);
-    cvSplit(hsv, hue, 0, 0, 0 );
-
-	// create backprojection image and clip with mask
-    cvCalcBackProject(&hue, backproject, hist);
-    cvAnd(backproject, mask, backproject, 0);
-
-    // copy back projection into demo image
-    cvCvtColor(backproject, image, CV_GRAY2BGR);
-
-    // create contour storage
-    CvMemStorage* storage = cvCreateMemStorage(0);
-	CvSeq* contours = NULL;
-
-	// threhold the backprojection image
-	cvThreshold(backproject, backproject, threshold*255, 255, CV_THRESH_BINARY);
-
-    // close the backprojection image
-    IplConvKernel *circElem = cvCreateStructuringElementEx(3,3,1,1,CV_SHAPE_ELLIPSE);        
-    cvMorphologyEx(backproject, backproject, 0, circElem, CV_MOP_CLOSE, 1);  
-	cvReleaseStructuringElement(&circElem);
-
-    // find contours in backprojection image
-    cvFindContours( backproject, storage, &contours, sizeof(CvContour),
-                    CV_RETR_LIST, CV_CHAIN_APPROX_SIMPLE, cvPoint(0,0) );
-
-	// Loop over the found contours
-	for (; contours != NULL; contours = contours->h_next)
-	{
-        double contourArea = fabs(cvContourArea(contours));
-		if ((contourArea > COLOR_MIN_AREA) && (contourArea < COLOR_MAX_AREA)) {
-
-            // draw contour in new mask image
-            cvDrawContours(newMask, contours, cvScalar(0xFF), cvScalar(0xFF), 0, CV_FILLED, 8);
+	// unless the masks were worked out along with other classifiers', the fused kernel goes from
+	// the frame to the thresholded mask in one pass; otherwise we work from the HSV conversion and
+	// hue plane shared with the other classifiers on this frame
+	CvHistogram *modelHist = GetModel()->hist;
+	bool fused = ColorMaskKernel::MatchesOpenCV();
+	IplImage *hsv = NULL, *hue = NULL;
+	if ((masks == NULL) && fused) {
+		maskKernel.SetModel(modelHist, cvFloor(threshold*255), COLOR_SMIN, COLOR_VMIN, COLOR_VMAX);
+	} else if (masks == NULL) {
+	    EnsureImage(&mask, cvGetSize(frame), 8, 1);
+	    hsv = context->GetHSV();
+	    hue = context->GetHue();
+	}
 
-            // draw contour in demo image
-            cvDrawContours(image, contours, CV_RGB(0,255,255), CV_RGB(0,255,255), 0, 2, 8);
-        }
+    // the area limits are in full frame pixels, so shrink them to match a smaller pyramid level
+	double areaScale = context->GetScale()*context->GetScale();
+	double minArea = COLOR_MIN_AREA/areaScale, maxArea = COLOR_MAX_AREA/areaScale;
+
+    // reset contour storage
+    cvClearMemStorage(storage);
+
+	// only the regions of interest get filled in below
+	if (context->HasRegions()) cvZero(image);
+
+	for (int r=0; r<context->NumRegions(); r++) {
+		CvRect region = context->GetRegion(r);
+		CvMat backprojectRegion, imageRegion;
+		cvGetSubRect(backproject, &backprojectRegion, region);
+		cvGetSubRect(image, &imageRegion, region);
+
+		BitMask *regionMask = &closeMask;
+		if (masks != NULL) {
+			regionMask = masks[r];
+		} else if (fused) {
+			CvMat frameRegion;
+			cvGetSubRect(frame, &frameRegion, region);
+			maskKernel.Apply(&frameRegion, closeMask);
+		} else {
+			CvMat hsvRegion, hueRegion, maskRegion;
+			cvGetSubRect(hsv, &hsvRegion, region);
+			CvArr *hueArr = cvGetSubRect(hue, &hueRegion, region);
+			cvGetSubRect(mask, &maskRegion, region);
+
+			// create mask to clip out pixels outside of specified range
+			cvInRangeS(&hsvRegion, cvScalar(0,COLOR_SMIN,COLOR_VMIN,0), cvScalar(180,256,COLOR_VMAX,0), &maskRegion);
+
+			// create backprojection image and clip with mask, then threshold it as a packed mask
+		    cvCalcArrBackProject(&hueArr, &backprojectRegion, modelHist);
+		    cvAnd(&backprojectRegion, &maskRegion, &backprojectRegion, 0);
+			closeMask.FromImage(&backprojectRegion, cvFloor(threshold*255));
+		}
+
+		// close the mask, then unpack it for cvFindContours (and into the demo image, before
+		// cvFindContours changes it)
+		regionMask->Close(1);
+		regionMask->ToImage(&backprojectRegion);
+	    cvCvtColor(&backprojectRegion, &imageRegion, CV_GRAY2BGR);
+
+	    // find contours in backprojection image (offset back into frame coordinates)
+		CvSeq* contours = NULL;
+	    cvFindContours( &backprojectRegion, storage, &contours, sizeof(CvContour),
+	                    CV_RETR_LIST, CV_CHAIN_APPROX_SIMPLE, cvPoint(region.x,region.y) );
+
+		// Loop over the found contours
+		for (; contours != NULL; contours = contours->h_next)
+		{
+	        double contourArea = fabs(cvContourArea(contours));
+			if ((contourArea > minArea) && (contourArea < maxArea)) {
+
+	            // draw contour in new mask image
+	            cvDrawContours(newMask, contours, cvScalar(0xFF), cvScalar(0xFF), 0, CV_FILLED, 8);
+
+	            // draw contour in demo image
+	            cvDrawContours(image, contours, CV_RGB(0,255,255), CV_RGB(0,255,255), 0, 2, 8);
+	        }
+		}
 	}
 
 	// copy the final output mask
@@ -174,15 +247,6 @@ ClassifierOutputData ColorClassifier::ClassifyFrame(IplImage *frame) {
     cvResize(image, applyImage);
     IplToBitmap(applyImage, applyBitmap);
 
-	cvReleaseMemStorage(&storage);
-
-	cvReleaseImage(&image);
-	cvReleaseImage(&hsv);
-	cvReleaseImage(&hue);
-	cvReleaseImage(&mask);
-	cvReleaseImage(&backproject);
-	cvReleaseImage(&newMask);
-
 	UpdateStandardOutputData();
 	return outputData;
 }
@@ -1,5 +1,7 @@
 #pragma once
 #include "Classifier.h"
+#include "BitMask.h"
+#include "ColorMaskKernel.h"
 
 class ColorClassifier : public Classifier {
 public:
@@ -10,12 +12,28 @@ public:
     BOOL ContainsSufficientSamples(TrainingSet*);
 	void StartTraining(TrainingSet*);
 	ClassifierOutputData ClassifyFrame(IplImage*);
+	ClassifierOutputData ClassifyFrame(FrameContext*);
+	int GetFrameRequirements() { return ColorMaskKernel::MatchesOpenCV() ? 0 : (FRAME_HSV | FRAME_HUE); }
+	bool GetPixelTest(PixelTest &test);
+	ClassifierOutputData ClassifyPixelMasks(FrameContext *context, BitMask **masks);	// masks NULL to work them out here
     void Save();
 	void ResetRunningState() {}		// This classifier doesn't have store any new state info while running live
+	Classifier* CreateStreamInstance();
 
 private:
     void UpdateHistogramImage();
 
+	// the classifier holding the trained histogram (this one, unless we are a stream instance)
+	ColorClassifier* GetModel() { return sharedModel ? (ColorClassifier*)sharedModel : this; }
+
     CvHistogram *hist;
 	int hdims;
+
+	// working images, contour storage and the packed mask for closing, kept between frames
+	IplImage *image, *mask, *backproject, *newMask;
+	CvMemStorage *storage;
+	BitMask closeMask;
+
+	// classifies straight from the BGR frame, when it converts to HSV as this build of OpenCV does
+	ColorMaskKernel maskKernel;
 };
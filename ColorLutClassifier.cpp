@@ -0,0 +1,301 @@
+#include "precomp.h"
+#include "constants.h"
+#include "TrainingSample.h"
+#include "TrainingSet.h"
+#include "Classifier.h"
+#include "ColorLutClassifier.h"
+#include "FusedMaskEvaluator.h"
+
+// the table file holds the bits per channel, then the table
+static const int lutBits = COLOR_LUT_BITS;
+
+ColorLutClassifier::ColorLutClassifier() :
+	Classifier() {
+
+	memset(table, 0, sizeof(table));
+
+	// working images are allocated on the first frame
+	image = backproject = newMask = NULL;
+	storage = cvCreateMemStorage(0);
+
+    // set the default "friendly name" and type
+    wcscpy(friendlyName, L"Color Table Recognizer");
+    classifierType = COLOR_LUT_FILTER;
+    workingWidth = COLOR_WORKING_WIDTH;
+
+    // append identifier to directory name
+    wcscat(directoryName, FILE_COLOR_LUT_SUFFIX);
+}
+
+ColorLutClassifier::ColorLutClassifier(LPCWSTR pathname) :
+	Classifier(pathname) {
+
+    USES_CONVERSION;
+
+	memset(table, 0, sizeof(table));
+
+	// working images are allocated on the first frame
+	image = backproject = newMask = NULL;
+	storage = cvCreateMemStorage(0);
+
+    WCHAR filename[MAX_PATH];
+    wcscpy(filename, pathname);
+    wcscat(filename, FILE_DATA_NAME);
+
+    // load the table, unless it was built with a different number of cells
+    FILE *datafile = fopen(W2A(filename), "rb");
+	int bits = 0;
+	if ((datafile == NULL) || (fread(&bits, sizeof(int), 1, datafile) != 1) || (bits != lutBits) ||
+		(fread(table, 1, sizeof(table), datafile) != sizeof(table))) {
+		isTrained = false;
+	}
+	if (datafile != NULL) fclose(datafile);
+
+	// set the type
+	classifierType = COLOR_LUT_FILTER;
+	workingWidth = COLOR_WORKING_WIDTH;
+
+    UpdateTableImage();
+}
+
+ColorLutClassifier::~ColorLutClassifier() {
+	cvReleaseImage(&image);
+	cvReleaseImage(&backproject);
+	cvReleaseImage(&newMask);
+	cvReleaseMemStorage(&storage);
+}
+
+BOOL ColorLutClassifier::ContainsSufficientSamples(TrainingSet *sampleSet) {
+    return (sampleSet->posSampleCount > 0);
+}
+
+// adds the pixels of a BGR image to the counts of their cells
+static void CountPixels(IplImage *img, float *counts) {
+	for (int y=0; y<img->height; y++) {
+		const unsigned char *p = (const unsigned char*)(img->imageData + y*img->widthStep);
+		for (int x=0; x<img->width; x++, p+=3) {
+			counts[ColorLutClassifier::Cell(p[0], p[1], p[2])]++;
+		}
+	}
+}
+
+// blurs the counts with [1 2 1] along one channel (stride apart in the table), repeating the
+// cells at the ends, so colors between the ones in the examples get some of their weight
+static void SmoothCounts(float *counts, int stride) {
+	const int n = ColorLutClassifier::nBins;
+	vector<float> line(n);
+	for (int start=0; start<ColorLutClassifier::tableSize; start++) {
+		if ((start/stride) % n != 0) continue;		// not the first cell of a line
+		for (int i=0; i<n; i++) line[i] = counts[start + i*stride];
+		for (int i=0; i<n; i++) {
+			float prev = line[(i > 0) ? i-1 : 0], next = line[(i < n-1) ? i+1 : n-1];
+			counts[start + i*stride] = (prev + 2*line[i] + next)/4;
+		}
+	}
+}
+
+void ColorLutClassifier::StartTraining(TrainingSet *sampleSet) {
+	// Make a copy of the set used for training (we'll want to save it later)
+	sampleSet->CopyTo(&trainSet);
+
+	// count the colors of the positive and negative examples
+	vector<float> pos(tableSize, 0), neg(tableSize, 0);
+    for (map<UINT, TrainingSample*>::iterator i = sampleSet->sampleMap.begin(); i != sampleSet->sampleMap.end(); i++) {
+        TrainingSample *sample = (*i).second;
+        if (sample->iGroupId == GROUPID_POSSAMPLES) { // positive sample
+			CountPixels(sample->fullImageCopy, &pos[0]);
+		} else if (sample->iGroupId == GROUPID_NEGSAMPLES) { // negative sample
+			CountPixels(sample->fullImageCopy, &neg[0]);
+        }
+    }
+
+	// smooth along blue, green and red
+	for (int stride=1; stride<tableSize; stride*=nBins) {
+		SmoothCounts(&pos[0], stride);
+		SmoothCounts(&neg[0], stride);
+	}
+
+	// how often each color turns up on the object, weighted by the share of its pixels in the
+	// examples that were on the object, then scaled like the hue histogram so the best cell is 255
+	double posTotal = 0, negTotal = 0;
+	for (int i=0; i<tableSize; i++) {
+		posTotal += pos[i];
+		negTotal += neg[i];
+	}
+	vector<double> likelihood(tableSize, 0);
+	double maxLikelihood = 0;
+	for (int i=0; (i<tableSize) && (posTotal > 0); i++) {
+		double p = pos[i]/posTotal, n = (negTotal > 0) ? neg[i]/negTotal : 0;
+		if (p <= 0) continue;
+		likelihood[i] = p*p/(p+n);
+		maxLikelihood = max(maxLikelihood, likelihood[i]);
+	}
+	for (int i=0; i<tableSize; i++) {
+		table[i] = (maxLikelihood > 0) ? (unsigned char)cvRound(255*likelihood[i]/maxLikelihood) : 0;
+	}
+
+    UpdateTableImage();
+
+    if (isOnDisk) { // this classifier has been saved so we'll update the files
+        Save();
+    }
+
+	// update member variables
+	isTrained = true;
+}
+
+Classifier* ColorLutClassifier::CreateStreamInstance() {
+	ColorLutClassifier *instance = new ColorLutClassifier();
+	instance->InitStreamInstance(this);
+	return instance;
+}
+
+void ColorLutClassifier::Apply(const unsigned char *table, int thresh, const CvArr *bgr, BitMask &mask) {
+	CvMat stub;
+	CvMat *mat = cvGetMat(bgr, &stub);
+	int width = mat->cols, height = mat->rows;
+	mask.Create(width, height);
+
+	for (int y=0; y<height; y++) {
+		const unsigned char *p = mat->data.ptr + y*mat->step;
+		unsigned int *row = mask.GetRow(y);
+		for (int x0=0; x0<width; x0+=32) {
+			// a word of the mask at a time, so it is only written once
+			int x1 = min(x0+32, width);
+			unsigned int bits = 0;
+			for (int x=x0; x<x1; x++, p+=3) {
+				bits |= (unsigned int)(table[Cell(p[0], p[1], p[2])] > thresh) << (x-x0);
+			}
+			row[x0/32] = bits;
+		}
+	}
+}
+
+ClassifierOutputData ColorLutClassifier::ClassifyFrame(IplImage *frame) {
+	frameContext.SetFrame(frame);
+	return ClassifyFrame(&frameContext);
+}
+
+ClassifierOutputData ColorLutClassifier::ClassifyFrame(FrameContext *context) {
+	return ClassifyPixelMasks(context, NULL);
+}
+
+bool ColorLutClassifier::GetPixelTest(PixelTest &test) {
+	if (!isTrained) return false;
+	test.type = PIXELTEST_TABLE;
+	test.table = GetModel()->table;
+	test.thresh = cvFloor(threshold*255);
+	return true;
+}
+
+ClassifierOutputData ColorLutClassifier::ClassifyPixelMasks(FrameContext *context, BitMask **masks) {
+	cvZero(guessMask);
+	if (!isTrained) return outputData;
+	IplImage *frame = context->GetFrame();
+    if(!frame) return outputData;
+
+    EnsureImage(&image, cvGetSize(frame), 8, 3);
+    EnsureImage(&backproject, cvGetSize(frame), 8, 1);
+    EnsureImage(&newMask, cvGetSize(frame), 8, 1);
+    cvZero(newMask);
+
+	const unsigned char *modelTable = GetModel()->table;
+	int thresh = cvFloor(threshold*255);
+
+    // the area limits are in full frame pixels, so shrink them to match a smaller pyramid level
+	double areaScale = context->GetScale()*context->GetScale();
+	double minArea = COLOR_MIN_AREA/areaScale, maxArea = COLOR_MAX_AREA/areaScale;
+
+    // reset contour storage
+    cvClearMemStorage(storage);
+
+	// only the regions of interest get filled in below
+	if (context->HasRegions()) cvZero(image);
+
+	for (int r=0; r<context->NumRegions(); r++) {
+		CvRect region = context->GetRegion(r);
+		CvMat frameRegion, backprojectRegion, imageRegion;
+		cvGetSubRect(frame, &frameRegion, region);
+		cvGetSubRect(backproject, &backprojectRegion, region);
+		cvGetSubRect(image, &imageRegion, region);
+
+		// look up each pixel (unless that was done along with other classifiers), then close the
+		// mask and unpack it for cvFindContours (and into the demo image, before cvFindContours changes it)
+		BitMask *regionMask = &closeMask;
+		if (masks != NULL) regionMask = masks[r];
+		else Apply(modelTable, thresh, &frameRegion, closeMask);
+		regionMask->Close(1);
+		regionMask->ToImage(&backprojectRegion);
+	    cvCvtColor(&backprojectRegion, &imageRegion, CV_GRAY2BGR);
+
+	    // find contours in the mask (offset back into frame coordinates)
+		CvSeq* contours = NULL;
+	    cvFindContours( &backprojectRegion, storage, &contours, sizeof(CvContour),
+	                    CV_RETR_LIST, CV_CHAIN_APPROX_SIMPLE, cvPoint(region.x,region.y) );
+
+		// Loop over the found contours
+		for (; contours != NULL; contours = contours->h_next)
+		{
+	        double contourArea = fabs(cvContourArea(contours));
+			if ((contourArea > minArea) && (contourArea < maxArea)) {
+
+	            // draw contour in new mask image
+	            cvDrawContours(newMask, contours, cvScalar(0xFF), cvScalar(0xFF), 0, CV_FILLED, 8);
+
+	            // draw contour in demo image
+	            cvDrawContours(image, contours, CV_RGB(0,255,255), CV_RGB(0,255,255), 0, 2, 8);
+	        }
+		}
+	}
+
+	// copy the final output mask
+    cvResize(newMask, guessMask);
+
+    // update bitmap demo image
+    cvResize(image, applyImage);
+    IplToBitmap(applyImage, applyBitmap);
+
+	UpdateStandardOutputData();
+	return outputData;
+}
+
+void ColorLutClassifier::UpdateTableImage() {
+
+	// one tile of green (down) by red (across) for each blue cell, eight tiles to a row; each
+	// cell shows its color, as bright as the table says it is likely
+	int tilesAcross = 8, tilesDown = (nBins+7)/8;
+	IplImage *tableimg = cvCreateImage(cvSize(tilesAcross*nBins, tilesDown*nBins), 8, 3);
+	cvZero(tableimg);
+	for (int b=0; b<nBins; b++) {
+		int x0 = (b % tilesAcross)*nBins, y0 = (b / tilesAcross)*nBins;
+		for (int g=0; g<nBins; g++) {
+			unsigned char *p = (unsigned char*)(tableimg->imageData + (y0+g)*tableimg->widthStep) + 3*x0;
+			for (int r=0; r<nBins; r++, p+=3) {
+				int weight = table[(b << (2*COLOR_LUT_BITS)) | (g << COLOR_LUT_BITS) | r];
+				p[0] = (unsigned char)((((b << binShift) + (1 << binShift)/2)*weight)/255);
+				p[1] = (unsigned char)((((g << binShift) + (1 << binShift)/2)*weight)/255);
+				p[2] = (unsigned char)((((r << binShift) + (1 << binShift)/2)*weight)/255);
+			}
+		}
+	}
+    cvResize(tableimg, filterImage, CV_INTER_NN);
+    IplToBitmap(filterImage, filterBitmap);
+    cvReleaseImage(&tableimg);
+}
+
+void ColorLutClassifier::Save() {
+    if (!isTrained) return;
+
+	Classifier::Save();
+
+    USES_CONVERSION;
+    WCHAR filename[MAX_PATH];
+
+    // save the table
+    wcscpy(filename,directoryName);
+    wcscat(filename, FILE_DATA_NAME);
+    FILE *datafile = fopen(W2A(filename), "wb");
+	fwrite(&lutBits, sizeof(int), 1, datafile);
+	fwrite(table, 1, sizeof(table), datafile);
+    fclose(datafile);
+}
@@ -0,0 +1,52 @@
+#pragma once
+#include "Classifier.h"
+#include "BitMask.h"
+
+// Recognizes colors with a table indexed by the pixel's blue, green and red values (the top
+// COLOR_LUT_BITS bits of each), so classifying a pixel is one lookup with no conversion to HSV.
+// Training counts the pixels of the positive and negative examples in each cell, smooths the
+// counts a little and stores, for each cell, how likely its colors are to be the object.  Unlike
+// the hue histogram, the table keeps apart colors of the same hue but different saturation or
+// brightness, and learns from the negative examples.
+class ColorLutClassifier : public Classifier {
+public:
+    ColorLutClassifier();
+    ColorLutClassifier(LPCWSTR pathname);
+    ~ColorLutClassifier();
+
+    BOOL ContainsSufficientSamples(TrainingSet*);
+	void StartTraining(TrainingSet*);
+	ClassifierOutputData ClassifyFrame(IplImage*);
+	ClassifierOutputData ClassifyFrame(FrameContext*);
+	bool GetPixelTest(PixelTest &test);
+	ClassifierOutputData ClassifyPixelMasks(FrameContext *context, BitMask **masks);	// masks NULL to work them out here
+    void Save();
+	void ResetRunningState() {}		// This classifier doesn't have store any new state info while running live
+	Classifier* CreateStreamInstance();
+
+	static const int nBins = 1 << COLOR_LUT_BITS;	// cells along each channel
+	static const int binShift = 8 - COLOR_LUT_BITS;
+	static const int tableSize = nBins*nBins*nBins;
+
+	// the cell of a BGR pixel
+	static inline int Cell(int b, int g, int r) {
+		return ((b >> binShift) << (2*COLOR_LUT_BITS)) | ((g >> binShift) << COLOR_LUT_BITS) | (r >> binShift);
+	}
+
+private:
+    void UpdateTableImage();
+
+	// sets the bits of mask (created at the size of bgr) where the table is above thresh
+	static void Apply(const unsigned char *table, int thresh, const CvArr *bgr, BitMask &mask);
+
+	// the classifier holding the trained table (this one, unless we are a stream instance)
+	ColorLutClassifier* GetModel() { return sharedModel ? (ColorLutClassifier*)sharedModel : this; }
+
+	// how likely each cell is to be the object, from 0 to 255
+	unsigned char table[tableSize];
+
+	// working images, contour storage and the packed mask for closing, kept between frames
+	IplImage *image, *backproject, *newMask;
+	CvMemStorage *storage;
+	BitMask closeMask;
+};
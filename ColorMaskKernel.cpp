@@ -0,0 +1,218 @@
+#include "precomp.h"
+#include "ColorMaskKernel.h"
+#ifdef COLORMASK_SSE2
+#include <emmintrin.h>
+#endif
+
+int ColorMaskKernel::divTable[256];
+
+static int conversionMatches = -1;	// not checked yet
+
+ColorMaskKernel::ColorMaskKernel() {
+	// checked here rather than on the first frame, which may be classified on several threads at once
+	MatchesOpenCV();
+	memset(huePass, 0, sizeof(huePass));
+	for (int v=0; v<256; v++) minDiff[v] = 256;
+	leastDiff = lowValue = 256;
+	highValue = -1;
+	minSaturation = 0;
+	hues = backproject = NULL;
+}
+
+ColorMaskKernel::~ColorMaskKernel() {
+	cvReleaseImage(&hues);
+	cvReleaseImage(&backproject);
+}
+
+bool ColorMaskKernel::MatchesOpenCV() {
+	if (conversionMatches < 0) {
+		divTable[0] = 0;
+		for (int i=1; i<256; i++) divTable[i] = cvRound((double)(255 << hsvShift)/i);
+		conversionMatches = CheckConversion() ? 1 : 0;
+	}
+	return (conversionMatches != 0);
+}
+
+bool ColorMaskKernel::CheckConversion() {
+	// every pair of green and blue, with red running through all values in a different order
+	// along each row, so every value and max-min spread turns up with each channel as the largest
+	IplImage *bgr = cvCreateImage(cvSize(256, 256), IPL_DEPTH_8U, 3);
+	IplImage *hsv = cvCreateImage(cvSize(256, 256), IPL_DEPTH_8U, 3);
+	for (int y=0; y<256; y++) {
+		unsigned char *p = (unsigned char*)(bgr->imageData + y*bgr->widthStep);
+		for (int x=0; x<256; x++) {
+			p[3*x] = (unsigned char)x;
+			p[3*x+1] = (unsigned char)y;
+			p[3*x+2] = (unsigned char)((x*7 + y*13) & 0xFF);
+		}
+	}
+	cvCvtColor(bgr, hsv, CV_BGR2HSV);
+
+	bool matches = true;
+	for (int y=0; (y<256) && matches; y++) {
+		const unsigned char *p = (const unsigned char*)(bgr->imageData + y*bgr->widthStep);
+		const unsigned char *q = (const unsigned char*)(hsv->imageData + y*hsv->widthStep);
+		for (int x=0; x<256; x++) {
+			int b = p[3*x], g = p[3*x+1], r = p[3*x+2];
+			int v = max(b, max(g, r));
+			int diff = v - min(b, min(g, r));
+			int s = (diff * divTable[v]) >> hsvShift;
+			if ((Hue(b, g, r, v, diff) != q[3*x]) || (s != q[3*x+1]) || (v != q[3*x+2])) {
+				matches = false;
+				break;
+			}
+		}
+	}
+	cvReleaseImage(&bgr);
+	cvReleaseImage(&hsv);
+	return matches;
+}
+
+void ColorMaskKernel::SetModel(CvHistogram *hist, int thresh, int smin, int vmin, int vmax) {
+	// backproject every hue, so the table holds exactly what cvCalcBackProject would give
+	if (hues == NULL) {
+		hues = cvCreateImage(cvSize(256, 1), IPL_DEPTH_8U, 1);
+		backproject = cvCreateImage(cvSize(256, 1), IPL_DEPTH_8U, 1);
+		for (int i=0; i<256; i++) ((unsigned char*)hues->imageData)[i] = (unsigned char)i;
+	}
+	cvCalcArrBackProject((CvArr**)&hues, backproject, hist);
+	for (int i=0; i<256; i++) {
+		huePass[i] = (((unsigned char*)backproject->imageData)[i] > thresh) ? 1 : 0;
+	}
+
+	// the saturation only grows with the spread at a given value, so the test comes down to a least spread
+	leastDiff = lowValue = 256;
+	highValue = -1;
+	minSaturation = smin;
+	for (int v=0; v<256; v++) {
+		minDiff[v] = 256;
+		if ((v < vmin) || (v >= vmax)) continue;
+		for (int diff=0; diff<=v; diff++) {
+			if (((diff * divTable[v]) >> hsvShift) >= smin) {
+				minDiff[v] = (short)diff;
+				break;
+			}
+		}
+		if (minDiff[v] < 256) {
+			leastDiff = min(leastDiff, (int)minDiff[v]);
+			lowValue = min(lowValue, v);
+			highValue = v;
+		}
+	}
+}
+
+unsigned int ColorMaskKernel::MaskBits(const unsigned char *p, int n) {
+	unsigned int bits = 0;
+	for (int x=0; x<n; x++, p+=3) {
+		int b = p[0], g = p[1], r = p[2];
+		int v = max(b, max(g, r));
+		int diff = v - min(b, min(g, r));
+		if (diff < minDiff[v]) continue;
+		bits |= (unsigned int)huePass[Hue(b, g, r, v, diff)] << x;
+	}
+	return bits;
+}
+
+void ColorMaskKernel::Apply(const CvArr *bgr, BitMask &mask) {
+#ifdef COLORMASK_SSE2
+	ApplySSE2(bgr, mask);
+#else
+	ApplyScalar(bgr, mask);
+#endif
+}
+
+void ColorMaskKernel::ApplyScalar(const CvArr *bgr, BitMask &mask) {
+	CvMat stub;
+	CvMat *mat = cvGetMat(bgr, &stub);
+	int width = mat->cols, height = mat->rows;
+	mask.Create(width, height);
+
+	for (int y=0; y<height; y++) {
+		const unsigned char *p = mat->data.ptr + y*mat->step;
+		unsigned int *row = mask.GetRow(y);
+		for (int x0=0; x0<width; x0+=32, p+=3*32) {
+			// a word of the mask at a time, so it is only written once
+			row[x0/32] = MaskBits(p, min(32, width-x0));
+		}
+	}
+}
+
+#ifdef COLORMASK_SSE2
+void ColorMaskKernel::ApplySSE2(const CvArr *bgr, BitMask &mask) {
+	CvMat stub;
+	CvMat *mat = cvGetMat(bgr, &stub);
+	int width = mat->cols, height = mat->rows;
+	mask.Create(width, height);	// cleared
+	if (leastDiff > 255) return;	// no pixel can pass
+
+	// A pixel may pass if its value is in [lowValue, highValue], its spread is at least leastDiff
+	// and diff*255 + v >= minSaturation*v.  The saturation (diff << 12)/v is rounded off by less
+	// than v/255 of a step, so the last test never rules out a pixel that passes.  SSE2 only
+	// compares signed numbers, so unsigned a >= b is tested as max(a,b) == a, and as a-b
+	// saturating to 0 for the 16 bit sides of the last test.
+	const __m128i least = _mm_set1_epi8((char)leastDiff);
+	const __m128i low = _mm_set1_epi8((char)lowValue);
+	const __m128i high = _mm_set1_epi8((char)highValue);
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i full = _mm_set1_epi16(255);
+	const __m128i saturation = _mm_set1_epi16((short)minSaturation);
+	unsigned char channels[6*16], values[32], diffs[32];
+
+	for (int y=0; y<height; y++) {
+		const unsigned char *p = mat->data.ptr + y*mat->step;
+		unsigned int *row = mask.GetRow(y);
+		int x0 = 0;
+		for (; x0+32<=width; x0+=32, p+=3*32) {
+			// five rounds of interleaving the six vectors of 32 BGR pixels with each other leave
+			// the blue, green and red of the pixels in order, 16 to a vector
+			__m128i c[6], n[6];
+			for (int i=0; i<6; i++) c[i] = _mm_loadu_si128((const __m128i*)(p + 16*i));
+			for (int round=0; round<5; round++) {
+				for (int i=0; i<3; i++) {
+					n[2*i] = _mm_unpacklo_epi8(c[i], c[i+3]);
+					n[2*i+1] = _mm_unpackhi_epi8(c[i], c[i+3]);
+				}
+				for (int i=0; i<6; i++) c[i] = n[i];
+			}
+
+			unsigned int candidates = 0;
+			__m128i v[2], diff[2];
+			for (int half=0; half<2; half++) {
+				__m128i b = c[half], g = c[2+half], r = c[4+half];
+				v[half] = _mm_max_epu8(b, _mm_max_epu8(g, r));
+				diff[half] = _mm_sub_epi8(v[half], _mm_min_epu8(b, _mm_min_epu8(g, r)));
+				__m128i inRange = _mm_and_si128(_mm_cmpeq_epi8(_mm_max_epu8(v[half], low), v[half]),
+					_mm_cmpeq_epi8(_mm_min_epu8(v[half], high), v[half]));
+				__m128i spread = _mm_cmpeq_epi8(_mm_max_epu8(diff[half], least), diff[half]);
+				__m128i saturated[2];
+				for (int part=0; part<2; part++) {
+					__m128i v16 = part ? _mm_unpackhi_epi8(v[half], zero) : _mm_unpacklo_epi8(v[half], zero);
+					__m128i diff16 = part ? _mm_unpackhi_epi8(diff[half], zero) : _mm_unpacklo_epi8(diff[half], zero);
+					__m128i lhs = _mm_add_epi16(_mm_mullo_epi16(diff16, full), v16);
+					__m128i rhs = _mm_mullo_epi16(saturation, v16);
+					saturated[part] = _mm_cmpeq_epi16(_mm_subs_epu16(rhs, lhs), zero);
+				}
+				__m128i pass = _mm_and_si128(_mm_and_si128(inRange, spread), _mm_packs_epi16(saturated[0], saturated[1]));
+				candidates |= (unsigned int)_mm_movemask_epi8(pass) << (16*half);
+			}
+			if (candidates == 0) continue;	// the word stays clear
+
+			// the rest of the test, and the hue, one candidate at a time
+			for (int i=0; i<6; i++) _mm_storeu_si128((__m128i*)(channels + 16*i), c[i]);
+			for (int half=0; half<2; half++) {
+				_mm_storeu_si128((__m128i*)(values + 16*half), v[half]);
+				_mm_storeu_si128((__m128i*)(diffs + 16*half), diff[half]);
+			}
+			unsigned int bits = 0;
+			int x = 0;
+			for (unsigned int rest = candidates; rest != 0; rest >>= 1, x++) {
+				if (!(rest & 1) || (diffs[x] < minDiff[values[x]])) continue;
+				int b = channels[x], g = channels[32+x], r = channels[64+x];
+				bits |= (unsigned int)huePass[Hue(b, g, r, values[x], diffs[x])] << x;
+			}
+			row[x0/32] = bits;
+		}
+		if (x0 < width) row[x0/32] = MaskBits(p, width-x0);
+	}
+}
+#endif
@@ -0,0 +1,69 @@
+#pragma once
+#include "BitMask.h"
+
+// SSE2 is always there on x64, and the x86 builds target it
+#if defined(_M_IX86) || defined(_M_X64) || defined(__SSE2__)
+#define COLORMASK_SSE2
+#endif
+
+// Goes from a BGR image straight to the packed mask of the pixels a hue histogram picks out, in
+// one sweep over the image.  A pixel is set where its saturation and value are in range and the
+// backprojection of its hue through the histogram is above the threshold: the same mask as
+// cvCvtColor(CV_BGR2HSV), cvInRangeS, cvSplit, cvCalcBackProject, cvAnd and a threshold give one
+// after another, without any of their full frame intermediate images.
+//
+// Each pixel is converted with the integer arithmetic of OpenCV's 8 bit BGR to HSV conversion,
+// and the hue is then looked up in a table of which hues pass (worked out through
+// cvCalcArrBackProject itself).  The conversion is checked against cvCvtColor once, and callers
+// should fall back on the OpenCV functions if the OpenCV they run with converts differently.
+// Where SSE2 is available, 32 pixels at a time are split into channels and ruled out by their
+// value and saturation together, so only the pixels that may pass are looked up one by one;
+// the masks are the same as the plain loop's.
+class ColorMaskKernel
+{
+public:
+	ColorMaskKernel();
+	~ColorMaskKernel();
+
+	// whether our conversion gives the same hue, saturation and value as cvCvtColor
+	static bool MatchesOpenCV();
+
+	// pixels pass if the backprojection of their hue through hist (over hues 0 to 180) is above
+	// thresh, and their saturation and value are within [smin, 256) and [vmin, vmax)
+	void SetModel(CvHistogram *hist, int thresh, int smin, int vmin, int vmax);
+
+	// mask is (re)created at the size of bgr, an 8 bit 3 channel image or CvMat region
+	void Apply(const CvArr *bgr, BitMask &mask);
+	void ApplyScalar(const CvArr *bgr, BitMask &mask);	// the plain loop, without SSE2
+
+	// the tables SetModel worked out, for testing pixels elsewhere (see FusedMaskEvaluator)
+	const unsigned char* GetHuePass() const { return huePass; }
+	const short* GetMinDiff() const { return minDiff; }
+
+	// the hue (0..179) cvCvtColor gives a pixel whose largest channel is v and smallest v-diff
+	// (only once MatchesOpenCV has been called)
+	static inline int Hue(int b, int g, int r, int v, int diff) {
+		int num = (v == r) ? (g - b) : ((v == g) ? (b - r + 2*diff) : (r - g + 4*diff));
+		return ((num * divTable[diff] * 15 + (1 << (hsvShift + 6))) >> (hsvShift + 7)) + ((num < 0) ? 180 : 0);
+	}
+
+private:
+	ColorMaskKernel(const ColorMaskKernel&);
+	void operator=(const ColorMaskKernel&);
+	static bool CheckConversion();
+	unsigned int MaskBits(const unsigned char *p, int n);	// the mask of n (up to 32) pixels from p
+#ifdef COLORMASK_SSE2
+	void ApplySSE2(const CvArr *bgr, BitMask &mask);
+#endif
+
+	// OpenCV's fixed point BGR to HSV conversion works with 12 fractional bits, dividing through
+	// this table of (255 << 12)/i
+	enum { hsvShift = 12 };
+	static int divTable[256];
+
+	unsigned char huePass[256];		// 1 for the hues whose backprojection is above the threshold
+	short minDiff[256];		// the least max-min spread saturated enough at each value (256 if the value is out of range)
+	int leastDiff, lowValue, highValue;	// the least of those spreads, and the values they are for
+	int minSaturation;
+	IplImage *hues, *backproject;		// every hue, and their backprojection
+};
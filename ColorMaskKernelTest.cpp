@@ -0,0 +1,73 @@
+// Checks that ColorMaskKernel's SSE2 path gives exactly the masks of its plain loop, over random
+// images, regions and models.  Built and run by "make test"; exits with 1 if any mask differs.
+
+#include "precomp.h"
+#include "ColorMaskKernel.h"
+
+static int CountDifferences(BitMask &a, BitMask &b) {
+	if ((a.GetWidth() != b.GetWidth()) || (a.GetHeight() != b.GetHeight())) return a.GetWidth()*a.GetHeight();
+	int differences = 0;
+	for (int y=0; y<a.GetHeight(); y++) {
+		for (int x=0; x<a.GetWidth(); x++) {
+			if (((a.GetRow(y)[x/32] >> (x%32)) & 1) != ((b.GetRow(y)[x/32] >> (x%32)) & 1)) differences++;
+		}
+	}
+	return differences;
+}
+
+int main() {
+	CvRNG rng = cvRNG(0x12345678);
+	ColorMaskKernel kernel;
+	BitMask fast, plain;
+
+	int hdims = 16;
+	float hranges_arr[] = {0, 180};
+	float *hranges = hranges_arr;
+	CvHistogram *hist = cvCreateHist(1, &hdims, CV_HIST_ARRAY, &hranges, 1);
+	IplImage *image = cvCreateImage(cvSize(643, 37), IPL_DEPTH_8U, 3);	// not a whole number of mask words wide
+
+	int failures = 0;
+	for (int trial=0; trial<500; trial++) {
+		// noise, or colors bunched around one, so that many pixels are near the limits
+		if (trial % 2) {
+			cvRandArr(&rng, image, CV_RAND_UNI, cvScalarAll(0), cvScalarAll(256));
+		} else {
+			CvScalar mean = cvScalar(cvRandInt(&rng)%256, cvRandInt(&rng)%256, cvRandInt(&rng)%256);
+			cvRandArr(&rng, image, CV_RAND_NORMAL, mean, cvScalarAll(1 + cvRandInt(&rng)%40));
+		}
+
+		// a random histogram and limits, with the usual ones (low saturation, any value) every so often
+		for (int i=0; i<hdims; i++) cvSetReal1D(hist->bins, i, cvRandInt(&rng)%256);
+		int smin = cvRandInt(&rng)%256;
+		int vmin = cvRandInt(&rng)%256;
+		int vmax = vmin + cvRandInt(&rng)%(257-vmin);
+		if (trial % 4 == 0) {
+			smin = cvRandInt(&rng)%60;
+			vmin = cvRandInt(&rng)%20;
+			vmax = 256;
+		}
+		kernel.SetModel(hist, cvRandInt(&rng)%256, smin, vmin, vmax);
+
+		// the whole image, and a region of it that starts part way along a row
+		kernel.Apply(image, fast);
+		kernel.ApplyScalar(image, plain);
+		int differences = CountDifferences(fast, plain);
+
+		CvMat region;
+		int x = cvRandInt(&rng)%(image->width-1), y = cvRandInt(&rng)%(image->height-1);
+		cvGetSubRect(image, &region, cvRect(x, y, 1 + cvRandInt(&rng)%(image->width-x), 1 + cvRandInt(&rng)%(image->height-y)));
+		kernel.Apply(&region, fast);
+		kernel.ApplyScalar(&region, plain);
+		differences += CountDifferences(fast, plain);
+
+		if (differences > 0) {
+			fprintf(stderr, "trial %d (smin %d, vmin %d, vmax %d): %d pixels differ\n", trial, smin, vmin, vmax, differences);
+			failures++;
+		}
+	}
+
+	cvReleaseHist(&hist);
+	cvReleaseImage(&image);
+	printf("ColorMaskKernel: %s\n", (failures == 0) ? "passed" : "FAILED");
+	return (failures == 0) ? 0 : 1;
+}
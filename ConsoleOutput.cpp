@@ -0,0 +1,106 @@
+#include "precomp.h"
+#include "constants.h"
+
+#include "OutputSink.h"
+#include "ConsoleOutput.h"
+#include <stdarg.h>
+
+ConsoleOutput::ConsoleOutput(FILE *stream, int index) :
+    OutputSink() {
+    outStream = stream;
+    streamIndex = index;
+    nFrames = 0;
+
+    SetName(L"Text Output to Console");
+}
+
+ConsoleOutput::~ConsoleOutput() {
+}
+
+void ConsoleOutput::ProcessInput(IplImage *image) {
+    // each input frame starts a new set of outputs
+    nFrames++;
+}
+
+void ConsoleOutput::StopRunning() {
+    fflush(outStream);
+}
+
+void ConsoleOutput::ProcessOutput(IplImage *image, ClassifierOutputData &data, char *filterName) {
+	int ival;
+	float fval;
+	Point pt;
+	vector<Rect> *bboxes;
+	string sval;
+
+	line.clear();
+	if (streamIndex >= 0) Append("%d\t", streamIndex);
+	Append("%ld\t", nFrames);
+	line += filterName;
+
+	int nVars = data.NumVariables();
+	for (int i=0; i<nVars; i++) {
+		const ClassifierOutputVariable &var = data.GetVariableOfIndex(i);
+		if (var.GetState() == true) {	// this variable is active
+			switch(var.GetType()) {
+				case CVAR_VOID:
+				case CVAR_IMAGE:
+					// can't do anything with these types
+					break;
+				case CVAR_INT:
+					ival = var.GetIntData();
+					Append("\t%s=%d", var.GetName().c_str(), ival);
+					break;
+				case CVAR_FLOAT:
+					fval = var.GetFloatData();
+					Append("\t%s=%f", var.GetName().c_str(), fval);
+					break;
+				case CVAR_POINT:
+					pt = var.GetPointData();
+					Append("\t%s=%d,%d", var.GetName().c_str(), ((int)pt.X), ((int)pt.Y));
+					break;
+				case CVAR_STRING:
+					sval = var.GetStringData();
+					Append("\t%s=\"%s\"", var.GetName().c_str(), sval.c_str());
+					break;
+				case CVAR_SEQ:
+					// contours aren't written as text
+					break;
+				case CVAR_BBOXES:
+					bboxes = var.GetBoundingBoxData();
+					Append("\t%s=", var.GetName().c_str());
+					for (vector<Rect>::iterator box = bboxes->begin(); box != bboxes->end(); box++) {
+						Rect r = (*box);
+						Append("%s%d,%d,%d,%d", (box == bboxes->begin()) ? "" : ";",
+							(int)r.X, (int)r.Y, (int)r.Width, (int)r.Height);
+					}
+					break;
+			}
+		}
+	}
+	line += '\n';
+
+	// one call, so it is written whole even when other streams write to the same place
+	fwrite(line.data(), 1, line.size(), outStream);
+}
+
+void ConsoleOutput::Append(const char *format, ...) {
+	char buf[256];
+	va_list args;
+	va_start(args, format);
+	int n = vsnprintf(buf, sizeof(buf), format, args);
+	va_end(args);
+	if (n < 0) return;
+	if (n < (int)sizeof(buf)) {
+		line.append(buf, n);
+		return;
+	}
+
+	// too long for the buffer (a long name or string value), so format it again in place
+	size_t start = line.size();
+	line.resize(start+n+1);
+	va_start(args, format);
+	vsnprintf(&line[start], n+1, format, args);
+	va_end(args);
+	line.resize(start+n);
+}
@@ -0,0 +1,25 @@
+#pragma once
+#include "OutputSink.h"
+
+// Writes the active output variables of each frame to a stdio stream, one line per filter result.
+// Used by the headless runner in place of the GUI-only sinks.  When several streams share the
+// same stdio stream, each is given its index, which starts its lines, and every line goes out
+// in a single write so the lines of different streams never run into each other.
+class ConsoleOutput : public OutputSink {
+public:
+    ConsoleOutput(FILE *stream, int index = -1);	// -1 for no stream column
+    ~ConsoleOutput();
+
+	void ProcessInput(IplImage* image);
+	void ProcessOutput(IplImage* image, ClassifierOutputData &data, char *filterName);
+	void StartRunning() {}	// nothing to open or close,
+	void StopRunning();     // but we flush the stream when stopped
+
+private:
+	void Append(const char *format, ...);	// printf to the end of the line
+
+    FILE *outStream;
+    int streamIndex;
+    long nFrames;
+	string line;	// kept between results, so its space is reused
+};
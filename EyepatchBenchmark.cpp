@@ -0,0 +1,574 @@
+// Offline throughput benchmark for saved Eyepatch recognizers.
+//
+// Runs each recognizer given on the command line (the epc*_COL, _LUT, _CAM, _SHP, _SIF, _APP,
+// _MOT, _GES, _BRI folders written by the Eyepatch GUI), plus adaptive background subtraction, over a
+// recorded clip at several resolutions, then runs all of them together as one chain in LIST,
+// AND, OR and CASCADE modes.  For every run it reports frames per second, per-frame latency
+// percentiles and peak resident memory, on the console and optionally as JSON and CSV.
+// With --compare, it also measures how closely each recognizer's masks follow the first one's
+// on the same frames, e.g. to weigh a color table recognizer against the hue histogram color
+// recognizer trained on the same examples.
+//
+// Frames are decoded and scaled outside the timed region, so only the filter chain is measured.
+// The first few frames of each run are left out of the statistics, since classifiers allocate
+// their working images and the motion history fills up on them.  After that the classifiers
+// should not touch the heap at all: every run counts the allocations made in its measured
+// frames, and with --check-allocations the benchmark fails if any run made one.
+//
+// Built with EYEPATCH_HEADLESS defined by "make EyepatchBenchmark", from the recognizer core that
+// EyepatchRunner uses too (the Makefile lists the sources).
+
+#include "precomp.h"
+#include "constants.h"
+#include "TrainingSample.h"
+#include "TrainingSet.h"
+#include "Classifier.h"
+#include "BackgroundSubtraction.h"
+#include "ClassifierFactory.h"
+#include "OutputSink.h"
+#include "FilterChain.h"
+#include <locale.h>
+#include <atomic>
+#include <new>
+#ifdef _WIN32
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+static void PrintUsage(const char *program) {
+	fprintf(stderr,
+		"usage: %s --file PATH [options] [classifier directory]...\n"
+		"  --file PATH       recorded video clip to run the recognizers over\n"
+		"  --sizes LIST      frame sizes to test, e.g. 320x240,640x480\n"
+		"                    (default 320x240,640x480,1280x720,1920x1080)\n"
+		"  --frames N        measure at most N frames of each run (default 300)\n"
+		"  --warmup N        frames to run before measuring (default 10)\n"
+		"  --threads N       classify each frame on N threads (default 1, 0 for one per processor)\n"
+		"  --no-background   leave background subtraction out\n"
+		"  --no-chains       only benchmark the recognizers one at a time\n"
+		"  --compare         compare the masks of each recognizer with those of the first\n"
+		"  --check-allocations\n"
+		"                    fail if any run allocates memory after its warm-up frames\n"
+		"  --json PATH       write the results to PATH as JSON\n"
+		"  --csv PATH        write the results to PATH as CSV\n",
+		program);
+}
+
+// what we measured for one recognizer (or chain) at one frame size
+struct BenchmarkResult {
+	string name;
+	string mode;
+	int width, height;
+	long frames;
+	double seconds;			// time spent in the filter chain, over the measured frames
+	double fps;
+	LatencyStats latency;	// per frame, over all of the measured frames
+	long peakMemoryKB;
+	long allocations;		// heap allocations in the filter chain, over the measured frames
+};
+
+// how closely one recognizer's masks follow another's, over the same frames
+struct AgreementResult {
+	string name;
+	string reference;
+	int width, height;
+	long frames;
+	double iou;			// pixels in both masks over pixels in either, over all of the frames
+	double precision;	// share of its pixels that are in the reference mask too
+	double recall;		// share of the reference mask's pixels that it finds as well
+};
+
+// Heap allocations are counted while the filter chain works on a measured frame, both through
+// operator new and through cvAlloc (which OpenCV uses for its images, matrices and storage).
+// The classifier threads allocate through the same functions, so they are counted too.
+static std::atomic<bool> countingAllocations(false);
+static std::atomic<long> nAllocations(0);
+
+void* operator new(size_t size) {
+	if (countingAllocations) nAllocations++;
+	void *p = malloc((size > 0) ? size : 1);
+	if (p == NULL) throw std::bad_alloc();
+	return p;
+}
+
+void operator delete(void *p) noexcept {
+	free(p);
+}
+
+// aligned the way OpenCV's own allocator does it, with the block's address just before the data
+static void* CV_CDECL CountingAlloc(size_t size, void*) {
+	if (countingAllocations) nAllocations++;
+	char *block = (char*)malloc(size + sizeof(char*) + CV_MALLOC_ALIGN);
+	if (block == NULL) return NULL;
+	char **data = (char**)cvAlignPtr((char**)block + 1, CV_MALLOC_ALIGN);
+	data[-1] = block;
+	return data;
+}
+
+static int CV_CDECL CountingFree(void *ptr, void*) {
+	if (ptr != NULL) free(((char**)ptr)[-1]);
+	return 0;
+}
+
+// Peak resident memory of the process.  Where the OS lets us reset the peak (Linux and Windows)
+// we do so before each run, so each result covers that run alone; elsewhere it is the peak so far.
+static void ResetPeakMemory() {
+#ifdef _WIN32
+	// trimming the working set is as close as Windows gets to resetting the peak
+	SetProcessWorkingSetSize(GetCurrentProcess(), (SIZE_T)-1, (SIZE_T)-1);
+#else
+	FILE *f = fopen("/proc/self/clear_refs", "w");
+	if (f == NULL) return;
+	fputs("5", f);
+	fclose(f);
+#endif
+}
+
+static long GetPeakMemoryKB() {
+#ifdef _WIN32
+	PROCESS_MEMORY_COUNTERS counters;
+	if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) return 0;
+	return (long)(counters.PeakWorkingSetSize/1024);
+#else
+	// VmHWM follows clear_refs; ru_maxrss never goes down
+	FILE *f = fopen("/proc/self/status", "r");
+	if (f != NULL) {
+		char line[256];
+		long kb = -1;
+		while (fgets(line, sizeof(line), f) != NULL) {
+			if (sscanf(line, "VmHWM: %ld", &kb) == 1) break;
+		}
+		fclose(f);
+		if (kb >= 0) return kb;
+	}
+	struct rusage usage;
+	if (getrusage(RUSAGE_SELF, &usage) != 0) return 0;
+#ifdef __APPLE__
+	return usage.ru_maxrss/1024;	// bytes on OS X
+#else
+	return usage.ru_maxrss;
+#endif
+#endif
+}
+
+// same percentiles as LatencyHistogram, over every sample instead of the last METRICS_WINDOW
+static void GetLatencyStats(vector<double> &samples, LatencyStats &stats) {
+	stats.name = "Frame";
+	stats.count = (long)samples.size();
+	stats.mean = stats.p50 = stats.p95 = stats.p99 = stats.max = 0;
+	int n = (int)samples.size();
+	if (n == 0) return;
+
+	sort(samples.begin(), samples.end());
+	double total = 0;
+	for (int i=0; i<n; i++) total += samples[i];
+	stats.mean = total/n;
+	stats.p50 = samples[(n-1)*50/100];
+	stats.p95 = samples[(n-1)*95/100];
+	stats.p99 = samples[(n-1)*99/100];
+	stats.max = samples[n-1];
+}
+
+static const char* GetCombineModeName(int mode) {
+	switch (mode) {
+		case IDC_COMBINE_AND: return "and";
+		case IDC_COMBINE_OR: return "or";
+		case IDC_COMBINE_CASCADE: return "cascade";
+		default: return "list";
+	}
+}
+
+// Runs the classifiers as one chain over the clip at the given size.  Returns false if the
+// clip can't be opened or has no frames past the warm-up.
+static bool RunBenchmark(const char *clipFile, vector<Classifier*> &classifiers, int combineMode,
+						 CvSize size, long maxFrames, int warmupFrames, int nThreads, BenchmarkResult &result) {
+	CvCapture *capture = cvCreateFileCapture(clipFile);
+	if (capture == NULL) return false;
+
+	FilterChain *chain = new FilterChain();
+	chain->filterCombineMode = combineMode;
+	chain->SetClassifierThreads(nThreads);
+	chain->drawContours = false;	// as in the headless runner
+	for (int i=0; i<(int)classifiers.size(); i++) {
+		chain->AddActiveFilter(classifiers[i]);
+	}
+	chain->StartProcessing(size.width, size.height);
+	chain->ResetActiveFilterRunningStates();
+
+	IplImage *frame = cvCreateImage(size, IPL_DEPTH_8U, 3);
+	vector<double> samples;
+	samples.reserve(maxFrames);
+	double totalMs = 0;
+	long allocations = 0;
+	ResetPeakMemory();
+
+	for (long frameNum = 0; (long)samples.size() < maxFrames; frameNum++) {
+		IplImage *src = cvQueryFrame(capture);
+		if (src == NULL) break;	// end of the clip
+		cvResize(src, frame, CV_INTER_LINEAR);
+		if (src->origin != IPL_ORIGIN_TL) cvFlip(frame, NULL, 0);
+
+		nAllocations = 0;
+		countingAllocations = true;
+		double start = GetTimeMs();
+		chain->ApplyFilterChain(frame, frameNum);
+		double ms = GetTimeMs()-start;
+		countingAllocations = false;
+
+		if (frameNum < warmupFrames) continue;
+		samples.push_back(ms);
+		totalMs += ms;
+		allocations += nAllocations;
+	}
+
+	result.mode = GetCombineModeName(combineMode);
+	result.width = size.width;
+	result.height = size.height;
+	result.frames = (long)samples.size();
+	result.seconds = totalMs/1000.0;
+	result.fps = (totalMs > 0) ? samples.size()*1000.0/totalMs : 0;
+	result.peakMemoryKB = GetPeakMemoryKB();
+	result.allocations = allocations;
+	GetLatencyStats(samples, result.latency);
+
+	chain->ClearActiveFilters();
+	delete chain;
+	cvReleaseImage(&frame);
+	cvReleaseCapture(&capture);
+	return (result.frames > 0);
+}
+
+// Runs the classifiers side by side as one LIST chain over the clip at the given size (so each
+// one works at its own pyramid level, as in the other runs), comparing the mask of each with
+// that of the first on every measured frame.  Returns false if there are no frames to compare.
+static bool RunAgreement(const char *clipFile, vector<Classifier*> &classifiers, CvSize size,
+						 long maxFrames, int warmupFrames, vector<AgreementResult> &results) {
+	CvCapture *capture = cvCreateFileCapture(clipFile);
+	if (capture == NULL) return false;
+
+	FilterChain *chain = new FilterChain();
+	chain->filterCombineMode = IDC_COMBINE_LIST;
+	chain->drawContours = false;
+	for (int i=0; i<(int)classifiers.size(); i++) {
+		chain->AddActiveFilter(classifiers[i]);
+	}
+	chain->StartProcessing(size.width, size.height);
+	chain->ResetActiveFilterRunningStates();
+
+	int n = (int)classifiers.size();
+	vector<double> both(n, 0), either(n, 0), found(n, 0);
+	double referenceFound = 0;
+	IplImage *frame = cvCreateImage(size, IPL_DEPTH_8U, 3);
+	IplImage *overlap = cvCreateImage(cvSize(GUESSMASK_WIDTH, GUESSMASK_HEIGHT), IPL_DEPTH_8U, 1);
+	long frames = 0;
+
+	for (long frameNum = 0; frames < maxFrames; frameNum++) {
+		IplImage *src = cvQueryFrame(capture);
+		if (src == NULL) break;	// end of the clip
+		cvResize(src, frame, CV_INTER_LINEAR);
+		if (src->origin != IPL_ORIGIN_TL) cvFlip(frame, NULL, 0);
+		chain->ApplyFilterChain(frame, frameNum);
+		if (frameNum < warmupFrames) continue;
+		frames++;
+
+		IplImage *reference = classifiers[0]->outputData.GetImageData(CVAR_ID_MASK);
+		int referenceCount = cvCountNonZero(reference);
+		referenceFound += referenceCount;
+		for (int i=1; i<n; i++) {
+			IplImage *mask = classifiers[i]->outputData.GetImageData(CVAR_ID_MASK);
+			int count = cvCountNonZero(mask);
+			cvAnd(reference, mask, overlap);
+			int overlapCount = cvCountNonZero(overlap);
+			both[i] += overlapCount;
+			either[i] += referenceCount + count - overlapCount;
+			found[i] += count;
+		}
+	}
+
+	for (int i=1; (i<n) && (frames > 0); i++) {
+		AgreementResult result;
+		result.name = W2A(classifiers[i]->GetName());
+		result.reference = W2A(classifiers[0]->GetName());
+		result.width = size.width;
+		result.height = size.height;
+		result.frames = frames;
+		// two empty masks agree completely
+		result.iou = (either[i] > 0) ? both[i]/either[i] : 1;
+		result.precision = (found[i] > 0) ? both[i]/found[i] : 1;
+		result.recall = (referenceFound > 0) ? both[i]/referenceFound : 1;
+		results.push_back(result);
+	}
+
+	chain->ClearActiveFilters();
+	delete chain;
+	cvReleaseImage(&frame);
+	cvReleaseImage(&overlap);
+	cvReleaseCapture(&capture);
+	return (frames > 0);
+}
+
+static string JsonEscape(const string &s) {
+	string escaped;
+	for (int i=0; i<(int)s.size(); i++) {
+		char c = s[i];
+		if ((c == '"') || (c == '\\')) {
+			escaped += '\\';
+			escaped += c;
+		} else if ((unsigned char)c < 0x20) {
+			char buf[8];
+			sprintf(buf, "\\u%04x", c);
+			escaped += buf;
+		} else {
+			escaped += c;
+		}
+	}
+	return escaped;
+}
+
+static string CsvEscape(const string &s) {
+	if (s.find_first_of(",\"\n") == string::npos) return s;
+	string escaped = "\"";
+	for (int i=0; i<(int)s.size(); i++) {
+		if (s[i] == '"') escaped += '"';
+		escaped += s[i];
+	}
+	return escaped + "\"";
+}
+
+static bool WriteJson(const char *path, const char *clipFile, vector<BenchmarkResult> &results,
+					  vector<AgreementResult> &agreement) {
+	FILE *f = fopen(path, "w");
+	if (f == NULL) return false;
+	fprintf(f, "{\n  \"clip\": \"%s\",\n  \"results\": [\n", JsonEscape(clipFile).c_str());
+	for (int i=0; i<(int)results.size(); i++) {
+		BenchmarkResult &r = results[i];
+		fprintf(f, "    {\"name\": \"%s\", \"mode\": \"%s\", \"width\": %d, \"height\": %d, \"frames\": %ld, "
+			"\"seconds\": %.4f, \"fps\": %.2f, \"mean_ms\": %.3f, \"p50_ms\": %.3f, \"p95_ms\": %.3f, "
+			"\"p99_ms\": %.3f, \"max_ms\": %.3f, \"peak_memory_kb\": %ld, \"allocations\": %ld}%s\n",
+			JsonEscape(r.name).c_str(), r.mode.c_str(), r.width, r.height, r.frames,
+			r.seconds, r.fps, r.latency.mean, r.latency.p50, r.latency.p95,
+			r.latency.p99, r.latency.max, r.peakMemoryKB, r.allocations, (i+1 < (int)results.size()) ? "," : "");
+	}
+	fprintf(f, "  ]");
+	if (!agreement.empty()) {
+		fprintf(f, ",\n  \"agreement\": [\n");
+		for (int i=0; i<(int)agreement.size(); i++) {
+			AgreementResult &a = agreement[i];
+			fprintf(f, "    {\"name\": \"%s\", \"reference\": \"%s\", \"width\": %d, \"height\": %d, "
+				"\"frames\": %ld, \"iou\": %.4f, \"precision\": %.4f, \"recall\": %.4f}%s\n",
+				JsonEscape(a.name).c_str(), JsonEscape(a.reference).c_str(), a.width, a.height,
+				a.frames, a.iou, a.precision, a.recall, (i+1 < (int)agreement.size()) ? "," : "");
+		}
+		fprintf(f, "  ]");
+	}
+	fprintf(f, "\n}\n");
+	fclose(f);
+	return true;
+}
+
+static bool WriteCsv(const char *path, vector<BenchmarkResult> &results) {
+	FILE *f = fopen(path, "w");
+	if (f == NULL) return false;
+	fprintf(f, "name,mode,width,height,frames,seconds,fps,mean_ms,p50_ms,p95_ms,p99_ms,max_ms,peak_memory_kb,allocations\n");
+	for (int i=0; i<(int)results.size(); i++) {
+		BenchmarkResult &r = results[i];
+		fprintf(f, "%s,%s,%d,%d,%ld,%.4f,%.2f,%.3f,%.3f,%.3f,%.3f,%.3f,%ld,%ld\n",
+			CsvEscape(r.name).c_str(), r.mode.c_str(), r.width, r.height, r.frames,
+			r.seconds, r.fps, r.latency.mean, r.latency.p50, r.latency.p95,
+			r.latency.p99, r.latency.max, r.peakMemoryKB, r.allocations);
+	}
+	fclose(f);
+	return true;
+}
+
+static void PrintResult(BenchmarkResult &r) {
+	fprintf(stderr, "%-32s %-8s %5dx%-5d %6ld %9.1f %8.2f %8.2f %8.2f %8.2f %10ld %8ld\n",
+		r.name.c_str(), r.mode.c_str(), r.width, r.height, r.frames, r.fps,
+		r.latency.p50, r.latency.p95, r.latency.p99, r.latency.max, r.peakMemoryKB, r.allocations);
+}
+
+static bool ParseSizes(const char *arg, vector<CvSize> &sizes) {
+	sizes.clear();
+	string list = arg;
+	size_t start = 0;
+	while (start < list.size()) {
+		size_t end = list.find(',', start);
+		if (end == string::npos) end = list.size();
+		int width, height;
+		if (sscanf(list.substr(start, end-start).c_str(), "%dx%d", &width, &height) != 2) return false;
+		if ((width <= 0) || (height <= 0)) return false;
+		sizes.push_back(cvSize(width, height));
+		start = end+1;
+	}
+	return !sizes.empty();
+}
+
+int main(int argc, char **argv) {
+	setlocale(LC_ALL, "");
+
+	// before OpenCV allocates anything, since the blocks have to be freed by the allocator that made them
+	cvSetMemoryManager(CountingAlloc, CountingFree, NULL);
+
+	const char *clipFile = NULL;
+	const char *jsonFile = NULL;
+	const char *csvFile = NULL;
+	long maxFrames = 300;
+	int warmupFrames = 10;
+	int nThreads = 1;
+	bool useBackground = true, runChains = true, compareMasks = false, checkAllocations = false;
+	vector<string> classifierDirs;
+	vector<CvSize> sizes;
+	ParseSizes("320x240,640x480,1280x720,1920x1080", sizes);
+
+	for (int i=1; i<argc; i++) {
+		string arg = argv[i];
+		bool hasValue = (i+1 < argc);
+		if ((arg == "--file") && hasValue) {
+			clipFile = argv[++i];
+		} else if ((arg == "--sizes") && hasValue) {
+			if (!ParseSizes(argv[++i], sizes)) {
+				fprintf(stderr, "Expected --sizes WxH[,WxH...], got \"%s\"\n", argv[i]);
+				return 1;
+			}
+		} else if ((arg == "--frames") && hasValue) {
+			maxFrames = atol(argv[++i]);
+		} else if ((arg == "--warmup") && hasValue) {
+			warmupFrames = atoi(argv[++i]);
+		} else if ((arg == "--threads") && hasValue) {
+			nThreads = atoi(argv[++i]);
+		} else if (arg == "--no-background") {
+			useBackground = false;
+		} else if (arg == "--no-chains") {
+			runChains = false;
+		} else if (arg == "--compare") {
+			compareMasks = true;
+		} else if (arg == "--check-allocations") {
+			checkAllocations = true;
+		} else if ((arg == "--json") && hasValue) {
+			jsonFile = argv[++i];
+		} else if ((arg == "--csv") && hasValue) {
+			csvFile = argv[++i];
+		} else if ((arg.size() > 0) && (arg[0] == '-')) {
+			PrintUsage(argv[0]);
+			return 1;
+		} else {
+			classifierDirs.push_back(arg);
+		}
+	}
+
+	if ((clipFile == NULL) || (maxFrames <= 0) || (classifierDirs.empty() && !useBackground)) {
+		PrintUsage(argv[0]);
+		return 1;
+	}
+
+	// load the saved recognizers, in the order given on the command line
+	vector<Classifier*> classifiers;
+	for (vector<string>::iterator dir = classifierDirs.begin(); dir != classifierDirs.end(); dir++) {
+		string path = (*dir);
+		while ((path.size() > 1) && ((path[path.size()-1] == '/') || (path[path.size()-1] == '\\'))) {
+			path.erase(path.size()-1);
+		}
+		Classifier *c = LoadClassifierFromDirectory(NarrowToWide(path.c_str()).c_str());
+		if (c == NULL) {
+			fprintf(stderr, "Skipping \"%s\": not a recognizer directory\n", dir->c_str());
+			continue;
+		}
+		if (!c->isTrained) {
+			fprintf(stderr, "Skipping \"%s\": recognizer could not be loaded\n", dir->c_str());
+			delete c;
+			continue;
+		}
+		classifiers.push_back(c);
+	}
+	vector<Classifier*> recognizers = classifiers;	// without the background subtraction
+	if (useBackground) {
+		classifiers.push_back(new BackgroundSubtraction());
+	}
+	if (classifiers.empty()) {
+		fprintf(stderr, "No recognizers to benchmark\n");
+		return 1;
+	}
+
+	vector<BenchmarkResult> results;
+	fprintf(stderr, "%-32s %-8s %11s %6s %9s %8s %8s %8s %8s %10s %8s\n",
+		"recognizer", "mode", "size", "frames", "fps", "p50 ms", "p95 ms", "p99 ms", "max ms", "peak KB", "allocs");
+
+	// each recognizer on its own
+	for (int i=0; i<(int)classifiers.size(); i++) {
+		vector<Classifier*> single(1, classifiers[i]);
+		for (int s=0; s<(int)sizes.size(); s++) {
+			BenchmarkResult result;
+			result.name = W2A(classifiers[i]->GetName());
+			if (!RunBenchmark(clipFile, single, IDC_COMBINE_LIST, sizes[s], maxFrames, warmupFrames, nThreads, result)) {
+				fprintf(stderr, "Unable to read frames from \"%s\"\n", clipFile);
+				return 2;
+			}
+			PrintResult(result);
+			results.push_back(result);
+		}
+	}
+
+	// all of them as one chain, in each combine mode
+	if (runChains && (classifiers.size() > 1)) {
+		int modes[] = { IDC_COMBINE_LIST, IDC_COMBINE_AND, IDC_COMBINE_OR, IDC_COMBINE_CASCADE };
+		for (int m=0; m<4; m++) {
+			for (int s=0; s<(int)sizes.size(); s++) {
+				BenchmarkResult result;
+				result.name = "chain";
+				if (!RunBenchmark(clipFile, classifiers, modes[m], sizes[s], maxFrames, warmupFrames, nThreads, result)) {
+					fprintf(stderr, "Unable to read frames from \"%s\"\n", clipFile);
+					return 2;
+				}
+				PrintResult(result);
+				results.push_back(result);
+			}
+		}
+	}
+
+	// the masks of each recognizer against those of the first, on the same frames
+	vector<AgreementResult> agreement;
+	if (compareMasks && (recognizers.size() > 1)) {
+		fprintf(stderr, "\n%-32s %-32s %11s %6s %7s %9s %7s\n",
+			"recognizer", "compared with", "size", "frames", "IoU", "precision", "recall");
+		for (int s=0; s<(int)sizes.size(); s++) {
+			int first = (int)agreement.size();
+			if (!RunAgreement(clipFile, recognizers, sizes[s], maxFrames, warmupFrames, agreement)) {
+				fprintf(stderr, "Unable to read frames from \"%s\"\n", clipFile);
+				return 2;
+			}
+			for (int i=first; i<(int)agreement.size(); i++) {
+				AgreementResult &a = agreement[i];
+				fprintf(stderr, "%-32s %-32s %5dx%-5d %6ld %7.3f %9.3f %7.3f\n", a.name.c_str(), a.reference.c_str(),
+					a.width, a.height, a.frames, a.iou, a.precision, a.recall);
+			}
+		}
+	} else if (compareMasks) {
+		fprintf(stderr, "Need at least two recognizers to --compare\n");
+	}
+
+	if ((jsonFile != NULL) && !WriteJson(jsonFile, clipFile, results, agreement)) {
+		fprintf(stderr, "Unable to write \"%s\"\n", jsonFile);
+	}
+	if ((csvFile != NULL) && !WriteCsv(csvFile, results)) {
+		fprintf(stderr, "Unable to write \"%s\"\n", csvFile);
+	}
+
+	for (int i=0; i<(int)classifiers.size(); i++) {
+		delete classifiers[i];
+	}
+
+	// once warmed up, a frame should not allocate anything
+	if (checkAllocations) {
+		int failed = 0;
+		for (int i=0; i<(int)results.size(); i++) {
+			BenchmarkResult &r = results[i];
+			if (r.allocations == 0) continue;
+			fprintf(stderr, "%s (%s, %dx%d) allocated %ld times in %ld frames\n", r.name.c_str(),
+				r.mode.c_str(), r.width, r.height, r.allocations, r.frames);
+			failed++;
+		}
+		if (failed > 0) return 3;
+	}
+	return 0;
+}
@@ -0,0 +1,500 @@
+// Command-line runner for saved Eyepatch recognizers.
+//
+// Loads one or more classifier directories (the epc*_COL, _LUT, _CAM, _SHP, _SIF, _APP, _MOT,
+// _GES, _BRI folders written by the Eyepatch GUI), applies them to a camera or video file as a
+// filter chain and sends the results to the selected outputs, without any window or GDI.
+// Given several cameras or files, it runs them all at once with one copy of each recognizer,
+// and a single file can be split into segments that are processed on several threads at once.
+//
+// Built with EYEPATCH_HEADLESS defined by "make EyepatchRunner"; the Makefile lists its sources.
+
+#include "precomp.h"
+#include "constants.h"
+#include "TrainingSample.h"
+#include "TrainingSet.h"
+#include "Classifier.h"
+#include "BackgroundSubtraction.h"
+#include "ClassifierFactory.h"
+#include "OutputSink.h"
+#include "OSCOutput.h"
+#include "ConsoleOutput.h"
+#include "HeadlessRunner.h"
+#include "MultiStreamRunner.h"
+#include "ShardedFileRunner.h"
+#include <signal.h>
+#include <locale.h>
+#include <chrono>
+
+static volatile sig_atomic_t interrupted = 0;
+
+static void OnInterrupt(int) {
+	interrupted = 1;
+}
+
+static void PrintUsage(const char *program) {
+	fprintf(stderr,
+		"usage: %s [options] <classifier directory>...\n"
+		"  --camera N        read from camera N (default 0)\n"
+		"  --file PATH       read from a recorded video file\n"
+		"                    (--camera and --file can be repeated to process several streams at once)\n"
+		"  --mode MODE       combine mode: list, and, or, cascade (default list)\n"
+		"  --frames N        stop after N frames\n"
+		"  --threads N       classify each frame on N threads (default 1, 0 for one per processor)\n"
+		"  --shards N        process a single file as segments on N threads at once\n"
+		"                    (0 for one per processor), sending the results in frame order\n"
+		"  --gop N           keyframe interval of the file, which segments are aligned to (default %d)\n"
+		"  --warmup N        frames run before each segment for stateful recognizers (default %d)\n"
+		"  --pipeline N      run capture, classification and output as separate stages\n"
+		"                    with queues of N frames between them (default 4, 0 to disable)\n"
+		"  --latest-frame    always process the newest camera frame, dropping any that arrive\n"
+		"                    while the last one is processed (instead of the pipeline)\n"
+		"  --cache DIR       remember what the recognizers found on each frame of a file in DIR,\n"
+		"                    so running it again only classifies with new recognizers\n"
+		"                    (a single stream only; the oldest files go past 512 MB)\n"
+		"  --every K=N       run the Kth recognizer (counting from 1) only on every Nth frame\n"
+		"  --max-hz K=HZ     run the Kth recognizer at most HZ times a second\n"
+		"  --budget K=MS     run the Kth recognizer only as often as an average of MS\n"
+		"                    milliseconds per frame allows\n"
+		"  --target-fps F    run expensive recognizers less often when needed to hold F fps\n"
+		"  --working-width K=W\n"
+		"                    let the Kth recognizer classify a smaller copy of the frame that\n"
+		"                    is still at least W pixels wide (0 for always the full frame)\n"
+		"  --metrics         print latency percentiles of each stage, recognizer and output at exit\n"
+		"  --publish-metrics send chain latency and frame counts along with the output variables\n"
+		"  --background      add adaptive background subtraction to the chain\n"
+		"  --print           write active output variables to stdout (with several streams, each\n"
+		"                    line starts with the number of its stream, from 0 in the order given)\n"
+		"  --osc             send active output variables as OSC to %s:%d\n",
+		program, SHARD_GOP_FRAMES, SHARD_WARMUP_FRAMES, OSC_ADDRESS, OSC_PORT);
+}
+
+static void PrintQueueStats(const char *name, RingBufferStats stats) {
+	fprintf(stderr, "%s queue: average depth %.1f of %d (max %d), producer waited %ld times, consumer waited %ld times\n",
+		name, stats.avgDepth, stats.capacity, stats.maxDepth, stats.fullWaits, stats.emptyWaits);
+}
+
+// per-recognizer setting (schedule or working width) given as K=VALUE
+struct ScheduleOption {
+	string flag;
+	int index;
+	double value;
+};
+
+static bool ParseScheduleOption(const string &flag, const char *arg, ScheduleOption &option) {
+	int index;
+	double value;
+	if (sscanf(arg, "%d=%lf", &index, &value) != 2) return false;
+	if (index < 1) return false;
+	option.flag = flag;
+	option.index = index;
+	option.value = value;
+	return true;
+}
+
+static void PrintMetrics(PipelineMetrics &metrics) {
+	vector<LatencyStats> stats;
+	metrics.GetStats(stats);
+	fprintf(stderr, "%-40s %8s %8s %8s %8s %8s\n", "stage (ms)", "count", "p50", "p95", "p99", "max");
+	for (int i=0; i<(int)stats.size(); i++) {
+		LatencyStats &s = stats[i];
+		fprintf(stderr, "%-40s %8ld %8.2f %8.2f %8.2f %8.2f\n", s.name.c_str(), s.count, s.p50, s.p95, s.p99, s.max);
+	}
+	fprintf(stderr, "%ld frames processed, %ld dropped\n", metrics.GetFramesProcessed(), metrics.GetFramesDropped());
+}
+
+static int ParseCombineMode(const char *mode) {
+	if (strcmp(mode, "list") == 0) return IDC_COMBINE_LIST;
+	if (strcmp(mode, "and") == 0) return IDC_COMBINE_AND;
+	if (strcmp(mode, "or") == 0) return IDC_COMBINE_OR;
+	if (strcmp(mode, "cascade") == 0) return IDC_COMBINE_CASCADE;
+	return -1;
+}
+
+// a camera or video file given on the command line
+struct VideoSource {
+	bool isFile;
+	int cameraIndex;
+	string filename;
+};
+
+// settings applied to the runner of every stream
+struct RunnerOptions {
+	int combineMode;
+	long maxFrames;
+	int nThreads;
+	int pipelineDepth;
+	bool latestFrameOnly;
+	double targetFps;
+	bool publishMetrics, usePrint, useOSC;
+	vector<ScheduleOption> scheduleOptions;
+};
+
+// applies the combine mode, metrics and schedules to a chain holding the given classifiers
+static void ConfigureChain(FilterChain &filterChain, const vector<Classifier*> &chain, RunnerOptions &options) {
+	filterChain.filterCombineMode = options.combineMode;
+	filterChain.metrics.publishVariables = options.publishMetrics;
+
+	// recognizers are numbered in the order they were loaded
+	for (vector<ScheduleOption>::iterator s = options.scheduleOptions.begin(); s != options.scheduleOptions.end(); s++) {
+		if (s->index > (int)chain.size()) continue;
+		Classifier *c = chain[s->index-1];
+		ClassifierSchedule schedule = filterChain.scheduler.GetSchedule(c);
+		if (s->flag == "--every") {
+			filterChain.scheduler.SetCadence(c, (int)s->value, schedule.maxHz);
+		} else if (s->flag == "--max-hz") {
+			filterChain.scheduler.SetCadence(c, schedule.everyNFrames, s->value);
+		} else {
+			filterChain.scheduler.SetBudget(c, s->value);
+		}
+	}
+	filterChain.scheduler.SetTargetFps(options.targetFps);
+}
+
+// the outputs selected on the command line, added to the list (streamIndex numbers the printed
+// lines when there are several streams, and is -1 otherwise)
+static void CreateOutputs(RunnerOptions &options, list<OutputSink*> &outputs, int streamIndex = -1) {
+	if (options.usePrint) outputs.push_back(new ConsoleOutput(stdout, streamIndex));
+	if (options.useOSC) outputs.push_back(new OSCOutput());
+}
+
+// sets up a runner whose chain holds the given classifiers, adding its outputs to the list
+static void ConfigureRunner(HeadlessRunner &runner, const vector<Classifier*> &chain, RunnerOptions &options,
+							int streamIndex, list<OutputSink*> &outputs) {
+	ConfigureChain(runner.filterChain, chain, options);
+	runner.maxFrames = options.maxFrames;
+	runner.filterChain.SetClassifierThreads(options.nThreads);
+	runner.pipelineDepth = options.pipelineDepth;
+	runner.latestFrameOnly = options.latestFrameOnly;
+
+	list<OutputSink*> runnerOutputs;
+	CreateOutputs(options, runnerOutputs, streamIndex);
+	for (list<OutputSink*>::iterator o = runnerOutputs.begin(); o != runnerOutputs.end(); o++) {
+		runner.filterChain.AddActiveOutput(*o);
+		outputs.push_back(*o);
+	}
+}
+
+// processes a single file in parallel segments; returns the exit code
+static int RunSharded(VideoSource &source, const vector<Classifier*> &classifiers, RunnerOptions &options,
+					  int nShards, int gopFrames, int warmupFrames, bool printMetrics) {
+	ShardedFileRunner runner;
+	for (int i=0; i<(int)classifiers.size(); i++) {
+		runner.AddModel(classifiers[i]);
+	}
+	if (!runner.OpenFile(source.filename.c_str(), nShards)) {
+		fprintf(stderr, "Unable to split video file \"%s\" (it can't be read, its length is unknown, or one of "
+			"the recognizers can't run on more than one stream)\n", source.filename.c_str());
+		return 2;
+	}
+	for (int i=0; i<runner.NumWorkers(); i++) {
+		ConfigureChain(runner.GetWorkerChain(i), runner.GetWorkerClassifiers(i), options);
+	}
+	runner.maxFrames = options.maxFrames;
+	runner.gopFrames = gopFrames;
+	runner.warmupFrames = warmupFrames;
+
+	list<OutputSink*> outputs;
+	CreateOutputs(options, outputs);
+	for (list<OutputSink*>::iterator o = outputs.begin(); o != outputs.end(); o++) {
+		runner.AddOutput(*o);
+	}
+
+	signal(SIGINT, OnInterrupt);
+	signal(SIGTERM, OnInterrupt);
+
+	if (!runner.StartProcessing()) {
+		fprintf(stderr, "Unable to read frames from the video source\n");
+		return 2;
+	}
+	fprintf(stderr, "Processing %dx%d video (%ld frames) on %d threads\n", runner.videoX, runner.videoY,
+		runner.framesAvailable, runner.NumWorkers());
+
+	while (!interrupted && runner.IsProcessing()) {
+		std::this_thread::sleep_for(std::chrono::milliseconds(100));
+	}
+	runner.StopProcessing();
+
+	long nFrames = runner.nFrames;
+	fprintf(stderr, "Processed %ld frames in %.2f seconds (%.1f fps)\n", nFrames, runner.elapsedSeconds,
+		(runner.elapsedSeconds > 0) ? nFrames/runner.elapsedSeconds : 0.0);
+	if (printMetrics) {
+		for (int i=0; i<runner.NumWorkers(); i++) {
+			fprintf(stderr, "Thread %d: ", i+1);
+			PrintMetrics(runner.GetWorkerChain(i).metrics);
+		}
+		fprintf(stderr, "Outputs: ");
+		PrintMetrics(runner.GetOutputMetrics());
+	}
+
+	runner.ClearOutputs();
+	for (list<OutputSink*>::iterator o = outputs.begin(); o != outputs.end(); o++) {
+		delete (*o);
+	}
+	return 0;
+}
+
+static bool OpenSource(HeadlessRunner &runner, VideoSource &source) {
+	bool opened = source.isFile ? runner.OpenFile(source.filename.c_str()) : runner.OpenCamera(source.cameraIndex);
+	if (!opened) {
+		if (source.isFile) fprintf(stderr, "Unable to load video file \"%s\"\n", source.filename.c_str());
+		else fprintf(stderr, "Unable to connect to camera %d\n", source.cameraIndex);
+	}
+	return opened;
+}
+
+static void PrintRunnerStats(HeadlessRunner &runner, RunnerOptions &options, bool printMetrics) {
+	long nFrames = runner.nFrames;
+	fprintf(stderr, "Processed %ld frames in %.2f seconds (%.1f fps)\n", nFrames, runner.elapsedSeconds,
+		(runner.elapsedSeconds > 0) ? nFrames/runner.elapsedSeconds : 0.0);
+	if (runner.runningLive && options.latestFrameOnly) {
+		long nDropped = runner.filterChain.metrics.GetFramesDropped();
+		fprintf(stderr, "Dropped %ld stale camera frames (%.1f%%)\n", nDropped,
+			(nFrames+nDropped > 0) ? 100.0*nDropped/(nFrames+nDropped) : 0.0);
+	} else if (options.pipelineDepth > 0) {
+		PrintQueueStats("capture -> classify", runner.GetCaptureQueueStats());
+		PrintQueueStats("classify -> output", runner.GetOutputQueueStats());
+	}
+	if (printMetrics) PrintMetrics(runner.filterChain.metrics);
+}
+
+int main(int argc, char **argv) {
+	setlocale(LC_ALL, "");
+
+	RunnerOptions options;
+	options.combineMode = IDC_COMBINE_LIST;
+	options.maxFrames = 0;
+	options.nThreads = 1;
+	options.pipelineDepth = 4;
+	options.latestFrameOnly = false;
+	options.targetFps = 0;
+	options.publishMetrics = options.usePrint = options.useOSC = false;
+	bool printMetrics = false, useBackground = false;
+	int nShards = -1, gopFrames = SHARD_GOP_FRAMES, warmupFrames = SHARD_WARMUP_FRAMES;
+	string cacheDir;
+	vector<VideoSource> sources;
+	vector<string> classifierDirs;
+	vector<ScheduleOption> workingWidths;
+
+	for (int i=1; i<argc; i++) {
+		string arg = argv[i];
+		bool hasValue = (i+1 < argc);
+		if (((arg == "--camera") || (arg == "--file")) && hasValue) {
+			VideoSource source;
+			source.isFile = (arg == "--file");
+			source.cameraIndex = source.isFile ? 0 : atoi(argv[i+1]);
+			source.filename = source.isFile ? argv[i+1] : "";
+			sources.push_back(source);
+			i++;
+		} else if ((arg == "--mode") && hasValue) {
+			options.combineMode = ParseCombineMode(argv[++i]);
+			if (options.combineMode < 0) {
+				fprintf(stderr, "Unknown combine mode \"%s\"\n", argv[i]);
+				return 1;
+			}
+		} else if ((arg == "--frames") && hasValue) {
+			options.maxFrames = atol(argv[++i]);
+		} else if ((arg == "--threads") && hasValue) {
+			options.nThreads = atoi(argv[++i]);
+		} else if ((arg == "--shards") && hasValue) {
+			nShards = atoi(argv[++i]);
+		} else if ((arg == "--gop") && hasValue) {
+			gopFrames = atoi(argv[++i]);
+		} else if ((arg == "--warmup") && hasValue) {
+			warmupFrames = atoi(argv[++i]);
+		} else if ((arg == "--pipeline") && hasValue) {
+			options.pipelineDepth = atoi(argv[++i]);
+		} else if (((arg == "--every") || (arg == "--max-hz") || (arg == "--budget")) && hasValue) {
+			ScheduleOption option;
+			if (!ParseScheduleOption(arg, argv[++i], option)) {
+				fprintf(stderr, "Expected %s K=VALUE, got \"%s\"\n", arg.c_str(), argv[i]);
+				return 1;
+			}
+			options.scheduleOptions.push_back(option);
+		} else if ((arg == "--working-width") && hasValue) {
+			ScheduleOption option;
+			if (!ParseScheduleOption(arg, argv[++i], option)) {
+				fprintf(stderr, "Expected %s K=VALUE, got \"%s\"\n", arg.c_str(), argv[i]);
+				return 1;
+			}
+			workingWidths.push_back(option);
+		} else if ((arg == "--target-fps") && hasValue) {
+			options.targetFps = atof(argv[++i]);
+		} else if ((arg == "--cache") && hasValue) {
+			cacheDir = argv[++i];
+		} else if (arg == "--latest-frame") {
+			options.latestFrameOnly = true;
+		} else if (arg == "--metrics") {
+			printMetrics = true;
+		} else if (arg == "--publish-metrics") {
+			options.publishMetrics = true;
+		} else if (arg == "--background") {
+			useBackground = true;
+		} else if (arg == "--print") {
+			options.usePrint = true;
+		} else if (arg == "--osc") {
+			options.useOSC = true;
+		} else if ((arg.size() > 0) && (arg[0] == '-')) {
+			PrintUsage(argv[0]);
+			return 1;
+		} else {
+			classifierDirs.push_back(arg);
+		}
+	}
+
+	if (classifierDirs.empty() && !useBackground) {
+		PrintUsage(argv[0]);
+		return 1;
+	}
+	if (sources.empty()) {
+		VideoSource camera;
+		camera.isFile = false;
+		camera.cameraIndex = 0;
+		sources.push_back(camera);
+	}
+
+	// load the saved recognizers, in the order given on the command line
+	vector<Classifier*> classifiers;
+	for (vector<string>::iterator dir = classifierDirs.begin(); dir != classifierDirs.end(); dir++) {
+		string path = (*dir);
+		while ((path.size() > 1) && ((path[path.size()-1] == '/') || (path[path.size()-1] == '\\'))) {
+			path.erase(path.size()-1);
+		}
+		Classifier *c = LoadClassifierFromDirectory(NarrowToWide(path.c_str()).c_str());
+		if (c == NULL) {
+			fprintf(stderr, "Skipping \"%s\": not a recognizer directory\n", dir->c_str());
+			continue;
+		}
+		if (!c->isTrained) {
+			fprintf(stderr, "Skipping \"%s\": recognizer could not be loaded\n", dir->c_str());
+			delete c;
+			continue;
+		}
+		classifiers.push_back(c);
+	}
+	if (useBackground) {
+		classifiers.push_back(new BackgroundSubtraction());
+	}
+	for (int i=0; i<(int)classifiers.size(); i++) {
+		fprintf(stderr, "Loaded %s\n", W2A(classifiers[i]->GetName()));
+	}
+	for (vector<ScheduleOption>::iterator s = options.scheduleOptions.begin(); s != options.scheduleOptions.end(); s++) {
+		if (s->index > (int)classifiers.size()) {
+			fprintf(stderr, "Ignoring %s %d: there are only %d recognizers\n", s->flag.c_str(), s->index, (int)classifiers.size());
+		}
+	}
+
+	// the working width is part of the model, so the stream instances pick it up too
+	for (vector<ScheduleOption>::iterator w = workingWidths.begin(); w != workingWidths.end(); w++) {
+		if (w->index > (int)classifiers.size()) {
+			fprintf(stderr, "Ignoring %s %d: there are only %d recognizers\n", w->flag.c_str(), w->index, (int)classifiers.size());
+			continue;
+		}
+		classifiers[w->index-1]->workingWidth = (int)w->value;
+	}
+
+	if (!cacheDir.empty() && ((sources.size() != 1) || (nShards >= 0))) {
+		fprintf(stderr, "Ignoring --cache: it only works with a single stream\n");
+	}
+	if (nShards >= 0) {
+		if ((sources.size() != 1) || !sources[0].isFile) {
+			fprintf(stderr, "--shards needs a single --file\n");
+			return 1;
+		}
+		int result = RunSharded(sources[0], classifiers, options, nShards, gopFrames, warmupFrames, printMetrics);
+		for (int i=0; i<(int)classifiers.size(); i++) {
+			delete classifiers[i];
+		}
+		return result;
+	}
+
+	// with one source the loaded recognizers run on it directly; with several, every stream
+	// gets its own instance of each of them, sharing the trained models
+	HeadlessRunner *singleRunner = NULL;
+	MultiStreamRunner *multiRunner = NULL;
+	ResultCache *resultCache = NULL;
+	vector<HeadlessRunner*> runners;
+	list<OutputSink*> outputs;
+	if (sources.size() == 1) {
+		singleRunner = new HeadlessRunner();
+		for (int i=0; i<(int)classifiers.size(); i++) {
+			singleRunner->filterChain.AddActiveFilter(classifiers[i]);
+		}
+		ConfigureRunner(*singleRunner, classifiers, options, -1, outputs);
+		runners.push_back(singleRunner);
+		if (!cacheDir.empty()) {
+			resultCache = new ResultCache();
+			resultCache->SetSpillDirectory(cacheDir.c_str());
+			singleRunner->filterChain.resultCache = resultCache;
+		}
+	} else {
+		multiRunner = new MultiStreamRunner();
+		for (int i=0; i<(int)classifiers.size(); i++) {
+			multiRunner->AddModel(classifiers[i]);
+		}
+		for (int i=0; i<(int)sources.size(); i++) {
+			HeadlessRunner *runner = multiRunner->AddStream();
+			if (runner == NULL) {
+				fprintf(stderr, "One of the recognizers can't run on more than one stream (Haar recognizers must be saved first)\n");
+				return 1;
+			}
+			ConfigureRunner(*runner, multiRunner->GetStreamClassifiers(i), options, i, outputs);
+			runners.push_back(runner);
+		}
+	}
+
+	for (int i=0; i<(int)runners.size(); i++) {
+		if (!OpenSource(*runners[i], sources[i])) return 2;
+	}
+
+	signal(SIGINT, OnInterrupt);
+	signal(SIGTERM, OnInterrupt);
+
+	bool started;
+	if (singleRunner != NULL) {
+		singleRunner->filterChain.ResetActiveFilterRunningStates();
+		started = singleRunner->StartProcessing();
+	} else {
+		started = multiRunner->StartProcessing();
+	}
+	if (!started) {
+		fprintf(stderr, "Unable to read frames from the video source\n");
+		return 2;
+	}
+	for (int i=0; i<(int)runners.size(); i++) {
+		if (runners.size() > 1) fprintf(stderr, "Stream %d: ", i+1);
+		fprintf(stderr, "Processing %dx%d video\n", runners[i]->videoX, runners[i]->videoY);
+	}
+
+	// wait for the video to finish, or for the user to interrupt us
+	while (!interrupted) {
+		bool processing = (singleRunner != NULL) ? singleRunner->IsProcessing() : multiRunner->IsProcessing();
+		if (!processing) break;
+		std::this_thread::sleep_for(std::chrono::milliseconds(100));
+	}
+
+	for (int i=0; i<(int)runners.size(); i++) {
+		runners[i]->StopProcessing();
+		if (runners.size() > 1) fprintf(stderr, "Stream %d: ", i+1);
+		PrintRunnerStats(*runners[i], options, printMetrics);
+	}
+
+	for (int i=0; i<(int)runners.size(); i++) {
+		runners[i]->filterChain.ClearActiveOutputs();
+	}
+	if (singleRunner != NULL) {
+		singleRunner->filterChain.ClearActiveFilters();
+		delete singleRunner;
+	}
+	if (resultCache != NULL) {
+		fprintf(stderr, "Result cache: %ld frames reused, %ld classified\n", resultCache->hits, resultCache->misses);
+		delete resultCache;		// writes what is still in memory to the directory
+	}
+	delete multiRunner;	// before the models its stream instances refer to
+	for (list<OutputSink*>::iterator o = outputs.begin(); o != outputs.end(); o++) {
+		delete (*o);
+	}
+	for (int i=0; i<(int)classifiers.size(); i++) {
+		delete classifiers[i];
+	}
+	return 0;
+}
@@ -0,0 +1,886 @@
+#include "precomp.h"
+#include "constants.h"
+#include "TrainingSample.h"
+#include "TrainingSet.h"
+#include "Classifier.h"
+#include "OutputSink.h"
+#include "MotionClassifier.h"
+#include "GestureClassifier.h"
+#include "FilterChain.h"
+
+FrameResults::FrameResults() {
+	nResults = 0;
+	nImages = 0;
+	nBoxes = 0;
+	storage = cvCreateMemStorage(0);
+}
+
+FrameResults::~FrameResults() {
+	for (int i=0; i<(int)images.size(); i++) {
+		cvReleaseImage(&images[i]);
+	}
+	for (int i=0; i<(int)boxes.size(); i++) {
+		delete boxes[i];
+	}
+	cvReleaseMemStorage(&storage);
+}
+
+void FrameResults::Clear() {
+	// keep the buffers around for the next frame
+	nResults = 0;
+	nImages = 0;
+	nBoxes = 0;
+	cvClearMemStorage(storage);
+}
+
+void FrameResults::Add(ClassifierOutputData &outdata, const char *filterName) {
+	if (nResults == (int)results.size()) {
+		results.push_back(ClassifierOutputData());
+		filterNames.push_back(string());
+	}
+	ClassifierOutputData &copy = results[nResults];
+	copy = outdata;
+	filterNames[nResults] = filterName;
+	nResults++;
+
+	// replace the pointers into classifier memory with copies we own
+	for (int v=0; v<copy.NumVariables(); v++) {
+		ClassifierOutputVariable &var = copy.GetVariableOfIndex(v);
+		if ((var.GetType() == CVAR_IMAGE) && (var.GetImageData() != NULL)) {
+			IplImage *src = var.GetImageData();
+			if (nImages == (int)images.size()) images.push_back(NULL);
+			IplImage *dst = EnsureImage(&images[nImages++], cvGetSize(src), src->depth, src->nChannels);
+			cvCopy(src, dst);
+			var = ClassifierOutputVariable(var.GetId(), dst, var.GetState());
+		} else if (var.GetType() == CVAR_SEQ) {
+			var = ClassifierOutputVariable(var.GetId(), CopySequenceTree(var.GetSequenceData(), NULL), var.GetState());
+		} else if ((var.GetType() == CVAR_BBOXES) && (var.GetBoundingBoxData() != NULL)) {
+			if (nBoxes == (int)boxes.size()) boxes.push_back(new vector<Rect>());
+			vector<Rect> *dst = boxes[nBoxes++];
+			*dst = *(var.GetBoundingBoxData());
+			var = ClassifierOutputVariable(var.GetId(), dst, var.GetState());
+		}
+	}
+}
+
+CvSeq* FrameResults::CopySequenceTree(CvSeq *seq, CvSeq *parent) {
+	// copy a list of sequences along with their children (as produced by cvFindContours)
+	CvSeq *first = NULL, *prev = NULL;
+	for (; seq != NULL; seq = seq->h_next) {
+		CvSeq *copy = cvCloneSeq(seq, storage);
+		copy->h_prev = prev;
+		copy->h_next = NULL;
+		copy->v_prev = parent;
+		copy->v_next = CopySequenceTree(seq->v_next, copy);
+		if (prev != NULL) prev->h_next = copy;
+		else first = copy;
+		prev = copy;
+	}
+	return first;
+}
+
+int FrameResults::NumResults() {
+	return nResults;
+}
+
+ClassifierOutputData& FrameResults::GetData(int index) {
+	return results[index];
+}
+
+char* FrameResults::GetFilterName(int index) {
+	return (char*)filterNames[index].c_str();
+}
+
+FilterChain::FilterChain() {
+	videoX = 0;
+	videoY = 0;
+	isProcessing = false;
+	outputFrame = NULL;
+	motionImage = NULL;
+	outputAccImage = NULL;
+	contourMask = NULL;
+	guessMask = NULL;
+	combineMaskOutput = NULL;
+	frameMask = NULL;
+	motionHistory = NULL;
+	memset(motionBuf, 0, MOTION_NUM_IMAGES*sizeof(IplImage*));
+	contourStorage = NULL;
+	last = 0;
+	processedMotion = false;
+	processedGesture = false;
+	parallelFrame = NULL;
+	parallelFrameNum = 0;
+	classifyMs = outputsMs = 0;
+
+	// the variables we add to the outputs when the metrics are published
+	metricVariables[0] = ClassifierOutputData::GetVariableId("ChainP50Ms");
+	metricVariables[1] = ClassifierOutputData::GetVariableId("ChainP95Ms");
+	metricVariables[2] = ClassifierOutputData::GetVariableId("ChainP99Ms");
+	metricVariables[3] = ClassifierOutputData::GetVariableId("FramesProcessed");
+	metricVariables[4] = ClassifierOutputData::GetVariableId("FramesDropped");
+	metricVariables[5] = ClassifierOutputData::GetVariableId("LatencyMs");
+
+    trackingMotion = 0;
+    trackingGesture = 0;
+	filterCombineMode = IDC_COMBINE_LIST;
+	drawContours = true;
+	combinedOutputs = ~0u;
+	fullSizeCombine = false;
+	resultCache = NULL;
+	videoId = 0;
+}
+
+FilterChain::~FilterChain() {
+	StopProcessing();
+}
+
+void FilterChain::StartProcessing(int width, int height) {
+	StopProcessing();
+	videoX = width;
+	videoY = height;
+	scheduler.Reset();
+
+	// create images to store the output and an accumulator for filter data
+    outputFrame = cvCreateImage(cvSize(videoX,videoY),IPL_DEPTH_8U,3);
+    outputAccImage =  cvCreateImage(cvSize(videoX,videoY),IPL_DEPTH_8U,3);
+	contourMask = cvCreateImage(cvSize(GUESSMASK_WIDTH, GUESSMASK_HEIGHT), IPL_DEPTH_8U, 1);
+	combineMaskOutput = cvCreateImage(cvSize(GUESSMASK_WIDTH, GUESSMASK_HEIGHT), IPL_DEPTH_8U, 1);
+
+    // create image to store motion history, and one to visualize it
+    motionHistory = cvCreateImage(cvSize(videoX,videoY), IPL_DEPTH_32F, 1);
+    cvZero(motionHistory);
+    motionImage = cvCreateImage(cvSize(videoX,videoY), IPL_DEPTH_8U, 3);
+    cvZero(motionImage);
+    motionMask = cvCreateImage(cvSize(videoX,videoY), IPL_DEPTH_8U, 1);
+
+    // Allocate an image history ring buffer
+    for(int i = 0; i < MOTION_NUM_IMAGES; i++) {
+        motionBuf[i] = cvCreateImage(cvSize(videoX,videoY), IPL_DEPTH_8U, 1);
+        cvZero(motionBuf[i]);
+    }
+    last = 0;
+
+    // create a mask to store the results of the processing, and one for combining multiple filters
+    guessMask = cvCreateImage(cvSize(GUESSMASK_WIDTH, GUESSMASK_HEIGHT), IPL_DEPTH_8U, 1);
+	frameMask = cvCreateImage(cvSize(videoX,videoY),IPL_DEPTH_8U,1);
+	combineFrameMask = cvCreateImage(cvSize(videoX,videoY),IPL_DEPTH_8U,1);
+	cvZero(combineFrameMask);
+	guessBits.Create(GUESSMASK_WIDTH, GUESSMASK_HEIGHT);
+	combineBits.Create(GUESSMASK_WIDTH, GUESSMASK_HEIGHT);
+	contourBits.Create(GUESSMASK_WIDTH, GUESSMASK_HEIGHT);
+	frameBits.Create(videoX, videoY);
+
+	// Initialize some contour storage for tracing combination masks
+	contourStorage = cvCreateMemStorage(0);
+
+	isProcessing = true;
+}
+
+void FilterChain::StopProcessing() {
+	if (!isProcessing) return;
+
+    cvReleaseImage(&outputFrame);
+    cvReleaseImage(&outputAccImage);
+	cvReleaseImage(&contourMask);
+    cvReleaseImage(&motionHistory);
+    cvReleaseImage(&motionImage);
+    cvReleaseImage(&motionMask);
+    for(int i = 0; i < MOTION_NUM_IMAGES; i++) {
+        cvReleaseImage(&motionBuf[i]);
+    }
+    cvReleaseImage(&guessMask);
+	cvReleaseImage(&combineMaskOutput);
+	cvReleaseImage(&frameMask);
+	cvReleaseImage(&combineFrameMask);
+	cvReleaseMemStorage(&contourStorage);
+
+	isProcessing = false;
+}
+
+// the standard outputs that come from labelling the mask
+static const unsigned int regionOutputs = CVAR_BIT(CVAR_ID_BOUNDINGBOXES) | CVAR_BIT(CVAR_ID_NUMREGIONS) |
+	CVAR_BIT(CVAR_ID_TOTALAREA) | CVAR_BIT(CVAR_ID_CENTROID);
+
+ClassifierOutputData FilterChain::GetStandardOutputData() {
+	ClassifierOutputData outputData;
+	if (!fullSizeCombine) combineBits.ToImage(combineMaskOutput);	// otherwise it is already there
+	outputData.AddVariable(ClassifierOutputVariable(CVAR_ID_MASK, combineMaskOutput));
+
+	// compute bounding boxes of mask regions, along with area and centroid, and count # of regions
+	// (if nothing needs them, the classifiers' own values are left in the combined data, inactive)
+	if (combinedOutputs & regionOutputs) {
+		int nRegions = regionLabeller.Label(combineBits);
+		boundingBoxes.clear();
+		Point centroid(0,0);
+		for (int i=0; i<nRegions; i++) {
+			CvRect cvr = regionLabeller.GetRegion(i).bounds;
+			Rect r(cvr.x, cvr.y, cvr.width, cvr.height);
+			boundingBoxes.push_back(r);
+			centroid.X += (cvr.x+cvr.width/2);
+			centroid.Y += (cvr.y+cvr.height/2);
+		}
+		if (nRegions > 0) {
+			centroid.X /= nRegions;
+			centroid.Y /= nRegions;
+		}
+		outputData.AddVariable(ClassifierOutputVariable(CVAR_ID_BOUNDINGBOXES, &boundingBoxes));
+		outputData.AddVariable(ClassifierOutputVariable(CVAR_ID_NUMREGIONS, nRegions));
+		outputData.AddVariable(ClassifierOutputVariable(CVAR_ID_TOTALAREA, regionLabeller.GetTotalArea()));
+		outputData.AddVariable(ClassifierOutputVariable(CVAR_ID_CENTROID, centroid));
+	}
+
+	// cvFindContours changes the image it traces, so trace a copy of the mask in contourMask
+	// (which is cleared before the contours are drawn)
+    cvClearMemStorage(contourStorage);
+    CvSeq* contours = NULL;
+	if ((combinedOutputs & CVAR_BIT(CVAR_ID_CONTOURS)) && !combineBits.IsEmpty()) {
+		combineBits.ToImage(contourMask);
+		cvFindContours(contourMask, contourStorage, &contours, sizeof(CvContour), CV_RETR_TREE, CV_CHAIN_APPROX_SIMPLE, cvPoint(0,0));
+		if (contours != NULL) {
+			contours = cvApproxPoly(contours, sizeof(CvContour), contourStorage, CV_POLY_APPROX_DP, 3, 1 );
+		}
+	}
+	outputData.AddVariable(ClassifierOutputVariable(CVAR_ID_CONTOURS, contours));
+	return outputData;
+}
+
+void FilterChain::ProcessInput(IplImage *frame) {
+    // some outputs run on the original (unfiltered) frame
+	// we apply these before applying any of the filters
+    for (list<OutputSink*>::iterator j=activeOutputs.begin(); j!=activeOutputs.end(); j++) {
+        (*j)->ProcessInput(frame);
+    }
+}
+
+void FilterChain::SendResults(IplImage *frame, FrameResults *results) {
+	double totalMs = 0;
+	for (int i=0; i<results->NumResults(); i++) {
+		for (list<OutputSink*>::iterator j=activeOutputs.begin(); j!=activeOutputs.end(); j++) {
+			double start = GetTimeMs();
+			(*j)->ProcessOutput(frame, results->GetData(i), results->GetFilterName(i));
+			double ms = GetTimeMs()-start;
+			metrics.Record(outputStages[*j], ms);
+			totalMs += ms;
+		}
+	}
+	metrics.Record(STAGE_OUTPUTS, totalMs);
+}
+
+void FilterChain::ApplyFilterChain(IplImage *frame, long frameNum, FrameResults *deferredOutputs) {
+	USES_CONVERSION;
+
+	ClassifierOutputData combinedata;	// used for combining data across multiple classifiers
+
+	double frameStart = GetTimeMs();
+	classifyMs = outputsMs = 0;
+
+	int nCurrentFilter = 0;
+    int nFiltersInChain = activeClassifiers.size();
+
+    // First black out the output frame
+    cvZero(outputFrame);
+
+	// Work out which outputs have to be computed.  In LIST mode we draw each classifier's contours
+	// (otherwise only those of the combined mask), CASCADE mode narrows the next filter's search to
+	// the bounding boxes of the last, and active variables are needed if there are outputs to send them to.
+	unsigned int required = 0;
+	if (drawContours && (filterCombineMode == IDC_COMBINE_LIST)) required |= CVAR_BIT(CVAR_ID_CONTOURS);
+	if (filterCombineMode == IDC_COMBINE_CASCADE) required |= CVAR_BIT(CVAR_ID_BOUNDINGBOXES);
+	bool sending = !activeOutputs.empty();
+	combinedOutputs = drawContours ? CVAR_BIT(CVAR_ID_CONTOURS) : 0;
+	for (list<Classifier*>::iterator i=activeClassifiers.begin(); i!=activeClassifiers.end(); i++) {
+		(*i)->requiredOutputs = required;
+		(*i)->sendingOutputs = sending;
+
+		// the combined variables take their states from the classifiers
+		for (int id=0; sending && (id<CVAR_NUM_STANDARD_IDS); id++) {
+			if ((*i)->outputData.GetVariable(id).GetState()) combinedOutputs |= CVAR_BIT(id);
+		}
+	}
+
+	scheduler.BeginFrame();
+	processedMotion = false;
+	processedGesture = false;
+	frameContext.SetFrame(frame);
+
+	// initialize the combined mask appropriately depending upon our combine mode
+	fullSizeCombine = AllAtFullSize();
+	if (filterCombineMode == IDC_COMBINE_AND) {
+		if (nFiltersInChain > 0) combineBits.Fill();
+		else combineBits.Clear();
+		if (fullSizeCombine) cvSet(combineFrameMask, cvScalar((nFiltersInChain > 0) ? 0xFF : 0));
+	} else if (filterCombineMode == IDC_COMBINE_OR) {
+		combineBits.Clear();
+		if (fullSizeCombine) cvZero(combineFrameMask);
+	}
+
+	// the pixel-wise classifiers that share a pyramid level go first, all in one pass
+	double pixelStart = GetTimeMs();
+	RunPixelGroups(frameNum);
+	classifyMs += GetTimeMs()-pixelStart;
+
+	// In CASCADE mode each filter sees the output of the previous one, so the chain has to run in order.
+	// In the other modes the filters only read the frame, so we can classify it with all of them at once
+	// and then combine the results below in chain order, exactly as if they had run one after another.
+	bool runParallel = (threadPool.NumThreads() > 0) && (nFiltersInChain > 1) && (filterCombineMode != IDC_COMBINE_CASCADE);
+	if (runParallel) {
+		double start = GetTimeMs();
+		RunClassifiersInParallel(frame, frameNum);
+		classifyMs += GetTimeMs()-start;
+	}
+
+	// step through each active classifier in turn
+	ClassifierOutputData outdata;
+    for (list<Classifier*>::iterator i=activeClassifiers.begin(); i!=activeClassifiers.end(); i++) {
+
+		// get the output of the classifier and store it in "outdata"
+		if (runParallel) {
+			outdata = chainOutputs[nCurrentFilter];
+		} else {
+			double start = GetTimeMs();
+			outdata = RunClassifier(*i, frame, frameNum);
+			classifyMs += GetTimeMs()-start;
+		}
+
+		// pull the mask out of the returned data and scale it up into "frameMask", or pack it into "guessBits"
+		if (fullSizeCombine) {
+			if (outdata.HasVariable(CVAR_ID_MASK)) cvResize(outdata.GetImageData(CVAR_ID_MASK), frameMask);
+			else cvZero(frameMask);
+		} else if (outdata.HasVariable(CVAR_ID_MASK)) {
+			IplImage *mask = outdata.GetImageData(CVAR_ID_MASK);
+			if ((mask->width == GUESSMASK_WIDTH) && (mask->height == GUESSMASK_HEIGHT)) {
+				guessBits.FromImage(mask);
+			} else {
+				cvResize(mask, guessMask);
+				guessBits.FromImage(guessMask);
+			}
+		} else {
+			guessBits.Clear();
+		}
+
+		if (filterCombineMode == IDC_COMBINE_LIST) {
+			// in LIST mode we draw each filter outlined separately in the accumulator frame
+
+			// Copy the masked output of this filter to accumulator frame
+			cvZero(outputAccImage);
+			if (!fullSizeCombine) UnpackFrameMask(guessBits);
+			cvCopy(frame, outputAccImage, frameMask);
+
+			// Trace contours in accumulator frame
+			CvSeq *contours = outdata.GetSequenceData(CVAR_ID_CONTOURS);
+			if (contours != NULL) {
+				cvZero(contourMask);
+				cvDrawContours(contourMask, contours, cvScalar(0xFF), cvScalar(0x00), 1, 1, CV_AA);
+				ScaleContourMask();
+				cvSet(outputAccImage, colorSwatch[nCurrentFilter%COLOR_SWATCH_SIZE], frameMask);
+			}
+
+			// Add masked accumulator frame to output frame
+			cvAddWeighted(outputAccImage, (1.0/nFiltersInChain), outputFrame, 1.0, 0, outputFrame);
+
+			// in LIST mode we apply output chain to each filter output separately (the name is
+			// only converted if there are outputs, since the conversion allocates)
+			if (sending) SendOutput(frame, outdata, W2A((*i)->GetName()), *i, deferredOutputs);
+		} else if (filterCombineMode == IDC_COMBINE_AND){
+			// In AND mode we don't draw anything until the end, once we've combined all the outputs.
+			// We combine the mask from each filter into the combined mask and draw that.
+			if (fullSizeCombine) cvAnd(frameMask, combineFrameMask, combineFrameMask);
+			else combineBits.And(guessBits);
+			combinedata.MergeWith(outdata);
+		} else if (filterCombineMode == IDC_COMBINE_OR){
+			// In OR mode we don't draw anything until the end, once we've combined all the outputs.
+			// We combine the mask from each filter into the combined mask and draw that.
+			if (fullSizeCombine) cvOr(frameMask, combineFrameMask, combineFrameMask);
+			else combineBits.Or(guessBits);
+			combinedata.MergeWith(outdata);
+		} else if (filterCombineMode == IDC_COMBINE_CASCADE){
+			// In CASCADE mode we actually modify the input frame so that the input of the next
+			// filter in the chain will include only the regions of the input image that have passed through
+			// the earlier filters in the chain.  The final mask is the output of the last filter in the chain.
+			// Blacking out only what's outside the mask leaves the rest of the frame where it is
+			// (contourBits is free as scratch until the contours are drawn at the end).
+			if (fullSizeCombine) {
+				cvCopy(frameMask, combineFrameMask);
+				cvCmpS(frameMask, 0, frameMask, CV_CMP_EQ);
+			} else {
+				contourBits.Fill();
+				contourBits.AndNot(guessBits);
+				UnpackFrameMask(contourBits);
+				combineBits.CopyFrom(guessBits);
+			}
+			cvSet(frame, cvScalarAll(0), frameMask);
+			combinedata.MergeWith(outdata);
+			// the derived images no longer match the frame, and the next filter only needs to search
+			// the areas this one found
+			SetCascadeRegions(frame, outdata);
+		}
+        nCurrentFilter++;
+	}
+
+	// If we are in a mode where outputs get combined, we need to output the final result
+	// now that we have run all the filters.
+	if (filterCombineMode != IDC_COMBINE_LIST) {
+		if (fullSizeCombine) {
+			// back down to mask resolution (interpolated, so the outputs get the mask as it comes)
+			cvResize(combineFrameMask, combineMaskOutput);
+			combineBits.FromImage(combineMaskOutput);
+		}
+		ClassifierOutputData combinemaskdata = GetStandardOutputData();
+		combinedata.MergeWith(combinemaskdata);
+
+		cvZero(outputAccImage);
+		if (fullSizeCombine) {
+			cvCopy(frame, outputAccImage, combineFrameMask);
+		} else {
+			UnpackFrameMask(combineBits);
+			cvCopy(frame, outputAccImage, frameMask);
+		}
+
+		// Trace contours in accumulator frame
+		CvSeq *contours = combinedata.GetSequenceData(CVAR_ID_CONTOURS);
+		if (contours != NULL) {
+			cvZero(contourMask);
+			cvDrawContours(contourMask, contours, cvScalar(0xFF), cvScalar(0x00), 1, 1, CV_AA);
+			ScaleContourMask();
+			cvSet(outputAccImage, colorSwatch[0], frameMask);
+		}
+
+		// copy accumulator frame to output frame
+		cvCopy(outputAccImage, outputFrame);
+
+		// now we apply the output chain to the combined output data
+		SendOutput(frame, combinedata, "Combination", NULL, deferredOutputs);
+	}
+	scheduler.EndFrame();
+
+	// whatever wasn't spent classifying or in the outputs went into combining the results
+	double frameMs = GetTimeMs()-frameStart;
+	metrics.Record(STAGE_FILTERCHAIN, frameMs);
+	metrics.Record(STAGE_COMBINE, frameMs-classifyMs-outputsMs);
+	if (deferredOutputs == NULL) metrics.Record(STAGE_OUTPUTS, outputsMs);
+	metrics.CountProcessedFrame();
+}
+
+void FilterChain::UnpackFrameMask(BitMask &mask) {
+	// nearest neighbour, so the mask stays binary
+	mask.ScaleTo(frameBits);
+	frameBits.ToImage(frameMask);
+}
+
+bool FilterChain::AllAtFullSize() {
+	for (list<Classifier*>::iterator i=activeClassifiers.begin(); i!=activeClassifiers.end(); i++) {
+		if (frameContext.GetLevelForWidth((*i)->workingWidth) != 0) return false;
+	}
+	return true;
+}
+
+void FilterChain::ScaleContourMask() {
+	if (fullSizeCombine) {
+		cvResize(contourMask, frameMask);
+	} else {
+		contourBits.FromImage(contourMask);
+		UnpackFrameMask(contourBits);
+	}
+}
+
+void FilterChain::SendOutput(IplImage *frame, ClassifierOutputData &outdata, char *filterName, Classifier *c, FrameResults *deferredOutputs) {
+	if (activeOutputs.empty()) return;
+	if (metrics.publishVariables) AddMetricsVariables(outdata, c);
+	if (deferredOutputs != NULL) {
+		deferredOutputs->Add(outdata, filterName);
+		return;
+	}
+	for (list<OutputSink*>::iterator j=activeOutputs.begin(); j!=activeOutputs.end(); j++) {
+		double start = GetTimeMs();
+		(*j)->ProcessOutput(frame, outdata, filterName);
+		double ms = GetTimeMs()-start;
+		metrics.Record(outputStages[*j], ms);
+		outputsMs += ms;
+	}
+}
+
+void FilterChain::AddMetricsVariables(ClassifierOutputData &outdata, Classifier *c) {
+	LatencyStats stats;
+	metrics.GetStageStats(STAGE_FILTERCHAIN, stats);
+	outdata.AddVariable(ClassifierOutputVariable(metricVariables[0], (float)stats.p50));
+	outdata.AddVariable(ClassifierOutputVariable(metricVariables[1], (float)stats.p95));
+	outdata.AddVariable(ClassifierOutputVariable(metricVariables[2], (float)stats.p99));
+	outdata.AddVariable(ClassifierOutputVariable(metricVariables[3], (int)metrics.GetFramesProcessed()));
+	outdata.AddVariable(ClassifierOutputVariable(metricVariables[4], (int)metrics.GetFramesDropped()));
+	if (c != NULL) {
+		outdata.AddVariable(ClassifierOutputVariable(metricVariables[5], (float)classifierStages[c].lastMs));
+	}
+}
+
+void FilterChain::UpdateMetricStages() {
+	// the stages follow the chain, so start them over whenever it changes
+	USES_CONVERSION;
+	metrics.RemoveAddedStages();
+	classifierStages.clear();
+	outputStages.clear();
+	for (list<Classifier*>::iterator i=activeClassifiers.begin(); i!=activeClassifiers.end(); i++) {
+		string name = W2A((*i)->GetName());
+		ClassifierMetricStages &stages = classifierStages[*i];
+		stages.classify = metrics.AddStage(name);
+		stages.standardOutputs = metrics.AddStage(name + " (standard outputs)");
+		stages.lastMs = 0;
+	}
+	for (list<OutputSink*>::iterator j=activeOutputs.begin(); j!=activeOutputs.end(); j++) {
+		outputStages[*j] = metrics.AddStage(string("Output: ") + W2A((*j)->GetName()));
+	}
+}
+
+void FilterChain::RecordClassifierTime(Classifier *c, double ms) {
+	map<Classifier*, ClassifierMetricStages>::iterator s = classifierStages.find(c);
+	if (s == classifierStages.end()) return;
+	s->second.lastMs = ms;
+	metrics.Record(s->second.classify, ms);
+	metrics.Record(s->second.standardOutputs, c->standardOutputMs);
+}
+
+void FilterChain::SetCascadeRegions(IplImage *frame, ClassifierOutputData &outdata) {
+	frameContext.SetFrame(frame);
+
+	// filters without bounding boxes (e.g. gestures) leave the whole frame to the next one
+	if (!outdata.HasVariable(CVAR_ID_BOUNDINGBOXES)) return;
+	vector<Rect> *bboxes = outdata.GetBoundingBoxData(CVAR_ID_BOUNDINGBOXES);
+	if (bboxes == NULL) return;
+
+	// the boxes are in mask coordinates, so scale them up to the frame and pad them a little,
+	// since the next filter may need some context around the object (SetRegions clips to the frame)
+	float scaleX = (float)frame->width/GUESSMASK_WIDTH;
+	float scaleY = (float)frame->height/GUESSMASK_HEIGHT;
+	cascadeRegions.clear();
+	for (int i=0; i<(int)bboxes->size(); i++) {
+		Rect r = (*bboxes)[i];
+		int x1 = (int)(r.X*scaleX) - CASCADE_REGION_PADDING;
+		int y1 = (int)(r.Y*scaleY) - CASCADE_REGION_PADDING;
+		int x2 = (int)ceil((r.X+r.Width)*scaleX) + CASCADE_REGION_PADDING;
+		int y2 = (int)ceil((r.Y+r.Height)*scaleY) + CASCADE_REGION_PADDING;
+		cascadeRegions.push_back(Rect(x1, y1, x2-x1, y2-y1));
+	}
+	frameContext.SetRegions(&cascadeRegions);
+}
+
+ClassifierOutputData FilterChain::RunClassifier(Classifier *c, IplImage *frame, long frameNum) {
+	// classifiers in a pixel group have already run on this frame
+	const ClassifierOutputData *grouped = GetPixelGroupOutput(c);
+	if (grouped != NULL) return *grouped;
+
+	ClassifierOutputData outdata;
+	double start = GetTimeMs();
+    if (c->classifierType == MOTION_FILTER) {
+		if (!processedMotion) {	// this is the first motion filter in the chain, so we'll update the motion image now
+			ProcessMotionFrame(frameNum);
+			processedMotion = true;
+		}
+        outdata = ((MotionClassifier*)c)->ClassifyMotion(motionHistory, frameNum);
+    } else if (c->classifierType == GESTURE_FILTER) {
+		if (!processedGesture) {	// this is the first gesture filter in the chain, so we'll update the motion trails now
+			ProcessGestureFrame(frame);
+			processedGesture = true;
+		}
+
+		MotionTrack mt = m_flowTracker.GetCurrentTrajectory();
+        outdata = ((GestureClassifier*)c)->ClassifyTrack(mt);
+		if (outdata.HasVariable(CVAR_ID_ISMATCH)) {
+			if (outdata.GetIntData(CVAR_ID_ISMATCH) != 0) {
+				m_flowTracker.ClearCurrentTrajectory();
+			}
+		}
+    } else if (scheduler.ShouldRun(c, frameNum)) {
+		if (!LookupResult(c, frameNum, outdata)) {
+			outdata = c->ClassifyFrame(GetClassifierContext(c));
+			StoreResult(c, frameNum, outdata);
+		}
+		scheduler.RecordRun(c, frameNum, outdata, GetTimeMs()-start);
+    } else {
+		// not this classifier's turn, so it reports what it found last time
+		return scheduler.GetLastOutput(c);
+	}
+	RecordClassifierTime(c, GetTimeMs()-start);
+	return outdata;
+}
+
+FrameContext* FilterChain::GetClassifierContext(Classifier *c) {
+	return frameContext.GetLevel(frameContext.GetLevelForWidth(c->workingWidth));
+}
+
+bool FilterChain::LookupResult(Classifier *c, long frameNum, ClassifierOutputData &outdata) {
+	// in CASCADE mode each filter only looks at what the last one left, so its mask isn't its own
+	if ((resultCache == NULL) || (filterCombineMode == IDC_COMBINE_CASCADE)) return false;
+	if (!resultCache->Lookup(videoId, frameNum, c, cachedBits)) return false;
+	outdata = c->ReplayMask(cachedBits);
+	return true;
+}
+
+void FilterChain::StoreResult(Classifier *c, long frameNum, ClassifierOutputData &outdata) {
+	if ((resultCache == NULL) || (filterCombineMode == IDC_COMBINE_CASCADE)) return;
+	if (outdata.HasVariable(CVAR_ID_MASK)) resultCache->Store(videoId, frameNum, c, outdata.GetImageData(CVAR_ID_MASK));
+}
+
+void FilterChain::RunClassifiersInParallel(IplImage *frame, long frameNum) {
+	// update the motion history and gesture trails up front, so no task has to
+	if (trackingMotion) {
+		ProcessMotionFrame(frameNum);
+		processedMotion = true;
+	}
+	if (trackingGesture) {
+		ProcessGestureFrame(frame);
+		processedGesture = true;
+	}
+
+	// the motion and gesture classifiers share the motion history and flow tracker, so they all
+	// go into task 0 (in chain order); each of the other classifiers gets a task of its own
+	chainClassifiers.assign(activeClassifiers.begin(), activeClassifiers.end());
+	chainOutputs.resize(chainClassifiers.size());
+	chainCosts.resize(chainClassifiers.size());
+	chainContexts.resize(chainClassifiers.size());
+	parallelTasks.clear();
+	parallelTasks.push_back(-1);
+
+	// the scheduler and result cache aren't thread safe, so we decide up front which classifiers run
+	// on this frame (and build the pyramid levels and shared derived images they need, so the tasks
+	// only ever read them); those whose results are cached are replayed here instead
+	for (int n=0; n<(int)chainClassifiers.size(); n++) {
+		Classifier *c = chainClassifiers[n];
+		if ((c->classifierType == MOTION_FILTER) || (c->classifierType == GESTURE_FILTER)) continue;
+		const ClassifierOutputData *grouped = GetPixelGroupOutput(c);
+		if (grouped != NULL) {
+			chainOutputs[n] = *grouped;
+		} else if (scheduler.ShouldRun(c, frameNum)) {
+			double start = GetTimeMs();
+			if (LookupResult(c, frameNum, chainOutputs[n])) {
+				double cost = GetTimeMs()-start;
+				scheduler.RecordRun(c, frameNum, chainOutputs[n], cost);
+				RecordClassifierTime(c, cost);
+				continue;
+			}
+			parallelTasks.push_back(n);
+			chainContexts[n] = GetClassifierContext(c);
+			chainContexts[n]->Prepare(c->GetFrameRequirements());
+		} else {
+			chainOutputs[n] = scheduler.GetLastOutput(c);
+		}
+	}
+
+	parallelFrame = frame;
+	parallelFrameNum = frameNum;
+	threadPool.ParallelFor(parallelTasks.size(), ClassifierTask, this);
+	parallelFrame = NULL;
+
+	for (int t=1; t<(int)parallelTasks.size(); t++) {
+		int n = parallelTasks[t];
+		StoreResult(chainClassifiers[n], frameNum, chainOutputs[n]);
+		scheduler.RecordRun(chainClassifiers[n], frameNum, chainOutputs[n], chainCosts[n]);
+		RecordClassifierTime(chainClassifiers[n], chainCosts[n]);
+	}
+}
+
+void FilterChain::ClassifierTask(int taskIndex, void *arg) {
+	FilterChain *chain = (FilterChain*)arg;
+	int n = chain->parallelTasks[taskIndex];
+	if (n >= 0) {
+		double start = GetTimeMs();
+		chain->chainOutputs[n] = chain->chainClassifiers[n]->ClassifyFrame(chain->chainContexts[n]);
+		chain->chainCosts[n] = GetTimeMs()-start;
+		return;
+	}
+	for (n=0; n<(int)chain->chainClassifiers.size(); n++) {
+		int type = chain->chainClassifiers[n]->classifierType;
+		if ((type == MOTION_FILTER) || (type == GESTURE_FILTER)) {
+			chain->chainOutputs[n] = chain->RunClassifier(chain->chainClassifiers[n], chain->parallelFrame, chain->parallelFrameNum);
+		}
+	}
+}
+
+const ClassifierOutputData* FilterChain::GetPixelGroupOutput(Classifier *c) {
+	for (int n=0; n<(int)pixelClassifiers.size(); n++) {
+		if ((pixelClassifiers[n] == c) && pixelGrouped[n]) return &pixelOutputs[n];
+	}
+	return NULL;
+}
+
+void FilterChain::RunPixelGroups(long frameNum) {
+	pixelClassifiers.clear();
+	pixelTests.clear();
+	pixelContexts.clear();
+	pixelGrouped.clear();
+	if (filterCombineMode == IDC_COMBINE_CASCADE) return;
+
+	// the pixel-wise classifiers in chain order, their tests (which take some setting up, so we
+	// only ask for them once) and the pyramid levels they work at
+	PixelTest test;
+	for (list<Classifier*>::iterator i=activeClassifiers.begin(); i!=activeClassifiers.end(); i++) {
+		Classifier *c = *i;
+		if ((c->classifierType == MOTION_FILTER) || (c->classifierType == GESTURE_FILTER)) continue;
+		if (c->GetPixelTest(test)) {
+			pixelClassifiers.push_back(c);
+			pixelTests.push_back(test);
+			pixelContexts.push_back(GetClassifierContext(c));
+			pixelGrouped.push_back(false);
+		}
+	}
+	pixelOutputs.resize(pixelClassifiers.size());
+
+	// each level with two or more of them makes a group, which we run when we come to its first member
+	for (int first=0; first<(int)pixelClassifiers.size(); first++) {
+		FrameContext *level = pixelContexts[first];
+		bool earlier = false;
+		int nMembers = 0;
+		for (int n=0; (n<(int)pixelClassifiers.size()) && !earlier; n++) {
+			if (pixelContexts[n] != level) continue;
+			if (n < first) earlier = true;
+			nMembers++;
+		}
+		if (earlier || (nMembers < 2)) continue;	// run already, or nothing to share (so it runs as usual)
+
+		// decide which of them run on this frame, as RunClassifier would
+		pixelEvaluator.Begin(level);
+		pixelRunning.clear();
+		for (int n=first; n<(int)pixelClassifiers.size(); n++) {
+			if (pixelContexts[n] != level) continue;
+			Classifier *c = pixelClassifiers[n];
+			pixelGrouped[n] = true;
+			if (!scheduler.ShouldRun(c, frameNum)) {
+				pixelOutputs[n] = scheduler.GetLastOutput(c);
+				continue;
+			}
+			double start = GetTimeMs();
+			if (LookupResult(c, frameNum, pixelOutputs[n])) {
+				double cost = GetTimeMs()-start;
+				scheduler.RecordRun(c, frameNum, pixelOutputs[n], cost);
+				RecordClassifierTime(c, cost);
+				continue;
+			}
+			pixelEvaluator.AddTest(pixelTests[n]);
+			pixelRunning.push_back(n);
+		}
+		if (pixelRunning.empty()) continue;
+
+		// one pass for all of their masks, then each of them carries on from its own in a task
+		// of its own; the pass is charged to them in equal shares
+		double start = GetTimeMs();
+		pixelEvaluator.Prepare(threadPool.NumThreads()+1);
+		threadPool.ParallelFor(pixelEvaluator.NumBands(), PixelGroupTask, this);
+		double passShare = (GetTimeMs()-start)/pixelRunning.size();
+		pixelCosts.resize(pixelRunning.size());
+		threadPool.ParallelFor(pixelRunning.size(), PixelFinishTask, this);
+
+		for (int t=0; t<(int)pixelRunning.size(); t++) {
+			int n = pixelRunning[t];
+			Classifier *c = pixelClassifiers[n];
+			StoreResult(c, frameNum, pixelOutputs[n]);
+			double cost = passShare + pixelCosts[t];
+			scheduler.RecordRun(c, frameNum, pixelOutputs[n], cost);
+			RecordClassifierTime(c, cost);
+		}
+	}
+}
+
+void FilterChain::PixelGroupTask(int taskIndex, void *arg) {
+	((FilterChain*)arg)->pixelEvaluator.ApplyBand(taskIndex);
+}
+
+void FilterChain::PixelFinishTask(int taskIndex, void *arg) {
+	// the tests were added in the order of pixelRunning, so task t has the masks of test t
+	FilterChain *chain = (FilterChain*)arg;
+	int n = chain->pixelRunning[taskIndex];
+	double start = GetTimeMs();
+	chain->pixelOutputs[n] = chain->pixelClassifiers[n]->ClassifyPixelMasks(chain->pixelContexts[n], chain->pixelEvaluator.GetMasks(taskIndex));
+	chain->pixelCosts[taskIndex] = GetTimeMs()-start;
+}
+
+void FilterChain::SetClassifierThreads(int nThreads) {
+	// the calling thread also runs classifiers, so we need one fewer worker than threads
+	if (nThreads == 1) threadPool.Stop();
+	else if (nThreads <= 0) threadPool.Start(0);
+	else threadPool.Start(nThreads-1);
+}
+
+int FilterChain::GetClassifierThreads() {
+	return threadPool.NumThreads()+1;
+}
+
+void FilterChain::ProcessMotionFrame(long frameNum) {
+    // grayscale frame for motion history computation (shared with the classifiers)
+    cvCopy(frameContext.GetGray(), motionBuf[last]);
+    int idx1 = last;
+    int idx2 = (last + 1) % MOTION_NUM_IMAGES;
+    last = idx2;
+
+    // get difference between frames
+    IplImage* silh = motionBuf[idx2];
+    cvAbsDiff(motionBuf[idx1], motionBuf[idx2], silh);
+
+    // threshold difference image and use it to update motion history image
+    cvThreshold(silh, silh, MOTION_DIFF_THRESHOLD, 1, CV_THRESH_BINARY);
+    cvUpdateMotionHistory(silh, motionHistory, frameNum, MOTION_MHI_DURATION); // update MHI
+
+    // convert MHI to blue 8U image
+    cvCvtScale(motionHistory, motionMask, 255./MOTION_MHI_DURATION,(MOTION_MHI_DURATION-frameNum)*255./MOTION_MHI_DURATION);
+    cvZero(motionImage);
+    cvCvtPlaneToPix( motionMask, 0, 0, 0, motionImage );
+}
+
+void FilterChain::ProcessGestureFrame(IplImage *frame) {
+    // Process the new frame with the flow tracker
+	m_flowTracker.ProcessFrame(frame);
+}
+
+bool FilterChain::AddActiveFilter(Classifier *c) {	// returns true if the filter was added; false if it was already active
+	bool alreadyAdded = false;
+    for (list<Classifier*>::iterator j=activeClassifiers.begin(); j!=activeClassifiers.end(); j++) {
+		if ((*j) == c) {
+			alreadyAdded = true;
+		}
+    }
+	if (!alreadyAdded) {
+		if (c->classifierType == MOTION_FILTER) {
+			trackingMotion++;
+		} else if (c->classifierType == GESTURE_FILTER) {
+			trackingGesture++;
+		}
+		activeClassifiers.push_back(c);
+		UpdateMetricStages();
+	}
+	return !alreadyAdded;
+}
+
+void FilterChain::ClearActiveFilters() {
+    trackingMotion = 0;
+    trackingGesture = 0;
+    activeClassifiers.clear();
+	scheduler.Clear();
+	UpdateMetricStages();
+}
+
+void FilterChain::ResetActiveFilterRunningStates() {
+    for (list<Classifier*>::iterator i=activeClassifiers.begin(); i!=activeClassifiers.end(); i++) {
+        (*i)->ResetRunningState();
+    }
+	scheduler.Reset();
+}
+
+bool FilterChain::AddActiveOutput(OutputSink *o) {	// returns true if the output was added; false if it was already active
+	bool alreadyAdded = false;
+    for (list<OutputSink*>::iterator j=activeOutputs.begin(); j!=activeOutputs.end(); j++) {
+		if ((*j) == o) {
+			alreadyAdded = true;
+		}
+    }
+	if (!alreadyAdded) {
+		activeOutputs.push_back(o);
+		o->StartRunning();
+		UpdateMetricStages();
+	}
+	return !alreadyAdded;
+}
+
+void FilterChain::ClearActiveOutputs() {
+    for (list<OutputSink*>::iterator j=activeOutputs.begin(); j!=activeOutputs.end(); j++) {
+        (*j)->StopRunning();
+    }
+    activeOutputs.clear();
+	UpdateMetricStages();
+}
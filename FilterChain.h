@@ -0,0 +1,213 @@
+#pragma once
+#include "SimpleFlowTracker.h"
+#include "ThreadPool.h"
+#include "ClassifierScheduler.h"
+#include "PipelineMetrics.h"
+#include "BitMask.h"
+#include "ResultCache.h"
+#include "FusedMaskEvaluator.h"
+
+// A deep copy of the results a frame sends to the output sinks (images, contours and
+// bounding boxes included), so the outputs can run on another thread while the filter
+// chain moves on to the next frame.  The buffers are kept and reused from frame to frame.
+class FrameResults
+{
+public:
+	FrameResults();
+	~FrameResults();
+
+	void Clear();
+	void Add(ClassifierOutputData &outdata, const char *filterName);
+
+	int NumResults();
+	ClassifierOutputData& GetData(int index);
+	char* GetFilterName(int index);
+
+private:
+	CvSeq* CopySequenceTree(CvSeq *seq, CvSeq *parent);
+
+	int nResults, nImages, nBoxes;
+	vector<ClassifierOutputData> results;
+	vector<string> filterNames;
+	vector<IplImage*> images;
+	vector< vector<Rect>* > boxes;
+	CvMemStorage *storage;
+};
+
+// The recognition pipeline shared by the GUI video runner and the headless runner:
+// applies a chain of classifiers to each frame, combines their masks according to the
+// combine mode, draws the result into outputFrame and passes the data to the output sinks.
+// It holds no window, bitmap or thread state, so callers are responsible for locking.
+class FilterChain
+{
+public:
+	FilterChain();
+	~FilterChain();
+
+	// allocate and free the per-stream images for frames of the given size
+	void StartProcessing(int width, int height);
+	void StopProcessing();
+
+	void ProcessInput(IplImage *frame);
+
+	// if deferredOutputs is given, the results are copied there instead of being sent to the
+	// outputs, and SendResults must be called later to pass them on
+	void ApplyFilterChain(IplImage *frame, long frameNum, FrameResults *deferredOutputs = NULL);
+	void SendResults(IplImage *frame, FrameResults *results);
+	ClassifierOutputData GetStandardOutputData();
+
+    bool AddActiveFilter(Classifier*);
+    void ClearActiveFilters();
+	void ResetActiveFilterRunningStates();
+
+	// run the classifiers of each frame on nThreads threads in LIST, AND and OR modes
+	// (1 runs them serially, 0 uses one thread per processor); results are identical either way
+	void SetClassifierThreads(int nThreads);
+	int GetClassifierThreads();
+
+    bool AddActiveOutput(OutputSink *o);
+    void ClearActiveOutputs();
+
+	int videoX, videoY;
+	bool isProcessing;
+
+	// output frame with the masked and outlined filter results, and a visualization of motion history
+	IplImage *outputFrame, *motionImage;
+
+	// outline the regions in outputFrame (true by default); the contours are only traced for
+	// this, so runs that never show outputFrame should turn it off
+	bool drawContours;
+
+    //  keep track of the number of active filters that require motion or blob tracking
+    int trackingMotion;
+    int trackingGesture;
+
+	// we can combine filters as LIST, AND, OR, or CASCADE
+	int filterCombineMode;
+
+	// for the bounding boxes output from a combination of filters
+	vector<Rect> boundingBoxes;
+
+	// for tracking optical flow for gesture tracking
+	SimpleFlowTracker m_flowTracker;
+
+	// the current frame and the gray/HSV/edge images shared by the classifiers that run on it
+	FrameContext frameContext;
+
+	// how often each classifier runs (every frame unless told otherwise); the settings are
+	// forgotten when the active filters are cleared
+	ClassifierScheduler scheduler;
+
+	// latency of each classifier, output and stage of the chain, and frame counts; the runners
+	// add capture, copy, bitmap and whole-frame times.  Set metrics.publishVariables to send the
+	// chain latency percentiles, frame counts and each classifier's latency to the outputs.
+	PipelineMetrics metrics;
+
+	// remembers what the classifiers found on each frame of a recorded video, so running the same
+	// file again only classifies what is new (NULL, the default, turns this off; not in CASCADE
+	// mode).  The runners set videoId to identify the file, and to 0 for a camera.
+	ResultCache *resultCache;
+	unsigned long long videoId;
+
+private:
+    // functions that may be called by ApplyFilterChain (if motion/gesture filters are active)
+    void ProcessMotionFrame(long frameNum);
+    void ProcessGestureFrame(IplImage *frame);
+
+	// run a single classifier on the current frame, motion history or gesture trajectory
+	ClassifierOutputData RunClassifier(Classifier *c, IplImage *frame, long frameNum);
+	FrameContext* GetClassifierContext(Classifier *c);	// the pyramid level it works at
+	bool LookupResult(Classifier *c, long frameNum, ClassifierOutputData &outdata);
+	void StoreResult(Classifier *c, long frameNum, ClassifierOutputData &outdata);
+	BitMask cachedBits;
+	void RunClassifiersInParallel(IplImage *frame, long frameNum);
+	static void ClassifierTask(int taskIndex, void *arg);
+
+	// When two or more of the classifiers that test each pixel on its own (color, color table,
+	// brightness) work at the same pyramid level, their masks come from one pass over it, split
+	// across the thread pool, and each of them carries on from there on a thread of its own.
+	// This runs them all (or replays them, as the scheduler and result cache say) ahead of the
+	// others, leaving their outputs for this frame in pixelOutputs; not in CASCADE mode.
+	void RunPixelGroups(long frameNum);
+	const ClassifierOutputData* GetPixelGroupOutput(Classifier *c);	// NULL if c isn't in a group
+	static void PixelGroupTask(int taskIndex, void *arg);
+	static void PixelFinishTask(int taskIndex, void *arg);
+	FusedMaskEvaluator pixelEvaluator;
+
+	// the pixel-wise classifiers in chain order, their tests for this frame, the pyramid level each
+	// works at, whether it is in a group and (if so) its output, and the ones of the current group
+	// that classify this frame, with their costs; all kept between frames, so their space is reused
+	vector<Classifier*> pixelClassifiers;
+	vector<PixelTest> pixelTests;
+	vector<FrameContext*> pixelContexts;
+	vector<bool> pixelGrouped;
+	vector<ClassifierOutputData> pixelOutputs;
+	vector<int> pixelRunning;
+	vector<double> pixelCosts;
+
+	// send data to the outputs now, or copy it for SendResults
+	void SendOutput(IplImage *frame, ClassifierOutputData &outdata, char *filterName, Classifier *c, FrameResults *deferredOutputs);
+
+	// metric stages for each classifier and output in the chain
+	struct ClassifierMetricStages {
+		int classify, standardOutputs;
+		double lastMs;
+	};
+	void UpdateMetricStages();
+	void RecordClassifierTime(Classifier *c, double ms);
+	void AddMetricsVariables(ClassifierOutputData &outdata, Classifier *c);
+	map<Classifier*, ClassifierMetricStages> classifierStages;
+	map<OutputSink*, int> outputStages;
+	int metricVariables[6];
+	double classifyMs, outputsMs;	// time spent on the current frame
+
+	// the masks are combined at mask resolution (GUESSMASK_WIDTH x GUESSMASK_HEIGHT, which is what
+	// the classifiers output), packed one bit per pixel; they are only unpacked into images for
+	// contour finding (combineMaskOutput) and for drawing over the frame (frameMask, at full size)
+    IplImage *outputAccImage, *contourMask, *guessMask, *combineMaskOutput, *frameMask, *motionHistory, *motionMask;
+	BitMask guessBits, combineBits, contourBits, frameBits;
+
+	// When every classifier works on the full frame, the masks are scaled up to it and combined
+	// there instead (in frameMask and combineFrameMask, interpolated, as they always were), so
+	// the results on frames that small are the same as before the pyramid.
+	IplImage *combineFrameMask;
+	bool fullSizeCombine;
+	bool AllAtFullSize();
+	void ScaleContourMask();	// contourMask into frameMask, either way
+	RegionLabeller regionLabeller;	// for the region statistics of the combined mask
+
+	// the standard outputs of the combined mask that something needs this frame (CVAR_BIT flags)
+	unsigned int combinedOutputs;
+	void UnpackFrameMask(BitMask &mask);
+    IplImage* motionBuf[MOTION_NUM_IMAGES];
+
+    // for keeping track of position within circular motion history buffer
+    int last;
+
+	// whether the motion history and gesture trails have been updated for the current frame
+	bool processedMotion, processedGesture;
+
+    // list of classifiers to apply to the video stream
+    list<Classifier*> activeClassifiers;
+
+    // list of outputs to which we will send video data
+    list<OutputSink*> activeOutputs;
+
+	// memory storage for contours of combine mask
+	CvMemStorage *contourStorage;
+
+	// for running independent classifiers concurrently: task 0 runs the motion and gesture
+	// classifiers (which share tracker state) in chain order, every other task runs one classifier
+	ThreadPool threadPool;
+	vector<Classifier*> chainClassifiers;
+	vector<ClassifierOutputData> chainOutputs;
+	vector<FrameContext*> chainContexts;
+	vector<double> chainCosts;
+	vector<int> parallelTasks;
+	IplImage *parallelFrame;
+	long parallelFrameNum;
+
+	// in CASCADE mode, the areas of the frame that survived the previous filter (in frame coordinates)
+	void SetCascadeRegions(IplImage *frame, ClassifierOutputData &outdata);
+	vector<Rect> cascadeRegions;
+};
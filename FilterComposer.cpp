@@ -6,6 +6,8 @@
 #include "VideoRecorder.h"
 #include "BrightnessClassifier.h"
 #include "ColorClassifier.h"
+#include "ColorLutClassifier.h"
+#include "CamshiftClassifier.h"
 #include "ShapeClassifier.h"
 #include "SiftClassifier.h"
 #include "HaarClassifier.h"
@@ -13,6 +15,7 @@
 #include "GestureClassifier.h"
 #include "BackgroundSubtraction.h"
 #include "TesseractClassifier.h"
+#include "ClassifierFactory.h"
 #include "OutputSink.h"
 #include "OSCOutput.h"
 #include "TCPOutput.h"
@@ -43,32 +46,35 @@ LRESULT CFilterComposer::OnPaint( UINT, WPARAM, LPARAM, BOOL& ) {
 
     graphics->Clear(Color(240,240,240));
 
+	// the latest frame the video runner has finished with (NULL if there isn't one yet)
+	PreviewFrames *frames = m_videoRunner.GetLatestFrames();
+
     graphics->FillRectangle(&whiteBrush, 10, 40, 320, 240);
     graphics->DrawRectangle(&blackPen, 10, 40, 320, 240);
     graphics->DrawString(L"INPUT VIDEO", 11, &labelFont, PointF(15,45), &blackBrush);
-    if (m_videoRunner.processingVideo) {
-        graphics->DrawImage(m_videoRunner.bmpInput, 10, 40, 320, 240);
+    if (frames != NULL) {
+        graphics->DrawImage(frames->input, 10, 40, 320, 240);
 	    graphics->DrawString(L"INPUT VIDEO", 11, &labelFont, PointF(15,45), &whiteBrush);
     }
 
     graphics->FillRectangle(&whiteBrush, 10, 420, 320, 240);
     graphics->DrawRectangle(&blackPen, 10, 420, 320, 240);
     graphics->DrawString(L"FILTERED VIDEO", 14, &labelFont, PointF(15,425), &blackBrush);
-    if (m_videoRunner.processingVideo) {
-        graphics->DrawImage(m_videoRunner.bmpOutput, 10, 420, 320, 240);
+    if (frames != NULL) {
+        graphics->DrawImage(frames->output, 10, 420, 320, 240);
 	    graphics->DrawString(L"FILTERED VIDEO", 14, &labelFont, PointF(15,425), &whiteBrush);
     }
 
-	if (m_videoRunner.processingVideo) {
+	if (frames != NULL) {
 		// draw the blob tracking status image
-		if (m_videoRunner.trackingGesture) {
-			graphics->DrawImage(m_videoRunner.bmpGesture, 10, 290, 160, 120);
+		if (frames->trackingGesture) {
+			graphics->DrawImage(frames->gesture, 10, 290, 160, 120);
 			graphics->DrawString(L"GESTURE INPUT", 13, &smallFont, PointF(15,295), &whiteBrush);
 		}
 
 		// draw the motion tracking status image
-		if (m_videoRunner.trackingMotion) {
-			graphics->DrawImage(m_videoRunner.bmpMotion, 170, 290, 160, 120);
+		if (frames->trackingMotion) {
+			graphics->DrawImage(frames->motion, 170, 290, 160, 120);
 			graphics->DrawString(L"MOTION INPUT", 12, &smallFont, PointF(175,295), &whiteBrush);
 		}
 	}
@@ -123,7 +129,7 @@ LRESULT CFilterComposer::OnCreate(UINT, WPARAM, LPARAM, BOOL& )
     m_filterLibrary.ShowWindow(TRUE);
 
 	// Set the starting combine mode to "LIST"
-	m_videoRunner.filterCombineMode = IDC_COMBINE_LIST;
+	m_videoRunner.filterChain.filterCombineMode = IDC_COMBINE_LIST;
 	m_filterLibrary.CheckRadioButton(IDC_COMBINE_LIST,IDC_COMBINE_CASCADE,IDC_COMBINE_LIST);
 	return 0;
 }
@@ -159,6 +165,8 @@ LRESULT CFilterComposer::OnAddCustomFilter( UINT, WPARAM wParam, LPARAM lParam,
         case ADABOOST_FILTER:
         case MOTION_FILTER:
         case GESTURE_FILTER:
+        case COLOR_LUT_FILTER:
+        case CAMSHIFT_FILTER:
             bool newlyAdded = m_videoRunner.AddActiveFilter((Classifier*)lParam);
 			if (newlyAdded) {
 				listView = m_filterLibrary.GetDlgItem(IDC_ACTIVE_FILTER_LIST);
@@ -257,7 +265,10 @@ LRESULT CFilterComposer::OnCommand( UINT, WPARAM wParam, LPARAM lParam, BOOL& bH
 		case IDC_COMBINE_AND:
 		case IDC_COMBINE_OR:
 		case IDC_COMBINE_CASCADE:
-			m_videoRunner.filterCombineMode = wParam;
+			m_videoRunner.filterChain.filterCombineMode = wParam;
+			break;
+		case IDC_CACHE_RESULTS:
+			m_videoRunner.SetResultCaching(m_filterLibrary.IsDlgButtonChecked(IDC_CACHE_RESULTS) == BST_CHECKED);
 			break;
         default:
             break;
@@ -269,29 +280,13 @@ void CFilterComposer::ResetState() {
     ClearActiveClassifiers();
     ClearActiveOutputs();
 	// Set the combine mode back to "LIST"
-	m_videoRunner.filterCombineMode = IDC_COMBINE_LIST;
+	m_videoRunner.filterChain.filterCombineMode = IDC_COMBINE_LIST;
 	m_filterLibrary.CheckRadioButton(IDC_COMBINE_LIST,IDC_COMBINE_CASCADE,IDC_COMBINE_LIST);
 }
 
 void CFilterComposer::LoadCustomClassifier(LPWSTR pathname) {
 
-    Classifier *newclassifier = NULL;
-
-    if (wcsstr(pathname, FILE_BRIGHTNESS_SUFFIX) != NULL) {
-        newclassifier = new BrightnessClassifier(pathname);
-    } else if (wcsstr(pathname, FILE_COLOR_SUFFIX) != NULL) { 
-        newclassifier = new ColorClassifier(pathname);
-    } else if (wcsstr(pathname, FILE_GESTURE_SUFFIX) != NULL) { 
-        newclassifier = new GestureClassifier(pathname);
-    } else if (wcsstr(pathname, FILE_HAAR_SUFFIX) != NULL) { 
-        newclassifier = new HaarClassifier(pathname);
-    } else if (wcsstr(pathname, FILE_MOTION_SUFFIX) != NULL) { 
-        newclassifier = new MotionClassifier(pathname);
-    } else if (wcsstr(pathname, FILE_SHAPE_SUFFIX) != NULL) { 
-        newclassifier = new ShapeClassifier(pathname);
-    } else if (wcsstr(pathname, FILE_SIFT_SUFFIX) != NULL) { 
-        newclassifier = new SiftClassifier(pathname);
-    }
+    Classifier *newclassifier = LoadClassifierFromDirectory(pathname);
 
     if (newclassifier != NULL) {
         customClassifiers.push_back(newclassifier);
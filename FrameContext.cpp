@@ -0,0 +1,210 @@
+#include "precomp.h"
+#include "constants.h"
+#include "FrameContext.h"
+
+FrameContext::FrameContext() {
+	frame = NULL;
+	gray = NULL;
+	hsv = NULL;
+	hue = NULL;
+	edges = NULL;
+	computed = 0;
+	useRegions = false;
+	for (int i=0; i<FRAME_MAX_LEVELS; i++) {
+		levels[i] = NULL;
+	}
+	builtLevels = 1;
+	levelFrame = NULL;
+	scale = 1;
+}
+
+FrameContext::~FrameContext() {
+	cvReleaseImage(&gray);
+	cvReleaseImage(&hsv);
+	cvReleaseImage(&hue);
+	cvReleaseImage(&edges);
+	cvReleaseImage(&levelFrame);
+	for (int i=1; i<FRAME_MAX_LEVELS; i++) {
+		delete levels[i];
+	}
+}
+
+void FrameContext::SetFrame(IplImage *newFrame) {
+	frame = newFrame;
+	computed = 0;
+	builtLevels = 1;
+	useRegions = false;
+	regions.clear();
+}
+
+void FrameContext::SetRegions(const vector<Rect> *newRegions) {
+	computed = 0;
+	builtLevels = 1;
+	regions.clear();
+	useRegions = (newRegions != NULL);
+	if (!useRegions) return;
+
+	// clip to the frame, dropping anything that ends up empty
+	for (int i=0; i<(int)newRegions->size(); i++) {
+		const Rect &r = (*newRegions)[i];
+		int x1 = max(r.X, 0), y1 = max(r.Y, 0);
+		int x2 = min(r.X+r.Width, frame->width), y2 = min(r.Y+r.Height, frame->height);
+		if ((x2 > x1) && (y2 > y1)) regions.push_back(cvRect(x1, y1, x2-x1, y2-y1));
+	}
+
+	// merge overlapping regions, so no pixel is processed twice
+	bool merged = true;
+	while (merged) {
+		merged = false;
+		for (int i=0; i<(int)regions.size() && !merged; i++) {
+			for (int j=i+1; j<(int)regions.size() && !merged; j++) {
+				CvRect a = regions[i], b = regions[j];
+				if ((a.x < b.x+b.width) && (b.x < a.x+a.width) && (a.y < b.y+b.height) && (b.y < a.y+a.height)) {
+					int x1 = min(a.x, b.x), y1 = min(a.y, b.y);
+					int x2 = max(a.x+a.width, b.x+b.width), y2 = max(a.y+a.height, b.y+b.height);
+					regions[i] = cvRect(x1, y1, x2-x1, y2-y1);
+					regions.erase(regions.begin()+j);
+					merged = true;
+				}
+			}
+		}
+	}
+}
+
+bool FrameContext::HasRegions() {
+	return useRegions;
+}
+
+int FrameContext::NumRegions() {
+	return useRegions ? (int)regions.size() : 1;
+}
+
+CvRect FrameContext::GetRegion(int index) {
+	if (!useRegions) return cvRect(0, 0, frame->width, frame->height);
+	return regions[index];
+}
+
+CvRect FrameContext::GetRegionBounds() {
+	if (!useRegions) return cvRect(0, 0, frame->width, frame->height);
+	if (regions.empty()) return cvRect(0, 0, 0, 0);
+	int x1 = frame->width, y1 = frame->height, x2 = 0, y2 = 0;
+	for (int i=0; i<(int)regions.size(); i++) {
+		x1 = min(x1, regions[i].x);
+		y1 = min(y1, regions[i].y);
+		x2 = max(x2, regions[i].x+regions[i].width);
+		y2 = max(y2, regions[i].y+regions[i].height);
+	}
+	return cvRect(x1, y1, x2-x1, y2-y1);
+}
+
+void FrameContext::Prepare(int requirements) {
+	if (requirements & FRAME_GRAY) GetGray();
+	if (requirements & FRAME_HSV) GetHSV();
+	if (requirements & FRAME_HUE) GetHue();
+	if (requirements & FRAME_EDGES) GetEdges();
+}
+
+IplImage* FrameContext::GetFrame() {
+	return frame;
+}
+
+IplImage* FrameContext::GetGray() {
+	if (!(computed & FRAME_GRAY)) {
+		EnsureImage(&gray, cvGetSize(frame), IPL_DEPTH_8U, 1);
+		for (int i=0; i<NumRegions(); i++) {
+			CvMat src, dst;
+			CvRect r = GetRegion(i);
+		    cvCvtColor(cvGetSubRect(frame, &src, r), cvGetSubRect(gray, &dst, r), CV_BGR2GRAY);
+		}
+		computed |= FRAME_GRAY;
+	}
+	return gray;
+}
+
+IplImage* FrameContext::GetHSV() {
+	if (!(computed & FRAME_HSV)) {
+		EnsureImage(&hsv, cvGetSize(frame), IPL_DEPTH_8U, 3);
+		for (int i=0; i<NumRegions(); i++) {
+			CvMat src, dst;
+			CvRect r = GetRegion(i);
+		    cvCvtColor(cvGetSubRect(frame, &src, r), cvGetSubRect(hsv, &dst, r), CV_BGR2HSV);
+		}
+		computed |= FRAME_HSV;
+	}
+	return hsv;
+}
+
+IplImage* FrameContext::GetHue() {
+	if (!(computed & FRAME_HUE)) {
+		EnsureImage(&hue, cvGetSize(frame), IPL_DEPTH_8U, 1);
+		IplImage *hsvImage = GetHSV();
+		for (int i=0; i<NumRegions(); i++) {
+			CvMat src, dst;
+			CvRect r = GetRegion(i);
+		    cvSplit(cvGetSubRect(hsvImage, &src, r), cvGetSubRect(hue, &dst, r), 0, 0, 0);
+		}
+		computed |= FRAME_HUE;
+	}
+	return hue;
+}
+
+IplImage* FrameContext::GetEdges() {
+	// the edge image used by the shape recognizer: Canny edges, dilated to close small gaps
+	if (!(computed & FRAME_EDGES)) {
+		EnsureImage(&edges, cvGetSize(frame), IPL_DEPTH_8U, 1);
+		IplImage *grayImage = GetGray();
+		for (int i=0; i<NumRegions(); i++) {
+			CvMat src, dst;
+			CvRect r = GetRegion(i);
+		    cvCanny(cvGetSubRect(grayImage, &src, r), cvGetSubRect(edges, &dst, r), SHAPE_CANNY_EDGE_LINK, SHAPE_CANNY_EDGE_FIND, SHAPE_CANNY_APERTURE);
+			cvDilate(&dst, &dst, 0, 2);
+		}
+		computed |= FRAME_EDGES;
+	}
+	return edges;
+}
+
+FrameContext* FrameContext::GetLevel(int level) {
+	level = max(0, min(level, FRAME_MAX_LEVELS-1));
+	while (builtLevels <= level) {
+		BuildLevel(builtLevels);
+		builtLevels++;
+	}
+	return (level == 0) ? this : levels[level];
+}
+
+int FrameContext::GetLevelForWidth(int minWidth) {
+	if (minWidth <= 0) return 0;
+	int level = 0;
+	int width = frame->width;
+	while ((level < FRAME_MAX_LEVELS-1) && ((width+1)/2 >= minWidth)) {
+		width = (width+1)/2;
+		level++;
+	}
+	return level;
+}
+
+void FrameContext::BuildLevel(int level) {
+	if (levels[level] == NULL) levels[level] = new FrameContext();
+	FrameContext *above = (level == 1) ? this : levels[level-1];
+	FrameContext *context = levels[level];
+
+	// cvPyrDown needs the smaller image rounded up
+	IplImage *src = above->frame;
+	EnsureImage(&context->levelFrame, cvSize((src->width+1)/2, (src->height+1)/2), src->depth, src->nChannels);
+	cvPyrDown(src, context->levelFrame, CV_GAUSSIAN_5x5);
+	context->SetFrame(context->levelFrame);
+	context->scale = 1 << level;
+
+	// shrink the regions to match, rounding outwards so they still cover the same pixels
+	if (useRegions) {
+		vector<Rect> levelRegions;
+		for (int i=0; i<(int)regions.size(); i++) {
+			CvRect r = regions[i];
+			int x1 = r.x >> level, y1 = r.y >> level;
+			int x2 = (r.x+r.width+context->scale-1) >> level, y2 = (r.y+r.height+context->scale-1) >> level;
+			levelRegions.push_back(Rect(x1, y1, x2-x1, y2-y1));
+		}
+		context->SetRegions(&levelRegions);
+	}
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+// derived images a classifier may ask the FrameContext for
+#define FRAME_GRAY	0x01
+#define FRAME_HSV	0x02
+#define FRAME_HUE	0x04
+#define FRAME_EDGES	0x08
+
+// number of image pyramid levels, including the full size frame
+#define FRAME_MAX_LEVELS 4
+
+// The current frame along with the representations several classifiers derive from it
+// (grayscale, HSV, hue and dilated Canny edges).  Each one is computed the first time it is
+// asked for and then shared by every classifier that runs on the frame.  The derived images
+// are read-only for classifiers; a classifier that needs to modify one must copy it first.
+//
+// The work can be limited to a set of regions of interest (as in CASCADE mode, where only the
+// areas found by the previous filter are left in the frame).  The derived images are then only
+// valid inside the regions, and classifiers that support regions only look there.
+//
+// Classifiers that don't need every pixel of a large frame can work on a smaller level of an
+// image pyramid instead: level N is the frame at 1/2^N of its size (built with cvPyrDown from
+// the level above, the first time it is asked for), with its own derived images and regions.
+class FrameContext
+{
+public:
+	FrameContext();
+	~FrameContext();
+
+	// start a new frame (or note that the current one has changed), discarding derived images
+	// and any regions of interest
+	void SetFrame(IplImage *frame);
+
+	// restrict processing to these rectangles (in frame coordinates); they are clipped to the
+	// frame and overlapping ones merged.  NULL means the whole frame, an empty list means nothing.
+	void SetRegions(const vector<Rect> *regions);
+	bool HasRegions();
+	int NumRegions();
+	CvRect GetRegion(int index);	// the whole frame if there are no regions set
+	CvRect GetRegionBounds();		// smallest rectangle containing all of the regions
+
+	// compute the requested FRAME_ images now, so they can be read from several threads at once
+	void Prepare(int requirements);
+
+	IplImage* GetFrame();
+	IplImage* GetGray();
+	IplImage* GetHSV();
+	IplImage* GetHue();
+	IplImage* GetEdges();
+
+	// the context of a pyramid level (0 is this one); like the derived images, a level should be
+	// asked for once before several threads read it
+	FrameContext* GetLevel(int level);
+
+	// the smallest pyramid level that is still at least minWidth pixels wide (0 for minWidth 0)
+	int GetLevelForWidth(int minWidth);
+
+	// how many times smaller than the original frame this context's frame is (1, 2, 4, ...)
+	int GetScale() { return scale; }
+
+private:
+	void BuildLevel(int level);
+
+	IplImage *frame;
+	bool useRegions;
+	vector<CvRect> regions;
+	IplImage *gray, *hsv, *hue, *edges;
+	int computed;	// which of the FRAME_ images are up to date for this frame
+
+	// the smaller pyramid levels (only used in the level 0 context), how many of them are up
+	// to date for this frame, and the downscaled frame a level's context owns
+	FrameContext *levels[FRAME_MAX_LEVELS];
+	int builtLevels;
+	IplImage *levelFrame;
+	int scale;
+};
@@ -0,0 +1,29 @@
+#include "precomp.h"
+#include "FrameView.h"
+
+FrameView::FrameView() {
+	frame = NULL;
+	buffer = NULL;
+}
+
+FrameView::~FrameView() {
+	if (buffer != NULL) cvReleaseImage(&buffer);
+}
+
+void FrameView::Attach(IplImage *captured) {
+	if (captured->origin == IPL_ORIGIN_TL) {
+		frame = captured;
+		return;
+	}
+	EnsureImage(&buffer, cvGetSize(captured), captured->depth, captured->nChannels);
+	cvFlip(captured, buffer);
+	frame = buffer;
+}
+
+IplImage* FrameView::GetWritable() {
+	if ((frame == NULL) || (frame == buffer)) return frame;
+	EnsureImage(&buffer, cvGetSize(frame), frame->depth, frame->nChannels);
+	cvCopy(frame, buffer);
+	frame = buffer;
+	return frame;
+}
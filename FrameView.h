@@ -0,0 +1,35 @@
+#pragma once
+
+// A captured frame as the pipeline sees it: upright, with the stride of whatever buffer holds it.
+// Frames the capture delivers top-down are read straight out of the capture buffer; only frames
+// that come bottom-up are flipped (OpenCV can't address rows with a negative stride), and only
+// a stage that changes the pixels (CASCADE masking) asks for a copy of its own.
+//
+// The view is only good until the next frame is grabbed from the same capture, since that
+// overwrites the capture buffer.  Anything that keeps a frame longer has to copy it.
+class FrameView
+{
+public:
+	FrameView();
+	~FrameView();
+
+	// the frame just returned by cvQueryFrame (or any image, for callers that already own one)
+	void Attach(IplImage *captured);
+
+	// the upright frame, for reading only
+	IplImage* Get() { return frame; }
+
+	// the upright frame, which the caller may change: the view's own copy of it, made now
+	// if the frame is still the capture buffer
+	IplImage* GetWritable();
+
+	// whether Get returns the view's own copy rather than the capture buffer
+	bool IsCopy() { return (frame != NULL) && (frame == buffer); }
+
+private:
+	FrameView(const FrameView&);
+	void operator=(const FrameView&);
+
+	IplImage *frame;		// what Get returns
+	IplImage *buffer;		// the view's own copy, kept between frames
+};
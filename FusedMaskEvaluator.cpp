@@ -0,0 +1,158 @@
+#include "precomp.h"
+#include "constants.h"
+#include "FusedMaskEvaluator.h"
+#include "ColorMaskKernel.h"
+#include "TrainingSample.h"
+#include "TrainingSet.h"
+#include "Classifier.h"
+#include "ColorLutClassifier.h"
+
+static int grayMatches = -1;	// not checked yet
+
+FusedMaskEvaluator::FusedMaskEvaluator() {
+	// the conversions are checked here rather than on the first frame, which may be split
+	// across several threads
+	GrayMatchesOpenCV();
+	ColorMaskKernel::MatchesOpenCV();
+	context = NULL;
+	nRegions = 0;
+}
+
+FusedMaskEvaluator::~FusedMaskEvaluator() {
+	for (int i=0; i<(int)masks.size(); i++) {
+		delete masks[i];
+	}
+}
+
+bool FusedMaskEvaluator::GrayMatchesOpenCV() {
+	if (grayMatches < 0) grayMatches = CheckGray() ? 1 : 0;
+	return (grayMatches != 0);
+}
+
+bool FusedMaskEvaluator::CheckGray() {
+	// every pair of green and blue, with red running through all values in a different order along each row
+	IplImage *bgr = cvCreateImage(cvSize(256, 256), IPL_DEPTH_8U, 3);
+	IplImage *gray = cvCreateImage(cvSize(256, 256), IPL_DEPTH_8U, 1);
+	for (int y=0; y<256; y++) {
+		unsigned char *p = (unsigned char*)(bgr->imageData + y*bgr->widthStep);
+		for (int x=0; x<256; x++) {
+			p[3*x] = (unsigned char)x;
+			p[3*x+1] = (unsigned char)y;
+			p[3*x+2] = (unsigned char)((x*7 + y*13) & 0xFF);
+		}
+	}
+	cvCvtColor(bgr, gray, CV_BGR2GRAY);
+
+	bool matches = true;
+	for (int y=0; (y<256) && matches; y++) {
+		const unsigned char *p = (const unsigned char*)(bgr->imageData + y*bgr->widthStep);
+		const unsigned char *q = (const unsigned char*)(gray->imageData + y*gray->widthStep);
+		for (int x=0; x<256; x++) {
+			if (Gray(p[3*x], p[3*x+1], p[3*x+2]) != q[x]) {
+				matches = false;
+				break;
+			}
+		}
+	}
+	cvReleaseImage(&bgr);
+	cvReleaseImage(&gray);
+	return matches;
+}
+
+void FusedMaskEvaluator::Begin(FrameContext *frameContext) {
+	context = frameContext;
+	nRegions = context->NumRegions();
+	tests.clear();
+	hueTests.clear();
+	grayTests.clear();
+	tableTests.clear();
+	bands.clear();
+}
+
+int FusedMaskEvaluator::AddTest(const PixelTest &test) {
+	int index = (int)tests.size();
+	tests.push_back(test);
+	if (test.type == PIXELTEST_HUE) hueTests.push_back(index);
+	else if (test.type == PIXELTEST_GRAY) grayTests.push_back(index);
+	else tableTests.push_back(index);
+	return index;
+}
+
+void FusedMaskEvaluator::Prepare(int bandsPerRegion) {
+	while ((int)masks.size() < (int)tests.size()*nRegions) {
+		masks.push_back(new BitMask());
+	}
+	for (int t=0; t<(int)tests.size(); t++) {
+		for (int r=0; r<nRegions; r++) {
+			CvRect region = context->GetRegion(r);
+			masks[t*nRegions + r]->Create(region.width, region.height);
+		}
+	}
+
+	// bands are whole rows, so no two of them write the same word of a mask
+	bands.clear();
+	for (int r=0; r<nRegions; r++) {
+		int height = context->GetRegion(r).height;
+		int rows = (height + bandsPerRegion-1)/bandsPerRegion;
+		for (int y=0; y<height; y+=rows) {
+			Band band = { r, y, min(y+rows, height) };
+			bands.push_back(band);
+		}
+	}
+	if (scratch.size() < bands.size()) scratch.resize(bands.size());
+	for (int b=0; b<(int)bands.size(); b++) {
+		scratch[b].bits.resize(tests.size());
+		scratch[b].rows.resize(tests.size());
+	}
+}
+
+void FusedMaskEvaluator::ApplyBand(int bandIndex) {
+	const Band &band = bands[bandIndex];
+	CvRect region = context->GetRegion(band.region);
+	IplImage *frame = context->GetFrame();
+	int nTests = (int)tests.size();
+	int nHue = (int)hueTests.size(), nGray = (int)grayTests.size(), nTable = (int)tableTests.size();
+	vector<unsigned int> &bits = scratch[bandIndex].bits;
+	vector<unsigned int*> &rows = scratch[bandIndex].rows;
+
+	for (int y=band.y0; y<band.y1; y++) {
+		const unsigned char *p = (const unsigned char*)(frame->imageData + (region.y+y)*frame->widthStep) + 3*region.x;
+		for (int t=0; t<nTests; t++) rows[t] = masks[t*nRegions + band.region]->GetRow(y);
+
+		for (int x0=0; x0<region.width; x0+=32) {
+			// a word of each mask at a time, so each is only written once
+			int x1 = min(x0+32, region.width);
+			for (int t=0; t<nTests; t++) bits[t] = 0;
+			for (int x=x0; x<x1; x++, p+=3) {
+				int b = p[0], g = p[1], r = p[2];
+				int bit = x-x0;
+				if (nHue > 0) {
+					// the hue is only worked out if some test finds the pixel saturated enough
+					int v = max(b, max(g, r));
+					int diff = v - min(b, min(g, r));
+					int h = -1;
+					for (int i=0; i<nHue; i++) {
+						const PixelTest &test = tests[hueTests[i]];
+						if (diff < test.minDiff[v]) continue;
+						if (h < 0) h = ColorMaskKernel::Hue(b, g, r, v, diff);
+						bits[hueTests[i]] |= (unsigned int)test.pass[h] << bit;
+					}
+				}
+				if (nGray > 0) {
+					int level = Gray(b, g, r);
+					for (int i=0; i<nGray; i++) {
+						bits[grayTests[i]] |= (unsigned int)tests[grayTests[i]].pass[level] << bit;
+					}
+				}
+				if (nTable > 0) {
+					int cell = ColorLutClassifier::Cell(b, g, r);
+					for (int i=0; i<nTable; i++) {
+						const PixelTest &test = tests[tableTests[i]];
+						bits[tableTests[i]] |= (unsigned int)(test.table[cell] > test.thresh) << bit;
+					}
+				}
+			}
+			for (int t=0; t<nTests; t++) rows[t][x0/32] = bits[t];
+		}
+	}
+}
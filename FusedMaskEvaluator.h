@@ -0,0 +1,79 @@
+#pragma once
+#include "BitMask.h"
+#include "FrameContext.h"
+
+// the kinds of per-pixel test a FusedMaskEvaluator knows
+typedef enum {
+	PIXELTEST_HUE = 0,	// ColorMaskKernel's: saturated and bright enough, with a hue that passes
+	PIXELTEST_GRAY,		// a gray level that passes
+	PIXELTEST_TABLE		// a ColorLutClassifier cell that is above the threshold
+} PixelTestType;
+
+// How a recognizer that decides each pixel on its own, from nothing but its color, picks out
+// the pixels of its mask.  The tables belong to the recognizer and must stay put while it is
+// being evaluated.
+struct PixelTest {
+	PixelTestType type;
+	const unsigned char *pass;	// hue and gray tests: 1 for each hue (0..179) or gray level that passes
+	const short *minDiff;		// hue tests: the least max-min spread saturated enough at each value
+	const unsigned char *table;	// table tests: the cell values, which pass above thresh
+	int thresh;
+};
+
+// Works out the first masks of several pixel-wise recognizers (color, color table, brightness)
+// in one pass over a frame: each pixel is read and converted to hue and gray once, and then
+// tested against every recognizer's tables, writing all of their packed masks at once.  The
+// recognizers then close the masks and trace their contours as usual (see
+// Classifier::ClassifyPixelMasks), so they find exactly what they would on their own.
+//
+// The regions are split into bands of rows, which can be evaluated on different threads at once.
+class FusedMaskEvaluator
+{
+public:
+	FusedMaskEvaluator();
+	~FusedMaskEvaluator();
+
+	// whether our BGR to gray conversion gives the same levels as cvCvtColor
+	static bool GrayMatchesOpenCV();
+
+	// the gray level of a pixel, with OpenCV's fixed point weights
+	static inline int Gray(int b, int g, int r) {
+		return (b*1868 + g*9617 + r*4899 + (1 << 13)) >> 14;
+	}
+
+	// starts over with no tests, on the regions of a frame or pyramid level
+	void Begin(FrameContext *context);
+	int AddTest(const PixelTest &test);		// returns the test's index
+	int NumTests() { return (int)tests.size(); }
+
+	// allocates the masks and splits each region into bandsPerRegion bands of rows
+	void Prepare(int bandsPerRegion);
+	int NumBands() { return (int)bands.size(); }
+	void ApplyBand(int band);
+
+	// the masks of a test, one for each region of the context (at the size of the region)
+	BitMask** GetMasks(int test) { return &masks[test*nRegions]; }
+
+private:
+	FusedMaskEvaluator(const FusedMaskEvaluator&);
+	void operator=(const FusedMaskEvaluator&);
+	static bool CheckGray();
+
+	struct Band {
+		int region, y0, y1;
+	};
+
+	// the mask words being built and the mask rows being written by one band
+	struct BandScratch {
+		vector<unsigned int> bits;
+		vector<unsigned int*> rows;
+	};
+
+	FrameContext *context;
+	int nRegions;
+	vector<PixelTest> tests;
+	vector<int> hueTests, grayTests, tableTests;	// indices of the tests of each kind
+	vector<BitMask*> masks;		// nRegions for each test, kept from frame to frame
+	vector<Band> bands;
+	vector<BandScratch> scratch;	// one for each band, kept from frame to frame
+};
@@ -89,7 +89,10 @@ void FlowTracker::ProcessFrame() {
         cvFlip(currentFrame,copyFrame);
     }
 
-	cvCopy(grcurrentFrame, grlastFrame);
+	// last frame's grayscale image becomes the previous one, and its buffer takes the new frame
+	IplImage *swap = grlastFrame;
+	grlastFrame = grcurrentFrame;
+	grcurrentFrame = swap;
 	cvConvertImage(copyFrame, grcurrentFrame);
 
 	// Pick out the good features in the image
@@ -136,7 +136,7 @@ Result Recognizer::BackRecognize(vector<OneDollarPoint> points) {
 
 	reverse(points.begin(), points.end());
 	double maxScore = 0;
-	int maxLength = min(points.size(), GESTURE_MAX_TRAJECTORY_LENGTH);
+	int maxLength = min((int)points.size(), GESTURE_MAX_TRAJECTORY_LENGTH);
 	for (int npts=GESTURE_MIN_TRAJECTORY_LENGTH; npts<maxLength; npts += GESTURE_BACKREC_STEPSIZE) {
 		vector<OneDollarPoint> sublist;
 		for (int pi=0; pi<npts; pi++) {
@@ -54,8 +54,11 @@ void SimpleFlowTracker::ProcessFrame(IplImage *frame) {
 		StartTracking(frame);
 	}
 
+	// outputFrame is drawn on, so it needs a copy; the grayscale buffers just swap roles
 	cvCopy(frame, outputFrame);
-	cvCopy(grcurrentFrame, grlastFrame);
+	IplImage *swap = grlastFrame;
+	grlastFrame = grcurrentFrame;
+	grcurrentFrame = swap;
 	cvConvertImage(frame, grcurrentFrame);
 
 	// Pick out the good features in the image
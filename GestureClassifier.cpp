@@ -75,7 +75,7 @@ void GestureClassifier::StartTraining(TrainingSet *sampleSet) {
 			char tname[MAX_PATH];
 			sprintf(tname, "Gesture %d", tNum);
 			rec.AddTemplate(tname, sample->motionTrack);
-            maxTemplateLength = max(maxTemplateLength, sample->motionTrack.size());
+            maxTemplateLength = max(maxTemplateLength, (int)sample->motionTrack.size());
 			tNum++;
 		}
     }
@@ -94,6 +94,12 @@ BOOL GestureClassifier::ContainsSufficientSamples(TrainingSet *sampleSet) {
     return (sampleSet->rangeSampleCount > 0);
 }
 
+Classifier* GestureClassifier::CreateStreamInstance() {
+	GestureClassifier *instance = new GestureClassifier();
+	instance->InitStreamInstance(this);
+	return instance;
+}
+
 ClassifierOutputData GestureClassifier::ClassifyFrame(IplImage *frame) {
     // not implemented: this class uses ClassifyTrack instead
     assert(false);
@@ -103,28 +109,30 @@ ClassifierOutputData GestureClassifier::ClassifyFrame(IplImage *frame) {
 
 ClassifierOutputData GestureClassifier::ClassifyTrack(MotionTrack mt) {
 	cvZero(guessMask);
-	outputData.SetVariable("IsMatch", 0);
+	outputData.SetVariable(CVAR_ID_ISMATCH, 0);
 	if (!isTrained) return outputData;
 	if (mt.size() < GESTURE_MIN_TRAJECTORY_LENGTH) return outputData;
 
     // don't start all the way at the beginning of the track if it's really long
-    int startFrame = max(0, mt.size()-GESTURE_MAX_TRAJECTORY_LENGTH);
+    int startFrame = max(0, (int)mt.size()-GESTURE_MAX_TRAJECTORY_LENGTH);
 
     cvZero(applyImage);
 
-	Result r = rec.BackRecognize(mt);
+	Recognizer &modelRec = GetModel()->rec;
+	Result r = modelRec.BackRecognize(mt);
 
 	if (r.m_score > threshold) {
-		outputData.SetVariable("IsMatch", 1);
+		outputData.SetVariable(CVAR_ID_ISMATCH, 1);
 
 		// fill up the mask image
 		cvSet(guessMask, cvScalar(0xFF));
 
-		// add a variable for the detected gesture number
-		outputData.SetVariable("Gesture", r.m_index);
+		// add a variable for the detected gesture number (IsMatch is always set, since the filter
+		// chain clears the trajectory when it sees a match)
+		if (IsOutputNeeded(CVAR_ID_GESTURE)) outputData.SetVariable(CVAR_ID_GESTURE, r.m_index);
 
 		// draw the recognized gesture in the apply image
-		DrawTrack(applyImage, rec.m_templates[r.m_index].m_points, colorSwatch[r.m_index % COLOR_SWATCH_SIZE], 3, GESTURE_SQUARE_SIZE);
+		DrawTrack(applyImage, modelRec.m_templates[r.m_index].m_points, colorSwatch[r.m_index % COLOR_SWATCH_SIZE], 3, GESTURE_SQUARE_SIZE);
 
 		// print the name of the recognized gesture
 		CvFont font;
@@ -15,9 +15,14 @@ public:
     ClassifierOutputData ClassifyTrack(MotionTrack mt);
     void Save();
 	void ResetRunningState() {}		// This classifier doesn't have store any new state info while running live
+	Classifier* CreateStreamInstance();
 
 private:
 	void UpdateTrajectoryImage();
+
+	// the classifier holding the gesture templates (this one, unless we are a stream instance)
+	GestureClassifier* GetModel() { return sharedModel ? (GestureClassifier*)sharedModel : this; }
+
 	Recognizer rec;
 
     int nTemplates;
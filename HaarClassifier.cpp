@@ -7,6 +7,7 @@
 #include "Classifier.h"
 #include "HaarClassifier.h"
 
+#ifndef EYEPATCH_HEADLESS
 HaarClassifierDialog::HaarClassifierDialog(HaarClassifier *p) {
 	parent = p;
 	m_hThread = NULL;
@@ -48,14 +49,19 @@ void HaarClassifierDialog::Train() {
 		GetDlgItem(IDC_HAAR_PROGRESS), &(parent->nStagesCompleted));
 	::EndDialog(m_hWnd, IDOK);
 }
+#endif
 
 
 HaarClassifier::HaarClassifier() :
-	Classifier(),
-	m_progressDlg(this) {
+	Classifier()
+#ifndef EYEPATCH_HEADLESS
+	, m_progressDlg(this)
+#endif
+{
     cascade = NULL;
     nStages = START_HAAR_STAGES;
     storage = cvCreateMemStorage(0);
+    frameCopy = newMask = NULL;
 	nPosSamples = 0;
 	nNegSamples = 0;
 	nStagesCompleted = 0;
@@ -63,19 +69,24 @@ HaarClassifier::HaarClassifier() :
     // set the default "friendly name" and type
     wcscpy(friendlyName, L"Adaboost Recognizer");
     classifierType = ADABOOST_FILTER;        
+    workingWidth = HAAR_WORKING_WIDTH;
 
     // append identifier to directory name
     wcscat(directoryName, FILE_HAAR_SUFFIX);
 }
 
 HaarClassifier::HaarClassifier(LPCWSTR pathname) :
-	Classifier(pathname),
-	m_progressDlg(this) {
+	Classifier(pathname)
+#ifndef EYEPATCH_HEADLESS
+	, m_progressDlg(this)
+#endif
+{
 
 	USES_CONVERSION;
     cascade = NULL;
     nStages = START_HAAR_STAGES;
     storage = cvCreateMemStorage(0);
+    frameCopy = newMask = NULL;
 	nPosSamples = 0;
 	nNegSamples = 0;
 	nStagesCompleted = 0;
@@ -93,10 +104,13 @@ HaarClassifier::HaarClassifier(LPCWSTR pathname) :
 
 	// set the type
     classifierType = ADABOOST_FILTER;
+    workingWidth = HAAR_WORKING_WIDTH;
 }
 
 HaarClassifier::~HaarClassifier() {
     cvReleaseMemStorage(&storage);
+    cvReleaseImage(&frameCopy);
+    cvReleaseImage(&newMask);
     if (isTrained) cvReleaseHaarClassifierCascade(&cascade);
 }
 
@@ -104,6 +118,7 @@ BOOL HaarClassifier::ContainsSufficientSamples(TrainingSet *sampleSet) {
     return ((sampleSet->posSampleCount > 3) && (sampleSet->negSampleCount > 3));
 }
 
+#ifndef EYEPATCH_HEADLESS
 void HaarClassifier::PrepareData(TrainingSet *sampleSet) {
 
     int gridSize = (int) ceil(sqrt((double)sampleSet->posSampleCount));
@@ -199,46 +214,78 @@ void HaarClassifier::StartTraining(TrainingSet* sampleSet) {
 	PrepareData(sampleSet);
 	m_progressDlg.DoModal();
 }
+#else
+void HaarClassifier::PrepareData(TrainingSet *sampleSet) {
+	// cascade training relies on the Win32 haartraining code, so headless builds can only load trained cascades
+}
+
+void HaarClassifier::StartTraining(TrainingSet* sampleSet) {
+	sampleSet->CopyTo(&trainSet);
+}
+#endif
+
+Classifier* HaarClassifier::CreateStreamInstance() {
+	if (!isTrained || !isOnDisk) return NULL;
+	HaarClassifier *instance = new HaarClassifier(directoryName);
+	instance->InitStreamInstance(this);
+	return instance;
+}
 
 ClassifierOutputData HaarClassifier::ClassifyFrame(IplImage *frame) {
+	frameContext.SetFrame(frame);
+	return ClassifyFrame(&frameContext);
+}
+
+ClassifierOutputData HaarClassifier::ClassifyFrame(FrameContext *context) {
 	cvZero(guessMask);
 	if (!isTrained) return outputData;
     if (!cascade) return outputData;
+	IplImage *frame = context->GetFrame();
+	if (!frame) return outputData;
 
-    IplImage *newMask = cvCreateImage(cvGetSize(frame), IPL_DEPTH_8U, 1);
+    EnsureImage(&newMask, cvGetSize(frame), IPL_DEPTH_8U, 1);
     cvZero(newMask);
 
-    // Clear the memory storage we used before
-    cvClearMemStorage( storage );
-
-    // There can be more than one object in an image, so we create a growable sequence of objects
-    // Detect the objects and store them in the sequence
-    CvSeq* objects = cvHaarDetectObjects(frame, cascade, storage,
-                                         1.1, (int)(1+threshold*4), CV_HAAR_DO_CANNY_PRUNING,
-                                         cvSize(HAAR_SAMPLE_X, HAAR_SAMPLE_Y));
-
-    IplImage *frameCopy = cvCreateImage(cvSize(frame->width,frame->height), IPL_DEPTH_8U, 3);
+    EnsureImage(&frameCopy, cvSize(frame->width,frame->height), IPL_DEPTH_8U, 3);
     cvCopy(frame, frameCopy);
 
     int objNum = 0;
-    // Loop over the found objects
-    for(int i = 0; i < (objects ? objects->total : 0); i++ )
-    {
-        CvRect* r = (CvRect*)cvGetSeqElem(objects, i);
-        cvRectangle(frameCopy, cvPoint(r->x,r->y), cvPoint(r->x+r->width,r->y+r->height), colorSwatch[objNum], 2, 8);
-        objNum = (objNum + 1) % COLOR_SWATCH_SIZE;
-
-        // draw rectangle in mask image
-        cvRectangle(newMask, cvPoint(r->x, r->y), cvPoint(r->x+r->width, r->y+r->height), cvScalar(0xFF), CV_FILLED, 8);
-    }
+	for (int reg=0; reg<context->NumRegions(); reg++) {
+		CvRect region = context->GetRegion(reg);
+
+		// a region smaller than the detection window can't contain an object
+		if ((region.width < HAAR_SAMPLE_X) || (region.height < HAAR_SAMPLE_Y)) continue;
+
+	    // Clear the memory storage we used before
+	    cvClearMemStorage( storage );
+
+	    // There can be more than one object in an image, so we create a growable sequence of objects
+	    // Detect the objects and store them in the sequence
+		CvMat frameRegion;
+		cvGetSubRect(frame, &frameRegion, region);
+	    CvSeq* objects = cvHaarDetectObjects(&frameRegion, cascade, storage,
+	                                         1.1, (int)(1+threshold*4), CV_HAAR_DO_CANNY_PRUNING,
+	                                         cvSize(HAAR_SAMPLE_X, HAAR_SAMPLE_Y));
+
+	    // Loop over the found objects
+	    for(int i = 0; i < (objects ? objects->total : 0); i++ )
+	    {
+	        CvRect* r = (CvRect*)cvGetSeqElem(objects, i);
+			r->x += region.x;
+			r->y += region.y;
+	        cvRectangle(frameCopy, cvPoint(r->x,r->y), cvPoint(r->x+r->width,r->y+r->height), colorSwatch[objNum], 2, 8);
+	        objNum = (objNum + 1) % COLOR_SWATCH_SIZE;
+
+	        // draw rectangle in mask image
+	        cvRectangle(newMask, cvPoint(r->x, r->y), cvPoint(r->x+r->width, r->y+r->height), cvScalar(0xFF), CV_FILLED, 8);
+	    }
+	}
 
 	// copy the final output mask
     cvResize(newMask, guessMask);
 
     cvResize(frameCopy, applyImage);
     IplToBitmap(applyImage, applyBitmap);
-	cvReleaseImage(&newMask);
-	cvReleaseImage(&frameCopy);
 
 	UpdateStandardOutputData();
 	return outputData;
@@ -3,6 +3,7 @@
 
 class HaarClassifier;
 
+#ifndef EYEPATCH_HEADLESS
 class HaarClassifierDialog : public CSimpleDialog<IDD_HAAR_DIALOG> {
 public:
 	HaarClassifierDialog(HaarClassifier*);
@@ -25,6 +26,7 @@ private:
 	HANDLE m_hThread;
 
 };
+#endif
 
 class HaarClassifier : public Classifier {
 public:
@@ -35,9 +37,14 @@ public:
     BOOL ContainsSufficientSamples(TrainingSet*);
 	void StartTraining(TrainingSet*);
 	ClassifierOutputData ClassifyFrame(IplImage*);
+	ClassifierOutputData ClassifyFrame(FrameContext*);
     void Save();
 	void ResetRunningState() {}		// This classifier doesn't have store any new state info while running live
 
+	// cvHaarDetectObjects keeps its per-image state inside the cascade, so a stream instance
+	// loads its own copy of the saved cascade (NULL if this one hasn't been saved yet)
+	Classifier* CreateStreamInstance();
+
 	int nStages, nStagesCompleted;
 
 private:
@@ -46,6 +53,9 @@ private:
 	CvHaarClassifierCascade* cascade;
     CvMemStorage* storage;
 
+	// working images, kept between frames
+	IplImage *frameCopy, *newMask;
+
     int nPosSamples, nNegSamples;
 
     char vecFilename[MAX_PATH];
@@ -53,7 +63,9 @@ private:
     char classifierPathname[MAX_PATH];
     char classifierName[MAX_PATH];
 
+#ifndef EYEPATCH_HEADLESS
 	friend class HaarClassifierDialog;
 	HaarClassifierDialog m_progressDlg;
+#endif
 
 };
@@ -0,0 +1,303 @@
+#include "precomp.h"
+#include "constants.h"
+#include "TrainingSample.h"
+#include "TrainingSet.h"
+#include "Classifier.h"
+#include "OutputSink.h"
+#include "HeadlessRunner.h"
+
+HeadlessRunner::HeadlessRunner() {
+    videoCapture = NULL;
+	maxFrames = 0;
+	videoX = 0;
+	videoY = 0;
+	fps = 0;
+	framesAvailable = 0;
+	runningLive = false;
+	nFrames = 0;
+	elapsedSeconds = 0;
+	processingVideo = false;
+	stopRequested = false;
+	pipelineDepth = 0;
+	latestFrameOnly = false;
+	freeQueue = NULL;
+	captureQueue = NULL;
+	outputQueue = NULL;
+	firstFrameTime = 0;
+
+	// nothing shows the chain's output frame, so there's no need to trace contours to outline it
+	filterChain.drawContours = false;
+}
+
+HeadlessRunner::~HeadlessRunner() {
+	StopProcessing();
+    if (videoCapture != NULL) cvReleaseCapture(&videoCapture);
+	delete freeQueue;
+	delete captureQueue;
+	delete outputQueue;
+}
+
+void HeadlessRunner::OpenCapture(CvCapture *capture, bool isLive) {
+    if (videoCapture != NULL) cvReleaseCapture(&videoCapture);
+	videoCapture = capture;
+	runningLive = isLive;
+    if (videoCapture == NULL) return;
+
+    // get video capture properties
+    videoX = (int) cvGetCaptureProperty(videoCapture, CV_CAP_PROP_FRAME_WIDTH);
+    videoY = (int) cvGetCaptureProperty(videoCapture, CV_CAP_PROP_FRAME_HEIGHT);
+    fps = cvGetCaptureProperty(videoCapture, CV_CAP_PROP_FPS);
+	framesAvailable = runningLive ? 0 : (long) cvGetCaptureProperty(videoCapture, CV_CAP_PROP_FRAME_COUNT);
+}
+
+bool HeadlessRunner::OpenCamera(int cameraIndex) {
+	OpenCapture(cvCreateCameraCapture(cameraIndex), true);
+	filterChain.videoId = 0;
+	return (videoCapture != NULL);
+}
+
+bool HeadlessRunner::OpenFile(const char *filename) {
+	OpenCapture(cvCreateFileCapture(filename), false);
+	filterChain.videoId = ResultCache::IdentifyFile(filename);
+	return (videoCapture != NULL);
+}
+
+bool HeadlessRunner::StartProcessing() {
+	if (processingVideo || (videoCapture == NULL)) return false;
+
+	// some capture backends only report the frame size once the first frame is decoded
+	firstFrameTime = GetTimeMs();
+    IplImage *firstFrame = cvQueryFrame(videoCapture);
+	if (firstFrame == NULL) return false;
+	videoX = firstFrame->width;
+	videoY = firstFrame->height;
+
+	// create the filter chain's images
+	filterChain.StartProcessing(videoX, videoY);
+	filterChain.metrics.Reset();
+
+	nFrames = 1;
+	stopRequested = false;
+	processingVideo = true;
+
+	// process the frame we just grabbed before starting the thread, so the capture is only read there afterwards
+	frameView.Attach(firstFrame);
+
+	startTime = std::chrono::steady_clock::now();
+	if (runningLive && latestFrameOnly) {
+		// the capture thread overwrites the first frame's buffer straight away, so we start from
+		// whatever it grabs next
+		nFrames = 0;
+		liveCapture.Start(videoCapture);
+		m_thread = std::thread(&HeadlessRunner::ProcessLatestFrames, this);
+	} else if (pipelineDepth > 0) {
+		StartPipeline();
+	} else {
+	    // Start processing thread
+		m_thread = std::thread(ThreadCallback, this);
+	}
+	return true;
+}
+
+void HeadlessRunner::StopProcessing() {
+	stopRequested = true;
+	liveCapture.Stop();		// wakes the processing thread if it's waiting for a frame
+	WaitForCompletion();
+}
+
+void HeadlessRunner::WaitForCompletion() {
+	if (m_thread.joinable()) {
+		m_thread.join();
+	}
+	liveCapture.Stop();
+	StopPipeline();
+	if (filterChain.isProcessing) {
+		filterChain.StopProcessing();
+	}
+}
+
+bool HeadlessRunner::IsProcessing() {
+	return processingVideo;
+}
+
+void HeadlessRunner::ThreadCallback(HeadlessRunner *instance) {
+	instance->ProcessFrames();
+}
+
+IplImage* HeadlessRunner::QueryFrame(long framesGrabbed) {
+	if ((maxFrames > 0) && (framesGrabbed >= maxFrames)) return NULL;
+	if (!runningLive && (framesAvailable > 0) && (framesGrabbed >= framesAvailable)) return NULL;
+
+    // Grab next frame (NULL when we are all out of video frames)
+	double start = GetTimeMs();
+	IplImage *currentFrame = cvQueryFrame(videoCapture);
+	if (currentFrame != NULL) filterChain.metrics.Record(STAGE_CAPTURE, GetTimeMs()-start);
+	return currentFrame;
+}
+
+bool HeadlessRunner::GrabFrame(IplImage *dst, long framesGrabbed) {
+	// the pipeline's packets outlive the capture buffer, so they need a copy of their own
+	IplImage *currentFrame = QueryFrame(framesGrabbed);
+	if (currentFrame == NULL) return false;
+	double grabbed = GetTimeMs();
+	if (currentFrame->origin == IPL_ORIGIN_TL) {
+		cvCopy(currentFrame, dst);
+	} else {
+		cvFlip(currentFrame, dst);
+	}
+	filterChain.metrics.Record(STAGE_COPY, GetTimeMs()-grabbed);
+	return true;
+}
+
+void HeadlessRunner::ProcessFrames() {
+	double frameStart = firstFrameTime;
+	while (!stopRequested) {
+	    // some outputs run on the original (unfiltered) frame
+		filterChain.ProcessInput(frameView.Get());
+
+	    // Now apply filter chain to frame; only CASCADE mode writes to it, so only then
+		// does it need a copy of the capture buffer
+		IplImage *frame = (filterChain.filterCombineMode == IDC_COMBINE_CASCADE) ? frameView.GetWritable() : frameView.Get();
+		filterChain.ApplyFilterChain(frame, nFrames);
+		filterChain.metrics.Record(STAGE_FRAME, GetTimeMs()-frameStart);
+
+		frameStart = GetTimeMs();
+		IplImage *currentFrame = QueryFrame(nFrames);
+		if (currentFrame == NULL) break;
+		double grabbed = GetTimeMs();
+		frameView.Attach(currentFrame);
+		filterChain.metrics.Record(STAGE_COPY, GetTimeMs()-grabbed);
+		nFrames++;
+	}
+
+	elapsedSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+	processingVideo = false;
+}
+
+void HeadlessRunner::ProcessLatestFrames() {
+	while (!stopRequested) {
+		if ((maxFrames > 0) && (nFrames >= maxFrames)) break;
+		IplImage *frame = liveCapture.TakeLatest();
+		if (frame == NULL) break;
+		filterChain.metrics.CountDroppedFrames(liveCapture.GetLastDropped());
+		filterChain.metrics.Record(STAGE_CAPTURE, liveCapture.GetLastGrabMs());
+		filterChain.metrics.Record(STAGE_COPY, liveCapture.GetLastCopyMs());
+
+	    // some outputs run on the original (unfiltered) frame
+		filterChain.ProcessInput(frame);
+
+		// the frame is ours until we take the next one, so CASCADE mode can write to it; frames
+		// are numbered as they were grabbed, so motion history still sees the time between them
+		filterChain.ApplyFilterChain(frame, liveCapture.GetLastSequence());
+		filterChain.metrics.Record(STAGE_FRAME, GetTimeMs()-liveCapture.GetLastCaptureTime());
+		nFrames++;
+	}
+
+	elapsedSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+	processingVideo = false;
+}
+
+void HeadlessRunner::StartPipeline() {
+	// enough packets to fill both queues with one more in each stage, all waiting in the free queue
+	int nPackets = 2*pipelineDepth + 3;
+	delete freeQueue;
+	delete captureQueue;
+	delete outputQueue;
+	freeQueue = new RingBuffer<FramePacket*>(nPackets);
+	captureQueue = new RingBuffer<FramePacket*>(pipelineDepth);
+	outputQueue = new RingBuffer<FramePacket*>(pipelineDepth);
+	for (int i=0; i<nPackets; i++) {
+		FramePacket *packet = new FramePacket();
+		packet->frameNum = 0;
+		packet->captureTime = 0;
+		packet->frame = cvCreateImage(cvSize(videoX,videoY), IPL_DEPTH_8U, 3);
+		packet->inputFrame = cvCreateImage(cvSize(videoX,videoY), IPL_DEPTH_8U, 3);
+		packets.push_back(packet);
+		freeQueue->Push(packet);
+	}
+	nFrames = 0;
+
+	m_captureThread = std::thread(&HeadlessRunner::CaptureStage, this);
+	m_thread = std::thread(&HeadlessRunner::ClassifyStage, this);
+	m_outputThread = std::thread(&HeadlessRunner::OutputStage, this);
+}
+
+void HeadlessRunner::StopPipeline() {
+	if (m_captureThread.joinable()) m_captureThread.join();
+	if (m_outputThread.joinable()) m_outputThread.join();
+	for (int i=0; i<(int)packets.size(); i++) {
+		cvReleaseImage(&packets[i]->frame);
+		cvReleaseImage(&packets[i]->inputFrame);
+		delete packets[i];
+	}
+	packets.clear();
+}
+
+void HeadlessRunner::CaptureStage() {
+	// the first frame was already grabbed by StartProcessing
+	long frameNum = 1;
+	FramePacket *packet = freeQueue->Pop();
+	cvCopy(frameView.Get(), packet->frame);
+	packet->captureTime = firstFrameTime;
+
+	while (true) {
+		packet->frameNum = frameNum++;
+		captureQueue->Push(packet);
+		if (stopRequested) break;
+
+		// if there are no more frames the packet just drops out of circulation (StopPipeline frees it)
+		packet = freeQueue->Pop();
+		packet->captureTime = GetTimeMs();
+		if (!GrabFrame(packet->frame, frameNum-1)) break;
+	}
+
+	// tell the next stage that there are no more frames
+	captureQueue->Push(NULL);
+}
+
+void HeadlessRunner::ClassifyStage() {
+	while (true) {
+		FramePacket *packet = captureQueue->Pop();
+		if (packet == NULL) break;
+
+		// CASCADE mode blacks out parts of the frame, but the outputs should still see the original
+		if (filterChain.filterCombineMode == IDC_COMBINE_CASCADE) {
+			cvCopy(packet->frame, packet->inputFrame);
+		}
+		packet->results.Clear();
+		filterChain.ApplyFilterChain(packet->frame, packet->frameNum, &packet->results);
+		outputQueue->Push(packet);
+	}
+	outputQueue->Push(NULL);
+}
+
+void HeadlessRunner::OutputStage() {
+	while (true) {
+		FramePacket *packet = outputQueue->Pop();
+		if (packet == NULL) break;
+
+		IplImage *inputFrame = (filterChain.filterCombineMode == IDC_COMBINE_CASCADE) ? packet->inputFrame : packet->frame;
+		filterChain.ProcessInput(inputFrame);
+		filterChain.SendResults(packet->frame, &packet->results);
+		nFrames++;
+
+		// from the grab to the last output, including the time spent waiting in the queues
+		filterChain.metrics.Record(STAGE_FRAME, GetTimeMs()-packet->captureTime);
+		freeQueue->Push(packet);
+	}
+
+	elapsedSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+	processingVideo = false;
+}
+
+RingBufferStats HeadlessRunner::GetCaptureQueueStats() {
+	if (captureQueue != NULL) return captureQueue->GetStats();
+	RingBufferStats stats = RingBufferStats();
+	return stats;
+}
+
+RingBufferStats HeadlessRunner::GetOutputQueueStats() {
+	if (outputQueue != NULL) return outputQueue->GetStats();
+	RingBufferStats stats = RingBufferStats();
+	return stats;
+}
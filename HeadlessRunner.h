@@ -0,0 +1,96 @@
+#pragma once
+#include <thread>
+#include <atomic>
+#include "FilterChain.h"
+#include "RingBuffer.h"
+#include "FrameView.h"
+#include "LiveCapture.h"
+
+// Runs a filter chain over a camera or video file on its own thread, without any
+// window or bitmap output.  This is the headless counterpart of CVideoRunner.
+//
+// With pipelineDepth > 0 the work is split into three stages on their own threads:
+// capture (decode and flip), classification (the filter chain) and output (the output
+// sinks), connected by ring buffers of that length.  Frames then come out at the rate
+// of the slowest stage instead of the sum of all three.
+//
+// With latestFrameOnly set, a camera is instead read on its own thread as fast as it delivers
+// frames, and each frame is classified and sent as soon as the last one is done, dropping any
+// that arrived in between (see LiveCapture).  That keeps the latency to about one frame however
+// slow the chain is.  Recorded video is always processed frame by frame.
+class HeadlessRunner
+{
+public:
+	HeadlessRunner();
+	~HeadlessRunner();
+
+	bool OpenCamera(int cameraIndex);
+	bool OpenFile(const char *filename);
+
+    bool StartProcessing();
+    void StopProcessing();
+	void WaitForCompletion();
+	bool IsProcessing();
+
+	// the classifiers, outputs and combine mode applied to each frame
+	FilterChain filterChain;
+
+	// stop after this many frames (0 means run until the video ends or we are stopped)
+	long maxFrames;
+
+	// length of the queues between the pipeline stages (0 runs every stage on one thread)
+	int pipelineDepth;
+
+	// process only the newest camera frame (takes precedence over pipelineDepth for cameras)
+	bool latestFrameOnly;
+
+	// occupancy of the capture->classify and classify->output queues
+	RingBufferStats GetCaptureQueueStats();
+	RingBufferStats GetOutputQueueStats();
+
+	int videoX, videoY;
+	double fps;
+	long framesAvailable;
+	bool runningLive;
+
+	std::atomic<long> nFrames;
+
+	// wall clock time spent in the processing loop
+	double elapsedSeconds;
+
+private:
+	// a frame on its way through the pipeline, along with the results it produced
+	struct FramePacket {
+		long frameNum;
+		double captureTime;		// when we started grabbing it
+		IplImage *frame;		// the captured frame, flipped upright
+		IplImage *inputFrame;	// unfiltered copy for the outputs, since CASCADE mode changes frame
+		FrameResults results;
+	};
+
+	static void ThreadCallback(HeadlessRunner*);
+	void ProcessFrames();
+	void ProcessLatestFrames();
+	void OpenCapture(CvCapture *capture, bool isLive);
+	IplImage* QueryFrame(long framesGrabbed);
+	bool GrabFrame(IplImage *dst, long framesGrabbed);
+
+	void StartPipeline();
+	void StopPipeline();
+	void CaptureStage();
+	void ClassifyStage();
+	void OutputStage();
+
+    CvCapture *videoCapture;
+	FrameView frameView;		// the frame being processed, read in place from the capture where possible
+	LiveCapture liveCapture;
+
+	std::thread m_thread, m_captureThread, m_outputThread;
+	std::chrono::steady_clock::time_point startTime;
+	double firstFrameTime;
+
+	vector<FramePacket*> packets;
+	RingBuffer<FramePacket*> *freeQueue, *captureQueue, *outputQueue;
+	std::atomic<bool> processingVideo;
+	std::atomic<bool> stopRequested;
+};
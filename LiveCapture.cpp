@@ -0,0 +1,144 @@
+#include "precomp.h"
+#include "LiveCapture.h"
+
+LiveCapture::LiveCapture() {
+	capture = NULL;
+	takenSequence = lastDropped = framesDropped = 0;
+	lastCaptureTime = lastGrabMs = lastCopyMs = 0;
+	running = false;
+	stopping = false;
+	ended = false;
+	for (int i=0; i<3; i++) {
+		frames.GetBuffer(i).image = NULL;
+		frames.GetBuffer(i).sequence = 0;
+		frames.GetBuffer(i).captureTime = 0;
+		frames.GetBuffer(i).grabMs = frames.GetBuffer(i).copyMs = 0;
+	}
+#ifdef EYEPATCH_HEADLESS
+	signalled = false;
+#else
+	m_hThread = NULL;
+	m_hFrameEvent = CreateEvent(NULL, FALSE, FALSE, NULL);
+#endif
+}
+
+LiveCapture::~LiveCapture() {
+	Stop();
+	for (int i=0; i<3; i++) {
+		if (frames.GetBuffer(i).image != NULL) cvReleaseImage(&frames.GetBuffer(i).image);
+	}
+#ifndef EYEPATCH_HEADLESS
+	CloseHandle(m_hFrameEvent);
+#endif
+}
+
+void LiveCapture::Start(CvCapture *newCapture) {
+	Stop();
+	capture = newCapture;
+	frames.Reset();
+	takenSequence = lastDropped = framesDropped = 0;
+	lastCaptureTime = lastGrabMs = lastCopyMs = 0;
+	stopping = false;
+	ended = false;
+	running = true;
+#ifdef EYEPATCH_HEADLESS
+	signalled = false;
+	m_thread = std::thread(&LiveCapture::CaptureLoop, this);
+#else
+	ResetEvent(m_hFrameEvent);
+	DWORD threadID;
+	m_hThread = CreateThread(NULL, 0, ThreadCallback, (LPVOID)this, 0, &threadID);
+#endif
+}
+
+void LiveCapture::Stop() {
+	if (!running) return;
+	stopping = true;
+	Signal();
+#ifdef EYEPATCH_HEADLESS
+	m_thread.join();
+#else
+	WaitForSingleObject(m_hThread, INFINITE);
+	CloseHandle(m_hThread);
+	m_hThread = NULL;
+#endif
+	running = false;
+}
+
+bool LiveCapture::IsRunning() {
+	return running;
+}
+
+#ifndef EYEPATCH_HEADLESS
+DWORD WINAPI LiveCapture::ThreadCallback(LPVOID param) {
+	((LiveCapture*)param)->CaptureLoop();
+	return 0;
+}
+#endif
+
+void LiveCapture::Signal() {
+#ifdef EYEPATCH_HEADLESS
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		signalled = true;
+	}
+	m_frameCondition.notify_one();
+#else
+	SetEvent(m_hFrameEvent);
+#endif
+}
+
+void LiveCapture::WaitForSignal() {
+	// like an auto-reset event: a signal given while nobody was waiting still ends the next wait
+#ifdef EYEPATCH_HEADLESS
+	std::unique_lock<std::mutex> lock(m_mutex);
+	while (!signalled) m_frameCondition.wait(lock);
+	signalled = false;
+#else
+	WaitForSingleObject(m_hFrameEvent, INFINITE);
+#endif
+}
+
+void LiveCapture::CaptureLoop() {
+	long sequence = 0;
+	while (!stopping) {
+		double start = GetTimeMs();
+		IplImage *captured = cvQueryFrame(capture);
+		if (captured == NULL) break;	// the camera went away
+		double grabbed = GetTimeMs();
+
+		// the capture buffer is overwritten by the next grab, so the frame needs a copy of its own
+		LiveFrame &frame = frames.GetWriteBuffer();
+		EnsureImage(&frame.image, cvGetSize(captured), captured->depth, captured->nChannels);
+		if (captured->origin == IPL_ORIGIN_TL) {
+			cvCopy(captured, frame.image);
+		} else {
+			cvFlip(captured, frame.image);
+		}
+		frame.sequence = ++sequence;
+		frame.captureTime = start;
+		frame.grabMs = grabbed-start;
+		frame.copyMs = GetTimeMs()-grabbed;
+		frames.Publish();
+		Signal();
+	}
+	ended = true;
+	Signal();
+}
+
+IplImage* LiveCapture::TakeLatest() {
+	while (true) {
+		LiveFrame *frame = frames.GetLatest();
+		if ((frame != NULL) && (frame->sequence > takenSequence)) {
+			lastDropped = frame->sequence - takenSequence - 1;
+			framesDropped += lastDropped;
+			takenSequence = frame->sequence;
+			lastCaptureTime = frame->captureTime;
+			lastGrabMs = frame->grabMs;
+			lastCopyMs = frame->copyMs;
+			return frame->image;
+		}
+		if (stopping || ended) return NULL;
+		WaitForSignal();
+	}
+}
@@ -0,0 +1,78 @@
+#pragma once
+#ifdef EYEPATCH_HEADLESS
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#endif
+#include "TripleBuffer.h"
+
+// A captured frame waiting to be processed
+struct LiveFrame {
+	IplImage *image;		// upright copy of the capture buffer
+	long sequence;			// counts from 1 in the order the frames were grabbed
+	double captureTime;		// when the grab started
+	double grabMs, copyMs;	// how long the grab and the copy (or flip) took
+};
+
+// Reads a live camera on its own thread as fast as it delivers frames, so the frame handed to
+// the pipeline is always the newest one instead of whatever the driver has had queued up since
+// the last frame was finished.  Frames that are replaced by a newer one before anybody takes
+// them are dropped, and counted.  Recorded video shouldn't use this, since every frame of it
+// is wanted however long it takes.
+//
+// One thread calls Start and Stop, and one thread (the same or another) calls TakeLatest.
+class LiveCapture
+{
+public:
+	LiveCapture();
+	~LiveCapture();
+
+	// start draining an open capture; the capture still belongs to the caller, who must not read
+	// it until after Stop
+	void Start(CvCapture *capture);
+
+	// stop the capture thread and wake up TakeLatest
+	void Stop();
+	bool IsRunning();
+
+	// waits for a frame newer than the last one taken and returns it, or NULL once stopped or
+	// the camera stops delivering frames.  The caller may change the image, which stays valid
+	// until the next call.
+	IplImage* TakeLatest();
+
+	// the sequence number and grab time of the frame TakeLatest last returned, how long its grab
+	// and copy took, and how many frames were dropped just before it (the thread that takes the
+	// frames records these, so nothing else touches its metrics)
+	long GetLastSequence() { return takenSequence; }
+	double GetLastCaptureTime() { return lastCaptureTime; }
+	double GetLastGrabMs() { return lastGrabMs; }
+	double GetLastCopyMs() { return lastCopyMs; }
+	long GetLastDropped() { return lastDropped; }
+
+	// frames dropped since Start
+	long GetFramesDropped() { return framesDropped; }
+
+private:
+	void CaptureLoop();
+	void Signal();
+	void WaitForSignal();
+
+	CvCapture *capture;
+	TripleBuffer<LiveFrame> frames;
+	long takenSequence, lastDropped, framesDropped;
+	double lastCaptureTime, lastGrabMs, lastCopyMs;
+	bool running;
+
+#ifdef EYEPATCH_HEADLESS
+	std::thread m_thread;
+	std::mutex m_mutex;
+	std::condition_variable m_frameCondition;
+	bool signalled;
+	std::atomic<bool> stopping, ended;
+#else
+	static DWORD WINAPI ThreadCallback(LPVOID param);
+	HANDLE m_hThread, m_hFrameEvent;
+	volatile bool stopping, ended;
+#endif
+};
@@ -9,6 +9,10 @@ MotionClassifier::MotionClassifier() :
 	Classifier() {
     motionAngles.clear();
 
+    // working images are allocated on the first frame
+    orient = segmask = mask = dst = newMask = NULL;
+    storage = cvCreateMemStorage(0);
+
     // set the default "friendly name" and type
     wcscpy(friendlyName, L"Motion Recognizer");
     classifierType = MOTION_FILTER;        
@@ -39,9 +43,19 @@ MotionClassifier::MotionClassifier(LPCWSTR pathname) :
 
     // set the type
     classifierType = MOTION_FILTER;
+
+    // working images are allocated on the first frame
+    orient = segmask = mask = dst = newMask = NULL;
+    storage = cvCreateMemStorage(0);
 }
 
 MotionClassifier::~MotionClassifier() {
+    cvReleaseImage(&orient);
+    cvReleaseImage(&segmask);
+    cvReleaseImage(&mask);
+    cvReleaseImage(&dst);
+    cvReleaseImage(&newMask);
+    cvReleaseMemStorage(&storage);
 }
 
 BOOL MotionClassifier::ContainsSufficientSamples(TrainingSet *sampleSet) {
@@ -152,6 +166,12 @@ void MotionClassifier::StartTraining(TrainingSet *sampleSet) {
 	isTrained = true;
 }
 
+Classifier* MotionClassifier::CreateStreamInstance() {
+	MotionClassifier *instance = new MotionClassifier();
+	instance->InitStreamInstance(this);
+	return instance;
+}
+
 ClassifierOutputData MotionClassifier::ClassifyFrame(IplImage *frame) {
     // not implemented: this classifier uses ClassifyMotion instead
     assert(false);
@@ -167,16 +187,17 @@ ClassifierOutputData MotionClassifier::ClassifyMotion(IplImage *frame, double ti
     // check to make sure that the frame passed in is a motion history image (not a normal frame image)
     if (frame->depth != IPL_DEPTH_32F) return outputData;
     if (frame->nChannels != 1) return outputData;
+	const list<double> &modelAngles = GetModel()->motionAngles;
 
     // first find the motion components in this motion history image
     CvSize size = cvSize(frame->width,frame->height);
-    IplImage *orient = cvCreateImage(size, IPL_DEPTH_32F, 1);
-    IplImage *segmask = cvCreateImage(size, IPL_DEPTH_32F, 1);
-    IplImage *mask = cvCreateImage(size, IPL_DEPTH_8U, 1);
-    IplImage *dst = cvCreateImage(size, IPL_DEPTH_8U, 3);
-    IplImage *newMask = cvCreateImage(size, IPL_DEPTH_8U, 1);
+    EnsureImage(&orient, size, IPL_DEPTH_32F, 1);
+    EnsureImage(&segmask, size, IPL_DEPTH_32F, 1);
+    EnsureImage(&mask, size, IPL_DEPTH_8U, 1);
+    EnsureImage(&dst, size, IPL_DEPTH_8U, 3);
+    EnsureImage(&newMask, size, IPL_DEPTH_8U, 1);
     cvZero(newMask);
-    CvMemStorage *storage = cvCreateMemStorage(0);
+    cvClearMemStorage(storage);
 
     // convert MHI to blue 8U image
     cvCvtScale(frame, mask, 255./MOTION_MHI_DURATION,(MOTION_MHI_DURATION-MOTION_NUM_HISTORY_FRAMES)*255./MOTION_MHI_DURATION);
@@ -218,7 +239,7 @@ ClassifierOutputData MotionClassifier::ClassifyMotion(IplImage *frame, double ti
 		int angle_diff_threshold = 60-threshold*58.0;
 
         // check if the direction of this component matches the direction in one of the samples
-        for (list<double>::iterator i = motionAngles.begin(); i!=motionAngles.end(); i++) {
+        for (list<double>::const_iterator i = modelAngles.begin(); i!=modelAngles.end(); i++) {
             double angleDiff = fabs((*i)-motionAngle);
             // for angles close to 360
             if (angleDiff > (360-angle_diff_threshold)) angleDiff = 360-angleDiff;
@@ -245,13 +266,6 @@ ClassifierOutputData MotionClassifier::ClassifyMotion(IplImage *frame, double ti
 	// copy the final output mask
     cvResize(newMask, guessMask);
 
-    cvReleaseImage(&orient);
-    cvReleaseImage(&segmask);
-    cvReleaseImage(&mask);
-    cvReleaseImage(&dst);
-	cvReleaseImage(&newMask);
-    cvReleaseMemStorage(&storage);
-
 	UpdateStandardOutputData();
 	return outputData;
 }
@@ -13,7 +13,15 @@ public:
     ClassifierOutputData ClassifyMotion(IplImage*, double);
     void Save();
 	void ResetRunningState() {}		// This classifier doesn't have store any new state info while running live
+	Classifier* CreateStreamInstance();
 
 private:
+	// the classifier holding the trained motion angles (this one, unless we are a stream instance)
+	MotionClassifier* GetModel() { return sharedModel ? (MotionClassifier*)sharedModel : this; }
+
     list<double> motionAngles;
+
+	// working images and motion segment storage, kept between frames
+	IplImage *orient, *segmask, *mask, *dst, *newMask;
+	CvMemStorage *storage;
 };
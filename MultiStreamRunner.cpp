@@ -0,0 +1,83 @@
+#include "precomp.h"
+#include "constants.h"
+#include "TrainingSample.h"
+#include "TrainingSet.h"
+#include "Classifier.h"
+#include "OutputSink.h"
+#include "MultiStreamRunner.h"
+
+MultiStreamRunner::MultiStreamRunner() {
+}
+
+MultiStreamRunner::~MultiStreamRunner() {
+	StopProcessing();
+	for (int i=0; i<(int)streams.size(); i++) {
+		// the chain only refers to the classifiers, so it has to let go of them before they are deleted
+		streams[i].runner->filterChain.ClearActiveFilters();
+		delete streams[i].runner;
+		for (int j=0; j<(int)streams[i].classifiers.size(); j++) {
+			delete streams[i].classifiers[j];
+		}
+	}
+}
+
+void MultiStreamRunner::AddModel(Classifier *model) {
+	models.push_back(model);
+}
+
+HeadlessRunner* MultiStreamRunner::AddStream() {
+	Stream stream;
+	for (int i=0; i<(int)models.size(); i++) {
+		Classifier *c = models[i]->CreateStreamInstance();
+		if (c == NULL) {
+			for (int j=0; j<(int)stream.classifiers.size(); j++) {
+				delete stream.classifiers[j];
+			}
+			return NULL;
+		}
+		stream.classifiers.push_back(c);
+	}
+
+	stream.runner = new HeadlessRunner();
+	for (int i=0; i<(int)stream.classifiers.size(); i++) {
+		stream.runner->filterChain.AddActiveFilter(stream.classifiers[i]);
+	}
+	streams.push_back(stream);
+	return stream.runner;
+}
+
+int MultiStreamRunner::NumStreams() {
+	return (int)streams.size();
+}
+
+HeadlessRunner* MultiStreamRunner::GetStream(int index) {
+	return streams[index].runner;
+}
+
+const vector<Classifier*>& MultiStreamRunner::GetStreamClassifiers(int index) {
+	return streams[index].classifiers;
+}
+
+bool MultiStreamRunner::StartProcessing() {
+	for (int i=0; i<(int)streams.size(); i++) {
+		streams[i].runner->filterChain.ResetActiveFilterRunningStates();
+		if (!streams[i].runner->StartProcessing()) {
+			StopProcessing();
+			return false;
+		}
+	}
+	return true;
+}
+
+void MultiStreamRunner::StopProcessing() {
+	for (int i=0; i<(int)streams.size(); i++) {
+		streams[i].runner->StopProcessing();
+	}
+}
+
+bool MultiStreamRunner::IsProcessing() {
+	for (int i=0; i<(int)streams.size(); i++) {
+		if (streams[i].runner->IsProcessing()) return true;
+	}
+	return false;
+}
@@ -0,0 +1,43 @@
+#pragma once
+#include "HeadlessRunner.h"
+
+// Runs the same recognizers over several cameras or video files at once, each stream on its
+// own HeadlessRunner.  Every stream gets a stream instance of each model (see
+// Classifier::CreateStreamInstance), so there is one copy of each trained model in memory
+// however many streams there are, and the streams never share any per-frame state.
+class MultiStreamRunner
+{
+public:
+	MultiStreamRunner();
+	~MultiStreamRunner();
+
+	// the recognizers applied to every stream, in chain order; they belong to the caller and
+	// must outlive the runner.  Add them all before the first stream.
+	void AddModel(Classifier *model);
+
+	// a new stream with its own instance of each model, for the caller to open and configure
+	// (combine mode, outputs, scheduling); NULL if one of the models can't run on more than one stream
+	HeadlessRunner* AddStream();
+
+	int NumStreams();
+	HeadlessRunner* GetStream(int index);
+
+	// the stream instances in the chain of a stream, in the same order as the models
+	const vector<Classifier*>& GetStreamClassifiers(int index);
+
+	// false if any stream fails to start (the ones that did start are stopped again)
+	bool StartProcessing();
+	void StopProcessing();
+
+	// true while any stream is still processing
+	bool IsProcessing();
+
+private:
+	struct Stream {
+		HeadlessRunner *runner;
+		vector<Classifier*> classifiers;
+	};
+
+	vector<Classifier*> models;
+	vector<Stream> streams;
+};
@@ -18,7 +18,7 @@ OSCOutput::~OSCOutput() {
 void OSCOutput::ProcessInput(IplImage *image) {
 }
 
-void OSCOutput::ProcessOutput(IplImage *image, ClassifierOutputData data, char *filterName) {
+void OSCOutput::ProcessOutput(IplImage *image, ClassifierOutputData &data, char *filterName) {
     char buffer[OSC_OUTPUT_BUFFER_SIZE];
     char oscaddress[OSC_OUTPUT_BUFFER_SIZE];
     osc::OutboundPacketStream p( buffer, OSC_OUTPUT_BUFFER_SIZE );
@@ -32,7 +32,7 @@ void OSCOutput::ProcessOutput(IplImage *image, ClassifierOutputData data, char *
 
 	int nVars = data.NumVariables();
 	for (int i=0; i<nVars; i++) {
-		ClassifierOutputVariable var = data.data[i];
+		const ClassifierOutputVariable &var = data.GetVariableOfIndex(i);
 		if (var.GetState() == true) {	// this variable is active
 			sprintf(oscaddress, "/%s", var.GetName().c_str());
 			switch(var.GetType()) {
@@ -14,7 +14,7 @@ public:
     }
 
     virtual void ProcessInput(IplImage* image) = 0;
-    virtual void ProcessOutput(IplImage* image, ClassifierOutputData data, char* filterName) = 0;
+    virtual void ProcessOutput(IplImage* image, ClassifierOutputData &data, char *filterName) = 0;
 
 	virtual void StartRunning() = 0;
 	virtual void StopRunning() = 0;
@@ -0,0 +1,96 @@
+#include "precomp.h"
+#include "PipelineMetrics.h"
+
+static const char *stageNames[NUM_PIPELINE_STAGES] = {
+	"Capture", "Copy", "FilterChain", "Combine", "Outputs", "Bitmap", "Frame"
+};
+
+LatencyHistogram::LatencyHistogram() {
+	Reset();
+}
+
+void LatencyHistogram::Reset() {
+	nextSample = 0;
+	count = 0;
+}
+
+void LatencyHistogram::Add(double ms) {
+	samples[nextSample] = (float)ms;
+	nextSample = (nextSample+1) % METRICS_WINDOW;
+	count++;
+}
+
+void LatencyHistogram::GetStats(LatencyStats &stats) {
+	stats.name = name;
+	stats.count = count;
+	stats.mean = stats.p50 = stats.p95 = stats.p99 = stats.max = 0;
+	int n = (int)min(count, (long)METRICS_WINDOW);
+	if (n == 0) return;
+
+	float sorted[METRICS_WINDOW];
+	memcpy(sorted, samples, n*sizeof(float));
+	sort(sorted, sorted+n);
+
+	double total = 0;
+	for (int i=0; i<n; i++) total += sorted[i];
+	stats.mean = total/n;
+	stats.p50 = sorted[(n-1)*50/100];
+	stats.p95 = sorted[(n-1)*95/100];
+	stats.p99 = sorted[(n-1)*99/100];
+	stats.max = sorted[n-1];
+}
+
+PipelineMetrics::PipelineMetrics() {
+	for (int i=0; i<NUM_PIPELINE_STAGES; i++) {
+		AddStage(stageNames[i]);
+	}
+	framesProcessed = framesDropped = 0;
+	publishVariables = false;
+}
+
+PipelineMetrics::~PipelineMetrics() {
+	for (int i=0; i<(int)stages.size(); i++) {
+		delete stages[i];
+	}
+}
+
+void PipelineMetrics::Record(int stage, double ms) {
+	if ((stage < 0) || (stage >= (int)stages.size())) return;
+	stages[stage]->Add(ms);
+}
+
+int PipelineMetrics::AddStage(const string &name) {
+	// the histograms are allocated separately so they don't move when stages are added
+	LatencyHistogram *h = new LatencyHistogram();
+	h->name = name;
+	stages.push_back(h);
+	return (int)stages.size()-1;
+}
+
+void PipelineMetrics::RemoveAddedStages() {
+	for (int i=NUM_PIPELINE_STAGES; i<(int)stages.size(); i++) {
+		delete stages[i];
+	}
+	stages.resize(NUM_PIPELINE_STAGES);
+}
+
+void PipelineMetrics::Reset() {
+	for (int i=0; i<(int)stages.size(); i++) {
+		stages[i]->Reset();
+	}
+	framesProcessed = framesDropped = 0;
+}
+
+bool PipelineMetrics::GetStageStats(int stage, LatencyStats &stats) {
+	if ((stage < 0) || (stage >= (int)stages.size())) return false;
+	stages[stage]->GetStats(stats);
+	return (stats.count > 0);
+}
+
+void PipelineMetrics::GetStats(vector<LatencyStats> &stats) {
+	stats.clear();
+	for (int i=0; i<(int)stages.size(); i++) {
+		LatencyStats s;
+		if (GetStageStats(i, s)) stats.push_back(s);
+	}
+}
@@ -0,0 +1,96 @@
+#pragma once
+
+// number of recent samples each latency histogram keeps
+#define METRICS_WINDOW 256
+
+// Summary of one stage's recent latencies, in milliseconds
+struct LatencyStats {
+	string name;
+	long count;			// samples recorded since the last reset
+	double mean, p50, p95, p99, max;	// over the last METRICS_WINDOW samples
+};
+
+// Rolling window of the latest samples of one stage.  Recording is a store into a fixed ring;
+// the percentiles are only worked out when someone asks for them.
+class LatencyHistogram
+{
+public:
+	LatencyHistogram();
+	void Add(double ms);
+	void Reset();
+	void GetStats(LatencyStats &stats);
+
+	string name;
+
+private:
+	float samples[METRICS_WINDOW];
+	int nextSample;
+	long count;
+};
+
+// Fixed stages of the video pipeline, timed by the runners and the filter chain
+typedef enum PipelineStage {
+	STAGE_CAPTURE = 0,		// grabbing and decoding a frame
+	STAGE_COPY,				// flipping or copying it into the working frame
+	STAGE_FILTERCHAIN,		// all of ApplyFilterChain
+	STAGE_COMBINE,			// combining the masks and drawing the output frame
+	STAGE_OUTPUTS,			// all of the output sinks together
+	STAGE_BITMAP,			// converting the frames to bitmaps for display
+	STAGE_FRAME,			// a whole frame, from capture to display
+	NUM_PIPELINE_STAGES
+} PipelineStage;
+
+// Where frame time goes: latency histograms for the fixed pipeline stages, for each classifier
+// (ClassifyFrame, and UpdateStandardOutputData within it) and for each output sink, plus
+// counts of frames processed and dropped.
+//
+// Each stage is only ever recorded from one thread at a time.  Stages for classifiers and
+// outputs are added from the thread that owns the chain, never while frames are being
+// processed, and GetStats should be called under the same lock (or once processing stops).
+class PipelineMetrics
+{
+public:
+	PipelineMetrics();
+	~PipelineMetrics();
+
+	void Record(int stage, double ms);
+	int AddStage(const string &name);
+	void RemoveAddedStages();
+
+	void CountProcessedFrame() { framesProcessed++; }
+	void CountDroppedFrames(long n) { framesDropped += n; }
+	long GetFramesProcessed() { return framesProcessed; }
+	long GetFramesDropped() { return framesDropped; }
+
+	// clear the histograms and counters, keeping the stages
+	void Reset();
+
+	// the stats of every stage that has recorded anything
+	void GetStats(vector<LatencyStats> &stats);
+	bool GetStageStats(int stage, LatencyStats &stats);
+
+	// when set, the filter chain adds its latency and frame counts to the data it sends to the outputs
+	bool publishVariables;
+
+private:
+	vector<LatencyHistogram*> stages;
+	long framesProcessed, framesDropped;
+};
+
+// Times a block of code into a pipeline stage
+class ScopedTimer
+{
+public:
+	ScopedTimer(PipelineMetrics *metrics, int stage) {
+		m_metrics = metrics;
+		m_stage = stage;
+		m_start = GetTimeMs();
+	}
+	~ScopedTimer() {
+		m_metrics->Record(m_stage, GetTimeMs()-m_start);
+	}
+private:
+	PipelineMetrics *m_metrics;
+	int m_stage;
+	double m_start;
+};
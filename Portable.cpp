@@ -0,0 +1,103 @@
+#include "precomp.h"
+
+#ifdef EYEPATCH_HEADLESS
+
+#include <sys/stat.h>
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <dirent.h>
+#include <unistd.h>
+#endif
+
+std::string WideToNarrow(const WCHAR *wstr) {
+	if (wstr == NULL) return std::string();
+	size_t len = wcstombs(NULL, wstr, 0);
+	if (len == (size_t)-1) return std::string();
+	std::string str(len, '\0');
+	wcstombs(&str[0], wstr, len);
+	return str;
+}
+
+std::wstring NarrowToWide(const char *str) {
+	if (str == NULL) return std::wstring();
+	size_t len = mbstowcs(NULL, str, 0);
+	if (len == (size_t)-1) return std::wstring();
+	std::wstring wstr(len, L'\0');
+	mbstowcs(&wstr[0], str, len);
+	return wstr;
+}
+
+void GetAppDataPath(WCHAR *path) {
+	// same place the GUI keeps recognizers (%APPDATA%) on Windows, XDG data directory elsewhere
+	const char *root = getenv("APPDATA");
+	std::string rootpath;
+	if (root != NULL) {
+		rootpath = root;
+	} else if ((root = getenv("XDG_DATA_HOME")) != NULL) {
+		rootpath = root;
+	} else if ((root = getenv("HOME")) != NULL) {
+		rootpath = string(root) + "/.local/share";
+	} else {
+		rootpath = ".";
+	}
+	wcsncpy(path, NarrowToWide(rootpath.c_str()).c_str(), MAX_PATH-1);
+	path[MAX_PATH-1] = 0;
+}
+
+bool MakeDirectory(LPCWSTR path) {
+	// create each missing component of the path in turn
+	std::string dir = WideToNarrow(path);
+	for (size_t i=1; i<=dir.size(); i++) {
+		if ((i == dir.size()) || (dir[i] == '/') || (dir[i] == '\\')) {
+			std::string partial = dir.substr(0, i);
+#ifdef _WIN32
+			_mkdir(partial.c_str());
+#else
+			mkdir(partial.c_str(), 0755);
+#endif
+		}
+	}
+	struct stat info;
+	return (stat(dir.c_str(), &info) == 0) && (info.st_mode & S_IFDIR);
+}
+
+static bool RemoveTree(const std::string &dir) {
+#ifdef _WIN32
+	WIN32_FIND_DATAA findData;
+	HANDLE hFind = FindFirstFileA((dir + "\\*").c_str(), &findData);
+	if (hFind != INVALID_HANDLE_VALUE) {
+		do {
+			std::string name = findData.cFileName;
+			if ((name == ".") || (name == "..")) continue;
+			std::string child = dir + "\\" + name;
+			if (findData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) RemoveTree(child);
+			else DeleteFileA(child.c_str());
+		} while (FindNextFileA(hFind, &findData));
+		FindClose(hFind);
+	}
+	return (RemoveDirectoryA(dir.c_str()) != 0);
+#else
+	DIR *d = opendir(dir.c_str());
+	if (d != NULL) {
+		struct dirent *entry;
+		while ((entry = readdir(d)) != NULL) {
+			std::string name = entry->d_name;
+			if ((name == ".") || (name == "..")) continue;
+			std::string child = dir + "/" + name;
+			struct stat info;
+			if ((lstat(child.c_str(), &info) == 0) && S_ISDIR(info.st_mode)) RemoveTree(child);
+			else unlink(child.c_str());
+		}
+		closedir(d);
+	}
+	return (rmdir(dir.c_str()) == 0);
+#endif
+}
+
+bool DeleteDirectory(LPCTSTR lpszDir, bool useRecycleBin) {
+	// there is no recycle bin to move things to, so the directory is always removed outright
+	return RemoveTree(WideToNarrow(lpszDir));
+}
+
+#endif
@@ -0,0 +1,85 @@
+#pragma once
+
+// Portable stand-ins for the Win32, ATL and GDI+ types used by the recognizer core.
+// Only included when building without the GUI front end (EYEPATCH_HEADLESS), so the
+// classifiers, filter chain and output sinks can run on machines without a display.
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <stdint.h>
+#include <stdarg.h>
+#include <wchar.h>
+
+typedef wchar_t WCHAR;
+typedef WCHAR* LPWSTR;
+typedef const WCHAR* LPCWSTR;
+typedef const WCHAR* LPCTSTR;
+typedef int BOOL;
+typedef unsigned int UINT;
+typedef uint32_t DWORD;
+
+#ifndef TRUE
+#define TRUE 1
+#endif
+#ifndef FALSE
+#define FALSE 0
+#endif
+#define MAX_PATH 260
+
+// all of the wsprintf calls in the core write into MAX_PATH buffers
+#define wsprintf(buffer, ...) swprintf(buffer, MAX_PATH, __VA_ARGS__)
+#define _hypot hypot
+
+// SIFT/utils.h declares its own basename(), which clashes with the one in glibc's string.h
+#define basename sift_basename
+#endif
+
+#include <string>
+
+// GDI+ compatible point and rectangle
+class Point {
+public:
+	Point() { X = 0; Y = 0; }
+	Point(int x, int y) { X = x; Y = y; }
+	int X, Y;
+};
+
+class Rect {
+public:
+	Rect() { X = 0; Y = 0; Width = 0; Height = 0; }
+	Rect(int x, int y, int width, int height) { X = x; Y = y; Width = width; Height = height; }
+	int GetLeft() const { return X; }
+	int GetTop() const { return Y; }
+	int GetRight() const { return X+Width; }
+	int GetBottom() const { return Y+Height; }
+	bool Contains(int x, int y) const { return (x >= X) && (x < X+Width) && (y >= Y) && (y < Y+Height); }
+	bool Contains(const Point &pt) const { return Contains(pt.X, pt.Y); }
+	int X, Y, Width, Height;
+};
+
+// There is nothing to draw into without GDI+, so bitmaps are just placeholders
+// that let the classifiers keep their demo image members.
+#define PixelFormat24bppRGB 0
+class Bitmap {
+public:
+	Bitmap(int width, int height, int format) { m_width = width; m_height = height; }
+	int GetWidth() { return m_width; }
+	int GetHeight() { return m_height; }
+private:
+	int m_width, m_height;
+};
+
+// ATL string conversion replacements; the returned pointers are only valid
+// until the end of the full expression, just like the ATL stack buffers.
+std::string WideToNarrow(const WCHAR *wstr);
+std::wstring NarrowToWide(const char *str);
+#define USES_CONVERSION
+#define W2A(w) ((char*)WideToNarrow(w).c_str())
+#define A2W(a) ((WCHAR*)NarrowToWide(a).c_str())
+
+// Replacements for the shell functions used to locate and create recognizer directories
+void GetAppDataPath(WCHAR *path);
+bool MakeDirectory(LPCWSTR path);
@@ -0,0 +1,134 @@
+#include "precomp.h"
+#include "RegionLabeller.h"
+
+// index of the lowest set bit (bits must not be 0)
+static inline int LowestBit(unsigned int bits) {
+	static const int debruijn[32] = {
+		0, 1, 28, 2, 29, 14, 24, 3, 30, 22, 20, 15, 25, 17, 4, 8,
+		31, 27, 13, 23, 21, 19, 16, 7, 26, 12, 18, 6, 11, 5, 10, 9
+	};
+	return debruijn[((bits & (0u-bits)) * 0x077CB531u) >> 27];
+}
+
+// the first pixel at or after x that is set (or clear, if set is false), or width if there isn't one
+static inline int NextPixel(const unsigned int *row, int x, int width, bool set) {
+	int w = x/32;
+	int nWords = (width+31)/32;
+	unsigned int bits = (set ? row[w] : ~row[w]) & (~0u << (x%32));
+	while (bits == 0) {
+		if (++w >= nWords) return width;
+		bits = set ? row[w] : ~row[w];
+	}
+	return min(w*32 + LowestBit(bits), width);
+}
+
+RegionLabeller::RegionLabeller() {
+	totalArea = 0;
+}
+
+int RegionLabeller::NewLabel() {
+	parent.push_back((int)parent.size());
+	return (int)parent.size()-1;
+}
+
+int RegionLabeller::FindRoot(int label) {
+	int root = label;
+	while (parent[root] != root) root = parent[root];
+
+	// point everything on the way straight at the root
+	while (parent[label] != root) {
+		int next = parent[label];
+		parent[label] = root;
+		label = next;
+	}
+	return root;
+}
+
+void RegionLabeller::Merge(int a, int b) {
+	// the older label wins, so a region's root is the label of its first run
+	a = FindRoot(a);
+	b = FindRoot(b);
+	if (a < b) parent[b] = a;
+	else if (b < a) parent[a] = b;
+}
+
+int RegionLabeller::Label(IplImage *mask) {
+	packed.FromImage(mask);
+	return Label(packed);
+}
+
+int RegionLabeller::Label(const BitMask &mask) {
+	runs.clear();
+	parent.clear();
+	regions.clear();
+	totalArea = 0;
+
+	// first pass: find the runs, and join each to the runs it touches in the row above
+	// (including diagonally, so they only have to overlap or meet at a corner)
+	int width = mask.GetWidth(), height = mask.GetHeight();
+	int prevStart = 0, prevEnd = 0;		// runs of the row above
+	for (int y=0; y<height; y++) {
+		const unsigned int *row = mask.GetRow(y);
+		int rowStart = (int)runs.size();
+		int above = prevStart;
+		int x = NextPixel(row, 0, width, true);
+		while (x < width) {
+			Run run;
+			run.y = y;
+			run.x1 = x;
+			run.x2 = NextPixel(row, x, width, false);
+			run.label = -1;
+
+			// runs above that end before this one starts can't touch this or any later run
+			while ((above < prevEnd) && (runs[above].x2 < run.x1)) above++;
+			for (int a=above; (a < prevEnd) && (runs[a].x1 <= run.x2); a++) {
+				if (run.label < 0) run.label = runs[a].label;
+				else Merge(run.label, runs[a].label);
+			}
+			if (run.label < 0) run.label = NewLabel();
+			runs.push_back(run);
+
+			x = (run.x2 < width) ? NextPixel(row, run.x2, width, true) : width;
+		}
+		prevStart = rowStart;
+		prevEnd = (int)runs.size();
+	}
+
+	// second pass: accumulate each region's statistics over its runs
+	regionOfLabel.assign(parent.size(), -1);
+	sumX.clear();
+	sumY.clear();
+	for (int i=0; i<(int)runs.size(); i++) {
+		const Run &run = runs[i];
+		int root = FindRoot(run.label);
+		int r = regionOfLabel[root];
+		if (r < 0) {
+			r = regionOfLabel[root] = (int)regions.size();
+			MaskRegion region;
+			region.area = 0;
+			region.bounds = cvRect(run.x1, run.y, 0, 0);
+			regions.push_back(region);
+			sumX.push_back(0);
+			sumY.push_back(0);
+		}
+
+		// bounds is kept as x1,y1,x2,y2 until the end
+		MaskRegion &region = regions[r];
+		int length = run.x2-run.x1;
+		region.area += length;
+		region.bounds.x = min(region.bounds.x, run.x1);
+		region.bounds.width = max(region.bounds.width, run.x2);
+		region.bounds.height = run.y+1;
+		sumX[r] += length*(run.x1+run.x2-1)/2.0;
+		sumY[r] += (double)length*run.y;
+	}
+	for (int r=0; r<(int)regions.size(); r++) {
+		MaskRegion &region = regions[r];
+		region.bounds.width -= region.bounds.x;
+		region.bounds.height -= region.bounds.y;
+		region.centroidX = (float)(sumX[r]/region.area);
+		region.centroidY = (float)(sumY[r]/region.area);
+		totalArea += region.area;
+	}
+	return (int)regions.size();
+}
@@ -0,0 +1,47 @@
+#pragma once
+#include "BitMask.h"
+
+// area, bounding box and centroid of one connected region of a mask
+struct MaskRegion {
+	int area;			// in pixels
+	CvRect bounds;
+	float centroidX, centroidY;
+};
+
+// Finds the 8-connected regions of a binary mask (the same regions cvFindContours traces the
+// outlines of) without tracing them.  The first pass collects the runs of set pixels in each
+// row and merges the labels of runs that touch a run in the row above; the second pass
+// accumulates the statistics of each region over the runs, so each pixel is only looked at
+// once (and 32 at a time in clear or solid stretches of the packed mask).
+class RegionLabeller
+{
+public:
+	RegionLabeller();
+
+	// label the regions of a packed mask, or of an 8 bit mask (any nonzero pixel is set);
+	// returns how many regions there are
+	int Label(const BitMask &mask);
+	int Label(IplImage *mask);
+
+	// the regions of the last mask, in order of their topmost (then leftmost) pixel
+	int NumRegions() { return (int)regions.size(); }
+	const MaskRegion& GetRegion(int index) { return regions[index]; }
+	int GetTotalArea() { return totalArea; }
+
+private:
+	struct Run {
+		int y, x1, x2;	// x2 is one past the last pixel
+		int label;
+	};
+	int NewLabel();
+	int FindRoot(int label);
+	void Merge(int a, int b);
+
+	BitMask packed;			// for labelling 8 bit masks
+	vector<Run> runs;
+	vector<int> parent;		// union-find forest over the provisional labels
+	vector<int> regionOfLabel;
+	vector<double> sumX, sumY;
+	vector<MaskRegion> regions;
+	int totalArea;
+};
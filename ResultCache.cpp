@@ -0,0 +1,387 @@
+#include "precomp.h"
+#include "constants.h"
+#include "TrainingSample.h"
+#include "TrainingSet.h"
+#include "Classifier.h"
+#include "ResultCache.h"
+#include <sys/stat.h>
+#ifndef _WIN32
+#include <dirent.h>
+#endif
+
+// spill files start with this, followed by records of frame number, word count and words
+static const char spillMagic[4] = { 'E', 'P', 'R', 'C' };
+static const int spillVersion = 2;
+
+// rough cost of an entry in memory besides its words (map node and vector)
+static const size_t entryOverhead = 64;
+
+ResultCache::ResultCache() {
+	memoryLimit = RESULT_CACHE_MEMORY;
+	diskLimit = RESULT_CACHE_DISK;
+	memoryUsed = 0;
+	diskUsed = 0;
+	hits = misses = 0;
+}
+
+ResultCache::~ResultCache() {
+	Flush();
+	Clear();
+}
+
+unsigned long long ResultCache::HashBytes(unsigned long long hash, const void *data, size_t length) {
+	const unsigned char *p = (const unsigned char*)data;
+	for (size_t i=0; i<length; i++) {
+		hash ^= p[i];
+		hash *= 1099511628211ULL;
+	}
+	return hash;
+}
+
+unsigned long long ResultCache::HashFile(unsigned long long hash, const char *filename) {
+	// files that aren't there don't change the hash
+	FILE *file = fopen(filename, "rb");
+	if (file == NULL) return hash;
+	unsigned char buffer[4096];
+	size_t n;
+	while ((n = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+		hash = HashBytes(hash, buffer, n);
+	}
+	fclose(file);
+	return hash;
+}
+
+unsigned long long ResultCache::IdentifyFile(const char *filename) {
+	struct stat info;
+	if ((filename == NULL) || (stat(filename, &info) != 0)) return 0;
+	long long size = (long long)info.st_size;
+	long long modified = (long long)info.st_mtime;
+	unsigned long long hash = HashBytes(HASH_START, filename, strlen(filename));
+	hash = HashBytes(hash, &size, sizeof(size));
+	hash = HashBytes(hash, &modified, sizeof(modified));
+	return (hash != 0) ? hash : 1;
+}
+
+void ResultCache::SetSpillDirectory(const char *directory) {
+	USES_CONVERSION;
+	Flush();
+	Clear();
+	spillDirectory = (directory != NULL) ? directory : "";
+	if (spillDirectory.empty()) return;
+#ifndef EYEPATCH_HEADLESS
+	SHCreateDirectory(NULL, A2W(spillDirectory.c_str()));
+#else
+	MakeDirectory(A2W(spillDirectory.c_str()));
+#endif
+	TrimSpillDirectory(diskLimit);
+}
+
+bool ResultCache::IsCacheable(Classifier *c) {
+	// these only depend on the frame they are given, and only output what comes from the mask
+	switch (c->classifierType) {
+		case COLOR_FILTER:
+		case SHAPE_FILTER:
+		case BRIGHTNESS_FILTER:
+		case SIFT_FILTER:
+		case ADABOOST_FILTER:
+		case COLOR_LUT_FILTER:
+			return true;
+	}
+	return false;
+}
+
+int ResultCache::GetMaskVersion(Classifier *c) {
+	// bump a recognizer's version with any change that can change the masks it finds
+	switch (c->classifierType) {
+		case COLOR_FILTER:			return 1;
+		case SHAPE_FILTER:			return 1;
+		case BRIGHTNESS_FILTER:		return 1;
+		case SIFT_FILTER:			return 1;
+		case ADABOOST_FILTER:		return 1;
+		case COLOR_LUT_FILTER:		return 1;
+	}
+	return 0;
+}
+
+unsigned long long ResultCache::GetModelKey(Classifier *c) {
+	if (!IsCacheable(c)) return 0;
+	unsigned long long hash = c->GetModelHash();
+	if (hash == 0) return 0;
+	int version = GetMaskVersion(c);
+	hash = HashBytes(hash, &spillVersion, sizeof(spillVersion));
+	hash = HashBytes(hash, &version, sizeof(version));
+	hash = HashBytes(hash, &c->threshold, sizeof(c->threshold));
+	hash = HashBytes(hash, &c->workingWidth, sizeof(c->workingWidth));
+	return (hash != 0) ? hash : 1;
+}
+
+ResultCache::Table* ResultCache::GetTable(unsigned long long videoId, unsigned long long modelKey) {
+	TableKey key(videoId, modelKey);
+	map<TableKey, Table*>::iterator t = tables.find(key);
+	if (t != tables.end()) return t->second;
+
+	Table *table = new Table();
+	table->file = NULL;
+	table->appendable = false;
+	tables[key] = table;
+	if (!spillDirectory.empty()) OpenSpillFile(key, table);
+	return table;
+}
+
+string ResultCache::SpillFileName(const TableKey &key) {
+	char name[64];
+	sprintf(name, "%08x%08x-%08x%08x.dat", (unsigned int)(key.first >> 32), (unsigned int)key.first,
+		(unsigned int)(key.second >> 32), (unsigned int)key.second);
+	return name;
+}
+
+// a file in the spill directory
+struct SpillFile {
+	string name;
+	long long size;
+	long long modified;
+};
+
+static bool WrittenEarlier(const SpillFile &a, const SpillFile &b) {
+	return a.modified < b.modified;
+}
+
+// the .dat files in a directory
+static void ListSpillFiles(const string &directory, const string &separator, vector<SpillFile> &files) {
+	vector<string> names;
+#ifdef _WIN32
+	WIN32_FIND_DATAA findData;
+	HANDLE hFind = FindFirstFileA((directory + separator + "*.dat").c_str(), &findData);
+	if (hFind != INVALID_HANDLE_VALUE) {
+		do {
+			if (!(findData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)) names.push_back(findData.cFileName);
+		} while (FindNextFileA(hFind, &findData));
+		FindClose(hFind);
+	}
+#else
+	DIR *d = opendir(directory.c_str());
+	if (d != NULL) {
+		struct dirent *entry;
+		while ((entry = readdir(d)) != NULL) {
+			string name = entry->d_name;
+			if ((name.size() > 4) && (name.compare(name.size()-4, 4, ".dat") == 0)) names.push_back(name);
+		}
+		closedir(d);
+	}
+#endif
+	for (int i=0; i<(int)names.size(); i++) {
+		struct stat info;
+		if (stat((directory + separator + names[i]).c_str(), &info) != 0) continue;
+		SpillFile file;
+		file.name = names[i];
+		file.size = (long long)info.st_size;
+		file.modified = (long long)info.st_mtime;
+		files.push_back(file);
+	}
+}
+
+void ResultCache::TrimSpillDirectory(long long limit) {
+	USES_CONVERSION;
+	string separator = W2A(FILE_PATH_SEPARATOR);
+	vector<SpillFile> files;
+	ListSpillFiles(spillDirectory, separator, files);
+	sort(files.begin(), files.end(), WrittenEarlier);
+
+	// the files of this run's tables are open, so they stay
+	vector<string> openFiles;
+	for (map<TableKey, Table*>::iterator t = tables.begin(); t != tables.end(); t++) {
+		if (t->second->file != NULL) openFiles.push_back(SpillFileName(t->first));
+	}
+
+	diskUsed = 0;
+	for (int i=0; i<(int)files.size(); i++) diskUsed += files[i].size;
+	for (int i=0; (i<(int)files.size()) && (diskUsed > limit); i++) {
+		if (find(openFiles.begin(), openFiles.end(), files[i].name) != openFiles.end()) continue;
+		if (remove((spillDirectory + separator + files[i].name).c_str()) == 0) diskUsed -= files[i].size;
+	}
+}
+
+void ResultCache::OpenSpillFile(const TableKey &key, Table *table) {
+	USES_CONVERSION;
+	string filename = spillDirectory + W2A(FILE_PATH_SEPARATOR) + SpillFileName(key);
+	table->file = fopen(filename.c_str(), "a+b");
+	if (table->file == NULL) return;
+
+	// a new file gets a header; an existing one is indexed, as far as it is readable
+	fseek(table->file, 0, SEEK_END);
+	long fileSize = ftell(table->file);
+	if (fileSize == 0) {
+		fwrite(spillMagic, sizeof(spillMagic), 1, table->file);
+		fwrite(&spillVersion, sizeof(int), 1, table->file);
+		fflush(table->file);
+		diskUsed += sizeof(spillMagic) + sizeof(int);
+		table->appendable = true;
+		return;
+	}
+	fseek(table->file, 0, SEEK_SET);
+	char magic[4];
+	int version;
+	if ((fread(magic, sizeof(magic), 1, table->file) != 1) || (memcmp(magic, spillMagic, sizeof(magic)) != 0) ||
+		(fread(&version, sizeof(int), 1, table->file) != 1) || (version != spillVersion)) {
+		return;
+	}
+	long offset = ftell(table->file);
+	int header[2];
+	while ((offset < fileSize) && (fread(header, sizeof(int), 2, table->file) == 2)) {
+		long end = offset + 2*(long)sizeof(int) + header[1]*(long)sizeof(unsigned int);
+		if ((header[1] <= 0) || (end > fileSize)) break;
+		table->spilled[header[0]] = offset;
+		fseek(table->file, end, SEEK_SET);
+		offset = end;
+	}
+
+	// if the last record was cut off (the process died writing it), we can still read the ones
+	// before it, but anything appended after it would be lost
+	table->appendable = (offset == fileSize);
+}
+
+bool ResultCache::Lookup(unsigned long long videoId, long frameNum, Classifier *c, BitMask &mask) {
+	if (videoId == 0) return false;
+	unsigned long long modelKey = GetModelKey(c);
+	if (modelKey == 0) return false;
+	Table *table = GetTable(videoId, modelKey);
+
+	map<long, vector<unsigned int> >::iterator e = table->entries.find(frameNum);
+	if (e != table->entries.end()) {
+		if (Decode(&e->second[0], (int)e->second.size(), mask)) {
+			hits++;
+			return true;
+		}
+	} else {
+		map<long, long>::iterator s = table->spilled.find(frameNum);
+		int header[2];
+		if ((s != table->spilled.end()) && (fseek(table->file, s->second, SEEK_SET) == 0) &&
+			(fread(header, sizeof(int), 2, table->file) == 2) && (header[0] == frameNum) && (header[1] > 0)) {
+			record.resize(header[1]);
+			if ((fread(&record[0], sizeof(unsigned int), header[1], table->file) == (size_t)header[1]) &&
+				Decode(&record[0], header[1], mask)) {
+				hits++;
+				return true;
+			}
+		}
+	}
+	misses++;
+	return false;
+}
+
+void ResultCache::Store(unsigned long long videoId, long frameNum, Classifier *c, IplImage *mask) {
+	if ((videoId == 0) || (mask == NULL)) return;
+	unsigned long long modelKey = GetModelKey(c);
+	if (modelKey == 0) return;
+	Table *table = GetTable(videoId, modelKey);
+	if ((table->entries.count(frameNum) > 0) || (table->spilled.count(frameNum) > 0)) return;
+
+	packed.FromImage(mask);
+	vector<unsigned int> words;
+	Encode(packed, words);
+	size_t size = words.size()*sizeof(unsigned int) + entryOverhead;
+	if (memoryUsed + size > memoryLimit) {
+		if (spillDirectory.empty()) return;		// full
+		Spill();
+	}
+	table->entries[frameNum].swap(words);
+	memoryUsed += size;
+}
+
+void ResultCache::Spill() {
+	for (map<TableKey, Table*>::iterator t = tables.begin(); t != tables.end(); t++) {
+		Table *table = t->second;
+		long long bytes = 0;
+		for (map<long, vector<unsigned int> >::iterator e = table->entries.begin(); e != table->entries.end(); e++) {
+			bytes += 2*sizeof(int) + e->second.size()*sizeof(unsigned int);
+		}
+
+		// make room by deleting the oldest files, or let these entries go if that isn't enough
+		if (diskUsed + bytes > diskLimit) TrimSpillDirectory(diskLimit - bytes);
+		if ((table->file != NULL) && table->appendable && !table->entries.empty() && (diskUsed + bytes <= diskLimit)) {
+			diskUsed += bytes;
+			fseek(table->file, 0, SEEK_END);
+			for (map<long, vector<unsigned int> >::iterator e = table->entries.begin(); e != table->entries.end(); e++) {
+				long offset = ftell(table->file);
+				int header[2] = { (int)e->first, (int)e->second.size() };
+				fwrite(header, sizeof(int), 2, table->file);
+				fwrite(&e->second[0], sizeof(unsigned int), e->second.size(), table->file);
+				table->spilled[e->first] = offset;
+			}
+			fflush(table->file);
+		}
+		table->entries.clear();
+	}
+	memoryUsed = 0;
+}
+
+void ResultCache::Flush() {
+	if (!spillDirectory.empty()) Spill();
+}
+
+void ResultCache::Clear() {
+	for (map<TableKey, Table*>::iterator t = tables.begin(); t != tables.end(); t++) {
+		if (t->second->file != NULL) fclose(t->second->file);
+		delete t->second;
+	}
+	tables.clear();
+	memoryUsed = 0;
+}
+
+// The size of the mask, then the words of its rows (without the padding) as runs: a count of
+// zero words, a count of nonzero words, and the nonzero words themselves.
+void ResultCache::Encode(const BitMask &mask, vector<unsigned int> &words) {
+	int width = mask.GetWidth(), height = mask.GetHeight();
+	int wordsPerRow = (width+31)/32;
+	words.clear();
+	words.push_back(((unsigned int)width << 16) | (unsigned int)height);
+
+	unsigned int zeros = 0;
+	size_t literals = 0;	// index of the current run's nonzero count, or 0 if there isn't one yet
+	for (int y=0; y<height; y++) {
+		const unsigned int *row = mask.GetRow(y);
+		for (int i=0; i<wordsPerRow; i++) {
+			if (row[i] == 0) {
+				literals = 0;
+				zeros++;
+				continue;
+			}
+			if (literals == 0) {
+				words.push_back(zeros);
+				words.push_back(0);
+				literals = words.size()-1;
+				zeros = 0;
+			}
+			words[literals]++;
+			words.push_back(row[i]);
+		}
+	}
+	if (zeros > 0) {
+		words.push_back(zeros);
+		words.push_back(0);
+	}
+}
+
+bool ResultCache::Decode(const unsigned int *words, int nWords, BitMask &mask) {
+	if (nWords < 1) return false;
+	int width = (int)(words[0] >> 16), height = (int)(words[0] & 0xFFFF);
+	int wordsPerRow = (width+31)/32;
+	long total = (long)wordsPerRow*height;
+	if (total == 0) return false;
+	mask.Create(width, height);
+
+	long position = 0;		// in words of the rows, without the padding
+	int i = 1;
+	while ((i+1 < nWords) && (position < total)) {
+		long zeros = words[i++];
+		long literals = words[i++];
+		if ((position + zeros + literals > total) || (i + literals > nWords)) return false;
+		for (long end = position+zeros; position < end; position++) {
+			mask.GetRow(position/wordsPerRow)[position%wordsPerRow] = 0;
+		}
+		for (long end = position+literals; position < end; position++) {
+			mask.GetRow(position/wordsPerRow)[position%wordsPerRow] = words[i++];
+		}
+	}
+	return (position == total) && (i == nWords);
+}
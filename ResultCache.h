@@ -0,0 +1,89 @@
+#pragma once
+#include "BitMask.h"
+
+class Classifier;
+
+// Remembers the mask each recognizer found on each frame of a recorded video, so running the
+// same file again (after switching the combine mode, say, or adding another recognizer) only
+// classifies what is new.  Entries are keyed by the video (its path, size and modification time),
+// the frame number and the recognizer's model: a hash of its saved files, its threshold and its
+// working width.  Only saved color, color table, shape, brightness, SIFT and Haar recognizers
+// are cached; all of their outputs are worked out from the mask, so the mask is all we keep,
+// run-length encoded over its packed words.  Motion, gesture and the other recognizers that carry state from frame
+// to frame always run.
+//
+// Entries are kept in memory up to memoryLimit bytes.  With a spill directory, everything in
+// memory is then appended to a file for each video and model there, which later runs (and later
+// processes) read back; without one, nothing more is added once the memory is used up.  The
+// directory is kept under diskLimit bytes by deleting the files written longest ago.  The model
+// part of the key includes a version for each recognizer type (see GetMaskVersion), so masks
+// saved before a change to how a recognizer works are not used after it.
+// The cache isn't thread safe: use one per filter chain.
+class ResultCache
+{
+public:
+	ResultCache();
+	~ResultCache();
+
+	// identifies a video file by its path, size and modification time (0 if it can't be read)
+	static unsigned long long IdentifyFile(const char *filename);
+
+	// 64 bit FNV-1a, continuing from hash (start with HASH_START)
+	static const unsigned long long HASH_START = 14695981039346656037ULL;
+	static unsigned long long HashBytes(unsigned long long hash, const void *data, size_t length);
+	static unsigned long long HashFile(unsigned long long hash, const char *filename);
+
+	// keep the entries that don't fit in memory in files in this directory (created if needed;
+	// an empty name keeps everything in memory)
+	void SetSpillDirectory(const char *directory);
+
+	// whether a classifier's results can be cached at all
+	static bool IsCacheable(Classifier *c);
+
+	// the mask c found on a frame of the video, unpacked into mask; false if we don't have it
+	bool Lookup(unsigned long long videoId, long frameNum, Classifier *c, BitMask &mask);
+
+	// remember the mask c found on a frame of the video
+	void Store(unsigned long long videoId, long frameNum, Classifier *c, IplImage *mask);
+
+	// write the entries in memory to the spill directory, if there is one
+	void Flush();
+
+	// forget everything (the spilled files stay on disk)
+	void Clear();
+
+	size_t memoryLimit;
+	long long diskLimit;
+	long hits, misses;
+
+private:
+	ResultCache(const ResultCache&);
+	void operator=(const ResultCache&);
+
+	// the frames of one video classified with one model
+	struct Table {
+		map<long, vector<unsigned int> > entries;	// in memory
+		map<long, long> spilled;	// offset of each frame's record in the spill file
+		FILE *file;
+		bool appendable;	// false if the file is damaged or from another version, so we only read it
+	};
+	typedef pair<unsigned long long, unsigned long long> TableKey;
+
+	static int GetMaskVersion(Classifier *c);
+	unsigned long long GetModelKey(Classifier *c);
+	static string SpillFileName(const TableKey &key);
+	void TrimSpillDirectory(long long limit);
+	Table* GetTable(unsigned long long videoId, unsigned long long modelKey);
+	void OpenSpillFile(const TableKey &key, Table *table);
+	void Spill();
+
+	static void Encode(const BitMask &mask, vector<unsigned int> &words);
+	static bool Decode(const unsigned int *words, int nWords, BitMask &mask);
+
+	map<TableKey, Table*> tables;
+	string spillDirectory;
+	size_t memoryUsed;
+	long long diskUsed;		// by the files in the spill directory
+	BitMask packed;
+	vector<unsigned int> record;
+};
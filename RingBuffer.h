@@ -0,0 +1,133 @@
+#pragma once
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+
+// Occupancy counters for a ring buffer, for tuning queue lengths: a stage that often
+// waits on a full queue is faster than the one after it, and one that often waits on
+// an empty queue is faster than the one before it.
+struct RingBufferStats {
+	int capacity;
+	int depth;			// items in the queue right now
+	int maxDepth;		// most items ever queued at once
+	double avgDepth;	// average depth seen by the consumer
+	long pushes;
+	long fullWaits;		// times the producer had to wait for space
+	long emptyWaits;	// times the consumer had to wait for an item
+};
+
+// Bounded single-producer/single-consumer queue.  The items are handed over without a lock;
+// the mutex is only held briefly to wake the other side, which sleeps on a condition while the
+// queue is full (or empty).  Exactly one thread may push and exactly one other thread may pop.
+template <class T>
+class RingBuffer
+{
+public:
+	RingBuffer(int capacity) : head(0), tail(0) {
+		size = capacity+1;	// one slot stays empty to tell a full queue from an empty one
+		slots = new T[size];
+		maxDepth = 0;
+		depthSum = 0;
+		pushes = pops = 0;
+		fullWaits = emptyWaits = 0;
+	}
+	~RingBuffer() {
+		delete[] slots;
+	}
+
+	bool TryPush(const T &item) {
+		int t = tail.load(std::memory_order_relaxed);
+		int next = (t+1) % size;
+		if (next == head.load(std::memory_order_acquire)) return false;	// full
+		slots[t] = item;
+		tail.store(next, std::memory_order_release);
+
+		int depth = Depth();
+		if (depth > maxDepth) maxDepth = depth;
+		pushes++;
+		Notify();
+		return true;
+	}
+
+	bool TryPop(T &item) {
+		int h = head.load(std::memory_order_relaxed);
+		if (h == tail.load(std::memory_order_acquire)) return false;	// empty
+		depthSum += Depth();
+		pops++;
+		item = slots[h];
+		head.store((h+1) % size, std::memory_order_release);
+		Notify();
+		return true;
+	}
+
+	// block until there is space for the item
+	void Push(const T &item) {
+		if (TryPush(item)) return;
+		fullWaits++;
+		while (!TryPush(item)) Wait(HasSpace(this));
+	}
+
+	// block until there is an item to take
+	T Pop() {
+		T item;
+		if (TryPop(item)) return item;
+		emptyWaits++;
+		while (!TryPop(item)) Wait(HasItem(this));
+		return item;
+	}
+
+	int Depth() {
+		int d = tail.load(std::memory_order_acquire) - head.load(std::memory_order_acquire);
+		return (d < 0) ? d+size : d;
+	}
+
+	// the counters are updated without locking, so read them once both sides have stopped
+	// (or accept that they are approximate while the queue is in use)
+	RingBufferStats GetStats() {
+		RingBufferStats stats;
+		stats.capacity = size-1;
+		stats.depth = Depth();
+		stats.maxDepth = maxDepth;
+		stats.avgDepth = (pops > 0) ? (double)depthSum/pops : 0;
+		stats.pushes = pushes;
+		stats.fullWaits = fullWaits;
+		stats.emptyWaits = emptyWaits;
+		return stats;
+	}
+
+private:
+	// what Push and Pop wait for
+	struct HasSpace {
+		RingBuffer *queue;
+		HasSpace(RingBuffer *q) : queue(q) {}
+		bool operator()() const { return queue->Depth() < queue->size-1; }
+	};
+	struct HasItem {
+		RingBuffer *queue;
+		HasItem(RingBuffer *q) : queue(q) {}
+		bool operator()() const { return queue->Depth() > 0; }
+	};
+
+	void Notify() {
+		// the waiting side checks the queue under the same mutex, so it is either still before its
+		// check (and will see the change) or already asleep (and gets woken)
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_condition.notify_all();
+	}
+	template <class Pred> void Wait(Pred ready) {
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_condition.wait(lock, ready);
+	}
+
+	T *slots;
+	int size;
+	std::atomic<int> head, tail;
+	std::mutex m_mutex;
+	std::condition_variable m_condition;
+
+	// written only by the producer (maxDepth, pushes, fullWaits) or only by the consumer (the rest)
+	int maxDepth;
+	long long depthSum;
+	long pushes, pops;
+	long fullWaits, emptyWaits;
+};
@@ -4,30 +4,38 @@
 #include "TrainingSet.h"
 #include "Classifier.h"
 #include "ShapeClassifier.h"
+#include "ResultCache.h"
 
-double pghMatchShapes(CvSeq *shape1, CvSeq *shape2) {
-	int dims[] = {8, 8};
+// pairwise geometric histograms: angle by distance bins (the PGH file starts with these)
+static const int pghBins = 8;
+
+CvHistogram* CreatePGHHistogram() {
+	int dims[] = {pghBins, pghBins};
 	float range[] = {-180, 180, -100, 100};
 	float *ranges[] = {&range[0], &range[2]};
-    CvHistogram* hist1 = cvCreateHist(2, dims, CV_HIST_ARRAY, ranges, 1);
-    CvHistogram* hist2 = cvCreateHist(2, dims, CV_HIST_ARRAY, ranges, 1);
-	cvCalcPGH(shape1, hist1);
-    cvCalcPGH(shape2, hist2);
-	cvNormalizeHist(hist1, 100.0f);
-	cvNormalizeHist(hist2, 100.0f);
-    double corr = cvCompareHist(hist1, hist2, CV_COMP_BHATTACHARYYA);
-    cvReleaseHist(&hist1);
-    cvReleaseHist(&hist2);
-	return corr;
+    return cvCreateHist(2, dims, CV_HIST_ARRAY, ranges, 1);
+}
+
+// works out the normalized PGH of a contour, ready to compare with cvCompareHist
+void CalcNormalizedPGH(CvSeq *shape, CvHistogram *hist) {
+	cvCalcPGH(shape, hist);
+	cvNormalizeHist(hist, 100.0f);
 }
 
 ShapeClassifier::ShapeClassifier() :
 	Classifier() {
     templateStorage = cvCreateMemStorage(0);
+    templateContours = NULL;
+
+	// working images are allocated on the first frame
+	copy = grayscale = newMask = NULL;
+	storage = cvCreateMemStorage(0);
+	frameHist = CreatePGHHistogram();
 
     // set the default "friendly name" and type
     wcscpy(friendlyName, L"Shape Recognizer");
     classifierType = SHAPE_FILTER;        
+    workingWidth = SHAPE_WORKING_WIDTH;
 
     // append identifier to directory name
     wcscat(directoryName, FILE_SHAPE_SUFFIX);
@@ -39,6 +47,11 @@ ShapeClassifier::ShapeClassifier(LPCWSTR pathname) :
 	USES_CONVERSION;
     templateStorage = cvCreateMemStorage(0);
 
+	// working images are allocated on the first frame
+	copy = grayscale = newMask = NULL;
+	storage = cvCreateMemStorage(0);
+	frameHist = CreatePGHHistogram();
+
     WCHAR filename[MAX_PATH];
     wcscpy(filename, pathname);
     wcscat(filename, FILE_CONTOUR_NAME);
@@ -46,14 +59,25 @@ ShapeClassifier::ShapeClassifier(LPCWSTR pathname) :
     // load the contours from the data file
     templateContours = (CvSeq*)cvLoad(W2A(filename), templateStorage, 0, 0);
 
+	// and their histograms, which older recognizers don't have saved
+	if (!LoadTemplateHistograms(pathname)) UpdateTemplateHistograms();
+
 	// set the type
 	classifierType = SHAPE_FILTER;
+	workingWidth = SHAPE_WORKING_WIDTH;
 
     UpdateContourImage();
 }
 
 ShapeClassifier::~ShapeClassifier() {
     cvReleaseMemStorage(&templateStorage);
+	ReleaseTemplateHistograms();
+
+    cvReleaseImage(&copy);
+    cvReleaseImage(&grayscale);
+    cvReleaseImage(&newMask);
+    cvReleaseMemStorage(&storage);
+    cvReleaseHist(&frameHist);
 }
 
 BOOL ShapeClassifier::ContainsSufficientSamples(TrainingSet *sampleSet) {
@@ -105,6 +129,7 @@ void ShapeClassifier::StartTraining(TrainingSet *sampleSet) {
         }
     }
 
+    UpdateTemplateHistograms();
     UpdateContourImage();
 
     if (isOnDisk) { // this classifier has been saved so we'll update the files
@@ -115,32 +140,73 @@ void ShapeClassifier::StartTraining(TrainingSet *sampleSet) {
 	isTrained = true;
 }
 
+Classifier* ShapeClassifier::CreateStreamInstance() {
+	ShapeClassifier *instance = new ShapeClassifier();
+	instance->InitStreamInstance(this);
+	return instance;
+}
+
 ClassifierOutputData ShapeClassifier::ClassifyFrame(IplImage *frame) {
+	frameContext.SetFrame(frame);
+	return ClassifyFrame(&frameContext);
+}
+
+ClassifierOutputData ShapeClassifier::ClassifyFrame(FrameContext *context) {
 	cvZero(guessMask);
 	if (!isTrained) return outputData;
+	IplImage *frame = context->GetFrame();
     if(!frame) return outputData;
 
-    IplImage *copy = cvCreateImage( cvSize(frame->width, frame->height), IPL_DEPTH_8U, 3);
-    IplImage *grayscale = cvCreateImage( cvSize(frame->width, frame->height), IPL_DEPTH_8U, 1);
-    IplImage *newMask = cvCreateImage( cvSize(frame->width, frame->height), IPL_DEPTH_8U, 1);
+    EnsureImage(&copy, cvSize(frame->width, frame->height), IPL_DEPTH_8U, 3);
+    EnsureImage(&grayscale, cvSize(frame->width, frame->height), IPL_DEPTH_8U, 1);
+    EnsureImage(&newMask, cvSize(frame->width, frame->height), IPL_DEPTH_8U, 1);
     cvZero(newMask);
 
-    cvCvtColor(frame, grayscale, CV_BGR2GRAY);
-    cvCanny(grayscale, grayscale, SHAPE_CANNY_EDGE_LINK, SHAPE_CANNY_EDGE_FIND, SHAPE_CANNY_APERTURE);
-	cvDilate(grayscale, grayscale, 0, 2);
+    IplImage *edges = context->GetEdges();
+    cvClearMemStorage(storage);
 
-    cvCvtColor(grayscale, copy, CV_GRAY2BGR);
+	// only the regions of interest get filled in below
+	if (context->HasRegions()) {
+		cvZero(copy);
+		cvZero(grayscale);
+	}
+
+	for (int r=0; r<context->NumRegions(); r++) {
+		CvRect region = context->GetRegion(r);
+		CvMat edgesRegion, grayRegion, copyRegion;
+		cvGetSubRect(edges, &edgesRegion, region);
+		cvGetSubRect(grayscale, &grayRegion, region);
+		cvGetSubRect(copy, &copyRegion, region);
+
+	    // the edge image is shared with the other classifiers on this frame, and cvFindContours
+	    // overwrites its input, so we work on a copy
+	    cvCopy(&edgesRegion, &grayRegion);
+	    cvCvtColor(&grayRegion, &copyRegion, CV_GRAY2BGR);
+
+	    CvSeq *frameContours = NULL;
+	    cvFindContours(&grayRegion, storage, &frameContours, sizeof(CvContour), CV_RETR_EXTERNAL, CV_CHAIN_APPROX_TC89_KCOS, cvPoint(region.x,region.y));
+		MatchContours(frameContours);
+	}
+
+    cvResize(copy, applyImage);
+    IplToBitmap(applyImage, applyBitmap);
 
-    CvSeq *frameContours;
-    CvMemStorage *storage = cvCreateMemStorage(0);
-    cvFindContours(grayscale, storage, &frameContours, sizeof(CvContour), CV_RETR_EXTERNAL, CV_CHAIN_APPROX_TC89_KCOS);
+	// copy the final output mask
+    cvResize(newMask, guessMask);
 
+	UpdateStandardOutputData();
+	return outputData;
+}
+
+void ShapeClassifier::MatchContours(CvSeq *frameContours) {
+	const vector<CvHistogram*> &modelHists = GetModel()->templateHists;
     for (CvSeq *contour = frameContours; contour != NULL; contour = contour->h_next) {
         if ( contour->total > SHAPE_MIN_CONTOUR_POINTS) {
+			// the histogram of each frame contour is worked out once, and compared with those of the templates
+			CalcNormalizedPGH(contour, frameHist);
             int contourNum = 0;
-            for (CvSeq *matchContour = templateContours; matchContour != NULL; matchContour = matchContour->h_next) {
-//                double match_error = cvMatchShapes(contour, matchContour, CV_CONTOURS_MATCH_I1, 0);
-                double match_error = pghMatchShapes(contour, matchContour);
+            for (int i=0; i<(int)modelHists.size(); i++) {
+                double match_error = cvCompareHist(frameHist, modelHists[i], CV_COMP_BHATTACHARYYA);
 				if (match_error < (0.75-threshold*.75)) {
                     cvDrawContours(copy, contour, colorSwatch[contourNum], CV_RGB(0,0,0), 0, 3, 8, cvPoint(0,0));
 		            CvRect rect = cvBoundingRect(contour, 1);
@@ -152,19 +218,60 @@ ClassifierOutputData ShapeClassifier::ClassifyFrame(IplImage *frame) {
             }
         }
     }
-    cvResize(copy, applyImage);
-    IplToBitmap(applyImage, applyBitmap);
+}
 
-	// copy the final output mask
-    cvResize(newMask, guessMask);
+void ShapeClassifier::UpdateTemplateHistograms() {
+	ReleaseTemplateHistograms();
+    for (CvSeq *contour = templateContours; contour != NULL; contour = contour->h_next) {
+		CvHistogram *hist = CreatePGHHistogram();
+		CalcNormalizedPGH(contour, hist);
+		templateHists.push_back(hist);
+	}
+}
 
-    cvReleaseMemStorage(&storage);
-    cvReleaseImage(&copy);
-    cvReleaseImage(&grayscale);
-	cvReleaseImage(&newMask);
+bool ShapeClassifier::LoadTemplateHistograms(LPCWSTR pathname) {
+	USES_CONVERSION;
+    WCHAR filename[MAX_PATH];
+    wcscpy(filename, pathname);
+    wcscat(filename, FILE_CONTOUR_NAME);
+	unsigned long long contourHash = ResultCache::HashFile(ResultCache::HASH_START, W2A(filename));
+    wcscpy(filename, pathname);
+    wcscat(filename, FILE_PGH_NAME);
 
-	UpdateStandardOutputData();
-	return outputData;
+	int numContours = 0;
+    for (CvSeq *contour = templateContours; contour != NULL; contour = contour->h_next) {
+		 numContours++;
+	}
+
+	// the file holds the bins along each axis, the number of templates and a hash of the contour
+	// file they were worked out from, then the bins of each histogram; it is only used if the
+	// contour file hasn't changed since
+    FILE *datafile = fopen(W2A(filename), "rb");
+	if (datafile == NULL) return false;
+	int header[2] = {0, 0};
+	unsigned long long savedHash = 0;
+	bool loaded = (fread(header, sizeof(int), 2, datafile) == 2) && (header[0] == pghBins) && (header[1] == numContours) &&
+		(fread(&savedHash, sizeof(savedHash), 1, datafile) == 1) && (savedHash == contourHash);
+	ReleaseTemplateHistograms();
+	for (int i=0; loaded && (i<numContours); i++) {
+		CvHistogram *hist = CreatePGHHistogram();
+		templateHists.push_back(hist);
+		for (int j=0; loaded && (j<pghBins*pghBins); j++) {
+			float val;
+			loaded = (fread(&val, sizeof(float), 1, datafile) == 1);
+			cvSetReal2D(hist->bins, j/pghBins, j%pghBins, val);
+		}
+	}
+	fclose(datafile);
+	if (!loaded) ReleaseTemplateHistograms();
+	return loaded;
+}
+
+void ShapeClassifier::ReleaseTemplateHistograms() {
+	for (int i=0; i<(int)templateHists.size(); i++) {
+		cvReleaseHist(&templateHists[i]);
+	}
+	templateHists.clear();
 }
 
 void ShapeClassifier::UpdateContourImage() {
@@ -226,4 +333,21 @@ void ShapeClassifier::Save() {
         0
     };
     cvSave(W2A(filename), templateContours, 0, 0, cvAttrList(contour_attrs,0));
+	unsigned long long contourHash = ResultCache::HashFile(ResultCache::HASH_START, W2A(filename));
+
+	// and their histograms, so loading doesn't have to work them out again
+    wcscpy(filename,directoryName);
+    wcscat(filename, FILE_PGH_NAME);
+    FILE *datafile = fopen(W2A(filename), "wb");
+	if (datafile == NULL) return;
+	int header[2] = {pghBins, (int)templateHists.size()};
+	fwrite(header, sizeof(int), 2, datafile);
+	fwrite(&contourHash, sizeof(contourHash), 1, datafile);
+	for (int i=0; i<(int)templateHists.size(); i++) {
+		for (int j=0; j<pghBins*pghBins; j++) {
+			float val = (float)cvGetReal2D(templateHists[i]->bins, j/pghBins, j%pghBins);
+	        fwrite(&val, sizeof(float), 1, datafile);
+		}
+	}
+    fclose(datafile);
 }
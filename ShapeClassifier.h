@@ -10,12 +10,31 @@ public:
     BOOL ContainsSufficientSamples(TrainingSet*);
 	void StartTraining(TrainingSet*);
 	ClassifierOutputData ClassifyFrame(IplImage*);
+	ClassifierOutputData ClassifyFrame(FrameContext*);
+	int GetFrameRequirements() { return FRAME_EDGES; }
     void Save();
 	void ResetRunningState() {}		// This classifier doesn't have store any new state info while running live
+	Classifier* CreateStreamInstance();
 
 private:
     void UpdateContourImage();
+	void MatchContours(CvSeq *frameContours);
+
+	// the normalized PGH of each template contour, in the same order, worked out once when the
+	// templates change (or read back from the file Save writes)
+	void UpdateTemplateHistograms();
+	bool LoadTemplateHistograms(LPCWSTR pathname);
+	void ReleaseTemplateHistograms();
+
+	// the classifier holding the template contours (this one, unless we are a stream instance)
+	ShapeClassifier* GetModel() { return sharedModel ? (ShapeClassifier*)sharedModel : this; }
 
     CvMemStorage *templateStorage;
     CvSeq *templateContours;
+	vector<CvHistogram*> templateHists;
+
+	// working images, contour storage and the PGH of a frame contour, kept between frames
+	IplImage *copy, *grayscale, *newMask;
+	CvMemStorage *storage;
+	CvHistogram *frameHist;
 };
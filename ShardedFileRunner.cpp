@@ -0,0 +1,332 @@
+#include "precomp.h"
+#include "constants.h"
+#include "TrainingSample.h"
+#include "TrainingSet.h"
+#include "Classifier.h"
+#include "OutputSink.h"
+#include "ShardedFileRunner.h"
+
+ShardedFileRunner::ShardedFileRunner() {
+	maxFrames = 0;
+	gopFrames = SHARD_GOP_FRAMES;
+	segmentFrames = 0;
+	warmupFrames = SHARD_WARMUP_FRAMES;
+	keepFrames = false;
+	videoX = 0;
+	videoY = 0;
+	fps = 0;
+	framesAvailable = 0;
+	nFrames = 0;
+	elapsedSeconds = 0;
+	nextSegment = 0;
+	nextToSend = 0;
+	maxSegmentsAhead = 0;
+	processingVideo = false;
+	stopRequested = false;
+}
+
+ShardedFileRunner::~ShardedFileRunner() {
+	StopProcessing();
+	ClearOutputs();
+	ReleaseWorkers();
+	ReleaseSegments();
+}
+
+void ShardedFileRunner::AddModel(Classifier *model) {
+	models.push_back(model);
+}
+
+void ShardedFileRunner::ReleaseWorkers() {
+	for (int i=0; i<(int)workers.size(); i++) {
+		Worker *w = workers[i];
+		// the chain only refers to the classifiers, so it has to let go of them before they are deleted
+		w->chain->ClearActiveFilters();
+		delete w->chain;
+		for (int j=0; j<(int)w->classifiers.size(); j++) {
+			delete w->classifiers[j];
+		}
+		if (w->capture != NULL) cvReleaseCapture(&w->capture);
+		delete w;
+	}
+	workers.clear();
+}
+
+bool ShardedFileRunner::OpenFile(const char *name, int nWorkers) {
+	if (processingVideo) return false;
+	ClearOutputs();
+	ReleaseWorkers();
+	filename = name;
+
+	// some capture backends only report the frame size once the first frame is decoded
+	CvCapture *capture = cvCreateFileCapture(name);
+	if (capture == NULL) return false;
+	fps = cvGetCaptureProperty(capture, CV_CAP_PROP_FPS);
+	framesAvailable = (long) cvGetCaptureProperty(capture, CV_CAP_PROP_FRAME_COUNT);
+	IplImage *firstFrame = cvQueryFrame(capture);
+	if (firstFrame != NULL) {
+		videoX = firstFrame->width;
+		videoY = firstFrame->height;
+	}
+	cvReleaseCapture(&capture);
+	if ((firstFrame == NULL) || (framesAvailable <= 0)) return false;
+
+	if (nWorkers <= 0) nWorkers = ThreadPool::NumProcessors();
+	for (int i=0; i<nWorkers; i++) {
+		Worker *w = new Worker();
+		w->capture = NULL;
+		w->position = 0;
+		w->chain = new FilterChain();
+		w->chain->drawContours = false;		// nothing shows the workers' output frames
+		workers.push_back(w);
+		for (int j=0; j<(int)models.size(); j++) {
+			Classifier *c = models[j]->CreateStreamInstance();
+			if (c == NULL) {
+				ReleaseWorkers();
+				return false;
+			}
+			w->classifiers.push_back(c);
+			w->chain->AddActiveFilter(c);
+		}
+	}
+	return true;
+}
+
+int ShardedFileRunner::NumWorkers() {
+	return (int)workers.size();
+}
+
+FilterChain& ShardedFileRunner::GetWorkerChain(int index) {
+	return *workers[index]->chain;
+}
+
+const vector<Classifier*>& ShardedFileRunner::GetWorkerClassifiers(int index) {
+	return workers[index]->classifiers;
+}
+
+void ShardedFileRunner::AddOutput(OutputSink *o) {
+	if (!outputChain.AddActiveOutput(o)) return;
+	outputs.push_back(o);
+
+	// the workers never send anything themselves, but they only gather the output
+	// variables for chains that have outputs to send them to
+	for (int i=0; i<(int)workers.size(); i++) {
+		workers[i]->chain->AddActiveOutput(o);
+	}
+}
+
+void ShardedFileRunner::ClearOutputs() {
+	for (int i=0; i<(int)workers.size(); i++) {
+		workers[i]->chain->ClearActiveOutputs();
+	}
+	outputChain.ClearActiveOutputs();
+	outputs.clear();
+}
+
+bool ShardedFileRunner::StartProcessing() {
+	if (processingVideo || workers.empty()) return false;
+	ReleaseSegments();
+
+	long nTotal = framesAvailable;
+	if ((maxFrames > 0) && (maxFrames < nTotal)) nTotal = maxFrames;
+	if (gopFrames < 1) gopFrames = 1;
+
+	// cut the file into whole GOPs, a few segments per worker so they finish close together
+	long length = segmentFrames;
+	if (length <= 0) length = (nTotal + 4*(long)workers.size() - 1) / (4*(long)workers.size());
+	length = max(1L, (length + gopFrames - 1) / gopFrames) * gopFrames;
+	for (long start = 0; start < nTotal; start += length) {
+		Segment *segment = new Segment();
+		segment->start = start;
+		segment->end = min(start + length, nTotal);
+		// round the warm-up back to a keyframe too, so the seek lands exactly on it
+		segment->warmupStart = max(0L, ((start - warmupFrames) / gopFrames) * gopFrames);
+		segment->done = false;
+		segments.push_back(segment);
+	}
+
+	for (int i=0; i<(int)workers.size(); i++) {
+		Worker *w = workers[i];
+		if (w->capture != NULL) cvReleaseCapture(&w->capture);
+		w->capture = cvCreateFileCapture(filename.c_str());
+		if (w->capture == NULL) return false;
+		w->position = 0;
+		w->chain->StartProcessing(videoX, videoY);
+		w->chain->metrics.Reset();
+		w->chain->ResetActiveFilterRunningStates();
+	}
+	outputChain.metrics.Reset();
+
+	nextSegment = 0;
+	nextToSend = 0;
+	maxSegmentsAhead = 2*(int)workers.size();
+	nFrames = 0;
+	stopRequested = false;
+	processingVideo = true;
+
+	startTime = std::chrono::steady_clock::now();
+	for (int i=0; i<(int)workers.size(); i++) {
+		workers[i]->thread = std::thread(&ShardedFileRunner::WorkerLoop, this, workers[i]);
+	}
+	m_thread = std::thread(&ShardedFileRunner::SendSegments, this);
+	return true;
+}
+
+void ShardedFileRunner::StopProcessing() {
+	{
+		std::lock_guard<std::mutex> lock(segmentLock);
+		stopRequested = true;
+	}
+	segmentProgress.notify_all();
+	WaitForCompletion();
+}
+
+void ShardedFileRunner::WaitForCompletion() {
+	if (m_thread.joinable()) {
+		m_thread.join();
+	}
+	for (int i=0; i<(int)workers.size(); i++) {
+		if (workers[i]->thread.joinable()) workers[i]->thread.join();
+		if (workers[i]->chain->isProcessing) workers[i]->chain->StopProcessing();
+	}
+}
+
+bool ShardedFileRunner::IsProcessing() {
+	return processingVideo;
+}
+
+void ShardedFileRunner::WorkerLoop(Worker *worker) {
+	while (true) {
+		Segment *segment;
+		{
+			std::unique_lock<std::mutex> lock(segmentLock);
+			while (!stopRequested && (nextSegment < (int)segments.size()) && (nextSegment >= nextToSend + maxSegmentsAhead)) {
+				segmentProgress.wait(lock);
+			}
+			if (stopRequested || (nextSegment >= (int)segments.size())) break;
+			segment = segments[nextSegment++];
+		}
+
+		// only this worker touches the segment until it is done
+		ProcessSegment(worker, segment);
+		{
+			std::lock_guard<std::mutex> lock(segmentLock);
+			segment->done = true;
+		}
+		segmentProgress.notify_all();
+	}
+}
+
+bool ShardedFileRunner::SeekWorker(Worker *worker, long frame) {
+	// a seek lands on the keyframe at or before the frame; backends that can't seek (or land
+	// past it) are reopened, and whatever is left is decoded and skipped
+	if ((frame < worker->position) || (frame - worker->position > gopFrames)) {
+		cvSetCaptureProperty(worker->capture, CV_CAP_PROP_POS_FRAMES, (double)frame);
+		worker->position = (long) cvGetCaptureProperty(worker->capture, CV_CAP_PROP_POS_FRAMES);
+		if ((worker->position < 0) || (worker->position > frame)) {
+			cvReleaseCapture(&worker->capture);
+			worker->capture = cvCreateFileCapture(filename.c_str());
+			worker->position = 0;
+			if (worker->capture == NULL) return false;
+		}
+	}
+	while (worker->position < frame) {
+		if (!cvGrabFrame(worker->capture)) return false;
+		worker->position++;
+	}
+	return true;
+}
+
+void ShardedFileRunner::ProcessSegment(Worker *worker, Segment *segment) {
+	long from = segment->start;
+	if (worker->position != segment->start) {
+		from = segment->warmupStart;
+		if (!SeekWorker(worker, from)) return;
+		worker->chain->ResetActiveFilterRunningStates();
+	}
+
+	// frame numbers count from 1 as in the other runners, so motion history and the
+	// scheduler's cadences line up whichever worker classifies a frame
+	for (long f = from; (f < segment->end) && !stopRequested; f++) {
+		IplImage *captured = cvQueryFrame(worker->capture);
+		if (captured == NULL) break;	// the file is shorter than it said
+		worker->position++;
+		worker->frame.Attach(captured);
+
+		// only CASCADE mode writes to the frame, so otherwise the capture buffer is classified in place
+		bool writesFrame = (worker->chain->filterCombineMode == IDC_COMBINE_CASCADE);
+		if (f < segment->start) {
+			// warming up: the chain still needs somewhere to put the results, which nobody sees
+			worker->warmupResults.Clear();
+			worker->chain->ApplyFilterChain(writesFrame ? worker->frame.GetWritable() : worker->frame.Get(), f+1, &worker->warmupResults);
+			continue;
+		}
+
+		// copied before classifying, since CASCADE mode blacks out parts of the frame
+		if (keepFrames) segment->frames.push_back(cvCloneImage(worker->frame.Get()));
+		FrameResults *results = new FrameResults();
+		worker->chain->ApplyFilterChain(writesFrame ? worker->frame.GetWritable() : worker->frame.Get(), f+1, results);
+		segment->results.push_back(results);
+	}
+}
+
+void ShardedFileRunner::SendSegments() {
+	for (int s=0; s<(int)segments.size(); s++) {
+		Segment *segment = segments[s];
+		{
+			std::unique_lock<std::mutex> lock(segmentLock);
+			while (!segment->done && !stopRequested) {
+				segmentProgress.wait(lock);
+			}
+			if (!segment->done) break;
+		}
+
+		for (int i=0; i<(int)segment->results.size(); i++) {
+			IplImage *frame = keepFrames ? segment->frames[i] : NULL;
+			outputChain.ProcessInput(frame);
+			outputChain.SendResults(frame, segment->results[i]);
+			nFrames++;
+		}
+		bool videoEnded = ((long)segment->results.size() < segment->end - segment->start);
+		ReleaseSegment(segment);
+		{
+			std::lock_guard<std::mutex> lock(segmentLock);
+			nextToSend = s+1;
+		}
+		segmentProgress.notify_all();
+
+		// the frames after a short segment don't exist (or we were stopped), so neither do later segments
+		if (videoEnded) break;
+	}
+
+	// let the workers go, and wait for them to finish what they were doing
+	{
+		std::lock_guard<std::mutex> lock(segmentLock);
+		stopRequested = true;
+	}
+	segmentProgress.notify_all();
+	for (int i=0; i<(int)workers.size(); i++) {
+		if (workers[i]->thread.joinable()) workers[i]->thread.join();
+	}
+
+	elapsedSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+	processingVideo = false;
+}
+
+void ShardedFileRunner::ReleaseSegment(Segment *segment) {
+	for (int i=0; i<(int)segment->results.size(); i++) {
+		delete segment->results[i];
+	}
+	for (int i=0; i<(int)segment->frames.size(); i++) {
+		cvReleaseImage(&segment->frames[i]);
+	}
+	segment->results.clear();
+	segment->frames.clear();
+}
+
+void ShardedFileRunner::ReleaseSegments() {
+	for (int i=0; i<(int)segments.size(); i++) {
+		ReleaseSegment(segments[i]);
+		delete segments[i];
+	}
+	segments.clear();
+}
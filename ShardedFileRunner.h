@@ -0,0 +1,118 @@
+#pragma once
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include "FilterChain.h"
+#include "FrameView.h"
+
+// Runs a filter chain over a recorded video file on several threads at once.  The file is cut
+// into segments that start on keyframes (multiples of gopFrames), and each worker thread decodes
+// and classifies whole segments with its own capture and its own stream instance of each model
+// (see Classifier::CreateStreamInstance).  The results are sent to the outputs in frame order,
+// each segment as soon as it and all the segments before it are done.
+//
+// A worker that picks up a segment straight after the one it just finished carries on with its
+// state.  Otherwise it starts warmupFrames earlier and throws those results away, so stateful
+// recognizers (motion, gesture, background subtraction) have settled by the first frame it sends.
+class ShardedFileRunner
+{
+public:
+	ShardedFileRunner();
+	~ShardedFileRunner();
+
+	// the recognizers applied to the file, in chain order; they belong to the caller and must
+	// outlive the runner.  Add them all before opening the file.
+	void AddModel(Classifier *model);
+
+	// opens the file and sets up nWorkers workers (0 for one per processor); false if the file
+	// can't be read, its length is unknown, or one of the models can't run on more than one stream
+	bool OpenFile(const char *filename, int nWorkers);
+
+	// configure the chain of each worker (combine mode, scheduling); the classifiers are the
+	// worker's instances of the models, in the same order
+	int NumWorkers();
+	FilterChain& GetWorkerChain(int index);
+	const vector<Classifier*>& GetWorkerClassifiers(int index);
+
+	// outputs receive every frame's results in order, from a single thread; add them after opening
+	void AddOutput(OutputSink *o);
+	void ClearOutputs();
+
+	bool StartProcessing();
+	void StopProcessing();
+	void WaitForCompletion();
+	bool IsProcessing();
+
+	// stop after this many frames (0 means run until the video ends)
+	long maxFrames;
+
+	// keyframe interval the segments are aligned to, frames per segment (0 picks a length that
+	// gives each worker a few segments; always a whole number of GOPs) and warm-up frames
+	int gopFrames;
+	long segmentFrames;
+	int warmupFrames;
+
+	// pass the frames to the outputs.  Each frame of a segment is then held until the segment is
+	// sent, so this is off by default; the console and OSC outputs are given NULL frames.
+	bool keepFrames;
+
+	// times the outputs (the workers' chains time the recognizers)
+	PipelineMetrics& GetOutputMetrics() { return outputChain.metrics; }
+
+	int videoX, videoY;
+	double fps;
+	long framesAvailable;
+
+	std::atomic<long> nFrames;
+
+	// wall clock time from the start to the last output
+	double elapsedSeconds;
+
+private:
+	// a run of frames [start, end) (counting from 0), and the results of each once classified
+	struct Segment {
+		long start, end;
+		long warmupStart;		// where a worker that has to seek starts from
+		bool done;
+		vector<FrameResults*> results;
+		vector<IplImage*> frames;		// only with keepFrames
+	};
+
+	struct Worker {
+		CvCapture *capture;
+		long position;			// the frame the capture returns next
+		FilterChain *chain;
+		vector<Classifier*> classifiers;
+		FrameView frame;
+		FrameResults warmupResults;
+		std::thread thread;
+	};
+
+	void ReleaseWorkers();
+	void ReleaseSegments();
+	void ReleaseSegment(Segment *segment);
+
+	void WorkerLoop(Worker *worker);
+	void ProcessSegment(Worker *worker, Segment *segment);
+	bool SeekWorker(Worker *worker, long frame);
+	void SendSegments();
+
+	string filename;
+	vector<Classifier*> models;
+	vector<Worker*> workers;
+	vector<Segment*> segments;
+	list<OutputSink*> outputs;
+	FilterChain outputChain;	// only its outputs and metrics are used
+
+	// the next segment to hand out and the next to send; workers stay at most
+	// maxSegmentsAhead segments ahead of the outputs, bounding what is held in memory
+	int nextSegment, nextToSend, maxSegmentsAhead;
+	std::mutex segmentLock;
+	std::condition_variable segmentProgress;
+
+	std::thread m_thread;
+	std::chrono::steady_clock::time_point startTime;
+	std::atomic<bool> processingVideo;
+	std::atomic<bool> stopRequested;
+};
@@ -12,10 +12,14 @@ SiftClassifier::SiftClassifier() :
     numSampleFeatures = 0;
     sampleCopy = NULL;
     sampleFeatures = NULL;
+    frameCopy = featureImage = newMask = regionImage = NULL;
+    matchedFeatures = NULL;
+    matchedCapacity = 0;
 
     // set the default "friendly name" and type
     wcscpy(friendlyName, L"SIFT Recognizer");
     classifierType = SIFT_FILTER;
+    workingWidth = SIFT_WORKING_WIDTH;
 
     // append identifier to directory name
     wcscat(directoryName, FILE_SIFT_SUFFIX);
@@ -27,6 +31,9 @@ SiftClassifier::SiftClassifier(LPCWSTR pathname) :
     numSampleFeatures = 0;
     sampleCopy = NULL;
     sampleFeatures = NULL;
+    frameCopy = featureImage = newMask = regionImage = NULL;
+    matchedFeatures = NULL;
+    matchedCapacity = 0;
 
     WCHAR filename[MAX_PATH];
     wcscpy(filename, pathname);
@@ -44,6 +51,7 @@ SiftClassifier::SiftClassifier(LPCWSTR pathname) :
 
 	// set the type
     classifierType = SIFT_FILTER;
+    workingWidth = SIFT_WORKING_WIDTH;
 
     UpdateSiftImage();
 }
@@ -51,6 +59,11 @@ SiftClassifier::SiftClassifier(LPCWSTR pathname) :
 SiftClassifier::~SiftClassifier() {
     if (sampleCopy) cvReleaseImage(&sampleCopy);
     if (numSampleFeatures > 0) free(sampleFeatures);
+    cvReleaseImage(&frameCopy);
+    cvReleaseImage(&featureImage);
+    cvReleaseImage(&regionImage);
+    cvReleaseImage(&newMask);
+    if (matchedFeatures) free(matchedFeatures);
 }
 
 BOOL SiftClassifier::ContainsSufficientSamples(TrainingSet *sampleSet) {
@@ -92,20 +105,53 @@ void SiftClassifier::StartTraining(TrainingSet *sampleSet) {
     UpdateSiftImage();
 }
 
+Classifier* SiftClassifier::CreateStreamInstance() {
+	SiftClassifier *instance = new SiftClassifier();
+	instance->InitStreamInstance(this);
+	return instance;
+}
+
 ClassifierOutputData SiftClassifier::ClassifyFrame(IplImage *frame) {
+	frameContext.SetFrame(frame);
+	return ClassifyFrame(&frameContext);
+}
+
+ClassifierOutputData SiftClassifier::ClassifyFrame(FrameContext *context) {
 	cvZero(guessMask);
 	if (!isTrained) return outputData;
+	IplImage *frame = context->GetFrame();
     if(!frame) return outputData;
+	SiftClassifier *model = GetModel();
 
     // copy current frame and sample image for demo image
-    IplImage *frameCopy = cvCloneImage(frame);
-    IplImage *featureImage = cvCloneImage(sampleCopy);
-    IplImage *newMask = cvCreateImage(cvGetSize(frame), IPL_DEPTH_8U, 1);
+    EnsureImage(&frameCopy, cvGetSize(frame), frame->depth, frame->nChannels);
+    EnsureImage(&featureImage, cvGetSize(model->sampleCopy), model->sampleCopy->depth, model->sampleCopy->nChannels);
+    EnsureImage(&newMask, cvGetSize(frame), IPL_DEPTH_8U, 1);
+    cvCopy(frame, frameCopy);
+    cvCopy(model->sampleCopy, featureImage);
     cvZero(newMask);
 
-    // get features in current frame
-    struct feature *frameFeatures;
-    int nFeatures = sift_features(frameCopy, &frameFeatures);
+    // get features in current frame, or just in the box around the regions of interest
+    // (feature detection needs a contiguous image, so we search the bounding box of all the regions)
+    struct feature *frameFeatures = NULL;
+    int nFeatures = 0;
+	CvRect bounds = context->GetRegionBounds();
+	if (!context->HasRegions()) {
+	    nFeatures = sift_features(frameCopy, &frameFeatures);
+	} else if ((bounds.width > 0) && (bounds.height > 0)) {
+		EnsureImage(&regionImage, cvSize(bounds.width, bounds.height), frame->depth, frame->nChannels);
+		CvMat frameRegion;
+		cvCopy(cvGetSubRect(frame, &frameRegion, bounds), regionImage);
+	    nFeatures = sift_features(regionImage, &frameFeatures);
+
+		// move the features back into frame coordinates
+		for (int i=0; i<nFeatures; i++) {
+			frameFeatures[i].x += bounds.x;
+			frameFeatures[i].y += bounds.y;
+			frameFeatures[i].img_pt.x += bounds.x;
+			frameFeatures[i].img_pt.y += bounds.y;
+		}
+	}
 
     if (nFeatures > 0) {
 
@@ -116,13 +162,18 @@ ClassifierOutputData SiftClassifier::ClassifyFrame(IplImage *frame) {
         ptMin.x = frameCopy->width;
         ptMin.y = frameCopy->height;
 
+        if (matchedCapacity < model->numSampleFeatures) {
+            if (matchedFeatures) free(matchedFeatures);
+            matchedCapacity = model->numSampleFeatures;
+            matchedFeatures = (struct feature*)malloc(matchedCapacity*sizeof(struct feature));
+        }
+
         struct kd_node* kd_root = kdtree_build(frameFeatures, nFeatures);
         struct feature** nbrs;
         numFeatureMatches = 0;
-        for(int i=0; i<numSampleFeatures; i++)
+        for(int i=0; i<model->numSampleFeatures; i++)
         {
-            struct feature *feat = sampleFeatures + i;
-            sampleFeatures[i].fwd_match = NULL;
+            struct feature *feat = model->sampleFeatures + i;
             int k = kdtree_bbf_knn(kd_root, feat, 2, &nbrs, KDTREE_BBF_MAX_NN_CHKS);
             if( k == 2 ) {
                 double d0 = descr_dist_sq(feat, nbrs[0]);
@@ -140,8 +191,10 @@ ClassifierOutputData SiftClassifier::ClassifyFrame(IplImage *frame) {
                     // draw feature in frame image
                     cvCircle(frameCopy, ptFrame, 2, colorSwatch[numFeatureMatches % COLOR_SWATCH_SIZE], 4, 8);
 
+                    matchedFeatures[numFeatureMatches] = *feat;
+                    matchedFeatures[numFeatureMatches].fwd_match = nbrs[0];
+                    matchedFeatures[numFeatureMatches].feature_data = NULL;
                     numFeatureMatches++;
-                    sampleFeatures[i].fwd_match = nbrs[0];
                 }
             }
             free( nbrs );
@@ -156,11 +209,11 @@ ClassifierOutputData SiftClassifier::ClassifyFrame(IplImage *frame) {
 
 		if (numFeatureMatches >= SIFT_MIN_RANSAC_FEATURES) {
             // try to use RANSAC algorithm to find transformation
-            CvMat* H = ransac_xform(sampleFeatures, numSampleFeatures, FEATURE_FWD_MATCH, lsq_homog, 4, 0.01, homog_xfer_err, 3.0, NULL, NULL );
+            CvMat* H = ransac_xform(matchedFeatures, numFeatureMatches, FEATURE_FWD_MATCH, lsq_homog, 4, 0.01, homog_xfer_err, 3.0, NULL, NULL );
             if (H != NULL) {
                 IplImage* xformed;
 
-                double pts[] = {0,0,sampleWidth,0,sampleWidth,sampleHeight,0,sampleHeight};
+                double pts[] = {0,0,model->sampleWidth,0,model->sampleWidth,model->sampleHeight,0,model->sampleHeight};
                 CvMat foundRect = cvMat(1, 4, CV_64FC2, pts);
                 cvPerspectiveTransform(&foundRect, &foundRect, H);
 
@@ -200,10 +253,6 @@ ClassifierOutputData SiftClassifier::ClassifyFrame(IplImage *frame) {
 	// copy the final output mask
     cvResize(newMask, guessMask);
 
-    cvReleaseImage(&frameCopy);
-    cvReleaseImage(&featureImage);
-	cvReleaseImage(&newMask);
-
 	UpdateStandardOutputData();
 	return outputData;
 }
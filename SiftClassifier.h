@@ -10,13 +10,27 @@ public:
     BOOL ContainsSufficientSamples(TrainingSet*);
 	void StartTraining(TrainingSet*);
 	ClassifierOutputData ClassifyFrame(IplImage*);
+	ClassifierOutputData ClassifyFrame(FrameContext*);
     void Save();
 	void ResetRunningState() {}		// This classifier doesn't have store any new state info while running live
+	Classifier* CreateStreamInstance();
 
 private:
     void UpdateSiftImage();
+
+	// the classifier holding the sample image and features (this one, unless we are a stream instance)
+	SiftClassifier* GetModel() { return sharedModel ? (SiftClassifier*)sharedModel : this; }
+
     IplImage *sampleCopy;
     int numSampleFeatures, numFeatureMatches;
     int sampleWidth, sampleHeight;
     struct feature* sampleFeatures;
+
+	// working images, kept between frames
+	IplImage *frameCopy, *featureImage, *newMask, *regionImage;
+
+	// copies of the sample features matched in the current frame, with their matches (the
+	// sample features themselves are only read, since other streams may share them)
+	struct feature* matchedFeatures;
+	int matchedCapacity;
 };
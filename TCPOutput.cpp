@@ -32,7 +32,7 @@ DWORD WINAPI TCPOutput::ServerListenThread(SocketServer* server) {
 void TCPOutput::ProcessInput(IplImage *image) {
 }
 
-void TCPOutput::ProcessOutput(IplImage *image, ClassifierOutputData data, char *filterName) {
+void TCPOutput::ProcessOutput(IplImage *image, ClassifierOutputData &data, char *filterName) {
     char buffer[TCP_OUTPUT_BUFFER_SIZE];
     char message[TCP_OUTPUT_BUFFER_SIZE];
 	int ival;
@@ -48,7 +48,7 @@ void TCPOutput::ProcessOutput(IplImage *image, ClassifierOutputData data, char *
 
 	int nVars = data.NumVariables();
 	for (int i=0; i<nVars; i++) {
-		ClassifierOutputVariable var = data.data[i];
+		const ClassifierOutputVariable &var = data.GetVariableOfIndex(i);
 		if (var.GetState() == true) {	// this variable is active
 			switch(var.GetType()) {
 				case CVAR_VOID:
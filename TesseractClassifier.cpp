@@ -15,6 +15,7 @@ TesseractClassifier::TesseractClassifier() :
 
     isTrained = false;
 	isOnDisk = false;
+	frameGray = newMask = NULL;
 
 	// Create the custom output variables for this classifier
 	outputData.AddVariable("Text", "");
@@ -29,6 +30,8 @@ TesseractClassifier::TesseractClassifier(LPCWSTR pathname) :
 }
 
 TesseractClassifier::~TesseractClassifier() {
+	cvReleaseImage(&frameGray);
+	cvReleaseImage(&newMask);
 }
 
 BOOL TesseractClassifier::ContainsSufficientSamples(TrainingSet *sampleSet) {
@@ -45,15 +48,21 @@ void TesseractClassifier::StartTraining(TrainingSet *sampleSet) {
 }
 
 ClassifierOutputData TesseractClassifier::ClassifyFrame(IplImage *frame) {
+	frameContext.SetFrame(frame);
+	return ClassifyFrame(&frameContext);
+}
+
+ClassifierOutputData TesseractClassifier::ClassifyFrame(FrameContext *context) {
 	cvZero(guessMask);
+	IplImage *frame = context->GetFrame();
     if(!frame) return outputData;
 
-    IplImage *frameGray = cvCreateImage(cvGetSize(frame), IPL_DEPTH_8U, 1);
-    IplImage *newMask = cvCreateImage(cvGetSize(frame), IPL_DEPTH_8U, 1);
+    EnsureImage(&frameGray, cvGetSize(frame), IPL_DEPTH_8U, 1);
+    EnsureImage(&newMask, cvGetSize(frame), IPL_DEPTH_8U, 1);
     cvZero(newMask);
 
-	cvCvtColor(frame, frameGray, CV_BGR2GRAY);
-	cvThreshold(frameGray, frameGray, 0, 255, CV_THRESH_BINARY+CV_THRESH_OTSU);
+	// threshold the shared grayscale image into our own buffer
+	cvThreshold(context->GetGray(), frameGray, 0, 255, CV_THRESH_BINARY+CV_THRESH_OTSU);
 
 	api.BeginPageUpright(frameGray->width, frameGray->height, (unsigned char*)frameGray->imageData, frameGray->depth);
 	ETEXT_DESC* output = api.Recognize_all_Words();
@@ -74,15 +83,13 @@ ClassifierOutputData TesseractClassifier::ClassifyFrame(IplImage *frame) {
 		cvRectangle(newMask, cvPoint(ch->left, ch->top), cvPoint(ch->right, ch->bottom), cvScalar(0xFF), CV_FILLED);
 	}
 	buffer[len] = '\0';
-	outputData.SetVariable("Text", buffer);
+	if (IsOutputNeeded(CVAR_ID_TEXT)) outputData.SetVariable(CVAR_ID_TEXT, buffer);
 
 	// copy the final output mask
 	cvResize(newMask, guessMask);
 
 	UpdateStandardOutputData();
 
-	cvReleaseImage(&newMask);
-
 	return outputData;
 }
 
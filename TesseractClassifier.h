@@ -10,9 +10,14 @@ public:
     BOOL ContainsSufficientSamples(TrainingSet*);
     void StartTraining(TrainingSet*);
 	ClassifierOutputData ClassifyFrame(IplImage*);
+	ClassifierOutputData ClassifyFrame(FrameContext*);
+	int GetFrameRequirements() { return FRAME_GRAY; }
     void Save();
 	void ResetRunningState();
 
 private:
 	TessDllAPI api;
+
+	// working images, kept between frames
+	IplImage *frameGray, *newMask;
 };
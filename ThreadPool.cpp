@@ -0,0 +1,186 @@
+#include "precomp.h"
+#include "ThreadPool.h"
+
+#ifndef EYEPATCH_HEADLESS
+// the Win32 thread entry point only gets one parameter, so we pass the worker index along with the pool
+struct ThreadPoolWorker {
+	ThreadPool *pool;
+	int index;
+};
+#endif
+
+ThreadPool::ThreadPool() {
+	nWorkers = 0;
+	currentFunc = NULL;
+	currentArg = NULL;
+	currentTaskCount = 0;
+	nextTask = 0;
+	stopping = false;
+#ifdef EYEPATCH_HEADLESS
+	generation = 0;
+	nBusy = 0;
+#endif
+}
+
+ThreadPool::~ThreadPool() {
+	Stop();
+}
+
+int ThreadPool::NumProcessors() {
+#ifdef EYEPATCH_HEADLESS
+	int n = (int)std::thread::hardware_concurrency();
+	return (n > 0) ? n : 1;
+#else
+	SYSTEM_INFO sysInfo;
+	GetSystemInfo(&sysInfo);
+	return (int)sysInfo.dwNumberOfProcessors;
+#endif
+}
+
+void ThreadPool::Start(int nThreads) {
+	Stop();
+	if (nThreads <= 0) nThreads = NumProcessors()-1;
+	if (nThreads <= 0) return;
+
+	stopping = false;
+	nWorkers = nThreads;
+#ifdef EYEPATCH_HEADLESS
+	for (int i=0; i<nWorkers; i++) {
+		workers.push_back(std::thread(&ThreadPool::WorkerLoop, this, i));
+	}
+#else
+	for (int i=0; i<nWorkers; i++) {
+		startEvents.push_back(CreateEvent(NULL, FALSE, FALSE, NULL));
+		doneEvents.push_back(CreateEvent(NULL, TRUE, TRUE, NULL));
+	}
+	for (int i=0; i<nWorkers; i++) {
+		ThreadPoolWorker *worker = new ThreadPoolWorker;
+		worker->pool = this;
+		worker->index = i;
+		DWORD threadID;
+		workers.push_back(CreateThread(NULL, 0, ThreadCallback, (LPVOID)worker, 0, &threadID));
+	}
+#endif
+}
+
+void ThreadPool::Stop() {
+	if (nWorkers == 0) return;
+#ifdef EYEPATCH_HEADLESS
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		stopping = true;
+	}
+	m_startCondition.notify_all();
+	for (int i=0; i<nWorkers; i++) {
+		workers[i].join();
+	}
+#else
+	stopping = true;
+	for (int i=0; i<nWorkers; i++) {
+		SetEvent(startEvents[i]);
+	}
+	WaitForMultipleObjects(nWorkers, &workers[0], TRUE, INFINITE);
+	for (int i=0; i<nWorkers; i++) {
+		CloseHandle(workers[i]);
+		CloseHandle(startEvents[i]);
+		CloseHandle(doneEvents[i]);
+	}
+	startEvents.clear();
+	doneEvents.clear();
+#endif
+	workers.clear();
+	nWorkers = 0;
+}
+
+int ThreadPool::NumThreads() {
+	return nWorkers;
+}
+
+void ThreadPool::RunTasks() {
+	// claim task indices until there are none left
+	while (true) {
+#ifdef EYEPATCH_HEADLESS
+		int task = nextTask++;
+#else
+		int task = InterlockedIncrement(&nextTask)-1;
+#endif
+		if (task >= currentTaskCount) break;
+		currentFunc(task, currentArg);
+	}
+}
+
+void ThreadPool::ParallelFor(int nTasks, TaskFunc func, void *arg) {
+	if (nTasks <= 0) return;
+	if ((nWorkers == 0) || (nTasks == 1)) {
+		// nothing to gain from waking the workers
+		for (int i=0; i<nTasks; i++) func(i, arg);
+		return;
+	}
+
+	currentFunc = func;
+	currentArg = arg;
+	currentTaskCount = nTasks;
+	nextTask = 0;
+
+#ifdef EYEPATCH_HEADLESS
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		nBusy = nWorkers;
+		generation++;
+	}
+	m_startCondition.notify_all();
+
+	// the calling thread takes tasks too, then waits for the workers to finish theirs
+	RunTasks();
+	std::unique_lock<std::mutex> lock(m_mutex);
+	while (nBusy > 0) m_doneCondition.wait(lock);
+#else
+	for (int i=0; i<nWorkers; i++) {
+		ResetEvent(doneEvents[i]);
+		SetEvent(startEvents[i]);
+	}
+
+	// the calling thread takes tasks too, then waits for the workers to finish theirs
+	RunTasks();
+	WaitForMultipleObjects(nWorkers, &doneEvents[0], TRUE, INFINITE);
+#endif
+}
+
+void ThreadPool::WorkerLoop(int workerIndex) {
+#ifdef EYEPATCH_HEADLESS
+	(void)workerIndex;	// the workers all wait on the one start condition
+	long lastGeneration = 0;
+	while (true) {
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			while (!stopping && (generation == lastGeneration)) m_startCondition.wait(lock);
+			if (stopping) return;
+			lastGeneration = generation;
+		}
+		RunTasks();
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			nBusy--;
+		}
+		m_doneCondition.notify_one();
+	}
+#else
+	while (true) {
+		WaitForSingleObject(startEvents[workerIndex], INFINITE);
+		if (stopping) return;
+		RunTasks();
+		SetEvent(doneEvents[workerIndex]);
+	}
+#endif
+}
+
+#ifndef EYEPATCH_HEADLESS
+DWORD WINAPI ThreadPool::ThreadCallback(LPVOID param) {
+	ThreadPoolWorker *worker = (ThreadPoolWorker*)param;
+	ThreadPool *pool = worker->pool;
+	int index = worker->index;
+	delete worker;
+	pool->WorkerLoop(index);
+	return 0;
+}
+#endif
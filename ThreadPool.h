@@ -0,0 +1,53 @@
+#pragma once
+#ifdef EYEPATCH_HEADLESS
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#endif
+
+// A fixed set of worker threads for running independent pieces of per-frame work.
+// ParallelFor hands out task indices to the workers (and the calling thread) and
+// returns only when every task has finished, so callers see no concurrency outside it.
+class ThreadPool
+{
+public:
+	typedef void (*TaskFunc)(int taskIndex, void *arg);
+
+	ThreadPool();
+	~ThreadPool();
+
+	// start nThreads workers (0 means one per processor, not counting the caller)
+	void Start(int nThreads);
+	void Stop();
+	int NumThreads();
+
+	// run func(i, arg) for i = 0..nTasks-1 across the pool and wait for all of them
+	void ParallelFor(int nTasks, TaskFunc func, void *arg);
+
+	static int NumProcessors();
+
+private:
+	void WorkerLoop(int workerIndex);
+	void RunTasks();
+
+	int nWorkers;
+	TaskFunc currentFunc;
+	void *currentArg;
+	int currentTaskCount;
+
+#ifdef EYEPATCH_HEADLESS
+	vector<std::thread> workers;
+	std::mutex m_mutex;
+	std::condition_variable m_startCondition, m_doneCondition;
+	std::atomic<int> nextTask;
+	long generation;
+	int nBusy;
+	bool stopping;
+#else
+	static DWORD WINAPI ThreadCallback(LPVOID param);
+	vector<HANDLE> workers, startEvents, doneEvents;
+	volatile LONG nextTask;
+	volatile bool stopping;
+#endif
+};
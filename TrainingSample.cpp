@@ -2,6 +2,7 @@
 #include "constants.h"
 #include "TrainingSample.h"
 
+#ifndef EYEPATCH_HEADLESS
 // Constructor for a standard training sample (no motion or range data)
 TrainingSample::TrainingSample(IplImage* srcImage, HWND lc, HIMAGELIST il, Rect bounds, int groupId) {
 	// this constructor should only be called for positive and negative sample types
@@ -186,18 +187,21 @@ TrainingSample::TrainingSample(char *filename, HWND lc, HIMAGELIST il, int group
 
     id = ListView_MapIndexToID(hwndListControl, newListItemPos);
 }
+#endif
 
 // Constructor for cloning an existing sample
 TrainingSample::TrainingSample(TrainingSample *toClone) {
+#ifndef EYEPATCH_HEADLESS
     hwndListControl = toClone->hwndListControl;
     hImageList = toClone->hImageList;
+    lvi = toClone->lvi;
+#endif
     iGroupId = toClone->iGroupId;
 	iOrigId = toClone->iOrigId;
 	selectBounds = toClone->selectBounds;
 	id = toClone->id;
 	width = toClone->width;
 	height = toClone->height;
-	lvi = toClone->lvi;
 	motionTrack = toClone->motionTrack;
 
     fullImageCopy = cvCloneImage(toClone->fullImageCopy);
@@ -210,7 +214,9 @@ TrainingSample::TrainingSample(TrainingSample *toClone) {
     bmpImage = new Bitmap(LISTVIEW_SAMPLE_X, LISTVIEW_SAMPLE_Y, PixelFormat24bppRGB);
 
     IplToBitmap(resizedImage, bmpImage);
+#ifndef EYEPATCH_HEADLESS
     bmpImage->GetHBITMAP(NULL, &hbmImage);
+#endif
 }
 
 TrainingSample::~TrainingSample(void) {
@@ -225,24 +231,26 @@ void TrainingSample::Save(WCHAR *directory, int index) {
 	WCHAR filename[MAX_PATH];
 
     if (iGroupId == GROUPID_POSSAMPLES) { // positive sample
-		wsprintf(filename, L"%s%s%d%s", directory, FILE_POSIMAGE_PREFIX, index, FILE_IMAGE_EXT);
+		wsprintf(filename, L"%ls%ls%d%ls", directory, FILE_POSIMAGE_PREFIX, index, FILE_IMAGE_EXT);
 		cvSaveImage(W2A(filename), fullImageCopy);
 	} else if (iGroupId == GROUPID_NEGSAMPLES) { // negative sample
-		wsprintf(filename, L"%s%s%d%s", directory, FILE_NEGIMAGE_PREFIX, index, FILE_IMAGE_EXT);
+		wsprintf(filename, L"%ls%ls%d%ls", directory, FILE_NEGIMAGE_PREFIX, index, FILE_IMAGE_EXT);
 		cvSaveImage(W2A(filename), fullImageCopy);
 	} else if (iGroupId == GROUPID_MOTIONSAMPLES) { // motion sample
-		wsprintf(filename, L"%s%s%d%s", directory, FILE_MOTIMAGE_PREFIX, index, FILE_IMAGE_EXT);
+		wsprintf(filename, L"%ls%ls%d%ls", directory, FILE_MOTIMAGE_PREFIX, index, FILE_IMAGE_EXT);
 		cvSaveImage(W2A(filename), fullImageCopy);
-		wsprintf(filename, L"%s%s%d%s%s", directory, FILE_MOTIMAGE_PREFIX, index, FILE_IMAGE_EXT, FILE_MOTIONIMAGE_EXT);
+		wsprintf(filename, L"%ls%ls%d%ls%ls", directory, FILE_MOTIMAGE_PREFIX, index, FILE_IMAGE_EXT, FILE_MOTIONIMAGE_EXT);
 		SaveTrackToFile(motionTrack, filename);
 	} else if (iGroupId == GROUPID_RANGESAMPLES) { // range sample
-		wsprintf(filename, L"%s%s%d%s", directory, FILE_RNGIMAGE_PREFIX, index, FILE_IMAGE_EXT);
+		wsprintf(filename, L"%ls%ls%d%ls", directory, FILE_RNGIMAGE_PREFIX, index, FILE_IMAGE_EXT);
 		cvSaveImage(W2A(filename), fullImageCopy);
-		wsprintf(filename, L"%s%s%d%s%s", directory, FILE_RNGIMAGE_PREFIX, index, FILE_IMAGE_EXT, FILE_MOTIONTRACK_EXT);
+		wsprintf(filename, L"%ls%ls%d%ls%ls", directory, FILE_RNGIMAGE_PREFIX, index, FILE_IMAGE_EXT, FILE_MOTIONTRACK_EXT);
 		SaveTrackToFile(motionTrack, filename);
     }
 }
 
+#ifndef EYEPATCH_HEADLESS
 void TrainingSample::Draw(Graphics *g, int x, int y) {
     g->DrawImage(bmpImage, x, y);
 }
+#endif
@@ -4,26 +4,34 @@ class TrainingSample
 {
 public:
     IplImage *fullImageCopy, *motionHistory;
+#ifndef EYEPATCH_HEADLESS
     LVITEM lvi;
     HBITMAP hbmImage;
+#endif
     UINT id;
     int iGroupId, iOrigId;
 	Rect selectBounds;
     MotionTrack motionTrack;
 
+#ifndef EYEPATCH_HEADLESS
     TrainingSample(IplImage* srcImage, HWND listControl, HIMAGELIST imageList, Rect selectBounds, int groupId);
     TrainingSample(IplImage* srcImage, IplImage* motionHistory, HWND listControl, HIMAGELIST imageList, Rect selectBounds, int groupId);
     TrainingSample(char *filename, HWND listControl, HIMAGELIST imageList, int groupId);
     TrainingSample(IplImage*, MotionTrack mt, HWND listControl, HIMAGELIST imageList, int groupId);
+#endif
 	TrainingSample(TrainingSample *toClone);
     ~TrainingSample(void);
+#ifndef EYEPATCH_HEADLESS
     void Draw(Graphics*, int x, int y);
+#endif
 	void Save(WCHAR *directory, int index);
 
 private:
     IplImage *resizedImage;
     Bitmap *bmpImage;
     int width, height;
+#ifndef EYEPATCH_HEADLESS
     HWND hwndListControl;
     HIMAGELIST hImageList;
+#endif
 };
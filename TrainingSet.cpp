@@ -14,10 +14,12 @@ TrainingSet::~TrainingSet(void) {
 	ClearSamples();
 }
 
+#ifndef EYEPATCH_HEADLESS
 HIMAGELIST TrainingSet::GetImageList() {
     // TODO: store and maintain imagelist here instead of in videomarkup?
     return NULL;
 }
+#endif
 
 void TrainingSet::AddSample(TrainingSample *sample) {
     if (sample->iGroupId == GROUPID_POSSAMPLES) posSampleCount++;
@@ -3,13 +3,17 @@
 class TrainingSet
 {
 public:
+#ifndef EYEPATCH_HEADLESS
     HIMAGELIST m_imageList;
+#endif
     map<UINT, TrainingSample*> sampleMap;
     int posSampleCount, negSampleCount, motionSampleCount, rangeSampleCount;
 
     TrainingSet(void);
     ~TrainingSet(void);
+#ifndef EYEPATCH_HEADLESS
     HIMAGELIST GetImageList();
+#endif
     void AddSample(TrainingSample *sample);
 	int GetOriginalSampleGroup(UINT sampleId);
     void SetSampleGroup(UINT sampleId, int groupId);
@@ -0,0 +1,70 @@
+#pragma once
+#ifdef EYEPATCH_HEADLESS
+#include <atomic>
+#endif
+
+// Hands the latest value from one writer thread to one reader thread without either of them
+// ever waiting.  There are three buffers: the writer fills its back buffer and publishes it by
+// swapping it with the middle one, and the reader takes the middle one (when something new has
+// been published) by swapping it with the buffer it was reading.  The reader's buffer is never
+// touched by the writer, so it stays consistent until the reader asks for the next one; frames
+// the reader doesn't get to in time are simply skipped.
+//
+// Exactly one thread may call GetWriteBuffer/Publish and exactly one other may call GetLatest.
+template <class T>
+class TripleBuffer
+{
+public:
+	TripleBuffer() {
+		Reset();
+	}
+
+	// forget anything published; only call this while neither thread is using the buffers
+	void Reset() {
+		writeIndex = 0;
+		middle = 1;
+		readIndex = 2;
+		hasValue = false;
+	}
+
+	// all three buffers, for allocating and freeing their contents (same caveat as Reset)
+	T& GetBuffer(int index) { return buffers[index]; }
+
+	// writer: the buffer to fill in, then make it the latest value
+	T& GetWriteBuffer() { return buffers[writeIndex]; }
+	void Publish() {
+		writeIndex = Exchange(writeIndex | FRESH) & INDEX_MASK;
+	}
+
+	// reader: the latest published value (NULL if nothing has been published yet), which
+	// stays valid until the next call
+	T* GetLatest() {
+		if (middle & FRESH) {
+			readIndex = Exchange(readIndex) & INDEX_MASK;
+			hasValue = true;
+		}
+		return hasValue ? &buffers[readIndex] : NULL;
+	}
+
+private:
+	enum { INDEX_MASK = 3, FRESH = 4 };
+
+	// swaps the middle index (with its fresh flag) for a new one
+	int Exchange(int value) {
+#ifdef EYEPATCH_HEADLESS
+		return middle.exchange(value);
+#else
+		return (int)InterlockedExchange(&middle, value);
+#endif
+	}
+
+	T buffers[3];
+	int writeIndex;		// only used by the writer
+	int readIndex;		// only used by the reader
+	bool hasValue;
+#ifdef EYEPATCH_HEADLESS
+	std::atomic<int> middle;
+#else
+	volatile LONG middle;
+#endif
+};
@@ -224,15 +224,11 @@ void CVideoLoader::ConvertFrame() {
 	if (currentFrame == NULL) return;
 
 	Rect videoBounds(0,0,videoX,videoY);
-	if (currentFrame->origin  == IPL_ORIGIN_TL) {
-		cvCopy(currentFrame,copyFrame);
-	} else {
-		cvFlip(currentFrame,copyFrame);
-	}
-	cvWriteFrame(videoWriter, copyFrame);
+	frameView.Attach(currentFrame);
+	cvWriteFrame(videoWriter, frameView.Get());
 	nFrames++;
 
-    IplToBitmap(copyFrame, bmpVideo);
+    IplToBitmap(frameView.Get(), bmpVideo);
 
     // Grab next frame
 	currentFrame = cvQueryFrame(videoCapture);
@@ -265,14 +261,9 @@ IplImage* CVideoLoader::GetMotionHistory() {
         currentFrame = cvQueryFrame(videoCapture);
 	    if (!currentFrame) return motionHistory;
 
-        if (currentFrame->origin  == IPL_ORIGIN_TL) {
-            cvCopy(currentFrame,copyFrame);
-        } else {
-            cvFlip(currentFrame,copyFrame);
-        }
-        
         // convert frame to grayscale
-        cvCvtColor(copyFrame, buf[last], CV_BGR2GRAY);
+        frameView.Attach(currentFrame);
+        cvCvtColor(frameView.Get(), buf[last], CV_BGR2GRAY);
         idx1 = last;
         idx2 = (last + 1) % MOTION_NUM_IMAGES;
         last = idx2;
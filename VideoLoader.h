@@ -1,4 +1,5 @@
 #pragma once
+#include "FrameView.h"
 
 class CVideoLoader;
 
@@ -70,6 +71,10 @@ private:
     IplImage *currentFrame;
     IplImage *motionHistory;
 
+	// frames that are only read on the way through (converting, motion history) are viewed in
+	// place rather than copied, leaving copyFrame holding the frame that was last loaded
+	FrameView frameView;
+
     FlowTracker *m_flowTracker;
 
 	friend class CVideoLoaderDialog;
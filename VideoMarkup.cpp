@@ -6,11 +6,14 @@
 #include "VideoRecorder.h"
 #include "BrightnessClassifier.h"
 #include "ColorClassifier.h"
+#include "ColorLutClassifier.h"
+#include "CamshiftClassifier.h"
 #include "ShapeClassifier.h"
 #include "SiftClassifier.h"
 #include "HaarClassifier.h"
 #include "MotionClassifier.h"
 #include "GestureClassifier.h"
+#include "ClassifierFactory.h"
 #include "FilterSelect.h"
 #include "VideoControl.h"
 #include "ClassifierTester.h"
@@ -499,6 +502,12 @@ LRESULT CVideoMarkup::OnLoadFilter( UINT, WPARAM wParam, LPARAM lParam, BOOL& bH
         case GESTURE_FILTER:
             ReplaceClassifier((GestureClassifier*)lParam);
             break;
+        case COLOR_LUT_FILTER:
+            ReplaceClassifier((ColorLutClassifier*)lParam);
+            break;
+        case CAMSHIFT_FILTER:
+            ReplaceClassifier((CamshiftClassifier*)lParam);
+            break;
     }
     InvalidateRgn(activeRgn, FALSE);
     return isAlreadyLoaded;
@@ -617,6 +626,12 @@ LRESULT CVideoMarkup::OnCommand( UINT, WPARAM wParam, LPARAM lParam, BOOL& bHand
 					case GESTURE_FILTER:
 						ReplaceClassifier(new GestureClassifier());
 						break;
+					case COLOR_LUT_FILTER:
+						ReplaceClassifier(new ColorLutClassifier());
+						break;
+					case CAMSHIFT_FILTER:
+						ReplaceClassifier(new CamshiftClassifier());
+						break;
 				}
 			}
 			needToRerunClassifier = true;
@@ -728,23 +743,7 @@ void CVideoMarkup::RecordVideoFile() {
 
 void CVideoMarkup::LoadClassifier(LPWSTR pathname) {
 
-    Classifier *newclassifier = NULL;
-
-    if (wcsstr(pathname, FILE_BRIGHTNESS_SUFFIX) != NULL) {
-        newclassifier = new BrightnessClassifier(pathname);
-    } else if (wcsstr(pathname, FILE_COLOR_SUFFIX) != NULL) { 
-        newclassifier = new ColorClassifier(pathname);
-    } else if (wcsstr(pathname, FILE_GESTURE_SUFFIX) != NULL) { 
-        newclassifier = new GestureClassifier(pathname);
-    } else if (wcsstr(pathname, FILE_HAAR_SUFFIX) != NULL) { 
-        newclassifier = new HaarClassifier(pathname);
-    } else if (wcsstr(pathname, FILE_MOTION_SUFFIX) != NULL) { 
-        newclassifier = new MotionClassifier(pathname);
-    } else if (wcsstr(pathname, FILE_SHAPE_SUFFIX) != NULL) { 
-        newclassifier = new ShapeClassifier(pathname);
-    } else if (wcsstr(pathname, FILE_SIFT_SUFFIX) != NULL) { 
-        newclassifier = new SiftClassifier(pathname);
-    }
+    Classifier *newclassifier = LoadClassifierFromDirectory(pathname);
 
     if (newclassifier != NULL) {
         savedClassifiers.push_back(newclassifier);
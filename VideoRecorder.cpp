@@ -78,7 +78,6 @@ void CVideoRecorderDialog::ConvertFrames() {
 CVideoRecorder::CVideoRecorder() :
 	m_hVideoRecorderDialog(this) {
     videoCapture = NULL;
-    copyFrame = NULL;
     bmpVideo = NULL;
     recordingVideo = false;
     nFrames = 0;
@@ -88,7 +87,6 @@ CVideoRecorder::CVideoRecorder() :
 CVideoRecorder::~CVideoRecorder(void) {
     if (recordingVideo) {
         cvReleaseCapture(&videoCapture);
-        cvReleaseImage(&copyFrame);
 		delete bmpVideo;
     }
 }
@@ -130,9 +128,6 @@ BOOL CVideoRecorder::RecordVideoFile(HWND hwndOwner) {
     videoY = cvGetCaptureProperty(videoCapture, CV_CAP_PROP_FRAME_HEIGHT);
     fps = cvGetCaptureProperty(videoCapture, CV_CAP_PROP_FPS);
 
-	// create an image to store a copy of the current frame
-    copyFrame = cvCreateImage(cvSize(videoX,videoY),IPL_DEPTH_8U,3);
-
     // Create a bitmap to display video
     bmpVideo = new Bitmap(videoX, videoY, PixelFormat24bppRGB);
 
@@ -153,16 +148,13 @@ void CVideoRecorder::ConvertFrame() {
 
 	if (currentFrame == NULL) return;
 
+	// both the writer and the bitmap only read the frame, so it's only copied if it needs flipping
 	Rect videoBounds(0,0,videoX,videoY);
-	if (currentFrame->origin  == IPL_ORIGIN_TL) {
-		cvCopy(currentFrame,copyFrame);
-	} else {
-		cvFlip(currentFrame,copyFrame);
-	}
-	cvWriteFrame(videoWriter, copyFrame);
+	frameView.Attach(currentFrame);
+	cvWriteFrame(videoWriter, frameView.Get());
 	nFrames++;
 
-    IplToBitmap(copyFrame, bmpVideo);
+    IplToBitmap(frameView.Get(), bmpVideo);
 }
 
 void CVideoRecorder::GrabNextFrame() {
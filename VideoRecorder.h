@@ -1,4 +1,5 @@
 #pragma once
+#include "FrameView.h"
 
 class CVideoRecorder;
 
@@ -47,7 +48,6 @@ public:
     int fps;
     int nFrames;
     bool recordingVideo;
-    IplImage *copyFrame;
     Bitmap *bmpVideo;
 
 private:
@@ -55,6 +55,7 @@ private:
 	CvVideoWriter *videoWriter;
 	
     IplImage *currentFrame;
+	FrameView frameView;	// the current frame, upright; the capture buffer itself unless it needed flipping
 
 	friend class CVideoRecorderDialog;
 	CVideoRecorderDialog m_hVideoRecorderDialog;
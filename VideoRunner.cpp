@@ -4,28 +4,29 @@
 #include "TrainingSet.h"
 #include "Classifier.h"
 #include "OutputSink.h"
-#include "MotionClassifier.h"
-#include "GestureClassifier.h"
+#include "FilterChain.h"
 #include "VideoRunner.h"
 
 CVideoRunner::CVideoRunner(CWindow *caller) {
     videoCapture = NULL;
-    copyFrame = NULL;
-    outputAccImage = NULL;
-	contourMask = NULL;
-    motionHistory = NULL;
-    bmpInput = NULL;
-    bmpOutput = NULL;
-	bmpMotion = NULL;
-	bmpGesture = NULL;
+    currentFrame = NULL;
+	captureStart = captureMs = 0;
+	bitmapMs = frameMs = 0;
+	for (int i=0; i<3; i++) {
+		PreviewFrames &frames = previewFrames.GetBuffer(i);
+		frames.input = frames.output = frames.motion = frames.gesture = NULL;
+		frames.trackingMotion = frames.trackingGesture = false;
+	}
     processingVideo = false;
 	runningLive = true;
+	latestFrameOnly = true;
+	takingLatest = false;
     nFrames = 0;
 	framesAvailable = 0;
     parent = caller;
 
-    trackingMotion = 0;
-    trackingGesture = 0;
+	// spread the classifiers of each frame across all of the processors
+	filterChain.SetClassifierThreads(0);
 
 	m_hMutex = NULL;
     m_hThread = NULL;
@@ -36,204 +37,47 @@ CVideoRunner::~CVideoRunner(void) {
 	if (m_hMutex) CloseHandle(m_hMutex);
 }
 
-ClassifierOutputData CVideoRunner::GetStandardOutputData() {
-	ClassifierOutputData outputData;
-	cvResize(combineMask, combineMaskOutput);
-	outputData.AddVariable("Mask", combineMaskOutput);
-
-	// reset the contour storage
-    cvClearMemStorage(contourStorage);
-	// find the contours in the combineMask
-    CvSeq* contours = NULL;
-	cvFindContours(combineMaskOutput, contourStorage, &contours, sizeof(CvContour), CV_RETR_TREE, CV_CHAIN_APPROX_SIMPLE, cvPoint(0,0));
-	if (contours != NULL) {
-        contours = cvApproxPoly(contours, sizeof(CvContour), contourStorage, CV_POLY_APPROX_DP, 3, 1 );
-	}
-	outputData.AddVariable("Contours", contours);
-
-	// compute bounding boxes of mask contours, along with area and centroid, and count # of regions
-	boundingBoxes.clear();
-	Point centroid(0,0);
-	int nRegions = 0;
-	int totalArea = 0;
-	if (contours != NULL){
-		for (CvSeq *contour = contours; contour != NULL; contour = contour->h_next) {
-			CvRect cvr = cvBoundingRect(contour, 1);
-			totalArea += fabs(cvContourArea(contour));
-			Rect r(cvr.x, cvr.y, cvr.width, cvr.height);
-			boundingBoxes.push_back(r);
-			centroid.X += (cvr.x+cvr.width/2);
-			centroid.Y += (cvr.y+cvr.height/2);
-			nRegions++;
-		}
-		if (nRegions > 0) {
-			centroid.X /= nRegions;
-			centroid.Y /= nRegions;
-		}
-	}
-	outputData.AddVariable("BoundingBoxes", &boundingBoxes);
-	outputData.AddVariable("NumRegions", nRegions);
-	outputData.AddVariable("TotalArea", totalArea);
-	outputData.AddVariable("Centroid", centroid);
-	return outputData;
-}
-
-void CVideoRunner::ApplyFilterChain() {
-	USES_CONVERSION;
-
-	bool processedMotion = false, processedGesture = false;
-	ClassifierOutputData combinedata;	// used for combining data across multiple classifiers
-
-	int nCurrentFilter = 0;
-    int nFiltersInChain = activeClassifiers.size();
-
-	// initialize the "combineMask" appropriately depending upon our combine mode
-	if (filterCombineMode == IDC_COMBINE_AND) {
-		if (nFiltersInChain > 0) cvSet(combineMask, cvScalar(0xFF));
-		else cvZero(combineMask);
-	} else if (filterCombineMode == IDC_COMBINE_OR) {
-		cvZero(combineMask);
-	}
-
-	// step through each active classifier in turn
-    for (list<Classifier*>::iterator i=activeClassifiers.begin(); i!=activeClassifiers.end(); i++) {
-
-		// get the output of the classifier and store it in "outdata"
-		ClassifierOutputData outdata;
-
-        if ((*i)->classifierType == MOTION_FILTER) {
-			if (!processedMotion) {	// this is the first motion filter in the chain, so we'll update the motion image now
-				ProcessMotionFrame();
-				processedMotion = true;
-			}
-            outdata = ((MotionClassifier*)(*i))->ClassifyMotion(motionHistory, nFrames);
-        } else if ((*i)->classifierType == GESTURE_FILTER) {
-			if (!processedGesture) {	// this is the first gesture filter in the chain, so we'll update the motion trails now
-				ProcessGestureFrame();
-				processedGesture = true;
-			}
-
-			MotionTrack mt = m_flowTracker.GetCurrentTrajectory();
-            outdata = ((GestureClassifier*)(*i))->ClassifyTrack(mt);
-			if (outdata.HasVariable("IsMatch")) {
-				if (outdata.GetIntData("IsMatch") != 0) {
-					m_flowTracker.ClearCurrentTrajectory();
-				}
-			}
-        } else {
-            outdata = (*i)->ClassifyFrame(copyFrame);
-        } 
-
-		// pull the mask out of the returned data and store it in "guessMask"
-		if (outdata.HasVariable("Mask")) {
-			IplImage *mask = outdata.GetImageData("Mask");
-			cvResize(mask, guessMask);
-		} else {
-			cvZero(guessMask);
-		}
-
-		if (filterCombineMode == IDC_COMBINE_LIST) {
-			// in LIST mode we draw each filter outlined separately in the accumulator frame
-
-			// Copy the masked output of this filter to accumulator frame
-			cvZero(outputAccImage);
-			cvCopy(copyFrame, outputAccImage, guessMask);
-
-			// Trace contours in accumulator frame
-			CvSeq *contours = outdata.GetSequenceData("Contours");
-			if (contours != NULL) {
-				cvZero(contourMask);
-				cvDrawContours(contourMask, contours, cvScalar(0xFF), cvScalar(0x00), 1, 1, CV_AA);
-				cvResize(contourMask, guessMask);
-				cvSet(outputAccImage, colorSwatch[nCurrentFilter%COLOR_SWATCH_SIZE], guessMask);
-			}
-
-			// Add masked accumulator frame to output frame
-			cvAddWeighted(outputAccImage, (1.0/nFiltersInChain), outputFrame, 1.0, 0, outputFrame);
-
-			// in LIST mode we apply output chain to each filter output separately
-			for (list<OutputSink*>::iterator j=activeOutputs.begin(); j!=activeOutputs.end(); j++) {
-				(*j)->ProcessOutput(copyFrame, outdata, W2A((*i)->GetName()));
-			}
-		} else if (filterCombineMode == IDC_COMBINE_AND){
-			// In AND mode we don't draw anything until the end, once we've combined all the outputs.
-			// We combine the "guessMask" from each filter into the "combineMask" and draw that.
-			cvAnd(guessMask, combineMask, combineMask);
-			combinedata.MergeWith(outdata);
-		} else if (filterCombineMode == IDC_COMBINE_OR){
-			// In OR mode we don't draw anything until the end, once we've combined all the outputs.
-			// We combine the "guessMask" from each filter into the "combineMask" and draw that.
-			cvOr(guessMask, combineMask, combineMask);
-			combinedata.MergeWith(outdata);
-		} else if (filterCombineMode == IDC_COMBINE_CASCADE){
-			// In CASCADE mode we actually modify the input frame so that the input of the next
-			// filter in the chain will include only the regions of the input image that have passed through
-			// the earlier filters in the chain.  The final mask is the output of the last filter in the chain.
-			cvCopy(copyFrame, outputAccImage);
-			cvZero(copyFrame);
-			cvCopy(outputAccImage, copyFrame, guessMask);
-			cvCopy(guessMask, combineMask);
-			combinedata.MergeWith(outdata);
-		}
-        nCurrentFilter++;
-	}
-
-	// If we are in a mode where outputs get combined, we need to output the final result
-	// now that we have run all the filters.
-	if (filterCombineMode != IDC_COMBINE_LIST) {
-		ClassifierOutputData combinemaskdata = GetStandardOutputData();
-		combinedata.MergeWith(combinemaskdata);
-
-		cvZero(outputAccImage);
-		cvCopy(copyFrame, outputAccImage, combineMask);
-
-		// Trace contours in accumulator frame
-		CvSeq *contours = combinedata.GetSequenceData("Contours");
-		if (contours != NULL) {
-			cvZero(contourMask);
-			cvDrawContours(contourMask, contours, cvScalar(0xFF), cvScalar(0x00), 1, 1, CV_AA);
-			cvResize(contourMask, guessMask);
-			cvSet(outputAccImage, colorSwatch[0], guessMask);
-		}
-
-		// copy accumulator frame to output frame
-		cvCopy(outputAccImage, outputFrame);
-
-		// now we apply the output chain to the combined output data
-		for (list<OutputSink*>::iterator j=activeOutputs.begin(); j!=activeOutputs.end(); j++) {
-			(*j)->ProcessOutput(copyFrame, combinedata, "Combination");
-		}
-	}
-}
-
 void CVideoRunner::ProcessFrame() {
     USES_CONVERSION;
 	if (currentFrame == NULL) return;
 
     WaitForSingleObject(m_hMutex,INFINITE);
 
-    // load frame and flip if needed
-	if (currentFrame->origin  == IPL_ORIGIN_TL) {
-		cvCopy(currentFrame,copyFrame);
+	// the frame was grabbed (and the previous one converted to bitmaps) outside the lock,
+	// so we record how long that took now; the live capture times its own grabs and copies
+	if (takingLatest) {
+		filterChain.metrics.CountDroppedFrames(liveCapture.GetLastDropped());
+		filterChain.metrics.Record(STAGE_CAPTURE, liveCapture.GetLastGrabMs());
+		filterChain.metrics.Record(STAGE_COPY, liveCapture.GetLastCopyMs());
 	} else {
-		cvFlip(currentFrame,copyFrame);
+		filterChain.metrics.Record(STAGE_CAPTURE, captureMs);
 	}
+	if (nFrames > 1) {
+		filterChain.metrics.Record(STAGE_BITMAP, bitmapMs);
+		filterChain.metrics.Record(STAGE_FRAME, frameMs);
+	}
+
+    // read the frame in place, flipping it only if it's upside down
+	double start = GetTimeMs();
+	frameView.Attach(currentFrame);
+	if (!takingLatest) filterChain.metrics.Record(STAGE_COPY, GetTimeMs()-start);
 
     // some outputs run on the original (unfiltered) frame
 	// we apply these before applying any of the filters
-    for (list<OutputSink*>::iterator j=activeOutputs.begin(); j!=activeOutputs.end(); j++) {
-        (*j)->ProcessInput(copyFrame);
-    }
+    filterChain.ProcessInput(frameView.Get());
 
-    // First black out the output frame
-    cvZero(outputFrame);
+    // Now apply filter chain to frame (CASCADE mode writes to it, so it gets a copy of the capture buffer)
+	// Live frames are numbered as they were grabbed, so motion history sees the time between them.
+	IplImage *frame = (filterChain.filterCombineMode == IDC_COMBINE_CASCADE) ? frameView.GetWritable() : frameView.Get();
+	filterChain.ApplyFilterChain(frame, takingLatest ? liveCapture.GetLastSequence() : nFrames);
 
-    // Now apply filter chain to frame
-	ApplyFilterChain();
+    // update frame count and release the mutex
+    nFrames++;
+    ReleaseMutex(m_hMutex);
 
-    // convert to bitmap
-    IplToBitmap(copyFrame, bmpInput);
-    IplToBitmap(outputFrame, bmpOutput);
+	// the images we convert are only written by this thread, so a slow paint or a filter
+	// being added never holds up the next frame
+	PublishPreviewFrames();
 
     // invalidate parent rectangle for redraw
     CRect videoRect(FILTERLIBRARY_WIDTH, 0, WINDOW_X, WINDOW_Y);
@@ -241,53 +85,52 @@ void CVideoRunner::ProcessFrame() {
         parent->InvalidateRect(&videoRect, FALSE);
     }
 
-    // update frame count and release the mutex
-    nFrames++;
-    ReleaseMutex(m_hMutex);
-
     // Grab next frame (do this AFTER releasing mutex)
-	if (runningLive || (nFrames < framesAvailable)) {
+	if (takingLatest) {
+		// the newest frame the capture thread has, waiting for one if we're ahead of the camera
+		currentFrame = liveCapture.TakeLatest();
+	} else if (runningLive || (nFrames < framesAvailable)) {
+		captureStart = GetTimeMs();
 		currentFrame = cvQueryFrame(videoCapture);
+		captureMs = GetTimeMs()-captureStart;
 	} else {	// we are all out of recorded video frames
-		parent->SendMessage(WM_COMMAND, IDC_RUNRECORDED, 0);
+		// the UI thread stops us by waiting for this thread to finish, so we can't wait for it here
+		currentFrame = NULL;
+		parent->PostMessage(WM_COMMAND, IDC_RUNRECORDED, 0);
 	}
 }
 
-void CVideoRunner::ProcessMotionFrame() {
-    // convert frame to grayscale for motion history computation
-    cvCvtColor(copyFrame, motionBuf[last], CV_BGR2GRAY);
-    int idx1 = last;
-    int idx2 = (last + 1) % MOTION_NUM_IMAGES;
-    last = idx2;
-
-    // get difference between frames
-    IplImage* silh = motionBuf[idx2];
-    cvAbsDiff(motionBuf[idx1], motionBuf[idx2], silh);
-
-    // threshold difference image and use it to update motion history image
-    cvThreshold(silh, silh, MOTION_DIFF_THRESHOLD, 1, CV_THRESH_BINARY); 
-    cvUpdateMotionHistory(silh, motionHistory, nFrames, MOTION_MHI_DURATION); // update MHI
-
-    // convert MHI to blue 8U image
-    IplImage *mask = cvCreateImage(cvSize(motionHistory->width, motionHistory->height), IPL_DEPTH_8U, 1);
-    IplImage *dst = cvCreateImage(cvSize(motionHistory->width, motionHistory->height), IPL_DEPTH_8U, 3);
-    cvCvtScale(motionHistory, mask, 255./MOTION_MHI_DURATION,(MOTION_MHI_DURATION-nFrames)*255./MOTION_MHI_DURATION);
-    cvZero(dst);
-    cvCvtPlaneToPix( mask, 0, 0, 0, dst );
-
-    IplToBitmap(dst, bmpMotion);
-	cvReleaseImage(&mask);
-	cvReleaseImage(&dst);
+void CVideoRunner::PublishPreviewFrames() {
+	double start = GetTimeMs();
+	PreviewFrames &frames = previewFrames.GetWriteBuffer();
+    IplToBitmap(frameView.Get(), frames.input);
+    IplToBitmap(filterChain.outputFrame, frames.output);
+	frames.trackingMotion = (filterChain.trackingMotion > 0);
+	frames.trackingGesture = (filterChain.trackingGesture > 0);
+    if (frames.trackingMotion) {
+        IplToBitmap(filterChain.motionImage, frames.motion);
+    }
+    if (frames.trackingGesture) {
+        IplToBitmap(filterChain.m_flowTracker.outputFrame, frames.gesture);
+    }
+	previewFrames.Publish();
+	bitmapMs = GetTimeMs()-start;
+
+	// from the start of the grab to the frame being ready for display
+	frameMs = GetTimeMs()-(takingLatest ? liveCapture.GetLastCaptureTime() : captureStart);
 }
 
-void CVideoRunner::ProcessGestureFrame() {
-    // Process the new frame with the flow tracker
-	m_flowTracker.ProcessFrame(copyFrame);
-	IplToBitmap(m_flowTracker.outputFrame, bmpGesture);
+PreviewFrames* CVideoRunner::GetLatestFrames() {
+	if (!processingVideo) return NULL;
+	return previewFrames.GetLatest();
 }
 
 DWORD WINAPI CVideoRunner::ThreadCallback(CVideoRunner* instance) {
     while (1) {
+		// frames from the live capture are waited for here, starting with the first one
+		if (instance->processingVideo && instance->takingLatest && (instance->currentFrame == NULL)) {
+			instance->currentFrame = instance->liveCapture.TakeLatest();
+		}
         if (instance->processingVideo && (instance->currentFrame != NULL)) {
 	        instance->ProcessFrame();
         } else {
@@ -302,6 +145,7 @@ void CVideoRunner::StartProcessing(bool isLive) {
 	runningLive = isLive;
 	if (isLive) {    // Attempt to access the camera and get dimensions
 	    vc = cvCreateCameraCapture(0);
+		filterChain.videoId = 0;
 		if (vc == NULL) {
 			MessageBox(GetActiveWindow(),
 				L"Sorry, I'm unable to connect to a camera.  Please make sure that your camera is plugged in and its drivers are installed.", 
@@ -323,7 +167,9 @@ void CVideoRunner::StartProcessing(bool isLive) {
 
     // get video capture properties
 	videoCapture = vc;
+	captureStart = GetTimeMs();
     currentFrame = cvQueryFrame(videoCapture);
+	captureMs = GetTimeMs()-captureStart;
     videoX = cvGetCaptureProperty(videoCapture, CV_CAP_PROP_FRAME_WIDTH);
     videoY = cvGetCaptureProperty(videoCapture, CV_CAP_PROP_FRAME_HEIGHT);
     fps = cvGetCaptureProperty(videoCapture, CV_CAP_PROP_FPS);
@@ -332,42 +178,33 @@ void CVideoRunner::StartProcessing(bool isLive) {
 		framesAvailable = cvGetCaptureProperty(videoCapture, CV_CAP_PROP_FRAME_COUNT);
 	}
 
-	// create images to store a copy of the current frame input and output, and an accumulator for filter data
-    copyFrame = cvCreateImage(cvSize(videoX,videoY),IPL_DEPTH_8U,3);
-    outputFrame = cvCreateImage(cvSize(videoX,videoY),IPL_DEPTH_8U,3);
-    outputAccImage =  cvCreateImage(cvSize(videoX,videoY),IPL_DEPTH_8U,3);
-	contourMask = cvCreateImage(cvSize(GUESSMASK_WIDTH, GUESSMASK_HEIGHT), IPL_DEPTH_8U, 1);
-	combineMaskOutput = cvCreateImage(cvSize(GUESSMASK_WIDTH, GUESSMASK_HEIGHT), IPL_DEPTH_8U, 1);
-
-    // create image to store motion history
-    motionHistory = cvCreateImage(cvSize(videoX,videoY), IPL_DEPTH_32F, 1);
-    cvZero(motionHistory);
-
-    // Allocate an image history ring buffer
-    memset(motionBuf, 0, MOTION_NUM_IMAGES*sizeof(IplImage*));
-    for(int i = 0; i < MOTION_NUM_IMAGES; i++) {
-        motionBuf[i] = cvCreateImage(cvSize(copyFrame->width,copyFrame->height), IPL_DEPTH_8U, 1);
-        cvZero(motionBuf[i]);
-    }
-    last = 0;
-
-    // create a mask to store the results of the processing, and one for combining multiple filters
-    guessMask = cvCreateImage(cvSize(videoX,videoY),IPL_DEPTH_8U,1);
-    combineMask = cvCreateImage(cvSize(videoX,videoY),IPL_DEPTH_8U,1);
-
-    // Create bitmaps to display video input and output
-    bmpInput = new Bitmap(videoX, videoY, PixelFormat24bppRGB);
-    bmpOutput = new Bitmap(videoX, videoY, PixelFormat24bppRGB);
-
-	// Create smaller bitmaps for motion and gesture status images
-    bmpMotion = new Bitmap(videoX, videoY, PixelFormat24bppRGB);
-    bmpGesture = new Bitmap(videoX, videoY, PixelFormat24bppRGB);
-
-	// Initialize some contour storage for tracing combination masks
-	contourStorage = cvCreateMemStorage(0);
+	// create the images used by the filter chain (output, masks and motion history)
+	filterChain.StartProcessing(videoX, videoY);
+	filterChain.metrics.Reset();
+
+    // Create bitmaps to display video input and output, and motion and gesture status images,
+	// one set for each of the preview buffers
+	previewFrames.Reset();
+	for (int i=0; i<3; i++) {
+		PreviewFrames &frames = previewFrames.GetBuffer(i);
+	    frames.input = new Bitmap(videoX, videoY, PixelFormat24bppRGB);
+	    frames.output = new Bitmap(videoX, videoY, PixelFormat24bppRGB);
+	    frames.motion = new Bitmap(videoX, videoY, PixelFormat24bppRGB);
+	    frames.gesture = new Bitmap(videoX, videoY, PixelFormat24bppRGB);
+		frames.trackingMotion = frames.trackingGesture = false;
+	}
+	bitmapMs = frameMs = 0;
 
     processingVideo = true;
 
+	// a camera is read on its own thread, which overwrites the first frame's buffer straight
+	// away, so the processing thread starts from whatever it grabs next
+	takingLatest = runningLive && latestFrameOnly;
+	if (takingLatest) {
+		liveCapture.Start(videoCapture);
+		currentFrame = NULL;
+	}
+
     // Start processing thread
 	m_hMutex = CreateMutex(NULL,FALSE,NULL);
 	m_hThread = CreateThread(NULL, 0, (LPTHREAD_START_ROUTINE)ThreadCallback, (LPVOID)this, 0, &threadID);
@@ -377,93 +214,104 @@ void CVideoRunner::StopProcessing() {
     if (!processingVideo) return;
 
     WaitForSingleObject(m_hMutex,INFINITE);
-
-	// End processing thread
-	TerminateThread(m_hThread, 0);
     processingVideo = false;
+    ReleaseMutex(m_hMutex);
+
+	// End processing thread; it may be converting bitmaps or grabbing a frame outside the lock,
+	// so we let it finish that rather than terminating it (stopping the live capture wakes it
+	// if it's waiting for a frame)
+	liveCapture.Stop();
+	WaitForSingleObject(m_hThread, INFINITE);
+	CloseHandle(m_hThread);
+	m_hThread = NULL;
 	currentFrame = NULL;
 
     cvReleaseCapture(&videoCapture);
-    cvReleaseImage(&copyFrame);
-    cvReleaseImage(&outputFrame);
-    cvReleaseImage(&outputAccImage);
-	cvReleaseImage(&contourMask);
-    cvReleaseImage(&motionHistory);
-    for(int i = 0; i < MOTION_NUM_IMAGES; i++) {
-        cvReleaseImage(&motionBuf[i]);
-    }
-    cvReleaseImage(&guessMask);
-    cvReleaseImage(&combineMask);
-	cvReleaseImage(&combineMaskOutput);
+	filterChain.StopProcessing();
+	resultCache.Flush();
+
+	for (int i=0; i<3; i++) {
+		PreviewFrames &frames = previewFrames.GetBuffer(i);
+	    delete frames.input;
+	    delete frames.output;
+		delete frames.motion;
+		delete frames.gesture;
+		frames.input = frames.output = frames.motion = frames.gesture = NULL;
+	}
+	previewFrames.Reset();
+}
 
-    delete bmpInput;
-    delete bmpOutput;
-	delete bmpMotion;
-	delete bmpGesture;
+bool CVideoRunner::AddActiveFilter(Classifier *c) {	// returns true if the filter was added; false if it was already active
+    WaitForSingleObject(m_hMutex,INFINITE);
+	bool newlyAdded = filterChain.AddActiveFilter(c);
+    ReleaseMutex(m_hMutex);
+	return newlyAdded;
+}
 
-	cvReleaseMemStorage(&contourStorage);
+void CVideoRunner::ClearActiveFilters() {
+    WaitForSingleObject(m_hMutex,INFINITE);
+    filterChain.ClearActiveFilters();
+    ReleaseMutex(m_hMutex);
+}
 
+void CVideoRunner::ResetActiveFilterRunningStates() {
+    WaitForSingleObject(m_hMutex,INFINITE);
+    filterChain.ResetActiveFilterRunningStates();
     ReleaseMutex(m_hMutex);
 }
 
-bool CVideoRunner::AddActiveFilter(Classifier *c) {	// returns true if the filter was added; false if it was already active
-	bool alreadyAdded = false;
+void CVideoRunner::GetMetrics(vector<LatencyStats> &stats, long &framesProcessed, long &framesDropped) {
     WaitForSingleObject(m_hMutex,INFINITE);
-    for (list<Classifier*>::iterator j=activeClassifiers.begin(); j!=activeClassifiers.end(); j++) {
-		if ((*j) == c) {
-			alreadyAdded = true;
-		}
-    }
-	if (!alreadyAdded) {
-		if (c->classifierType == MOTION_FILTER) {
-			trackingMotion++;
-		} else if (c->classifierType == GESTURE_FILTER) {
-			trackingGesture++;
-		}
-		activeClassifiers.push_back(c);
-	}
+	filterChain.metrics.GetStats(stats);
+	framesProcessed = filterChain.metrics.GetFramesProcessed();
+	framesDropped = filterChain.metrics.GetFramesDropped();
     ReleaseMutex(m_hMutex);
-	return !alreadyAdded;
 }
 
-void CVideoRunner::ClearActiveFilters() {
+void CVideoRunner::SetFilterCadence(Classifier *c, int everyNFrames, double maxHz) {
     WaitForSingleObject(m_hMutex,INFINITE);
-    trackingMotion = 0;
-    trackingGesture = 0;
-    activeClassifiers.clear();
+    filterChain.scheduler.SetCadence(c, everyNFrames, maxHz);
     ReleaseMutex(m_hMutex);
 }
 
-void CVideoRunner::ResetActiveFilterRunningStates() {
+void CVideoRunner::SetFilterBudget(Classifier *c, double budgetMs) {
     WaitForSingleObject(m_hMutex,INFINITE);
-    for (list<Classifier*>::iterator i=activeClassifiers.begin(); i!=activeClassifiers.end(); i++) {
-        (*i)->ResetRunningState();
-    }
+    filterChain.scheduler.SetBudget(c, budgetMs);
     ReleaseMutex(m_hMutex);
 }
 
-bool CVideoRunner::AddActiveOutput(OutputSink *o) {	// returns true if the output was added; false if it was already active
-	bool alreadyAdded = false;
+void CVideoRunner::SetResultCaching(bool enabled) {
     WaitForSingleObject(m_hMutex,INFINITE);
-    for (list<OutputSink*>::iterator j=activeOutputs.begin(); j!=activeOutputs.end(); j++) {
-		if ((*j) == o) {
-			alreadyAdded = true;
-		}
-    }
-	if (!alreadyAdded) {
-		activeOutputs.push_back(o);
-		o->StartRunning();
+	if (enabled) {
+		USES_CONVERSION;
+		WCHAR cachepath[MAX_PATH];
+		SHGetFolderPath(NULL, CSIDL_APPDATA, NULL, SHGFP_TYPE_CURRENT, cachepath);
+		wcscat(cachepath, FILE_PATH_SEPARATOR APP_CLASS FILE_RESULT_CACHE_DIR);
+		resultCache.SetSpillDirectory(W2A(cachepath));
+		filterChain.resultCache = &resultCache;
+	} else {
+		filterChain.resultCache = NULL;
+		resultCache.SetSpillDirectory("");	// writes out what is in memory, then forgets it
 	}
     ReleaseMutex(m_hMutex);
-	return !alreadyAdded;
+}
+
+void CVideoRunner::SetTargetFps(double fps) {
+    WaitForSingleObject(m_hMutex,INFINITE);
+    filterChain.scheduler.SetTargetFps(fps);
+    ReleaseMutex(m_hMutex);
+}
+
+bool CVideoRunner::AddActiveOutput(OutputSink *o) {	// returns true if the output was added; false if it was already active
+    WaitForSingleObject(m_hMutex,INFINITE);
+	bool newlyAdded = filterChain.AddActiveOutput(o);
+    ReleaseMutex(m_hMutex);
+	return newlyAdded;
 }
 
 void CVideoRunner::ClearActiveOutputs() {
     WaitForSingleObject(m_hMutex,INFINITE);
-    for (list<OutputSink*>::iterator j=activeOutputs.begin(); j!=activeOutputs.end(); j++) {
-        (*j)->StopRunning();
-    }
-    activeOutputs.clear();
+    filterChain.ClearActiveOutputs();
     ReleaseMutex(m_hMutex);
 }
 
@@ -487,5 +335,6 @@ BOOL CVideoRunner::LoadRecordedVideo(HWND hwndOwner, CvCapture** capture) {
     USES_CONVERSION;
     // Attempt to load the video file and get dimensions
     *capture = cvCreateFileCapture(W2A(szFileName));
+	filterChain.videoId = ResultCache::IdentifyFile(W2A(szFileName));
 	return TRUE;
 }
@@ -1,8 +1,17 @@
 #pragma once
-#include "SimpleFlowTracker.h"
+#include "FilterChain.h"
+#include "TripleBuffer.h"
+#include "FrameView.h"
+#include "LiveCapture.h"
 
 class CFilterComposer;
 
+// The images the filter composer shows for one processed frame
+struct PreviewFrames {
+	Bitmap *input, *output, *motion, *gesture;
+	bool trackingMotion, trackingGesture;	// whether the motion and gesture images were drawn
+};
+
 class CVideoRunner
 {
 public: 
@@ -12,14 +21,26 @@ public:
     static DWORD WINAPI ThreadCallback(CVideoRunner*);
     void StartProcessing(bool isLive);
     void StopProcessing();
-	void ApplyFilterChain();
 	void ProcessFrame();
-	ClassifierOutputData GetStandardOutputData();
 
     bool AddActiveFilter(Classifier*);
     void ClearActiveFilters();
 	void ResetActiveFilterRunningStates();
 
+	// run a filter only on every Nth frame and at most maxHz times a second, or within an average
+	// time budget per frame; with a target frame rate the cadences of expensive filters are stretched
+	// as needed to hold it (0 turns this off)
+	void SetFilterCadence(Classifier *c, int everyNFrames, double maxHz);
+	void SetFilterBudget(Classifier *c, double budgetMs);
+	void SetTargetFps(double fps);
+
+	// remember what the classifiers found on the frames of recorded videos, on disk between
+	// sessions, so playing one again only runs new classifiers (off by default)
+	void SetResultCaching(bool enabled);
+
+	// latency percentiles of each pipeline stage, classifier and output, and the frame counts
+	void GetMetrics(vector<LatencyStats> &stats, long &framesProcessed, long &framesDropped);
+
     bool AddActiveOutput(OutputSink *o);
     void ClearActiveOutputs();
 
@@ -28,43 +49,36 @@ public:
 	int videoX, videoY;
     int fps;
     long nFrames, framesAvailable;
-    bool processingVideo, runningLive;
-    IplImage *copyFrame, *outputFrame, *outputAccImage, *contourMask;
-	Bitmap *bmpInput, *bmpOutput, *bmpMotion, *bmpGesture;
+    volatile bool processingVideo;	// cleared to stop the processing thread
+    bool runningLive;
+
+	// with a camera, always process the newest frame and drop the ones that arrive while the
+	// last is processed, rather than working through the driver's queue (on by default)
+	bool latestFrameOnly;
 
-    //  keep track of the number of active filters that require motion or blob tracking
-    int trackingMotion;
-    int trackingGesture;
+	// the bitmaps of the latest processed frame (NULL until the first one is ready); they stay
+	// valid until the next call, and the processing thread never waits for whoever is reading
+	// them.  Only call this from the UI thread.
+	PreviewFrames* GetLatestFrames();
 
-	// we can combine filters as LIST, AND, OR, or CASCADE
-	int filterCombineMode;
+	// the classifiers, outputs and combine mode applied to each frame
+	FilterChain filterChain;
 
-	// for the bounding boxes output from a combination of filters
-	vector<Rect> boundingBoxes;
+	// what the classifiers found on the frames of recorded videos (see SetResultCaching)
+	ResultCache resultCache;
 
 private:
     CvCapture *videoCapture;
-    IplImage *currentFrame, *guessMask, *combineMask, *combineMaskOutput, *motionHistory;
-    IplImage* motionBuf[MOTION_NUM_IMAGES];
-
-    // functions that may be called by ProcessFrame (if motion/gesture filters are active)
-    void ProcessMotionFrame();
-    void ProcessGestureFrame();
-
-    // for keeping track of position within circular motion history buffer
-    int last;
-
-	// for tracking optical flow for gesture tracking
-	SimpleFlowTracker m_flowTracker;
-
-    // list of classifiers to apply to live video stream
-    list<Classifier*> activeClassifiers;
-
-    // list of outputs to which we will send video data
-    list<OutputSink*> activeOutputs;
-
-	// memory storage for contours of combine mask
-	CvMemStorage *contourStorage;
+    IplImage *currentFrame;
+	FrameView frameView;	// the current frame, upright; the capture buffer itself unless it needed flipping
+	LiveCapture liveCapture;
+	bool takingLatest;		// whether frames come from liveCapture (fixed while processing)
+	double captureStart, captureMs;		// when the current frame was grabbed, and how long that took
+	double bitmapMs, frameMs;			// times of the previous frame that were taken outside the lock
+
+	// bitmaps published by the processing thread for the UI, converted outside the lock
+	TripleBuffer<PreviewFrames> previewFrames;
+	void PublishPreviewFrames();
 
 	DWORD threadID;
 	HANDLE m_hMutex;
@@ -22,6 +22,17 @@
 #define COLOR_VMAX 230
 #define COLOR_SMIN 30
 
+// color table parameters: the table is indexed by the top bits of each of blue, green and red
+#define COLOR_LUT_BITS 5
+
+// CamShift parameters
+/* the search window reaches this share of the object's size past where it was last */
+#define CAMSHIFT_SEARCH_MARGIN 0.5
+/* a track is lost once less of its window than this passes the threshold */
+#define CAMSHIFT_MIN_COVERAGE 0.2
+#define CAMSHIFT_MAX_TRACKS 8
+#define CAMSHIFT_MAX_ITERATIONS 10
+
 // shape matching parameters
 #define SHAPE_MIN_CONTOUR_POINTS 40
 #define SHAPE_CANNY_EDGE_FIND 220
@@ -35,6 +46,15 @@
 #define NN_SQ_DIST_RATIO_THR 0.49
 #define SIFT_MIN_RANSAC_FEATURES 4
 
+// working resolution: on frames wider than this, these recognizers classify a smaller level
+// of the image pyramid (1/2, 1/4, ...) that is still at least this wide
+#define COLOR_WORKING_WIDTH 480
+#define BRIGHTNESS_WORKING_WIDTH 480
+#define CAMSHIFT_WORKING_WIDTH 480
+#define HAAR_WORKING_WIDTH 640
+#define SHAPE_WORKING_WIDTH 0	// always the full frame: its point count and PGH distances are in pixels
+#define SIFT_WORKING_WIDTH 640
+
 // Motion parameters
 /* history image and deltas are in frames, not seconds */
 #define MOTION_MHI_DURATION 10.0
@@ -59,6 +79,10 @@
 // clear out the trajectory after this many frames with no motion
 #define FLOW_INACTIVE_THRESHOLD 20
 
+// cascade parameters
+/* pixels added around each upstream bounding box before the next filter searches it */
+#define CASCADE_REGION_PADDING 8
+
 // OneDollar Recognizer class constants
 #define NumTemplates 16
 #define NumPoints 64
@@ -77,6 +101,16 @@
 // number of frames to discard at beginning before starting to build background model
 #define BACKGROUND_SUBTRACTION_DISCARD_FRAMES 5
 
+// offline processing of a file in parallel segments: segment boundaries fall on multiples of
+// the keyframe interval, and each segment is preceded by warm-up frames for the stateful filters
+#define SHARD_GOP_FRAMES 30
+#define SHARD_WARMUP_FRAMES 30
+
+// memory the per-frame result cache of recorded video may use before spilling to disk, and the
+// most its spill directory may hold (the files written longest ago are deleted to stay under it)
+#define RESULT_CACHE_MEMORY (64*1024*1024)
+#define RESULT_CACHE_DISK (512*1024*1024LL)
+
 // OSC parameters
 #define OSC_OUTPUT_BUFFER_SIZE 1024
 #define OSC_ADDRESS "127.0.0.1"
@@ -103,25 +137,34 @@
 #define FILTERLIBRARY_WIDTH 670
 
 // save recognizer: folder prefixes and file names
-#define FILE_FRIENDLY_NAME L"\\name.dat"
-#define FILE_DATA_NAME L"\\data.dat"
-#define FILE_THRESHOLD_NAME L"\\threshold.dat"
-#define FILE_CONTOUR_NAME L"\\data.xml"
-#define FILE_CASCADE_NAME L"\\classifier.xml"
-#define FILE_DEMOIMAGE_NAME L"\\demo-image.jpg"
-#define FILE_SIFTIMAGE_NAME L"\\sift-image.jpg"
+#ifdef _WIN32
+#define FILE_PATH_SEPARATOR L"\\"
+#else
+#define FILE_PATH_SEPARATOR L"/"
+#endif
+#define FILE_FRIENDLY_NAME FILE_PATH_SEPARATOR L"name.dat"
+#define FILE_DATA_NAME FILE_PATH_SEPARATOR L"data.dat"
+#define FILE_THRESHOLD_NAME FILE_PATH_SEPARATOR L"threshold.dat"
+#define FILE_CONTOUR_NAME FILE_PATH_SEPARATOR L"data.xml"
+#define FILE_PGH_NAME FILE_PATH_SEPARATOR L"pgh.dat"
+#define FILE_CASCADE_NAME FILE_PATH_SEPARATOR L"classifier.xml"
+#define FILE_DEMOIMAGE_NAME FILE_PATH_SEPARATOR L"demo-image.jpg"
+#define FILE_SIFTIMAGE_NAME FILE_PATH_SEPARATOR L"sift-image.jpg"
 #define FILE_CLASSIFIER_PREFIX L"epc"
-#define FILE_POSIMAGE_PREFIX L"\\pos"
-#define FILE_NEGIMAGE_PREFIX L"\\neg"
-#define FILE_MOTIMAGE_PREFIX L"\\mot"
-#define FILE_RNGIMAGE_PREFIX L"\\rng"
+#define FILE_RESULT_CACHE_DIR FILE_PATH_SEPARATOR L"cache"
+#define FILE_POSIMAGE_PREFIX FILE_PATH_SEPARATOR L"pos"
+#define FILE_NEGIMAGE_PREFIX FILE_PATH_SEPARATOR L"neg"
+#define FILE_MOTIMAGE_PREFIX FILE_PATH_SEPARATOR L"mot"
+#define FILE_RNGIMAGE_PREFIX FILE_PATH_SEPARATOR L"rng"
 #define FILE_IMAGE_EXT L".jpg"
 #define FILE_MOTIONIMAGE_EXT L".yml"
 #define FILE_MOTIONTRACK_EXT L".mtd"
 
 // save recognizer: folder suffixes
 #define FILE_BRIGHTNESS_SUFFIX L"_BRI"
+#define FILE_CAMSHIFT_SUFFIX L"_CAM"
 #define FILE_COLOR_SUFFIX L"_COL"
+#define FILE_COLOR_LUT_SUFFIX L"_LUT"
 #define FILE_GESTURE_SUFFIX L"_GES"
 #define FILE_HAAR_SUFFIX L"_APP"
 #define FILE_MOTION_SUFFIX L"_MOT"
@@ -136,6 +179,8 @@
 #define ADABOOST_FILTER		4
 #define MOTION_FILTER		5
 #define GESTURE_FILTER		6
+#define COLOR_LUT_FILTER	7
+#define CAMSHIFT_FILTER		8
 
 #define APP_CLASS L"Eyepatch"
 #define FILTER_CREATE_CLASS L"VideoMarkup"
@@ -153,7 +198,7 @@
 #define FILTER_BUILTIN 10001
 
 // Number of classifier types in the system
-#define NUM_FILTERS 7
+#define NUM_FILTERS 9
 
 // listview group IDs
 typedef enum {
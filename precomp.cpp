@@ -1,5 +1,6 @@
 #include "precomp.h"
 
+#ifndef EYEPATCH_HEADLESS
 void CopyImageToClipboard (IplImage* img) {
 	if ((img==NULL) || (img->nChannels != 3)) return;
 	if (::OpenClipboard(NULL)) {
@@ -32,8 +33,10 @@ void CopyImageToClipboard (IplImage* img) {
 		// GlobalFree (hMem) ; // Clipboard now owns the memory location, so we don't free it!
 	}
 }
+#endif
 
 void IplToBitmap(IplImage *src, Bitmap *dst) {
+#ifndef EYEPATCH_HEADLESS
     BitmapData bmData;
     bmData.Width = src->width;
     bmData.Height = src->height;
@@ -43,6 +46,25 @@ void IplToBitmap(IplImage *src, Bitmap *dst) {
     Rect sampleRect(0, 0, src->width, src->height);
     dst->LockBits(&sampleRect, ImageLockModeWrite | ImageLockModeUserInputBuf, PixelFormat24bppRGB, &bmData);
     dst->UnlockBits(&bmData);
+#endif
+}
+
+// Returns a scratch image of the requested format, reusing *img if it already matches
+// and (re)allocating it only on the first call or when the frame size changes.
+// Contents are not cleared, so callers must overwrite or zero the image themselves.
+IplImage* EnsureImage(IplImage **img, CvSize size, int depth, int channels) {
+    if ((*img != NULL) && ((*img)->width == size.width) && ((*img)->height == size.height) &&
+        ((*img)->depth == depth) && ((*img)->nChannels == channels)) {
+        return *img;
+    }
+    if (*img != NULL) cvReleaseImage(img);
+    *img = cvCreateImage(size, depth, channels);
+    return *img;
+}
+
+// Milliseconds on a monotonic clock, for timing parts of the pipeline
+double GetTimeMs() {
+	return (double)cvGetTickCount()/(cvGetTickFrequency()*1000.0);
 }
 
 CvScalar hsv2rgb( float hue ) {
@@ -81,7 +103,7 @@ CvScalar colorSwatch[COLOR_SWATCH_SIZE] = {
 };
 
 WCHAR *filterNames[] = { L"Color", L"Shape", L"Brightness", L"SIFT",
-							 L"Adaboost", L"Motion", L"Gesture" };
+							 L"Adaboost", L"Motion", L"Gesture", L"Color Table", L"CamShift" };
 
 void DrawArrow(IplImage *img, CvPoint center, double angleDegrees, double magnitude, CvScalar color, int thickness) {
 	CvPoint endpoint, arrowpoint;
@@ -118,6 +140,7 @@ void DrawTrack(IplImage *img, MotionTrack mt,  CvScalar color, int thickness, fl
     delete[] trackPoints;
 }
 
+#ifndef EYEPATCH_HEADLESS
 void DrawTrack(Graphics *graphics, MotionTrack mt, float width, float height, float squareSize) {
 	int nPoints = (int) mt.size();
 	PointF *trackPoints = new PointF[nPoints];
@@ -132,6 +155,7 @@ void DrawTrack(Graphics *graphics, MotionTrack mt, float width, float height, fl
 	}
     delete[] trackPoints;
 }
+#endif
 
 void SaveTrackToFile(MotionTrack mt, WCHAR *filename) {
 	USES_CONVERSION;
@@ -161,6 +185,7 @@ MotionTrack ReadTrackFromFile(WCHAR *filename) {
 	return mt;
 }
 
+#ifndef EYEPATCH_HEADLESS
 bool DeleteDirectory(LPCTSTR lpszDir, bool useRecycleBin = true) {
     int len = (int) _tcslen(lpszDir);
     TCHAR *pszFrom = new TCHAR[len+2];
@@ -187,3 +212,4 @@ bool DeleteDirectory(LPCTSTR lpszDir, bool useRecycleBin = true) {
     delete [] pszFrom;  
     return (ret == 0);
 }
+#endif
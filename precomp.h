@@ -1,5 +1,6 @@
 #pragma once
 
+#ifndef EYEPATCH_HEADLESS
 #define _WIN32_WINNT 0x0600
 #define WINVER 0x0600
 #define _WIN32_IE 0x0700
@@ -13,6 +14,7 @@
 #include <windowsx.h>
 #include <shfolder.h>
 #include <shlobj.h>
+#endif
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
@@ -22,35 +24,45 @@
 #define _USE_MATH_DEFINES
 #include <math.h>
 #include <float.h>
-#include <io.h>
 #include <time.h>
 
+#ifndef EYEPATCH_HEADLESS
+#include <io.h>
 #include <gdiplus.h>
 using namespace Gdiplus;
+#endif
 
 // STL includes
 #include <list>
 #include <map>
 #include <vector>
 #include <algorithm>
+#include <string>
 using namespace std;
 
+#ifndef EYEPATCH_HEADLESS
 // ATL includes
 #include <atlbase.h>
 #include <atltypes.h>
 #include <atlfile.h>
 #include <atlwin.h>
+#else
+// stand-ins for the Windows types used by the recognizer core
+#include "Portable.h"
+#endif
 
 // OpenCV Includes
 #include "cv.h"
 #include "highgui.h"
 #include "cvaux.h"
 
+#ifndef EYEPATCH_HEADLESS
 // Haar Training Includes
 #include "CVHaar/_cvcommon.h"
 #include "CVHaar/_cvhaartraining.h"
 #include "CVHaar/cvhaartraining.h"
 #include "CVHaar/cvclassifier.h"
+#endif
 
 // SIFT includes
 #include "SIFT/sift.h"
@@ -62,18 +74,28 @@ using namespace std;
 // Gesture Tracking includes
 #include "Gesture/OneDollar.h"
 typedef vector<OneDollarPoint> MotionTrack;
+#ifndef EYEPATCH_HEADLESS
 #include "Gesture/FlowTracker.h"
+#endif
 
+#ifndef EYEPATCH_HEADLESS
 // Tesseract OCR includes
 #include "tessdll.h"
+#endif
 
 // Utility functions
+#ifndef EYEPATCH_HEADLESS
 void CopyImageToClipboard (IplImage* img);
+#endif
 void IplToBitmap(IplImage *src, Bitmap *dst);
+IplImage* EnsureImage(IplImage **img, CvSize size, int depth, int channels);
+double GetTimeMs();
 CvScalar hsv2rgb(float hue);
 void DrawArrow(IplImage *img, CvPoint center, double angleDegrees, double magnitude, CvScalar color, int thickness=1);
 void DrawTrack(IplImage *img, MotionTrack mt, CvScalar color, int thickness, float squareSize, int maxPointsToDraw=0);
+#ifndef EYEPATCH_HEADLESS
 void DrawTrack(Graphics *graphics, MotionTrack mt, float width, float height, float squareSize);
+#endif
 bool DeleteDirectory(LPCTSTR lpszDir, bool useRecycleBin);
 void SaveTrackToFile(MotionTrack mt, WCHAR *filename);
 MotionTrack ReadTrackFromFile (WCHAR* filename);